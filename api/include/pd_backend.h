@@ -88,6 +88,10 @@ typedef enum PDEventType {
 
     PDEventType_ToggleBreakpointCurrentLine,
 
+    // Sent by the backend when the state of the target has changed (see PDStateChange below)
+
+    PDEventType_StateChanged,
+
     // End of events
 
     PDEventType_End,
@@ -97,6 +101,105 @@ typedef enum PDEventType {
 
 } PDEventType;
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Get* events can optionally include a request id (u32) with this key. The backend writes the same id back in the
+// Set* event it replies with so the sender can match up replies when it has several requests in flight (or when
+// several views send the same kind of request.) Events without an id works as before.
+//
+// uint32_t requestId;
+//
+// if (PDRead_find_u32(reader, &requestId, PD_REQUEST_ID, 0) != PDReadStatus_NotFound)
+//     PDWrite_u32(writer, PD_REQUEST_ID, requestId);
+
+#define PD_REQUEST_ID "request_id"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// GetMemory/SetMemory can optionally include the address space (u32) for targets that has more than one (such as
+// several CPUs or memory banks.) Address space 0 is used when not present.
+
+#define PD_ADDRESS_SPACE "address_space"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Instead of having the views ask for locals, callstack, etc every frame backends can tell them when something has
+// changed with a StateChanged event:
+//
+// PD_STATE_EPOCH   (u32) increased by the backend each time it sends the event
+// PD_STATE_CHANGED (u32) PDStateChange bits of what changed since the previous epoch
+// PD_STATE_MEMORY  (optional array of "address_start" (u64) and "size" (u64)) the memory ranges that changed if
+//                  PDStateChange_Memory is set. If not present all memory should be seen as changed.
+//
+// The session keeps the last StateChanged event and gives it to the views each frame (until a new one arrives) so
+// views opened later still see the current epoch. Views only request data when the epoch advances with any of the
+// bits they care about. Until a view has seen a StateChanged event it keeps requesting data as before so backends
+// that doesn't send it still works (see PDStateTracker.)
+
+typedef enum PDStateChange {
+    PDStateChange_Registers = 1 << 0,
+    PDStateChange_Memory = 1 << 1,
+    PDStateChange_Threads = 1 << 2,
+    PDStateChange_Modules = 1 << 3,
+    PDStateChange_Callstack = 1 << 4,
+    PDStateChange_Locals = 1 << 5,
+    PDStateChange_ExceptionLocation = 1 << 6,
+    PDStateChange_All = 0x7f
+} PDStateChange;
+
+#define PD_STATE_EPOCH "epoch"
+#define PD_STATE_CHANGED "changed"
+#define PD_STATE_MEMORY "memory_ranges"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Helper for views to track the epoch. Zero initialize it and call PDStateTracker_update for each StateChanged event
+// then check PDStateTracker_should_request before sending a request
+
+typedef struct PDStateTracker {
+    uint32_t epoch;
+    uint32_t changed;   // bits that changed since the view last requested data for them
+    int active;         // set when the backend has sent a StateChanged event
+} PDStateTracker;
+
+// Returns the bits that changed if the epoch is new (0 otherwise.) The first event seen is treated as everything
+// having changed as the view has no data yet. The epoch is only compared for equality so a backend that is
+// restarted (and starts over from 0) is handled as well.
+
+static PD_INLINE uint32_t PDStateTracker_update(PDStateTracker* tracker, PDReader* reader) {
+    uint32_t epoch = 0;
+    uint32_t changed = PDStateChange_All;
+
+    PDRead_find_u32(reader, &epoch, PD_STATE_EPOCH, 0);
+    PDRead_find_u32(reader, &changed, PD_STATE_CHANGED, 0);
+
+    if (!tracker->active) {
+        tracker->active = 1;
+        tracker->epoch = epoch;
+        tracker->changed = PDStateChange_All;
+        return PDStateChange_All;
+    }
+
+    if (tracker->epoch == epoch)
+        return 0;
+
+    tracker->epoch = epoch;
+    tracker->changed |= changed;
+
+    return changed;
+}
+
+// Returns non-zero if any of the bits in mask has changed (and clears them.) Always returns non-zero if the backend
+// hasn't sent any StateChanged events.
+
+static PD_INLINE int PDStateTracker_should_request(PDStateTracker* tracker, uint32_t mask) {
+    if (!tracker->active)
+        return 1;
+
+    if (!(tracker->changed & mask))
+        return 0;
+
+    tracker->changed &= ~mask;
+
+    return 1;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 typedef struct PDBackendPlugin {
@@ -31,6 +31,15 @@ struct PDPluginBase {
 #define PD_EXPORT
 #endif
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// For the small helper functions in the headers (MSVC doesn't know about inline in C)
+
+#if defined(_MSC_VER) && !defined(__cplusplus)
+#define PD_INLINE __inline
+#else
+#define PD_INLINE inline
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #ifdef _cplusplus
@@ -38,6 +38,40 @@ typedef struct PDSettingsFuncs {
 	uint32_t (*get_shortcut)(const char* plugin_id, const char* operation);
 } PDSettingsFuncs;
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Memory of the target shared by all views in a session. The memory is cached in pages and the pages that are
+// missing (or out of date because the target has been running) are requested from the backend by the session so
+// views doesn't need to send GetMemory themselves. Several views showing the same memory only costs one fetch.
+//
+// The functions works on the session of the view that is being updated so only call them from the update function.
+
+#define PDMEMORYCACHE_GLOBAL "Memory Cache 1"
+
+typedef struct PDMemoryCacheFuncs {
+	// Copies the memory to dest. Returns non-zero if all of it was up to date. Pages that are missing or out of date
+	// are requested and will be there in a later update. Out of date pages are still copied (so the old memory can be
+	// shown until the new one arrives) while dest is left as is for pages the cache has never had.
+	int (*read)(uint32_t address_space, uint64_t address, void* dest, uint64_t size);
+
+	// Increased each time memory arrives or is invalidated so views only needs to read again when it changes
+	uint32_t (*get_change_count)(void);
+} PDMemoryCacheFuncs;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Scoped CPU samples shown in the profiler of ProDBG (Remotery.) The service is only there (non-zero) when ProDBG has
+// been started with profiling enabled so plugins that doesn't get it can skip their samples.
+
+#define PDPROFILER_GLOBAL "Profiler 1"
+
+typedef struct PDProfilerFuncs {
+	// Starts a sample. The name must stay valid as long as the plugin is loaded. hash_cache is where the hash of the
+	// name is kept between calls (one for each name) and can be 0 (which is slower)
+	void (*begin_sample)(const char* name, uint32_t* hash_cache);
+
+	// Ends the last sample started on this thread
+	void (*end_sample)(void);
+} PDProfilerFuncs;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #ifdef __cplusplus
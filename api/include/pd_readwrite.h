@@ -46,6 +46,12 @@ typedef enum PDReadType {
     PDReadType_Array,
     /// Array type
     PDReadType_ArrayEntry,
+    /// Arrays of numbers (stored in little endian, see PDWriter::write_u8_array)
+    PDReadType_U8Array,
+    PDReadType_U16Array,
+    PDReadType_U32Array,
+    PDReadType_U64Array,
+    PDReadType_FloatArray,
     /// total count of types
     PDReadType_Count
 } PDReadType;
@@ -116,13 +122,18 @@ typedef struct PDWriter {
     PDWriteStatus (*write_event_end)(struct PDWriter* writer);
 
     /**
-     *
-     * NOTICE THAT THIS IS NOT IMPLEMENTED YET.
      *
      * Begins an table with a predefined structure. This is useful when writing
      * a table where all the entries are the same all the time. So in order to save both
      * CPU time and bandwith it's possible to begin an array with a fixed number of slots for
-     * each entry.
+     * each entry. The key names are only written once and each row has the same size so readers
+     * can step through the rows without searching.
+     *
+     * The header array must be the first thing written after PDWriter::write_array_begin and
+     * it replaces the array entries so PDReader::read_next_entry will step over the rows and the
+     * regular find functions can be used on each row. The types of the columns are decided by the
+     * first row and all values has to be written (in the same order as the ids) for each row.
+     * Only numeric types and strings are supported (no data or arrays.)
      *
      * \warning
      * It's worth note when using this minimal error checking will be done when writing
@@ -146,6 +157,7 @@ typedef struct PDWriter {
      *
      * ...
      *
+     * PDWrite_array_begin(writer, "disassembly");
      * PDWrite_header_array_begin(writer, ids);
      *
      * for (i to addressCount)
@@ -155,6 +167,7 @@ typedef struct PDWriter {
      * }
      *
      * PDWrite_header_array_end(writer);
+     * PDWrite_array_end(writer);
      *
      * \endcode
      *
@@ -378,6 +391,55 @@ typedef struct PDWriter {
      */
     PDWriteStatus (*write_data)(struct PDWriter* writer, const char* id, void* data, unsigned int len);
 
+    /**
+     *
+     * Same as PDWriter::write_data except that the data isn't copied into the writer. Only the pointer is stored
+     * and readers in the same process gets the original pointer back. When sent to another process the data is
+     * sent directly from the pointer. Useful for large blocks (memory, traces) to avoid copies.
+     *
+     * The data must stay valid until the writer is done with it at which point the release callback is called
+     * (which is also the case if the write fails.) Release can be NULL if the data doesn't need to be released.
+     *
+     * @param writer writer object
+     * @param id key to associate the value with
+     * @param data data to reference
+     * @param len size in bytes of the data
+     * @param release called with user_data and data when the writer is done with the data
+     * @param user_data passed to release
+     *
+     * \code
+     * static void releaseMemory(void* user_data, void* data) {
+     *     free(user_data);
+     * }
+     *
+     * PDWrite_data_ref(writer, "data", memory + 2, size, releaseMemory, memory);
+     * \endcode
+     *
+     */
+    PDWriteStatus (*write_data_ref)(struct PDWriter* writer, const char* id, void* data, unsigned int len,
+                                    void (*release)(void* user_data, void* data), void* user_data);
+
+    /**
+     *
+     * Writes an array of numbers. This is much more compact than writing each value as its own
+     * key/value (which has a header for each value) and the data is stored in native (little endian) order
+     * aligned to the size of the type so readers can use the data directly. Use for things like memory pages
+     * or register banks.
+     *
+     * @param writer writer object
+     * @param id key to associate the array with
+     * @param data values to write
+     * @param count number of values (not bytes)
+     *
+     */
+    ///@{
+    PDWriteStatus (*write_u8_array)(struct PDWriter* writer, const char* id, const uint8_t* data, unsigned int count);
+    PDWriteStatus (*write_u16_array)(struct PDWriter* writer, const char* id, const uint16_t* data, unsigned int count);
+    PDWriteStatus (*write_u32_array)(struct PDWriter* writer, const char* id, const uint32_t* data, unsigned int count);
+    PDWriteStatus (*write_u64_array)(struct PDWriter* writer, const char* id, const uint64_t* data, unsigned int count);
+    PDWriteStatus (*write_f32_array)(struct PDWriter* writer, const char* id, const float* data, unsigned int count);
+    ///@}
+
 } PDWriter;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -539,6 +601,104 @@ typedef struct PDReader {
      */
     void (*read_dump_data)(struct PDReader* reader);
 
+    /**
+     *
+     * Returns the number of entries in an array (or rows if it's a header array)
+     *
+     * @param reader The reader object.
+     * @param arrayIt Iterator to the array. Must be the iterator given back from PDRead_find_array
+     * @return number of entries
+     *
+     */
+    uint32_t (*read_array_count)(struct PDReader* reader, PDReaderIterator arrayIt);
+
+    /**
+     *
+     * Gets the entry at the given index in an array without having to step over all entries before it. This is
+     * useful for views that only shows a part of a large array. The entry iterator is the same as
+     * PDReader::read_next_entry would give back so it's possible to continue stepping from it.
+     *
+     * @param reader The reader object.
+     * @param entryIt Iterator to the entry that can be used with the find functions
+     * @param arrayIt Iterator to the array. Must be the iterator given back from PDRead_find_array
+     * @param index Index of the entry
+     * @return PDReadStatus_Ok | PDReadType_ArrayEntry on success or PDReadStatus_NotFound if index is out of range
+     *
+     * \code
+     *
+     * PDRead_find_array(reader, &arrayIt, "disassembly", 0);
+     *
+     * for (i = firstVisible; i < firstVisible + visibleCount && i < PDRead_array_count(reader, arrayIt); ++i)
+     * {
+     *    PDRead_array_at(reader, &entryIt, arrayIt, i);
+     *    PDRead_find_u64(reader, &address, "address", entryIt);
+     * }
+     *
+     * \endcode
+     *
+     */
+    uint32_t (*read_array_entry_at)(struct PDReader* reader, PDReaderIterator* entryIt, PDReaderIterator arrayIt, uint32_t index);
+
+    /**
+     *
+     * Finds an array of numbers written with PDWriter::write_u8_array (etc.) The result points directly into the
+     * stream (no copy.) The values are stored little endian and aligned relative to the start of the stream so this
+     * only works when the stream is in memory at a suitable alignment on a little endian host. Streams received
+     * from another process (such as a remote backend) may not be, use the read_copy_*_array functions for those.
+     * The type must match exactly, no conversion is done.
+     *
+     * @param reader The reader object.
+     * @param res Pointer to the values (0 if they can't be used in place)
+     * @param count Number of values in the array
+     * @param id key of the array
+     * @param it iterator to search within (0 for the current event)
+     * @return Same as the other find functions and PDReadStatus_Fail if the values can't be used in place
+     *
+     */
+    ///@{
+    uint32_t (*read_find_u8_array)(struct PDReader* reader, const uint8_t** res, uint32_t* count, const char* id, PDReaderIterator it);
+    uint32_t (*read_find_u16_array)(struct PDReader* reader, const uint16_t** res, uint32_t* count, const char* id, PDReaderIterator it);
+    uint32_t (*read_find_u32_array)(struct PDReader* reader, const uint32_t** res, uint32_t* count, const char* id, PDReaderIterator it);
+    uint32_t (*read_find_u64_array)(struct PDReader* reader, const uint64_t** res, uint32_t* count, const char* id, PDReaderIterator it);
+    uint32_t (*read_find_f32_array)(struct PDReader* reader, const float** res, uint32_t* count, const char* id, PDReaderIterator it);
+    ///@}
+
+    /**
+     *
+     * Makes PDRead_get_event only return the given event types. The other events are skipped without being looked
+     * at so a view that only cares about a few events doesn't need to walk past large ones (such as memory or source
+     * files.) The events are still returned in the order they are in the stream. Setting the filter moves the reader
+     * back to the first event and the filter is kept when the reader gets a new stream. Views can also set this up front with PDViewPlugin::event_types.
+     *
+     * @param reader The reader object.
+     * @param events The event types to return
+     * @param count Number of event types (0 removes the filter so all events are returned again)
+     *
+     */
+    void (*read_set_event_filter)(struct PDReader* reader, const uint16_t* events, uint32_t count);
+
+    /**
+     *
+     * Copies an array of numbers written with PDWriter::write_u8_array (etc.) to dest in the byte order of the host.
+     * Works for any stream regardless of how it is aligned in memory. The type must match exactly.
+     *
+     * @param reader The reader object.
+     * @param dest Where to copy the values
+     * @param maxCount Max number of values to copy to dest
+     * @param count Number of values in the array (can be more than maxCount)
+     * @param id key of the array
+     * @param it iterator to search within (0 for the current event)
+     * @return Same as the other find functions
+     *
+     */
+    ///@{
+    uint32_t (*read_copy_u8_array)(struct PDReader* reader, uint8_t* dest, uint32_t maxCount, uint32_t* count, const char* id, PDReaderIterator it);
+    uint32_t (*read_copy_u16_array)(struct PDReader* reader, uint16_t* dest, uint32_t maxCount, uint32_t* count, const char* id, PDReaderIterator it);
+    uint32_t (*read_copy_u32_array)(struct PDReader* reader, uint32_t* dest, uint32_t maxCount, uint32_t* count, const char* id, PDReaderIterator it);
+    uint32_t (*read_copy_u64_array)(struct PDReader* reader, uint64_t* dest, uint32_t maxCount, uint32_t* count, const char* id, PDReaderIterator it);
+    uint32_t (*read_copy_f32_array)(struct PDReader* reader, float* dest, uint32_t maxCount, uint32_t* count, const char* id, PDReaderIterator it);
+    ///@}
+
 } PDReader;
 
 
@@ -568,6 +728,12 @@ typedef struct PDReader {
 #define PDWrite_double(w, id, v) w->write_double(w, id, v)
 #define PDWrite_string(w, id, v) w->write_string(w, id, v)
 #define PDWrite_data(w, id, data, len) w->write_data(w, id, data, len)
+#define PDWrite_data_ref(w, id, data, len, release, user_data) w->write_data_ref(w, id, data, len, release, user_data)
+#define PDWrite_u8_array(w, id, data, count) w->write_u8_array(w, id, data, count)
+#define PDWrite_u16_array(w, id, data, count) w->write_u16_array(w, id, data, count)
+#define PDWrite_u32_array(w, id, data, count) w->write_u32_array(w, id, data, count)
+#define PDWrite_u64_array(w, id, data, count) w->write_u64_array(w, id, data, count)
+#define PDWrite_f32_array(w, id, data, count) w->write_f32_array(w, id, data, count)
 
 /**
  *
@@ -576,6 +742,7 @@ typedef struct PDReader {
  */
 
 #define PDRead_get_event(r) r->read_get_event(r)
+#define PDRead_set_event_filter(r, events, count) r->read_set_event_filter(r, events, count)
 #define PDRead_get_next_entry(r, it) r->read_next_entry(r, it)
 #define PDRead_iterator_begin(r, it, keyName, parentIt) r->read_iterator_begin(r, it, keyName, parentIt)
 #define PDRead_iterator_Next(r, keyName, it) r->read_iterator_next(r, keyName, it)
@@ -593,6 +760,18 @@ typedef struct PDReader {
 #define PDRead_find_data(r, res, size, id, it) r->read_find_data(r, res, size, id, it)
 #define PDRead_find_array(r, arrayIt, id, it) r->read_find_array(r, arrayIt, id, it)
 #define PDRead_dump_data(r) r->read_dump_data(r)
+#define PDRead_array_count(r, arrayIt) r->read_array_count(r, arrayIt)
+#define PDRead_array_at(r, entryIt, arrayIt, index) r->read_array_entry_at(r, entryIt, arrayIt, index)
+#define PDRead_find_u8_array(r, res, count, id, it) r->read_find_u8_array(r, res, count, id, it)
+#define PDRead_find_u16_array(r, res, count, id, it) r->read_find_u16_array(r, res, count, id, it)
+#define PDRead_find_u32_array(r, res, count, id, it) r->read_find_u32_array(r, res, count, id, it)
+#define PDRead_find_u64_array(r, res, count, id, it) r->read_find_u64_array(r, res, count, id, it)
+#define PDRead_find_f32_array(r, res, count, id, it) r->read_find_f32_array(r, res, count, id, it)
+#define PDRead_copy_u8_array(r, dest, maxCount, count, id, it) r->read_copy_u8_array(r, dest, maxCount, count, id, it)
+#define PDRead_copy_u16_array(r, dest, maxCount, count, id, it) r->read_copy_u16_array(r, dest, maxCount, count, id, it)
+#define PDRead_copy_u32_array(r, dest, maxCount, count, id, it) r->read_copy_u32_array(r, dest, maxCount, count, id, it)
+#define PDRead_copy_u64_array(r, dest, maxCount, count, id, it) r->read_copy_u64_array(r, dest, maxCount, count, id, it)
+#define PDRead_copy_f32_array(r, dest, maxCount, count, id, it) r->read_copy_f32_array(r, dest, maxCount, count, id, it)
 
 #ifdef __cplusplus
 }
@@ -21,6 +21,36 @@ struct PDBackendPlugin;
 
 int PDRemote_create(struct PDBackendPlugin* plugin, int waitForConnection);
 
+/**
+ * \brief Same as PDRemote_create but talks to the debugger over shared memory
+ *
+ * Use this when the debugger runs on the same machine as the target. The data is the same as over the socket but
+ * is passed in shared memory ring buffers which avoids the syscalls and copies of going over loopback TCP.
+ * ProDBG connects to it with the Remote Backend using the address "shm:1340". Only supported on Linux, returns 0
+ * on other platforms.
+ *
+ * \param plugin Pointer to a backend plugin. This needs to be filled in according to the doc of PDBackendPlugin
+ * \param waitForConnection Number of seconds to wait for a connection from the Debugger. 0 if no waiting
+ * \return returns 1 on success otherwise 0
+ */
+
+int PDRemote_createShared(struct PDBackendPlugin* plugin, int waitForConnection);
+
+/**
+ * \brief Same as PDRemote_create but the connection is handled on a background thread
+ *
+ * The background thread owns the socket and waits for data from the debugger so the target doesn't need to poll
+ * the connection. The backend is still updated on the thread calling PDRemote_update (as it needs to access the
+ * state of the target) but the target only needs to call it when PDRemote_hasPendingRequest returns true or
+ * when it's stopped, so it can run at full speed until the debugger actually wants something.
+ *
+ * \param plugin Pointer to a backend plugin. This needs to be filled in according to the doc of PDBackendPlugin
+ * \param waitForConnection Number of seconds to wait for a connection from the Debugger. 0 if no waiting
+ * \return returns 1 on success otherwise 0
+ */
+
+int PDRemote_createThreaded(struct PDBackendPlugin* plugin, int waitForConnection);
+
 /**
  * \brief Updates the connection
  *
@@ -53,6 +83,19 @@ int PDRemote_update(int sleepTime);
 
 int PDRemote_isConnected();
 
+/**
+ * \brief Check if PDRemote_update needs to be called
+ *
+ * When created with PDRemote_createThreaded this returns TRUE when the debugger has sent something (such as a break
+ * request) that hasn't been handled by PDRemote_update yet. It's only an atomic load so it can be called for every
+ * instruction. In the other modes the connection needs to be polled so this always returns TRUE.
+ *
+ * \returns TRUE if PDRemote_update should be called otherwise FALSE
+ *
+ */
+
+int PDRemote_hasPendingRequest();
+
 /**
  * \brief Destroys the current connection and listener server.
  *
@@ -63,6 +106,86 @@ int PDRemote_isConnected();
 
 void PDRemote_destroy();
 
+/**
+ * \brief Flags for PDRemote_createInstance
+ */
+
+enum PDRemoteFlags {
+    PDRemoteFlags_Threaded = 1 << 0,        // same as PDRemote_createThreaded
+    PDRemoteFlags_SharedMemory = 1 << 1,    // same as PDRemote_createShared
+    PDRemoteFlags_Compression = 1 << 2,     // compress larger replies if the debugger supports it (not used with shared memory)
+};
+
+struct PDRemote;
+
+/**
+ * \brief Creates a remote instance that the debugger can connect to
+ *
+ * The PDRemote_create functions above uses one instance on port 1340. Use this when more than one target (or
+ * backend) in the same process should be debugged or when the port needs to be something else. Each instance
+ * has its own instance of the backend and accepts several debuggers at the same time. Requests from a debugger
+ * are answered to that debugger only while updates the backend does on its own are sent to all of them.
+ *
+ * \param plugin Pointer to a backend plugin. This needs to be filled in according to the doc of PDBackendPlugin
+ * \param port Port to listen on. 0 lets the OS pick a free port which can be fetched with PDRemote_getPort
+ * \param flags Combination of PDRemoteFlags
+ * \return returns the new instance or NULL on failure
+ */
+
+struct PDRemote* PDRemote_createInstance(struct PDBackendPlugin* plugin, int port, int flags);
+
+/**
+ * \brief Returns the port the instance is listening on (or the id of the shared memory region)
+ */
+
+int PDRemote_getPort(struct PDRemote* remote);
+
+/**
+ * \brief Same as PDRemote_update, PDRemote_isConnected and PDRemote_hasPendingRequest for a given instance
+ */
+
+int PDRemote_updateInstance(struct PDRemote* remote, int sleepTime);
+int PDRemote_isInstanceConnected(struct PDRemote* remote);
+int PDRemote_instanceHasPendingRequest(struct PDRemote* remote);
+
+/**
+ * \brief Lanes used when sending data to the debugger
+ *
+ * Replies up to 64k are sent on the control lane. Larger replies (such as big memory ranges) are sent in chunks on
+ * the bulk lane which are only written when there is nothing on the control lane, so replies to break/step actions
+ * doesn't have to wait for them.
+ */
+
+enum PDRemoteLane {
+    PDRemoteLane_Control,
+    PDRemoteLane_Bulk,
+};
+
+/**
+ * \brief Returns the number of bytes in a lane that are waiting to be sent
+ *
+ * Can be used to see if the connection keeps up with what the backend sends. Always 0 when using shared memory.
+ */
+
+int PDRemote_getQueueDepth(struct PDRemote* remote, enum PDRemoteLane lane);
+
+/**
+ * \brief Records all requests, actions and replies of the instance to a capture file
+ *
+ * The file can be played back with the replay backend to reproduce a session without the target. Starting a new
+ * capture closes the current one. Needs to be called on the same thread as PDRemote_updateInstance. Returns 0 if
+ * the file can't be created.
+ */
+
+int PDRemote_startCapture(struct PDRemote* remote, const char* filename);
+void PDRemote_stopCapture(struct PDRemote* remote);
+
+/**
+ * \brief Destroys an instance created with PDRemote_createInstance and closes all connections to it
+ */
+
+void PDRemote_destroyInstance(struct PDRemote* remote);
+
 #ifdef __cplusplus
 }
 #endif
@@ -17,7 +17,7 @@ struct PDLoadState;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define PD_VIEW_API_VERSION "ProDBG View 1"
+#define PD_VIEW_API_VERSION "ProDBG View 2"
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -34,6 +34,11 @@ typedef struct PDViewPlugin {
 	int (*save_state)(void* user_data, struct PDSaveState* save_state);
 	int (*load_state)(void* user_data, struct PDLoadState* load_state);
 
+	// Events the view wants to get in its reader, ended with PDEventType_None. If 0 the view gets all events and if
+	// the list is empty it gets none. This is the same as calling PDRead_set_event_filter on the reader (which can
+	// also be used to change it later.)
+	const uint16_t* event_types;
+
 } PDViewPlugin;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
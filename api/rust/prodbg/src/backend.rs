@@ -5,6 +5,40 @@ use std::mem::transmute;
 
 pub static BACKEND_API_VERSION: &'static [u8] = b"ProDBG Backend 1\0";
 
+/// PDEventType_Action (the PDAction is written as u32 in ACTION)
+pub const EVENT_ACTION: u16 = 30;
+/// PDEventType_StateChanged (see pd_backend.h for the fields)
+pub const EVENT_STATE_CHANGED: u16 = 37;
+
+pub static ACTION: &'static str = "action";
+
+pub static STATE_EPOCH: &'static str = "epoch";
+pub static STATE_CHANGED: &'static str = "changed";
+pub static STATE_MEMORY: &'static str = "memory_ranges";
+
+/// PDStateChange bits for STATE_CHANGED
+pub mod state_change {
+    pub const REGISTERS: u32 = 1 << 0;
+    pub const MEMORY: u32 = 1 << 1;
+    pub const THREADS: u32 = 1 << 2;
+    pub const MODULES: u32 = 1 << 3;
+    pub const CALLSTACK: u32 = 1 << 4;
+    pub const LOCALS: u32 = 1 << 5;
+    pub const EXCEPTION_LOCATION: u32 = 1 << 6;
+    pub const ALL: u32 = 0x7f;
+}
+
+/// PDAction
+pub mod action {
+    pub const NONE: u32 = 0;
+    pub const STOP: u32 = 1;
+    pub const BREAK: u32 = 2;
+    pub const RUN: u32 = 3;
+    pub const STEP: u32 = 4;
+    pub const STEP_OUT: u32 = 5;
+    pub const STEP_OVER: u32 = 6;
+}
+
 pub trait Backend {
     fn new(service: &Service) -> Self;
     fn update(&mut self, action: i32, reader: &mut Reader, writer: &mut Writer);
@@ -1,5 +1,7 @@
 use libc::*;
 use std::mem::transmute;
+use std::ptr;
+use std::slice;
 use CFixedString;
 
 #[repr(C)]
@@ -42,6 +44,30 @@ pub struct CPDReaderAPI {
     pub read_find_array: extern fn(reader: *mut c_void, arrayIt: *mut uint64_t, id: *const c_char,
                                    it: uint64_t) -> uint32_t,
     pub read_dump_data: extern fn(reader: *mut c_void),
+    pub read_array_count: extern fn(reader: *mut c_void, arrayIt: uint64_t) -> uint32_t,
+    pub read_array_entry_at: extern fn(reader: *mut c_void, entryIt: *mut uint64_t, arrayIt: uint64_t,
+                                       index: uint32_t) -> uint32_t,
+    pub read_find_u8_array: extern fn(reader: *mut c_void, res: *mut *const uint8_t, count: *mut uint32_t,
+                                      id: *const c_char, it: uint64_t) -> uint32_t,
+    pub read_find_u16_array: extern fn(reader: *mut c_void, res: *mut *const uint16_t, count: *mut uint32_t,
+                                       id: *const c_char, it: uint64_t) -> uint32_t,
+    pub read_find_u32_array: extern fn(reader: *mut c_void, res: *mut *const uint32_t, count: *mut uint32_t,
+                                       id: *const c_char, it: uint64_t) -> uint32_t,
+    pub read_find_u64_array: extern fn(reader: *mut c_void, res: *mut *const uint64_t, count: *mut uint32_t,
+                                       id: *const c_char, it: uint64_t) -> uint32_t,
+    pub read_find_f32_array: extern fn(reader: *mut c_void, res: *mut *const c_float, count: *mut uint32_t,
+                                       id: *const c_char, it: uint64_t) -> uint32_t,
+    pub read_set_event_filter: extern fn(reader: *mut c_void, events: *const uint16_t, count: uint32_t),
+    pub read_copy_u8_array: extern fn(reader: *mut c_void, dest: *mut uint8_t, max_count: uint32_t,
+                                      count: *mut uint32_t, id: *const c_char, it: uint64_t) -> uint32_t,
+    pub read_copy_u16_array: extern fn(reader: *mut c_void, dest: *mut uint16_t, max_count: uint32_t,
+                                       count: *mut uint32_t, id: *const c_char, it: uint64_t) -> uint32_t,
+    pub read_copy_u32_array: extern fn(reader: *mut c_void, dest: *mut uint32_t, max_count: uint32_t,
+                                       count: *mut uint32_t, id: *const c_char, it: uint64_t) -> uint32_t,
+    pub read_copy_u64_array: extern fn(reader: *mut c_void, dest: *mut uint64_t, max_count: uint32_t,
+                                       count: *mut uint32_t, id: *const c_char, it: uint64_t) -> uint32_t,
+    pub read_copy_f32_array: extern fn(reader: *mut c_void, dest: *mut c_float, max_count: uint32_t,
+                                       count: *mut uint32_t, id: *const c_char, it: uint64_t) -> uint32_t,
 }
 
 #[repr(C)]
@@ -76,6 +102,20 @@ pub struct CPDWriterAPI {
                              -> WriteStatus,
     pub write_data: extern fn(w: *mut c_void, id: *const c_char, d: *const uint8_t, l: c_uint)
                             -> WriteStatus,
+    pub write_data_ref: extern fn(w: *mut c_void, id: *const c_char, d: *mut c_void, l: c_uint,
+                                  release: Option<extern fn(user_data: *mut c_void, data: *mut c_void)>,
+                                  user_data: *mut c_void)
+                                -> WriteStatus,
+    pub write_u8_array: extern fn(w: *mut c_void, id: *const c_char, d: *const uint8_t, count: c_uint)
+                                -> WriteStatus,
+    pub write_u16_array: extern fn(w: *mut c_void, id: *const c_char, d: *const uint16_t, count: c_uint)
+                                 -> WriteStatus,
+    pub write_u32_array: extern fn(w: *mut c_void, id: *const c_char, d: *const uint32_t, count: c_uint)
+                                 -> WriteStatus,
+    pub write_u64_array: extern fn(w: *mut c_void, id: *const c_char, d: *const uint64_t, count: c_uint)
+                                 -> WriteStatus,
+    pub write_f32_array: extern fn(w: *mut c_void, id: *const c_char, d: *const c_float, count: c_uint)
+                                 -> WriteStatus,
 }
 
 pub struct Reader {
@@ -106,6 +146,11 @@ pub enum ReadType {
     Event,
     Array,
     ArrayEntry,
+    U8Array,
+    U16Array,
+    U32Array,
+    U64Array,
+    FloatArray,
     Count,
 }
 
@@ -121,6 +166,7 @@ pub enum ReadStatus {
 
 pub struct ReaderIter {
     reader: Reader,
+    array_iter: u64,
     curr_iter: u64,
 }
 
@@ -159,6 +205,46 @@ macro_rules! find_fun {
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+macro_rules! find_array_fun {
+    ($c_name:ident, $name:ident, $data_type:ident) => {
+        /// The slice points directly into the stream so it's only valid as long as the stream is. Fails if the
+        /// values aren't aligned in memory (use the copy_*_array functions for streams from other processes)
+        pub fn $name(&self, id: &str) -> Result<&[$data_type], ReadStatus> {
+            let s = CFixedString::from_str(id).as_ptr();
+            let mut res: *const $data_type = ptr::null();
+            let mut count = 0u32;
+            let ret;
+
+            unsafe {
+                ret = ((*self.api).$c_name)(transmute(self.api), &mut res, &mut count, s, self.it);
+                status_res((), ret).map(|_| slice::from_raw_parts(res, count as usize))
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+macro_rules! copy_array_fun {
+    ($c_name:ident, $name:ident, $data_type:ident) => {
+        /// Copies up to dest.len() values and returns the number of values in the array
+        pub fn $name(&self, id: &str, dest: &mut [$data_type]) -> Result<usize, ReadStatus> {
+            let s = CFixedString::from_str(id).as_ptr();
+            let mut count = 0u32;
+            let ret;
+
+            unsafe {
+                ret = ((*self.api).$c_name)(transmute(self.api), dest.as_mut_ptr(), dest.len() as uint32_t,
+                                            &mut count, s, self.it);
+            }
+
+            status_res(count as usize, ret)
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 impl Reader {
     pub fn new(in_api: *mut CPDReaderAPI, iter: u64) -> Self {
         return Reader {
@@ -178,6 +264,13 @@ impl Reader {
         }
     }
 
+    /// Only return these events from get_event (all events are returned if empty)
+    pub fn set_event_filter(&mut self, events: &[u16]) {
+        unsafe {
+            ((*self.api).read_set_event_filter)(transmute(self.api), events.as_ptr(), events.len() as uint32_t)
+        }
+    }
+
     find_fun!(read_find_s8, find_s8, i8);
     find_fun!(read_find_u8, find_u8, u8);
     find_fun!(read_find_s16, find_s16, i16);
@@ -189,6 +282,18 @@ impl Reader {
     find_fun!(read_find_float, find_float, f32);
     find_fun!(read_find_double, find_double, f64);
 
+    find_array_fun!(read_find_u8_array, find_u8_array, u8);
+    find_array_fun!(read_find_u16_array, find_u16_array, u16);
+    find_array_fun!(read_find_u32_array, find_u32_array, u32);
+    find_array_fun!(read_find_u64_array, find_u64_array, u64);
+    find_array_fun!(read_find_f32_array, find_f32_array, f32);
+
+    copy_array_fun!(read_copy_u8_array, copy_u8_array, u8);
+    copy_array_fun!(read_copy_u16_array, copy_u16_array, u16);
+    copy_array_fun!(read_copy_u32_array, copy_u32_array, u32);
+    copy_array_fun!(read_copy_u64_array, copy_u64_array, u64);
+    copy_array_fun!(read_copy_f32_array, copy_f32_array, f32);
+
     pub fn find_array(&self, id: &str) -> ReaderIter {
         let s = CFixedString::from_str(id).as_ptr();
         let mut t = 0u64;
@@ -199,11 +304,36 @@ impl Reader {
 
         ReaderIter {
             reader: self.clone(),
+            array_iter: t,
             curr_iter: t,
         }
     }
 }
 
+impl ReaderIter {
+    /// Number of entries in the array
+    pub fn entry_count(&self) -> usize {
+        unsafe {
+            ((*self.reader.api).read_array_count)(transmute(self.reader.api), self.array_iter) as usize
+        }
+    }
+
+    /// Get entry at index without stepping over the entries before it
+    pub fn entry_at(&self, index: usize) -> Option<Reader> {
+        let mut t = 0u64;
+        let ret = unsafe {
+            ((*self.reader.api).read_array_entry_at)(transmute(self.reader.api), &mut t,
+                                                     self.array_iter, index as u32)
+        };
+
+        if (ret & !(ReadStatus::TypeMask as u32)) == ReadStatus::Ok as u32 {
+            Some(Reader::new(self.reader.api, t))
+        } else {
+            None
+        }
+    }
+}
+
 impl Iterator for ReaderIter {
     type Item = Reader;
     fn next(&mut self) -> Option<Reader> {
@@ -231,6 +361,17 @@ macro_rules! write_fun {
     }
 }
 
+macro_rules! write_array_fun {
+    ($name:ident, $data_type:ident) => {
+        pub fn $name(&mut self, id: &str, data: &[$data_type]) {
+            let s = CFixedString::from_str(id).as_ptr();
+            unsafe {
+                ((*self.api).$name)(transmute(self.api), s, data.as_ptr(), data.len() as u32);
+            }
+        }
+    }
+}
+
 impl Writer {
     pub fn event_begin(&mut self, event: u16) {
         unsafe {
@@ -280,6 +421,12 @@ impl Writer {
     write_fun!(write_float, f32);
     write_fun!(write_double, f64);
 
+    write_array_fun!(write_u8_array, u8);
+    write_array_fun!(write_u16_array, u16);
+    write_array_fun!(write_u32_array, u32);
+    write_array_fun!(write_u64_array, u64);
+    write_array_fun!(write_f32_array, f32);
+
     pub fn write_string(&mut self, id: &str, v: &str) {
         let id_s = CFixedString::from_str(id).as_ptr();
         let v_s = CFixedString::from_str(v).as_ptr();
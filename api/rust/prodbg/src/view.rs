@@ -5,7 +5,7 @@ use ui_ffi::*;
 use libc::{c_void, c_uchar};
 use std::mem::transmute;
 
-pub static VIEW_API_VERSION: &'static [u8] = b"ProDBG View 1\0";
+pub static VIEW_API_VERSION: &'static [u8] = b"ProDBG View 2\0";
 
 pub trait View {
     fn new(ui: &Ui, service: &Service) -> Self;
@@ -27,6 +27,9 @@ pub struct CViewCallbacks {
 
     pub save_state: Option<fn(*mut c_void)>,
     pub load_state: Option<fn(*mut c_void)>,
+
+    /// Events the view wants, ended with 0 (PDEventType_None.) Null means all events
+    pub event_types: *const u16,
 }
 
 unsafe impl Sync for CViewCallbacks {}
@@ -76,7 +79,8 @@ macro_rules! define_view_plugin {
                 destroy_instance: Some(prodbg_api::view::destroy_view_instance::<$x>),
                 update: Some(prodbg_api::view::update_view_instance::<$x>),
                 save_state: None,
-                load_state: None
+                load_state: None,
+                event_types: 0 as *const u16,
         };
     }
 }
@@ -1,5 +1,7 @@
 #include <pd_readwrite.h>
 #include "pd_readwrite_private.h"
+#include "pd_key_table.h"
+#include "pd_profiler.h"
 #include "log.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -7,11 +9,53 @@
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Entry in the field index. Scope is the offset to the start of the fields in an event or array entry and offset is
+// where the field is located (0 = unused slot)
+
+typedef struct FieldIndexEntry {
+    uint32_t scope;
+    uint32_t offset;
+    uint32_t hash;
+} FieldIndexEntry;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Entry in the event index. The index is sorted on event type (and then offset) so all events of one type can be
+// found without walking the stream
+
+typedef struct EventIndexEntry {
+    uint32_t offset;
+    uint16_t event;
+} EventIndexEntry;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 typedef struct ReaderData {
     uint8_t* data;
     uint8_t* dataStart;
     uint8_t* dataEnd;
     uint8_t* nextEvent;
+    uint8_t* event;                 // header of the event returned by the last get_event
+    FieldIndexEntry* index;
+    uint32_t indexMask;
+    uint32_t indexCapacity;
+    int useIndex;
+    int hasIndex;
+    PDKeyTable* keys;               // ownKeys or the keys of the source for view readers
+    PDKeyTable ownKeys;
+    struct ReaderData* source;      // reader that owns the stream, index and keys (only set for view readers)
+    EventIndexEntry* eventIndex;    // built on demand for filtered readers
+    uint32_t eventIndexCount;
+    uint32_t eventIndexCapacity;
+    int hasEventIndex;
+    uint16_t* filter;               // sorted event types to return, all events are returned if filterCount is 0
+    uint32_t filterCount;
+    uint32_t* events;               // offsets of the events that passes the filter in stream order
+    uint32_t eventCount;
+    uint32_t eventCapacity;
+    uint32_t eventPos;
+    int hasEvents;
+    int allowPointerRefs;           // only for streams written in this process (see pd_binary_reader_init_from_writer)
 } ReaderData;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -110,6 +154,280 @@ static inline uint64_t getOffsetUpper(ReaderData* readerData, const uint8_t* dat
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static inline uint8_t getType(const uint8_t* ptr) {
+    return ptr[0] & ~PDReadType_KeyIdFlag;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Data and arrays (including typed ones) has 32-bit size, everything else 16-bit
+
+static inline int hasSize32(uint8_t type) {
+    return type == PDReadType_Data || type == PDReadType_Array ||
+           (type >= PDReadType_U8Array && type <= PDReadType_FloatArray);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint32_t getFieldSize(const uint8_t* ptr) {
+    return hasSize32(getType(ptr)) ? (uint32_t)getU32(ptr + 1) : getU16(ptr + 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns pointer to the value that follows the key (either a 16-bit key id or a null terminated string)
+
+static inline uint8_t* getValuePtr(const uint8_t* ptr) {
+    size_t keyOffset = hasSize32(getType(ptr)) ? 5 : 3;
+
+    if (ptr[0] & PDReadType_KeyIdFlag)
+        return (uint8_t*)ptr + keyOffset + 2;
+
+    return (uint8_t*)ptr + keyOffset + strlen((const char*)ptr + keyOffset) + 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline const char* getKeyName(const ReaderData* rData, const uint8_t* ptr) {
+    size_t keyOffset = hasSize32(getType(ptr)) ? 5 : 3;
+
+    if (ptr[0] & PDReadType_KeyIdFlag)
+        return pd_key_table_get_name(rData->keys, getU16(ptr + keyOffset));
+
+    return (const char*)ptr + keyOffset;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rows in header arrays are addressed with iterators that has this bit set in the lower 32 bits and the distance
+// back to the start of the header array in the rest of them (the upper 32 bits is the offset to the row as usual)
+
+#define HeaderRowFlag 0x80000000
+
+static inline int isHeaderRow(PDReaderIterator it) {
+    return (it & HeaderRowFlag) != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint32_t getColumnSize(uint8_t type) {
+    switch (type) {
+        case PDReadType_S8:
+        case PDReadType_U8:
+            return 1;
+        case PDReadType_S16:
+        case PDReadType_U16:
+            return 2;
+        case PDReadType_S64:
+        case PDReadType_U64:
+        case PDReadType_Double:
+            return 8;
+        default:
+            return 4;   // 32-bit types, float and string offsets
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns pointer to the value of a column in a header array row. Strings are resolved to the string pool.
+
+static uint8_t* findColumn(ReaderData* rData, const char* id, PDReaderIterator it, uint8_t* type) {
+    uint8_t* row = rData->dataStart + (it >> 32LL);
+    uint8_t* header = row - (uint32_t)(it & ~(uint64_t)HeaderRowFlag & 0xffffffffLL);
+    const char* name = (const char*)header + PDHeaderArray_HeaderSize;
+    int i, count = header[11];
+    uint32_t offset = 0;
+
+    for (i = 0; i < count; ++i) {
+        uint8_t columnType = (uint8_t)*name++;
+
+        if (!strcmp(name, id)) {
+            *type = columnType;
+
+            if (columnType == PDReadType_String)
+                return header + getU32(header + 12) + getU32(row + offset);
+
+            return row + offset;
+        }
+
+        offset += getColumnSize(columnType);
+        name += strlen(name) + 1;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Blocks in the stream that are placed between events but isn't events
+
+static inline int isStreamBlock(uint8_t type) {
+    return type == PDReadType_KeyTable || type == PDReadType_DataRefPayloads;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int compareEventIndex(const void* a, const void* b) {
+    const EventIndexEntry* ea = (const EventIndexEntry*)a;
+    const EventIndexEntry* eb = (const EventIndexEntry*)b;
+
+    if (ea->event != eb->event)
+        return ea->event < eb->event ? -1 : 1;
+
+    return ea->offset < eb->offset ? -1 : ea->offset > eb->offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int compareU32(const void* a, const void* b) {
+    uint32_t va = *(const uint32_t*)a;
+    uint32_t vb = *(const uint32_t*)b;
+    return va < vb ? -1 : va > vb;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int compareU16(const void* a, const void* b) {
+    return (int)*(const uint16_t*)a - (int)*(const uint16_t*)b;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Walks the events (without looking inside them) and sorts them on type. Done once per stream no matter how many
+// readers are filtering it.
+
+static void buildEventIndex(ReaderData* rData) {
+    uint8_t* data = rData->dataStart;
+
+    rData->eventIndexCount = 0;
+
+    while (data && data < rData->dataEnd) {
+        uint8_t type = *data;
+        uint32_t size;
+
+        if (type == PDReadType_Event) {
+            EventIndexEntry* entry;
+
+            if (rData->eventIndexCount == rData->eventIndexCapacity) {
+                uint32_t capacity = rData->eventIndexCapacity ? rData->eventIndexCapacity * 2 : 64;
+                EventIndexEntry* index = realloc(rData->eventIndex, capacity * sizeof(EventIndexEntry));
+
+                if (!index) {
+                    printf("Unable to allocate event index for %d events\n", capacity);
+                    break;
+                }
+
+                rData->eventIndex = index;
+                rData->eventIndexCapacity = capacity;
+            }
+
+            entry = &rData->eventIndex[rData->eventIndexCount++];
+            entry->offset = (uint32_t)(data - rData->dataStart);
+            entry->event = getU16(data + 1);
+
+            size = getU32(data + 3);
+        } else if (isStreamBlock(type)) {
+            size = getU32(data + 1);
+        } else {
+            break;
+        }
+
+        if (size == 0)
+            break;
+
+        data += size;
+    }
+
+    qsort(rData->eventIndex, rData->eventIndexCount, sizeof(EventIndexEntry), compareEventIndex);
+
+    rData->hasEventIndex = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns the first entry in the event index with the given type (or the count if there is none)
+
+static uint32_t findEventIndex(const ReaderData* rData, uint16_t event) {
+    uint32_t first = 0;
+    uint32_t last = rData->eventIndexCount;
+
+    while (first < last) {
+        uint32_t mid = first + (last - first) / 2;
+
+        if (rData->eventIndex[mid].event < event)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+
+    return first;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Collects the events that passes the filter using the event index of the stream. The cost only depends on the
+// number of events that are returned and not on the size of the stream.
+
+static void gatherEvents(ReaderData* rData) {
+    ReaderData* stream = rData->source ? rData->source : rData;
+    uint32_t i, types = 0;
+
+    rData->eventCount = 0;
+    rData->eventPos = 0;
+    rData->hasEvents = 1;
+
+    if (!stream->hasEventIndex)
+        buildEventIndex(stream);
+
+    for (i = 0; i < rData->filterCount; ++i) {
+        uint32_t first = findEventIndex(stream, rData->filter[i]);
+        uint32_t last = first;
+
+        while (last < stream->eventIndexCount && stream->eventIndex[last].event == rData->filter[i])
+            last++;
+
+        if (first == last)
+            continue;
+
+        if (rData->eventCount + (last - first) > rData->eventCapacity) {
+            uint32_t capacity = rData->eventCount + (last - first) + 64;
+            uint32_t* events = realloc(rData->events, capacity * sizeof(uint32_t));
+
+            if (!events) {
+                printf("Unable to allocate space for %d filtered events\n", capacity);
+                break;
+            }
+
+            rData->events = events;
+            rData->eventCapacity = capacity;
+        }
+
+        for (; first < last; ++first)
+            rData->events[rData->eventCount++] = stream->eventIndex[first].offset;
+
+        types++;
+    }
+
+    // events of the same type are already in stream order so only sort when there are several types
+
+    if (types > 1)
+        qsort(rData->events, rData->eventCount, sizeof(uint32_t), compareU32);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t getFilteredEvent(ReaderData* rData) {
+    uint8_t* data;
+
+    if (!rData->hasEvents)
+        gatherEvents(rData);
+
+    if (rData->eventPos >= rData->eventCount)
+        return 0;
+
+    data = rData->dataStart + rData->events[rData->eventPos++];
+
+    rData->event = data;
+    rData->nextEvent = data + getU32(data + 3);
+    rData->data = data + 7;
+
+    return getU16(data + 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static uint32_t read_get_event(struct PDReader* reader) {
     ReaderData* rData = (ReaderData*)reader->data;
     uint16_t event;
@@ -121,6 +439,9 @@ static uint32_t read_get_event(struct PDReader* reader) {
         return 0;
     }
 
+    if (rData->filterCount)
+        return getFilteredEvent(rData);
+
     if (rData->nextEvent >= rData->dataEnd) {
         log_debug("rData->nextEvent %p >= rData->dataEnd %p\n", rData->nextEvent, rData->dataEnd);
         return 0;
@@ -140,6 +461,20 @@ static uint32_t read_get_event(struct PDReader* reader) {
         return 0;
     }
 
+    // skip key tables that may have been written in the middle of the stream and payloads for data references
+
+    while (data < rData->dataEnd && isStreamBlock(*data)) {
+        uint32_t size = getU32(data + 1);
+
+        if (size == 0)
+            return 0;
+
+        data += size;
+    }
+
+    if (data >= rData->dataEnd)
+        return 0;
+
     type = *data;
 
     if (type != PDReadType_Event) {
@@ -148,7 +483,13 @@ static uint32_t read_get_event(struct PDReader* reader) {
         return 0;
     }
 
+    if (getU32(data + 3) == 0) {
+        log_debug("Unable to read event as its size is zero, all read operations will now fail.\n");
+        return 0;
+    }
+
     event = getU16(data + 1);
+    rData->event = data;
     rData->nextEvent = data + getU32(data + 3);
     rData->data = data + 7; // points to the next of data in the stream
 
@@ -178,11 +519,208 @@ static const char* typeTable[] =
     "PDReadType_Event",
     "PDReadType_Array",
     "PDReadType_ArrayEntry",
+    "PDReadType_U8Array",
+    "PDReadType_U16Array",
+    "PDReadType_U32Array",
+    "PDReadType_U64Array",
+    "PDReadType_FloatArray",
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static uint8_t* findIdByRange(const char* id, uint8_t* start, uint8_t* end) {
+static uint8_t* findId(struct PDReader* reader, const char* id, PDReaderIterator it);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Arrays starts with the entry count (4 bytes) and offset to the entry table (4 bytes) that is stored after the
+// entries. Returns the end of the entries (the start of the table) given the first entry and the end of the array
+
+static inline uint8_t* getArrayEntriesEnd(uint8_t* entries, uint8_t* arrayEnd) {
+    uint32_t tableOffset = getU32(entries - 4);
+    return tableOffset ? entries + tableOffset : arrayEnd;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns the offset from the start of a header array to the first row
+
+static uint32_t getHeaderRowsOffset(const uint8_t* header) {
+    uint32_t rowsOffset = PDHeaderArray_HeaderSize;
+    int i, count = header[11];
+
+    for (i = 0; i < count; ++i)
+        rowsOffset += (uint32_t)strlen((const char*)header + rowsOffset + 1) + 2;
+
+    return rowsOffset;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint32_t getIndexSlot(uint32_t scope, uint32_t hash) {
+    return hash ^ (scope * 2654435761u);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns the first field with the key inside the scope
+
+static uint8_t* findIndexed(ReaderData* rData, const char* id, uint32_t scope) {
+    uint32_t hash = pd_key_table_hash_name(id);
+    uint32_t slot = getIndexSlot(scope, hash) & rData->indexMask;
+
+    for (;;) {
+        const FieldIndexEntry* entry = &rData->index[slot];
+
+        if (entry->offset == 0)
+            return 0;
+
+        if (entry->hash == hash && entry->scope == scope) {
+            uint8_t* field = rData->dataStart + entry->offset;
+
+            if (!strcmp(getKeyName(rData, field), id))
+                return field;
+        }
+
+        slot = (slot + 1) & rData->indexMask;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void addIndex(ReaderData* rData, uint32_t scope, uint8_t* field) {
+    const char* name = getKeyName(rData, field);
+    uint32_t hash = pd_key_table_hash_name(name);
+    uint32_t slot = getIndexSlot(scope, hash) & rData->indexMask;
+
+    for (;;) {
+        FieldIndexEntry* entry = &rData->index[slot];
+
+        if (entry->offset == 0) {
+            entry->scope = scope;
+            entry->offset = (uint32_t)(field - rData->dataStart);
+            entry->hash = hash;
+            return;
+        }
+
+        // only the first one is used if the same key is present several times (same as a linear search)
+
+        if (entry->hash == hash && entry->scope == scope && !strcmp(getKeyName(rData, rData->dataStart + entry->offset), name))
+            return;
+
+        slot = (slot + 1) & rData->indexMask;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Walks the fields between start and end (and the entries of any arrays inside it) and adds them to the index if
+// insert is set. Returns the number of fields.
+
+static uint32_t indexFields(ReaderData* rData, uint8_t* start, uint8_t* end, int insert) {
+    uint32_t count = 0;
+    uint32_t scope = (uint32_t)(start - rData->dataStart);
+
+    while (start < end) {
+        uint8_t type = getType(start);
+        uint32_t size = getFieldSize(start);
+
+        if (size == 0)
+            break;
+
+        if (insert)
+            addIndex(rData, scope, start);
+
+        count++;
+
+        if (type == PDReadType_Array) {
+            uint8_t* entry = getValuePtr(start) + 8;
+            uint8_t* entriesEnd = getArrayEntriesEnd(entry, start + size);
+
+            while (entry < entriesEnd && *entry == PDReadType_ArrayEntry) {
+                uint32_t entrySize = getU32(entry + 1);
+
+                if (entrySize < 7)
+                    break;
+
+                count += indexFields(rData, entry + 7, entry + entrySize, insert);
+                entry += entrySize;
+            }
+        }
+
+        start += size;
+    }
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t indexEvents(ReaderData* rData, int insert) {
+    uint8_t* data = rData->dataStart;
+    uint32_t count = 0;
+
+    while (data < rData->dataEnd) {
+        uint8_t type = *data;
+        uint32_t size;
+
+        if (type == PDReadType_Event) {
+            size = getU32(data + 3);
+            count += indexFields(rData, data + 7, data + size, insert);
+        } else if (isStreamBlock(type)) {
+            size = getU32(data + 1);
+        } else {
+            break;
+        }
+
+        if (size == 0)
+            break;
+
+        data += size;
+    }
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// One pass over the stream that records where all fields in events and array entries are so find doesn't need
+// to search. Done in two passes so the table can be sized correctly.
+
+static void buildIndex(ReaderData* rData) {
+    uint32_t capacity = 256;
+    uint32_t count = indexEvents(rData, 0);
+
+    // keep the load factor below 0.5
+
+    while (capacity < count * 2)
+        capacity *= 2;
+
+    if (capacity > rData->indexCapacity) {
+        free(rData->index);
+        rData->index = malloc(capacity * sizeof(FieldIndexEntry));
+
+        // without an index find falls back to searching the events
+
+        if (!rData->index) {
+            rData->indexCapacity = 0;
+            return;
+        }
+
+        rData->indexCapacity = capacity;
+    }
+
+    memset(rData->index, 0, capacity * sizeof(FieldIndexEntry));
+    rData->indexMask = capacity - 1;
+
+    indexEvents(rData, 1);
+
+    rData->hasIndex = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint8_t* findIdByRange(ReaderData* rData, const char* id, uint8_t* start, uint8_t* end) {
+    // if the key has been interned we only need to compare ids. If it isn't in the table we only compare
+    // against keys stored as strings as all interned keys are present in the table.
+
+    int keyId = pd_key_table_find(rData->keys, id);
+
     while (start < end) {
         uint32_t size;
         uint8_t typeId = getU8(start);
@@ -194,18 +732,26 @@ static uint8_t* findIdByRange(const char* id, uint8_t* start, uint8_t* end) {
 
         // data is a special case as it has 32-bit size instead of 64k
 
-        if (typeId == PDReadType_Data || typeId == PDReadType_Array) {
+        if (hasSize32(typeId & ~PDReadType_KeyIdFlag)) {
             size = getU32(start + 1);
 
-            if (!strcmp((char*)start + 5, id))
+            if (typeId & PDReadType_KeyIdFlag) {
+                if (getU16(start + 5) == keyId)
+                    return start;
+            } else if (!strcmp((char*)start + 5, id)) {
                 return start;
+            }
         }else {
             size = getU16(start + 1);
 
             //log_debug("current string - %s searching for - %s\n", (char*)start + 3, id);
 
-            if (!strcmp((char*)start + 3, id))
+            if (typeId & PDReadType_KeyIdFlag) {
+                if (getU16(start + 3) == keyId)
+                    return start;
+            } else if (!strcmp((char*)start + 3, id)) {
                 return start;
+            }
         }
 
         start += size;
@@ -222,62 +768,89 @@ static uint8_t* findIdByRange(const char* id, uint8_t* start, uint8_t* end) {
 static uint8_t* findId(struct PDReader* reader, const char* id, PDReaderIterator it) {
     ReaderData* rData = (ReaderData*)reader->data;
 
+    if (rData->hasIndex) {
+        uint8_t* start = it == 0 ? rData->data : rData->dataStart + (it >> 32LL);
+        uint8_t* end = it == 0 ? rData->nextEvent : start + (it & 0xffffffffLL);
+        uint8_t* field = findIndexed(rData, id, (uint32_t)(start - rData->dataStart));
+
+        return field && field < end ? field : 0;
+    }
+
     // if iterator is 0 we search the event stream,
 
     if (it == 0) {
         // if no iterater we will just search the whole event
-        return findIdByRange(id, rData->data, rData->nextEvent);
+        return findIdByRange(rData, id, rData->data, rData->nextEvent);
     }else {
         // serach within the event but skip 7 bytes ahead to not read the event itself
         uint32_t dataOffset = it >> 32LL;
         uint32_t size = it & 0xffffffffLL;
         uint8_t* start = rData->dataStart + dataOffset;
         uint8_t* end = start + size;
-        return findIdByRange(id, start, end);
+        return findIdByRange(rData, id, start, end);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Finds a numeric value (either a regular field or a column in a header array row). Type is set to PDReadType_None
+// if nothing was found and if it isn't a numeric type 0 is returned.
+
+static const uint8_t* findNumeric(struct PDReader* reader, const char* id, PDReaderIterator it, uint8_t* type) {
+    const uint8_t* dataPtr;
+
+    *type = PDReadType_None;
+
+    if (isHeaderRow(it)) {
+        dataPtr = findColumn((ReaderData*)reader->data, id, it, type);
+    } else {
+        if (!(dataPtr = findId(reader, id, it)))
+            return 0;
+
+        *type = getType(dataPtr);
+
+        // numeric values are always at the end of the field
+
+        dataPtr += getU16(dataPtr + 1) - getColumnSize(*type);
     }
+
+    return *type < PDReadType_EndNumericTypes ? dataPtr : 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #define findValue(inType, realType, getFunc) \
     uint8_t type; \
-    size_t offset; \
-    const uint8_t* dataPtr = findId(reader, id, it); \
-    if (!dataPtr) \
-        return PDReadStatus_NotFound; \
-    type = *dataPtr; \
-    offset = getU16(dataPtr + 1) - (sizeof(realType)); \
+    const uint8_t* valuePtr = findNumeric(reader, id, it, &type); \
+    if (!valuePtr) \
+        return type == PDReadType_None ? PDReadStatus_NotFound : (PDReadType)type | PDReadStatus_IllegalType; \
     if (type == inType) \
     { \
-        *res = getFunc(dataPtr + offset); \
+        *res = getFunc(valuePtr); \
         return PDReadStatus_Ok | inType; \
     } \
-    if (type < PDReadType_EndNumericTypes) \
+    switch (type) \
     { \
-        offset = strlen((const char*)dataPtr + 3) + 4; \
-        switch (type) \
-        { \
-            case PDReadType_S8: \
-                *res = (realType)getS8(dataPtr + offset); return PDReadType_S8 | PDReadStatus_Converted; \
-            case PDReadType_U8: \
-                *res = (realType)getU8(dataPtr + offset); return PDReadType_U8 | PDReadStatus_Converted;  \
-            case PDReadType_S16: \
-                *res = (realType)getU16(dataPtr + offset); return PDReadType_S16 | PDReadStatus_Converted; \
-            case PDReadType_U16: \
-                *res = (realType)getU16(dataPtr + offset); return PDReadType_U16 | PDReadStatus_Converted; \
-            case PDReadType_S32: \
-                *res = (realType)getU32(dataPtr + offset); return PDReadType_S32 | PDReadStatus_Converted; \
-            case PDReadType_U32: \
-                *res = (realType)getU32(dataPtr + offset); return PDReadType_U32 | PDReadStatus_Converted; \
-            case PDReadType_S64: \
-                *res = (realType)getU64(dataPtr + offset); return PDReadType_S64 | PDReadStatus_Converted; \
-            case PDReadType_U64: \
-                *res = (realType)getU64(dataPtr + offset); return PDReadType_U64 | PDReadStatus_Converted; \
-            case PDReadType_Float: \
-                *res = (realType)getFloat(dataPtr + offset); return PDReadType_Float | PDReadStatus_Converted; \
-            case PDReadType_Double: \
-                *res = (realType)getDouble(dataPtr + offset); return PDReadType_Float | PDReadStatus_Converted; \
-        } \
+        case PDReadType_S8: \
+            *res = (realType)getS8(valuePtr); return PDReadType_S8 | PDReadStatus_Converted; \
+        case PDReadType_U8: \
+            *res = (realType)getU8(valuePtr); return PDReadType_U8 | PDReadStatus_Converted;  \
+        case PDReadType_S16: \
+            *res = (realType)getU16(valuePtr); return PDReadType_S16 | PDReadStatus_Converted; \
+        case PDReadType_U16: \
+            *res = (realType)getU16(valuePtr); return PDReadType_U16 | PDReadStatus_Converted; \
+        case PDReadType_S32: \
+            *res = (realType)getU32(valuePtr); return PDReadType_S32 | PDReadStatus_Converted; \
+        case PDReadType_U32: \
+            *res = (realType)getU32(valuePtr); return PDReadType_U32 | PDReadStatus_Converted; \
+        case PDReadType_S64: \
+            *res = (realType)getU64(valuePtr); return PDReadType_S64 | PDReadStatus_Converted; \
+        case PDReadType_U64: \
+            *res = (realType)getU64(valuePtr); return PDReadType_U64 | PDReadStatus_Converted; \
+        case PDReadType_Float: \
+            *res = (realType)getFloat(valuePtr); return PDReadType_Float | PDReadStatus_Converted; \
+        case PDReadType_Double: \
+            *res = (realType)getDouble(valuePtr); return PDReadType_Float | PDReadStatus_Converted; \
     } \
     return (PDReadType)type | PDReadStatus_IllegalType
 
@@ -345,74 +918,272 @@ static uint32_t read_find_double(struct PDReader* reader, double* res, const cha
 
 static uint32_t read_find_string(struct PDReader* reader, const char** res, const char* id, PDReaderIterator it) {
     uint8_t type;
-    int len;
+    const uint8_t* dataPtr;
+
+    if (isHeaderRow(it)) {
+        if (!(dataPtr = findColumn((ReaderData*)reader->data, id, it, &type)))
+            return PDReadStatus_NotFound;
+
+        if (type != PDReadType_String)
+            return (PDReadType)type | PDReadStatus_IllegalType;
 
-    const uint8_t* dataPtr = findId(reader, id, it);
+        *res = (const char*)dataPtr;
+
+        return PDReadType_String | PDReadStatus_Ok;
+    }
+
+    dataPtr = findId(reader, id, it);
     if (!dataPtr)
         return PDReadStatus_NotFound;
 
-    type = *dataPtr;
+    type = getType(dataPtr);
 
     if (type != PDReadType_String)
         return (PDReadType)type | PDReadStatus_IllegalType;
 
     // find the offset to the string
 
-    len = (int)strlen((const char*)dataPtr + 3);
-    *res = (const char*)dataPtr + 3 + len + 1;
+    *res = (const char*)getValuePtr(dataPtr);
 
     return (PDReadType)type | PDReadStatus_Ok;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Data that wasn't copied into the stream. Either in the same process (pointer) or sent after the stream (offset.)
+// Pointers are only valid for streams that comes from a writer in this process and offsets has to be inside the
+// stream so data received from another process can't be used to read any other memory.
 
-static uint32_t read_find_data(struct PDReader* reader, void** data, uint64_t* size, const char* id, PDReaderIterator it) {
+static void* getDataRef(ReaderData* rData, uint8_t* value, uint64_t* size) {
+    void* data;
+    uint32_t offset = (uint32_t)getU32(value + 12);
+    uint64_t streamSize = (uint64_t)(rData->dataEnd - rData->dataStart);
+
+    *size = (uint32_t)getU32(value + 8);
+
+    if (!offset) {
+        if (!rData->allowPointerRefs) {
+            printf("Data reference to memory in another process\n");
+            return 0;
+        }
+
+        memcpy(&data, value, sizeof(void*));
+        return data;
+    }
+
+    if (offset > streamSize || *size > streamSize - offset) {
+        printf("Data reference outside of the stream (offset %u size %u)\n", offset, (uint32_t)*size);
+        return 0;
+    }
+
+    return rData->dataStart + offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_find_data(struct PDReader* reader, void** data, uint64_t* size, const char* id, PDReaderIterator it) {
     uint8_t type;
-    int idLength;
+    uint8_t* valuePtr;
+    uint8_t* dataPtr;
+
+    // header arrays can't contain data
+
+    if (isHeaderRow(it))
+        return PDReadStatus_NotFound;
 
-    uint8_t* dataPtr = findId(reader, id, it);
+    dataPtr = findId(reader, id, it);
     if (!dataPtr) {
         printf("%s:%d\n", __FILE__, __LINE__);
         return PDReadStatus_NotFound;
     }
 
-    type = *dataPtr;
+    type = getType(dataPtr);
+
+    if (type == PDReadType_DataRef) {
+        if (!(*data = getDataRef((ReaderData*)reader->data, getValuePtr(dataPtr), size))) {
+            *size = 0;
+            return PDReadType_Data | PDReadStatus_Fail;
+        }
+
+        return PDReadType_Data | PDReadStatus_Ok;
+    }
 
     if (type != PDReadType_Data)
         return (PDReadType)type | PDReadStatus_IllegalType;
 
-    idLength = (int)strlen((const char*)dataPtr + 5) + 1;
+    valuePtr = getValuePtr(dataPtr);
 
-    // find the offset to the string
-
-    *size = (getU32(dataPtr + 1) - idLength) - 5;   // fix hard-coded values
-    *data = (void*)(dataPtr + 5 + idLength);
+    *size = (uint32_t)getU32(dataPtr + 1) - (uint32_t)(valuePtr - dataPtr);
+    *data = (void*)valuePtr;
 
     return PDReadType_Data | PDReadStatus_Ok;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// See writeTypedArray in pd_binary_writer.c for the layout. The values are little endian and aligned from the start
+// of the buffer the stream was written to so they may not be aligned in memory for received streams.
+
+static uint32_t getTypedArray(struct PDReader* reader, const uint8_t** res, uint32_t* count, const char* id,
+                              PDReaderIterator it, uint8_t inType, uint32_t elementSize) {
+    uint8_t type;
+    uint8_t* valuePtr;
+    uint8_t* dataPtr;
+
+    *count = 0;
+
+    if (isHeaderRow(it))
+        return PDReadStatus_NotFound;
+
+    if (!(dataPtr = findId(reader, id, it)))
+        return PDReadStatus_NotFound;
+
+    type = getType(dataPtr);
+
+    if (type != inType)
+        return (PDReadType)type | PDReadStatus_IllegalType;
+
+    valuePtr = getValuePtr(dataPtr);
+
+    *count = ((uint32_t)getU32(dataPtr + 1) - (uint32_t)(valuePtr - dataPtr) - 1 - valuePtr[0]) / elementSize;
+    *res = valuePtr + 1 + valuePtr[0];
+
+    return (PDReadType)inType | PDReadStatus_Ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The values can only be used where they are if they are aligned and in the byte order of the host
+
+static uint32_t findTypedArray(struct PDReader* reader, const void** res, uint32_t* count, const char* id,
+                               PDReaderIterator it, uint8_t inType, uint32_t elementSize) {
+    const uint8_t* values = 0;
+    uint32_t status = getTypedArray(reader, &values, count, id, it, inType, elementSize);
+
+    *res = 0;
+
+    if ((status >> 8) != (PDReadStatus_Ok >> 8))
+        return status;
+
+    if (*count > 0 && elementSize > 1 && (((uintptr_t)values & (elementSize - 1)) || !pd_is_little_endian()))
+        return (PDReadType)inType | PDReadStatus_Fail;
+
+    *res = values;
+
+    return status;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t copyTypedArray(struct PDReader* reader, void* dest, uint32_t maxCount, uint32_t* count,
+                               const char* id, PDReaderIterator it, uint8_t inType, uint32_t elementSize) {
+    const uint8_t* values = 0;
+    uint32_t status = getTypedArray(reader, &values, count, id, it, inType, elementSize);
+    uint32_t copyCount = *count < maxCount ? *count : maxCount;
+
+    if ((status >> 8) != (PDReadStatus_Ok >> 8))
+        return status;
+
+    if (elementSize == 1 || pd_is_little_endian()) {
+        memcpy(dest, values, copyCount * elementSize);
+    } else {
+        uint8_t* out = (uint8_t*)dest;
+        uint32_t i, j;
+
+        for (i = 0; i < copyCount; ++i, values += elementSize) {
+            for (j = 0; j < elementSize; ++j)
+                out[i * elementSize + j] = values[elementSize - 1 - j];
+        }
+    }
+
+    return status;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_find_u8_array(struct PDReader* r, const uint8_t** res, uint32_t* count, const char* id, PDReaderIterator it) {
+    return findTypedArray(r, (const void**)res, count, id, it, PDReadType_U8Array, sizeof(uint8_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_find_u16_array(struct PDReader* r, const uint16_t** res, uint32_t* count, const char* id, PDReaderIterator it) {
+    return findTypedArray(r, (const void**)res, count, id, it, PDReadType_U16Array, sizeof(uint16_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_find_u32_array(struct PDReader* r, const uint32_t** res, uint32_t* count, const char* id, PDReaderIterator it) {
+    return findTypedArray(r, (const void**)res, count, id, it, PDReadType_U32Array, sizeof(uint32_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_find_u64_array(struct PDReader* r, const uint64_t** res, uint32_t* count, const char* id, PDReaderIterator it) {
+    return findTypedArray(r, (const void**)res, count, id, it, PDReadType_U64Array, sizeof(uint64_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_find_f32_array(struct PDReader* r, const float** res, uint32_t* count, const char* id, PDReaderIterator it) {
+    return findTypedArray(r, (const void**)res, count, id, it, PDReadType_FloatArray, sizeof(float));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_copy_u8_array(struct PDReader* r, uint8_t* dest, uint32_t maxCount, uint32_t* count, const char* id,
+                                   PDReaderIterator it) {
+    return copyTypedArray(r, dest, maxCount, count, id, it, PDReadType_U8Array, sizeof(uint8_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_copy_u16_array(struct PDReader* r, uint16_t* dest, uint32_t maxCount, uint32_t* count,
+                                    const char* id, PDReaderIterator it) {
+    return copyTypedArray(r, dest, maxCount, count, id, it, PDReadType_U16Array, sizeof(uint16_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_copy_u32_array(struct PDReader* r, uint32_t* dest, uint32_t maxCount, uint32_t* count,
+                                    const char* id, PDReaderIterator it) {
+    return copyTypedArray(r, dest, maxCount, count, id, it, PDReadType_U32Array, sizeof(uint32_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_copy_u64_array(struct PDReader* r, uint64_t* dest, uint32_t maxCount, uint32_t* count,
+                                    const char* id, PDReaderIterator it) {
+    return copyTypedArray(r, dest, maxCount, count, id, it, PDReadType_U64Array, sizeof(uint64_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_copy_f32_array(struct PDReader* r, float* dest, uint32_t maxCount, uint32_t* count,
+                                    const char* id, PDReaderIterator it) {
+    return copyTypedArray(r, dest, maxCount, count, id, it, PDReadType_FloatArray, sizeof(float));
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static uint32_t read_find_array(struct PDReader* reader, PDReaderIterator* arrayIt, const char* id, PDReaderIterator it) {
     uint8_t type;
-    int idLength;
+    const uint8_t* dataPtr;
     ReaderData* rData = (ReaderData*)reader->data;
 
-    const uint8_t* dataPtr = findId(reader, id, it);
+    if (isHeaderRow(it))
+        return PDReadStatus_NotFound;
+
+    dataPtr = findId(reader, id, it);
     if (!dataPtr) {
         return PDReadStatus_NotFound;
     }
 
-    type = *dataPtr;
+    type = getType(dataPtr);
 
     if (type != PDReadType_Array)
         return (PDReadType)type | PDReadStatus_IllegalType;
 
-    idLength = (int)strlen((const char*)dataPtr + 5) + 1;
-
-    // get offset to the array entry
+    // get offset to the first array entry (skipping entry count and table offset)
 
-    dataPtr += idLength + 5;
+    dataPtr = getValuePtr(dataPtr) + 8;
 
     // find the offset to the string
 
@@ -437,7 +1208,33 @@ static int32_t read_next_entry(struct PDReader* reader, PDReaderIterator* arrayI
     uint32_t size = it & 0xffffffffLL;
     uint8_t* entryStart = rData->dataStart + offset + size;
 
-    if ((type = *entryStart) != PDReadType_ArrayEntry) {
+    // rows in header arrays has a fixed size so we can just step to the next one
+
+    if (isHeaderRow(it)) {
+        uint32_t distance = size & ~HeaderRowFlag;
+        uint8_t* header = rData->dataStart + offset - distance;
+        uint32_t rowSize = getU16(header + 9);
+
+        if (distance + rowSize >= (uint32_t)getU32(header + 12))
+            return 0;
+
+        *arrayIt = getOffsetUpper(rData, rData->dataStart + offset + rowSize) | HeaderRowFlag | (distance + rowSize);
+
+        return header[11];
+    }
+
+    if ((type = *entryStart) == PDReadType_HeaderArray) {
+        uint32_t rowsOffset = getHeaderRowsOffset(entryStart);
+
+        if (getU32(entryStart + 5) == 0)
+            return 0;
+
+        *arrayIt = getOffsetUpper(rData, entryStart + rowsOffset) | HeaderRowFlag | rowsOffset;
+
+        return entryStart[11];
+    }
+
+    if (type != PDReadType_ArrayEntry) {
         log_info("No arrayEntry found at %p (found %d) but expected %d\n", entryStart, type, PDReadType_ArrayEntry);
         return -1;
     }
@@ -456,6 +1253,50 @@ static int32_t read_next_entry(struct PDReader* reader, PDReaderIterator* arrayI
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static uint32_t read_array_count(struct PDReader* reader, PDReaderIterator arrayIt) {
+    ReaderData* rData = (ReaderData*)reader->data;
+    uint8_t* entries = rData->dataStart + (arrayIt >> 32LL);
+
+    // only iterators directly from find_array are valid here
+
+    if (arrayIt == 0 || (arrayIt & 0xffffffffLL) != 0)
+        return 0;
+
+    return (uint32_t)getU32(entries - 8);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read_array_entry_at(struct PDReader* reader, PDReaderIterator* entryIt, PDReaderIterator arrayIt, uint32_t index) {
+    uint8_t* entry;
+    ReaderData* rData = (ReaderData*)reader->data;
+    uint8_t* entries = rData->dataStart + (arrayIt >> 32LL);
+
+    if (read_array_count(reader, arrayIt) <= index)
+        return PDReadStatus_NotFound;
+
+    // header arrays has fixed size rows so we can just calculate where the row is
+
+    if (*entries == PDReadType_HeaderArray) {
+        uint32_t rowOffset = getHeaderRowsOffset(entries) + index * getU16(entries + 9);
+        *entryIt = getOffsetUpper(rData, entries + rowOffset) | HeaderRowFlag | rowOffset;
+        return PDReadType_ArrayEntry | PDReadStatus_Ok;
+    }
+
+    entry = entries + getU32(entries + getU32(entries - 4) + index * 4);
+
+    if (*entry != PDReadType_ArrayEntry)
+        return PDReadStatus_NotFound;
+
+    // same as read_next_entry gives back so it's possible to continue with that from here
+
+    *entryIt = getOffsetUpper(rData, entry + 7) | (getU32(entry + 1) - 7);
+
+    return PDReadType_ArrayEntry | PDReadStatus_Ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static void read_dump_data(struct PDReader* reader) {
     int eventId;
     ReaderData* rData = (ReaderData*)reader->data;
@@ -464,20 +1305,11 @@ static void read_dump_data(struct PDReader* reader) {
         log_info("{ = event %d - (start %p end %p)\n", eventId, rData->data, rData->nextEvent);
 
         while (rData->data < rData->nextEvent) {
-            uint8_t type = *(uint8_t*)rData->data;
-            uint32_t size = getU16(rData->data + 1);
-            const char* idOffset = (const char*)rData->data + 3;
+            uint8_t type = getType(rData->data);
+            uint32_t size = getFieldSize(rData->data);
 
-            if (type < PDReadType_Count) {
-                if (type == PDReadType_Array) {
-                    // need to handle array here, now just grab the correct size and idOffset
-
-                    size = getU32(rData->data + 1);
-                    idOffset = (const char*)rData->data + 5;
-                }
-
-                log_info("  %s : (%s - %d)\n", idOffset, typeTable[type], size);
-            }
+            if (type < PDReadType_Count)
+                log_info("  %s : (%s - %d)\n", getKeyName(rData, rData->data), typeTable[type], size);
 
             rData->data += size;
         }
@@ -489,6 +1321,41 @@ static void read_dump_data(struct PDReader* reader) {
 }
 
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void read_set_event_filter(struct PDReader* reader, const uint16_t* events, uint32_t count) {
+    ReaderData* rData = (ReaderData*)reader->data;
+    uint32_t i, unique = 0;
+
+    // start over from the first event with the new filter
+
+    rData->data = rData->dataStart;
+    rData->nextEvent = 0;
+    rData->event = 0;
+    rData->filterCount = 0;
+    rData->hasEvents = 0;
+
+    if (count == 0)
+        return;
+
+    free(rData->filter);
+
+    if (!(rData->filter = malloc(count * sizeof(uint16_t)))) {
+        printf("Unable to allocate event filter\n");
+        return;
+    }
+
+    memcpy(rData->filter, events, count * sizeof(uint16_t));
+    qsort(rData->filter, count, sizeof(uint16_t), compareU16);
+
+    for (i = 0; i < count; ++i) {
+        if (unique == 0 || rData->filter[unique - 1] != rData->filter[i])
+            rData->filter[unique++] = rData->filter[i];
+    }
+
+    rData->filterCount = unique;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void pd_binary_reader_init(PDReader* reader) {
@@ -508,16 +1375,30 @@ void pd_binary_reader_init(PDReader* reader) {
     reader->read_find_data = read_find_data;
     reader->read_find_array = read_find_array;
     reader->read_dump_data = read_dump_data;
+    reader->read_array_count = read_array_count;
+    reader->read_array_entry_at = read_array_entry_at;
+    reader->read_find_u8_array = read_find_u8_array;
+    reader->read_find_u16_array = read_find_u16_array;
+    reader->read_find_u32_array = read_find_u32_array;
+    reader->read_find_u64_array = read_find_u64_array;
+    reader->read_find_f32_array = read_find_f32_array;
+    reader->read_set_event_filter = read_set_event_filter;
+    reader->read_copy_u8_array = read_copy_u8_array;
+    reader->read_copy_u16_array = read_copy_u16_array;
+    reader->read_copy_u32_array = read_copy_u32_array;
+    reader->read_copy_u64_array = read_copy_u64_array;
+    reader->read_copy_f32_array = read_copy_f32_array;
 
     reader->data = malloc(sizeof(ReaderData));
     memset(reader->data, 0, sizeof(ReaderData));
+    ((ReaderData*)reader->data)->keys = &((ReaderData*)reader->data)->ownKeys;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 PDReader* pd_binary_reader_create() {
     PDReader* reader = malloc(sizeof(PDReader));
-    memset(reader, 0, sizeof(ReaderData));
+    memset(reader, 0, sizeof(PDReader));
 
 	pd_binary_reader_init(reader);
 
@@ -526,28 +1407,358 @@ PDReader* pd_binary_reader_create() {
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Walks the events (without looking inside them) to find the last key table in the stream
+
+static void readKeyTable(ReaderData* rData) {
+    uint8_t* data = rData->dataStart;
+    uint8_t* keyTable = 0;
+
+    pd_key_table_clear(rData->keys);
+
+    while (data < rData->dataEnd) {
+        uint8_t type = *data;
+        uint32_t size;
+
+        if (type == PDReadType_Event) {
+            size = getU32(data + 3);
+        } else if (type == PDReadType_KeyTable) {
+            keyTable = data;
+            size = getU32(data + 1);
+        } else if (type == PDReadType_DataRefPayloads) {
+            size = getU32(data + 1);
+        } else {
+            break;
+        }
+
+        if (size == 0)
+            break;
+
+        data += size;
+    }
+
+    if (keyTable) {
+        const char* name = (const char*)keyTable + 7;
+        int i, count = getU16(keyTable + 5);
+
+        for (i = 0; i < count; ++i) {
+            pd_key_table_intern(rData->keys, name);
+            name += strlen(name) + 1;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void pd_binary_reader_init_stream(PDReader* reader, uint8_t* data, unsigned int size) {
     ReaderData* readerData = (ReaderData*)reader->data;
+
+    PD_PROFILE_BEGIN("PDRead init_stream");
+
+    // a view reader that gets its own stream stops sharing the one of the source
+
+    if (readerData->source) {
+        readerData->source = 0;
+        readerData->keys = &readerData->ownKeys;
+        readerData->index = 0;
+        readerData->indexCapacity = 0;
+    }
+
     readerData->data = readerData->dataStart = data + 4;    // top 4 bytes for size + 2 bits for info
     readerData->dataEnd = (uint8_t*)data + size;
     readerData->nextEvent = 0;
+    readerData->event = 0;
+    readerData->hasIndex = 0;
+    readerData->hasEventIndex = 0;
+    readerData->hasEvents = 0;
+    readerData->allowPointerRefs = 0;
+    readKeyTable(readerData);
+
+    if (readerData->useIndex)
+        buildIndex(readerData);
+
+    PD_PROFILE_END();
+
     pda_log_set_level(LOG_INFO);
     log_debug("InitStream %p - size %d\n", data, size);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void pd_binary_reader_init_from_writer(PDReader* reader, PDWriter* writer) {
+    pd_binary_writer_finalize(writer);
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    ((ReaderData*)reader->data)->allowPointerRefs = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_binary_reader_init_view(PDReader* reader, PDReader* sourceReader) {
+    ReaderData* readerData = (ReaderData*)reader->data;
+    ReaderData* source = (ReaderData*)sourceReader->data;
+
+    // views of views reads the original stream
+
+    if (source->source)
+        source = source->source;
+
+    if (!readerData->source)
+        free(readerData->index);
+
+    readerData->source = source;
+    readerData->data = readerData->dataStart = source->dataStart;
+    readerData->dataEnd = source->dataEnd;
+    readerData->nextEvent = 0;
+    readerData->event = 0;
+    readerData->index = source->index;
+    readerData->indexMask = source->indexMask;
+    readerData->indexCapacity = 0;
+    readerData->useIndex = 0;
+    readerData->hasIndex = source->hasIndex;
+    readerData->keys = source->keys;
+    readerData->hasEvents = 0;
+    readerData->allowPointerRefs = source->allowPointerRefs;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void pd_binary_reader_reset(PDReader* reader) {
     ReaderData* readerData = (ReaderData*)reader->data;
     readerData->data = readerData->dataStart;
     readerData->nextEvent = 0;
+    readerData->event = 0;
+    readerData->eventPos = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_binary_reader_set_use_index(PDReader* reader, int enable) {
+    ReaderData* readerData = (ReaderData*)reader->data;
+    readerData->useIndex = !!enable;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void pd_binary_reader_destroy(PDReader* reader) {
     ReaderData* readerData = (ReaderData*)reader->data;
+
+    if (!readerData->source)
+        free(readerData->index);
+
+    free(readerData->eventIndex);
+    free(readerData->filter);
+    free(readerData->events);
     free(readerData);
     free(reader);
 }
 
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void copyFields(ReaderData* rData, PDWriter* writer, uint8_t* start, uint8_t* end);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Header arrays are written back as header arrays so the copy has the same layout as the original
+
+static void copyHeaderArray(PDWriter* writer, uint8_t* header) {
+    const char* ids[PDHeaderArray_MaxColumns + 1];
+    uint8_t types[PDHeaderArray_MaxColumns];
+    const uint8_t* pool = header + getU32(header + 12);
+    const char* name = (const char*)header + PDHeaderArray_HeaderSize;
+    uint32_t rowCount = (uint32_t)getU32(header + 5);
+    uint32_t rowSize = getU16(header + 9);
+    uint8_t* row = header + getHeaderRowsOffset(header);
+    int i, count = header[11];
+    uint32_t r;
+
+    for (i = 0; i < count; ++i) {
+        types[i] = (uint8_t)*name++;
+        ids[i] = name;
+        name += strlen(name) + 1;
+    }
+
+    ids[count] = 0;
+
+    PDWrite_header_array_begin(writer, ids);
+
+    for (r = 0; r < rowCount; ++r, row += rowSize) {
+        const uint8_t* value = row;
+
+        for (i = 0; i < count; ++i) {
+            switch (types[i]) {
+                case PDReadType_S8: PDWrite_s8(writer, 0, getS8(value)); break;
+                case PDReadType_U8: PDWrite_u8(writer, 0, getU8(value)); break;
+                case PDReadType_S16: PDWrite_s16(writer, 0, (int16_t)getS16(value)); break;
+                case PDReadType_U16: PDWrite_u16(writer, 0, getU16(value)); break;
+                case PDReadType_S32: PDWrite_s32(writer, 0, getS32(value)); break;
+                case PDReadType_U32: PDWrite_u32(writer, 0, (uint32_t)getU32(value)); break;
+                case PDReadType_S64: PDWrite_s64(writer, 0, getS64(value)); break;
+                case PDReadType_U64: PDWrite_u64(writer, 0, getU64(value)); break;
+                case PDReadType_Float: PDWrite_float(writer, 0, getFloat(value)); break;
+                case PDReadType_Double: PDWrite_double(writer, 0, getDouble(value)); break;
+                case PDReadType_String: PDWrite_string(writer, 0, (const char*)pool + getU32(value)); break;
+            }
+
+            value += getColumnSize(types[i]);
+        }
+    }
+
+    PDWrite_header_array_end(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void copyArray(ReaderData* rData, PDWriter* writer, const char* name, uint8_t* field, uint32_t size) {
+    uint8_t* entry = getValuePtr(field) + 8;
+    uint8_t* entriesEnd = getArrayEntriesEnd(entry, field + size);
+
+    PDWrite_array_begin(writer, name);
+
+    if (entry < entriesEnd && *entry == PDReadType_HeaderArray) {
+        copyHeaderArray(writer, entry);
+    } else {
+        while (entry < entriesEnd && *entry == PDReadType_ArrayEntry) {
+            uint32_t entrySize = (uint32_t)getU32(entry + 1);
+
+            if (entrySize < 7)
+                break;
+
+            PDWrite_array_entry_begin(writer);
+            copyFields(rData, writer, entry + 7, entry + entrySize);
+            PDWrite_entry_end(writer);
+
+            entry += entrySize;
+        }
+    }
+
+    PDWrite_array_end(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void copyFields(ReaderData* rData, PDWriter* writer, uint8_t* start, uint8_t* end) {
+    while (start < end) {
+        uint8_t type = getType(start);
+        uint32_t size = getFieldSize(start);
+        const char* name = getKeyName(rData, start);
+        uint8_t* value = getValuePtr(start);
+        uint32_t valueSize = size - (uint32_t)(value - start);
+
+        if (size == 0)
+            break;
+
+        switch (type) {
+            case PDReadType_S8: PDWrite_s8(writer, name, getS8(value)); break;
+            case PDReadType_U8: PDWrite_u8(writer, name, getU8(value)); break;
+            case PDReadType_S16: PDWrite_s16(writer, name, (int16_t)getS16(value)); break;
+            case PDReadType_U16: PDWrite_u16(writer, name, getU16(value)); break;
+            case PDReadType_S32: PDWrite_s32(writer, name, getS32(value)); break;
+            case PDReadType_U32: PDWrite_u32(writer, name, (uint32_t)getU32(value)); break;
+            case PDReadType_S64: PDWrite_s64(writer, name, getS64(value)); break;
+            case PDReadType_U64: PDWrite_u64(writer, name, getU64(value)); break;
+            case PDReadType_Float: PDWrite_float(writer, name, getFloat(value)); break;
+            case PDReadType_Double: PDWrite_double(writer, name, getDouble(value)); break;
+            case PDReadType_String: PDWrite_string(writer, name, (const char*)value); break;
+            case PDReadType_Data: PDWrite_data(writer, name, value, valueSize); break;
+            case PDReadType_Array: copyArray(rData, writer, name, start, size); break;
+
+            // data references are copied into the new stream as regular data
+
+            case PDReadType_DataRef:
+            {
+                uint64_t dataSize;
+                void* data = getDataRef(rData, value, &dataSize);
+
+                if (data)
+                    PDWrite_data(writer, name, data, (unsigned int)dataSize);
+
+                break;
+            }
+
+            // typed arrays are stored as padding count, padding and then the values (see findTypedArray)
+
+            case PDReadType_U8Array:
+                PDWrite_u8_array(writer, name, value + 1 + value[0], (valueSize - 1 - value[0]));
+                break;
+            case PDReadType_U16Array:
+                PDWrite_u16_array(writer, name, (const uint16_t*)(value + 1 + value[0]), (valueSize - 1 - value[0]) / 2);
+                break;
+            case PDReadType_U32Array:
+                PDWrite_u32_array(writer, name, (const uint32_t*)(value + 1 + value[0]), (valueSize - 1 - value[0]) / 4);
+                break;
+            case PDReadType_U64Array:
+                PDWrite_u64_array(writer, name, (const uint64_t*)(value + 1 + value[0]), (valueSize - 1 - value[0]) / 8);
+                break;
+            case PDReadType_FloatArray:
+                PDWrite_f32_array(writer, name, (const float*)(value + 1 + value[0]), (valueSize - 1 - value[0]) / 4);
+                break;
+        }
+
+        start += size;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_binary_reader_copy_events(PDReader* reader, PDWriter* writer) {
+    ReaderData* rData = (ReaderData*)reader->data;
+    uint8_t* data = rData->dataStart;
+
+    if (!data)
+        return;
+
+    PD_PROFILE_BEGIN("PDRead copy_events");
+
+    while (data < rData->dataEnd) {
+        uint8_t type = *data;
+        uint32_t size;
+
+        if (type == PDReadType_Event) {
+            size = (uint32_t)getU32(data + 3);
+
+            if (size < 7)
+                break;
+
+            PDWrite_event_begin(writer, getU16(data + 1));
+            copyFields(rData, writer, data + 7, data + size);
+            PDWrite_event_end(writer);
+        } else if (isStreamBlock(type)) {
+            size = (uint32_t)getU32(data + 1);
+        } else {
+            break;
+        }
+
+        if (size == 0)
+            break;
+
+        data += size;
+    }
+
+    PD_PROFILE_END();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_binary_reader_copy_event(PDReader* reader, PDWriter* writer, const char* skipKey) {
+    ReaderData* rData = (ReaderData*)reader->data;
+    uint8_t* field;
+    uint8_t* end;
+
+    if (!rData->event)
+        return;
+
+    field = rData->event + 7;
+    end = rData->event + getU32(rData->event + 3);
+
+    while (field < end) {
+        uint32_t size = getFieldSize(field);
+
+        if (size == 0)
+            break;
+
+        if (!skipKey || strcmp(getKeyName(rData, field), skipKey) != 0)
+            copyFields(rData, writer, field, field + size);
+
+        field += size;
+    }
+}
@@ -1,51 +1,367 @@
 #include <pd_readwrite.h>
 #include "pd_readwrite_private.h"
+#include "pd_key_table.h"
+#include "pd_chunk_pool.h"
+#include "pd_profiler.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+typedef struct DataRef {
+    uint32_t valueOffset;   // offset to the value in the stream (from dataStart)
+    void* data;
+    uint32_t size;
+    void (*release)(void* user_data, void* data);
+    void* userData;
+} DataRef;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 typedef struct WriterData {
     uint8_t*     dataStart;
     uint8_t*     data;
     uint8_t*     eventOffset;
     uint8_t*     arrayOffset;
     uint8_t*     entryOffset;
+    uint8_t*     keyTableOffset;
+    uint8_t*     headerArrayOffset;
+    uint8_t*     stringPool;
+    uint32_t*    entryOffsets;
+    DataRef*     refs;
+    PDBinarySegment* segments;
     unsigned int writingEvent;
     unsigned int writingArray;
     unsigned int writingArrayEntry;
+    unsigned int writingHeaderArray;
     unsigned int entryCount;
+    unsigned int arrayEntryCount;
+    unsigned int arrayEntriesOffset;
+    unsigned int entryOffsetCount;
+    unsigned int entryOffsetCapacity;
+    unsigned int arrayIsHeader;
+    unsigned int refCount;
+    unsigned int refCapacity;
+    uint8_t      refPayloadsHeader[5];
+    unsigned int columnCount;
+    unsigned int currentColumn;
+    unsigned int columnsSize;
+    unsigned int rowCount;
+    unsigned int rowSize;
+    unsigned int stringPoolSize;
+    unsigned int stringPoolCapacity;
+    uint8_t      columnTypes[PDHeaderArray_MaxColumns];
     unsigned int maxSize;
     unsigned int size;
+    unsigned int internKeys;
+    PDBinaryAllocator allocator;
+    PDKeyTable   keys;
 } WriterData;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+enum {
+    // Start small and grow on demand
+    WriterInitialSize = 64 * 1024,
+    // The stream size is stored in the lower 30 bits of the stream header
+    WriterMaxSize = 512 * 1024 * 1024,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 #ifdef _WIN32
 #define inline __inline
 #endif
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static inline uint8_t* writeIdSize(uint8_t* data, const char* id, uint8_t type, uint16_t typeSize) {
-    size_t len = strlen(id);
-    uint16_t totalSize = ((uint16_t)len) + typeSize + 4;    // + 4 for: type (1 byte) size (2 bytes) null term (1 byte)
+// Grows the buffer (by doubling) so it has room for at least size more bytes. As all the offsets we keep around
+// are pointers into the buffer they are moved along with the data.
+
+static int growBuffer(WriterData* wData, size_t size) {
+    uint8_t* newData;
+    size_t used = (size_t)(wData->data - wData->dataStart);
+    size_t newSize = wData->maxSize ? wData->maxSize : WriterInitialSize;
+
+    while (newSize < used + size) {
+        newSize *= 2;
+
+        if (newSize > WriterMaxSize) {
+            printf("Unable to grow writer to fit %d bytes (max size is %d)\n", (int)(used + size), WriterMaxSize);
+            return 0;
+        }
+    }
+
+    if (!(newData = wData->allocator.alloc(wData->allocator.user_data, newSize))) {
+        printf("Unable to allocate %d bytes for writer\n", (int)newSize);
+        return 0;
+    }
+
+    if (wData->dataStart)
+        memcpy(newData, wData->dataStart, used);
+
+#define rebase(ptr) if (ptr) ptr = newData + (ptr - wData->dataStart)
+    rebase(wData->eventOffset);
+    rebase(wData->arrayOffset);
+    rebase(wData->entryOffset);
+    rebase(wData->keyTableOffset);
+    rebase(wData->headerArrayOffset);
+#undef rebase
+
+    wData->allocator.free(wData->allocator.user_data, wData->dataStart, wData->maxSize);
+
+    wData->data = newData + used;
+    wData->dataStart = newData;
+    wData->maxSize = (unsigned int)newSize;
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Makes sure there is room for size bytes at the current write position
+
+static inline int reserve(WriterData* wData, size_t size) {
+    if ((size_t)(wData->data - wData->dataStart) + size <= wData->maxSize)
+        return 1;
+
+    return growBuffer(wData, size);
+}
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline int internKey(WriterData* wData, const char* id) {
+    if (!wData->internKeys)
+        return -1;
+
+    return pd_key_table_intern(&wData->keys, id);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint16_t getColumnSize(uint8_t type) {
+    switch (type) {
+        case PDReadType_S8:
+        case PDReadType_U8:
+            return 1;
+        case PDReadType_S16:
+        case PDReadType_U16:
+            return 2;
+        case PDReadType_S64:
+        case PDReadType_U64:
+        case PDReadType_Double:
+            return 8;
+        default:
+            return 4;   // 32-bit types, float and string offsets
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Inside a header array only the value is written. The types of the columns are decided by the first row and the
+// rest of the rows has to match it.
+
+static int writeColumn(WriterData* wData, uint8_t type) {
+    unsigned int column = wData->currentColumn;
+    uint16_t size = getColumnSize(type);
+
+    if (wData->rowCount == 0) {
+        wData->columnTypes[column] = type;
+    } else if (wData->columnTypes[column] != type) {
+        printf("Header array column %d has type %d but got %d\n", column, wData->columnTypes[column], type);
+        return 0;
+    }
+
+    if (!reserve(wData, size))
+        return 0;
+
+    // the value is written by the caller directly after this
+
+    if (wData->rowCount == 0)
+        wData->rowSize += size;
+
+    if (++wData->currentColumn == wData->columnCount) {
+        wData->currentColumn = 0;
+        wData->rowCount++;
+    }
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// realloc using the allocator of the writer. The old memory is kept if the new can't be allocated
+
+static void* reallocTable(WriterData* wData, void* ptr, size_t oldSize, size_t newSize) {
+    void* newPtr = wData->allocator.alloc(wData->allocator.user_data, newSize);
+
+    if (!newPtr)
+        return 0;
+
+    if (ptr) {
+        memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+        wData->allocator.free(wData->allocator.user_data, ptr, oldSize);
+    }
+
+    return newPtr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int writeColumnString(WriterData* wData, const char* v, size_t len) {
+    uint32_t offset = wData->stringPoolSize;
+
+    if (wData->stringPoolSize + len > wData->stringPoolCapacity) {
+        uint8_t* newPool;
+        size_t newSize = wData->stringPoolCapacity ? wData->stringPoolCapacity : 4096;
+
+        while (newSize < wData->stringPoolSize + len)
+            newSize *= 2;
+
+        if (newSize > WriterMaxSize || !(newPool = wData->allocator.alloc(wData->allocator.user_data, newSize)))
+            return 0;
+
+        if (wData->stringPool) {
+            memcpy(newPool, wData->stringPool, wData->stringPoolSize);
+            wData->allocator.free(wData->allocator.user_data, wData->stringPool, wData->stringPoolCapacity);
+        }
+
+        wData->stringPool = newPool;
+        wData->stringPoolCapacity = (unsigned int)newSize;
+    }
+
+    if (!writeColumn(wData, PDReadType_String))
+        return 0;
+
+    memcpy(wData->stringPool + offset, v, len);
+    wData->stringPoolSize += (unsigned int)len;
+
+    wData->data[0] = (offset >> 24) & 0xff;
+    wData->data[1] = (offset >> 16) & 0xff;
+    wData->data[2] = (offset >> 8) & 0xff;
+    wData->data[3] = (offset >> 0) & 0xff;
+    wData->data += 4;
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Writes the header (type, size and key) for a value of typeSize bytes and makes sure there is room for the value
+// itself. Returns 0 (without writing anything) if there isn't enough space
+
+static inline int writeIdSize(WriterData* wData, const char* id, uint8_t type, uint16_t typeSize) {
+    size_t len;
+    size_t totalSize;
+    uint8_t* data;
+    int keyId;
+
+    if (wData->writingHeaderArray)
+        return writeColumn(wData, type);
+
+    keyId = internKey(wData, id);
+
+    if (keyId >= 0) {
+        totalSize = (size_t)typeSize + 5;   // + 5 for: type (1 byte) size (2 bytes) key id (2 bytes)
+
+        if (totalSize > 0xffff || !reserve(wData, totalSize))
+            return 0;
+
+        data = wData->data;
+        data[0] = type | PDReadType_KeyIdFlag;
+        data[1] = (totalSize >> 8) & 0xff;
+        data[2] = (totalSize >> 0) & 0xff;
+        data[3] = (keyId >> 8) & 0xff;
+        data[4] = (keyId >> 0) & 0xff;
+
+        wData->data += 5;
+
+        return 1;
+    }
+
+    len = strlen(id);
+    totalSize = len + typeSize + 4;    // + 4 for: type (1 byte) size (2 bytes) null term (1 byte)
+
+    if (totalSize > 0xffff || !reserve(wData, totalSize))
+        return 0;
+
+    data = wData->data;
     data[0] = type;
     data[1] = (totalSize >> 8) & 0xff;
     data[2] = (totalSize >> 0) & 0xff;
 
     memcpy(data + 3, id, len + 1);
 
-    return data + len + 4;    // size (2) bytes, 1 byte (type), 1 byte (null terminator)
+    wData->data += len + 4;    // size (2) bytes, 1 byte (type), 1 byte (null terminator)
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Same as writeIdSize but for data/arrays where the size is 32-bit to support > 64k size.
+
+static inline int writeIdSize32(WriterData* wData, const char* id, uint8_t type, uint32_t typeSize) {
+    size_t len;
+    size_t totalSize;
+    uint8_t* data;
+    int keyId;
+
+    // data and arrays doesn't have a fixed size so they can't be used in header arrays
+
+    if (wData->writingHeaderArray) {
+        printf("Unable to write data/array inside a header array\n");
+        return 0;
+    }
+
+    keyId = internKey(wData, id);
+
+    if (keyId >= 0) {
+        totalSize = (size_t)typeSize + 7;   // type (1) size (4) key id (2)
+
+        if (totalSize > WriterMaxSize || !reserve(wData, totalSize))
+            return 0;
+
+        data = wData->data;
+        data[0] = type | PDReadType_KeyIdFlag;
+        data[1] = (totalSize >> 24) & 0xff;
+        data[2] = (totalSize >> 16) & 0xff;
+        data[3] = (totalSize >> 8) & 0xff;
+        data[4] = (totalSize >> 0) & 0xff;
+        data[5] = (keyId >> 8) & 0xff;
+        data[6] = (keyId >> 0) & 0xff;
+
+        wData->data += 7;
+
+        return 1;
+    }
+
+    len = strlen(id);
+    totalSize = len + typeSize + 6;    // type (1) size (4) null term (1)
+
+    if (totalSize > WriterMaxSize || !reserve(wData, totalSize))
+        return 0;
+
+    data = wData->data;
+    data[0] = type;
+    data[1] = (totalSize >> 24) & 0xff;
+    data[2] = (totalSize >> 16) & 0xff;
+    data[3] = (totalSize >> 8) & 0xff;
+    data[4] = (totalSize >> 0) & 0xff;
+
+    memcpy(data + 5, id, len + 1);
+
+    wData->data += len + 6;
+
+    return 1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static PDWriteStatus write_s8(struct PDWriter* writer, const char* id, int8_t v) {
     WriterData* wData = (WriterData*)writer->data;
-    wData->data = writeIdSize(wData->data, id, PDReadType_S8, sizeof(int8_t));
+
+    if (!writeIdSize(wData, id, PDReadType_S8, sizeof(int8_t)))
+        return PDWriteStatus_Fail;
+
     *wData->data++ = v;
 
     if (wData->writingArrayEntry) {
@@ -59,7 +375,10 @@ static PDWriteStatus write_s8(struct PDWriter* writer, const char* id, int8_t v)
 
 static PDWriteStatus write_u8(struct PDWriter* writer, const char* id, uint8_t v) {
     WriterData* wData = (WriterData*)writer->data;
-    wData->data = writeIdSize(wData->data, id, PDReadType_U8, sizeof(uint8_t));
+
+    if (!writeIdSize(wData, id, PDReadType_U8, sizeof(uint8_t)))
+        return PDWriteStatus_Fail;
+
     *wData->data++ = v;
 
     if (wData->writingArrayEntry) {
@@ -73,7 +392,9 @@ static PDWriteStatus write_u8(struct PDWriter* writer, const char* id, uint8_t v
 
 static PDWriteStatus write_s16(struct PDWriter* writer, const char* id, int16_t v) {
     WriterData* wData = (WriterData*)writer->data;
-    wData->data = writeIdSize(wData->data, id, PDReadType_S16, sizeof(int16_t));
+
+    if (!writeIdSize(wData, id, PDReadType_S16, sizeof(int16_t)))
+        return PDWriteStatus_Fail;
 
     wData->data[0] = (v >> 8) & 0xff;
     wData->data[1] = (v >> 0) & 0xff;
@@ -90,7 +411,9 @@ static PDWriteStatus write_s16(struct PDWriter* writer, const char* id, int16_t
 
 static PDWriteStatus write_u16(struct PDWriter* writer, const char* id, uint16_t v) {
     WriterData* wData = (WriterData*)writer->data;
-    wData->data = writeIdSize(wData->data, id, PDReadType_U16, sizeof(uint16_t));
+
+    if (!writeIdSize(wData, id, PDReadType_U16, sizeof(uint16_t)))
+        return PDWriteStatus_Fail;
 
     wData->data[0] = (v >> 8) & 0xff;
     wData->data[1] = (v >> 0) & 0xff;
@@ -107,7 +430,9 @@ static PDWriteStatus write_u16(struct PDWriter* writer, const char* id, uint16_t
 
 static PDWriteStatus write_s32(struct PDWriter* writer, const char* id, int32_t v) {
     WriterData* wData = (WriterData*)writer->data;
-    wData->data = writeIdSize(wData->data, id, PDReadType_S32, sizeof(int32_t));
+
+    if (!writeIdSize(wData, id, PDReadType_S32, sizeof(int32_t)))
+        return PDWriteStatus_Fail;
 
     wData->data[0] = (v >> 24) & 0xff;
     wData->data[1] = (v >> 16) & 0xff;
@@ -126,7 +451,9 @@ static PDWriteStatus write_s32(struct PDWriter* writer, const char* id, int32_t
 
 static PDWriteStatus write_u32(struct PDWriter* writer, const char* id, uint32_t v) {
     WriterData* wData = (WriterData*)writer->data;
-    wData->data = writeIdSize(wData->data, id, PDReadType_U32, sizeof(uint32_t));
+
+    if (!writeIdSize(wData, id, PDReadType_U32, sizeof(uint32_t)))
+        return PDWriteStatus_Fail;
 
     wData->data[0] = (v >> 24) & 0xff;
     wData->data[1] = (v >> 16) & 0xff;
@@ -145,7 +472,9 @@ static PDWriteStatus write_u32(struct PDWriter* writer, const char* id, uint32_t
 
 static PDWriteStatus write_s64(struct PDWriter* writer, const char* id, int64_t v) {
     WriterData* wData = (WriterData*)writer->data;
-    wData->data = writeIdSize(wData->data, id, PDReadType_S64, sizeof(int64_t));
+
+    if (!writeIdSize(wData, id, PDReadType_S64, sizeof(int64_t)))
+        return PDWriteStatus_Fail;
 
     wData->data[0] = (v >> 56) & 0xff;
     wData->data[1] = (v >> 48) & 0xff;
@@ -168,7 +497,9 @@ static PDWriteStatus write_s64(struct PDWriter* writer, const char* id, int64_t
 
 static PDWriteStatus write_u64(struct PDWriter* writer, const char* id, uint64_t v) {
     WriterData* wData = (WriterData*)writer->data;
-    wData->data = writeIdSize(wData->data, id, PDReadType_U64, sizeof(uint64_t));
+
+    if (!writeIdSize(wData, id, PDReadType_U64, sizeof(uint64_t)))
+        return PDWriteStatus_Fail;
 
     wData->data[0] = (v >> 56) & 0xff;
     wData->data[1] = (v >> 48) & 0xff;
@@ -201,7 +532,9 @@ union Convert {
 static PDWriteStatus write_float(struct PDWriter* writer, const char* id, float v) {
     union Convert c;
     WriterData* wData = (WriterData*)writer->data;
-    wData->data = writeIdSize(wData->data, id, PDReadType_Float, sizeof(uint32_t));
+
+    if (!writeIdSize(wData, id, PDReadType_Float, sizeof(uint32_t)))
+        return PDWriteStatus_Fail;
 
     c.fv = v;
 
@@ -223,7 +556,9 @@ static PDWriteStatus write_float(struct PDWriter* writer, const char* id, float
 static PDWriteStatus write_double(struct PDWriter* writer, const char* id, double v) {
     union Convert c;
     WriterData* wData = (WriterData*)writer->data;
-    wData->data = writeIdSize(wData->data, id, PDReadType_Double, sizeof(uint64_t));
+
+    if (!writeIdSize(wData, id, PDReadType_Double, sizeof(uint64_t)))
+        return PDWriteStatus_Fail;
 
     c.dv = v;
 
@@ -252,7 +587,12 @@ static PDWriteStatus write_string(struct PDWriter* writer, const char* id, const
 
     len = strlen(v) + 1;
 
-    wData->data = writeIdSize(wData->data, id, PDReadType_String, (uint16_t)len);
+    if (wData->writingHeaderArray)
+        return writeColumnString(wData, v, len) ? PDWriteStatus_ok : PDWriteStatus_Fail;
+
+    if (len > 0xffff || !writeIdSize(wData, id, PDReadType_String, (uint16_t)len))
+        return PDWriteStatus_Fail;
+
     memcpy(wData->data, v, len);
 
     wData->data += len;
@@ -268,35 +608,205 @@ static PDWriteStatus write_string(struct PDWriter* writer, const char* id, const
 
 static PDWriteStatus write_data(struct PDWriter* writer, const char* id, void* data, unsigned int len) {
     WriterData* wData = (WriterData*)writer->data;
-    size_t idLen = strlen(id);
 
     // for data we special case a bit with having the size in 32-bit instead to support > 64k size
 
-    uint32_t totalSize = ((uint16_t)idLen) + 4 + 1 + len + 1; // size (4) + type (1) + id_len (+1) null teminator
+    if (!writeIdSize32(wData, id, PDReadType_Data, len))
+        return PDWriteStatus_Fail;
+
+    memcpy(wData->data, data, len);
+
+    wData->data += len;
+
+    if (wData->writingArrayEntry) {
+        wData->entryCount++;
+    }
+
+    return PDWriteStatus_ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Typed arrays are stored as: header (32-bit size), padding count (1 byte), padding, values. The values are aligned
+// (relative to the start of the stream) to the size of the type and stored in native (little endian) order so they
+// can be used directly by the reader.
+
+static PDWriteStatus writeTypedArray(WriterData* wData, const char* id, uint8_t type, const void* data,
+                                     unsigned int count, unsigned int elementSize) {
+    size_t headerSize;
+    size_t valueOffset;
+    uint64_t size = (uint64_t)count * elementSize;
+    unsigned int padding;
+    int keyId;
+
+    if (size > WriterMaxSize)
+        return PDWriteStatus_Fail;
+
+    // figure out the size of the header so we know how much padding is needed
+
+    keyId = internKey(wData, id);
+    headerSize = keyId >= 0 ? 7 : strlen(id) + 6;
+    valueOffset = (size_t)(wData->data - wData->dataStart) + headerSize + 1;
+    padding = (unsigned int)(-(ptrdiff_t)valueOffset & (elementSize - 1));
+
+    if (!writeIdSize32(wData, id, type, (uint32_t)(size + padding + 1)))
+        return PDWriteStatus_Fail;
+
+    *wData->data++ = (uint8_t)padding;
+    memset(wData->data, 0, padding);
+    wData->data += padding;
+
+    if (elementSize == 1 || pd_is_little_endian()) {
+        memcpy(wData->data, data, (size_t)size);
+    } else {
+        const uint8_t* src = (const uint8_t*)data;
+        unsigned int i, j;
+
+        for (i = 0; i < count; ++i, src += elementSize) {
+            for (j = 0; j < elementSize; ++j)
+                wData->data[i * elementSize + j] = src[elementSize - 1 - j];
+        }
+    }
+
+    wData->data += size;
+
+    if (wData->writingArrayEntry) {
+        wData->entryCount++;
+    }
+
+    return PDWriteStatus_ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDWriteStatus write_u8_array(struct PDWriter* writer, const char* id, const uint8_t* data, unsigned int count) {
+    return writeTypedArray((WriterData*)writer->data, id, PDReadType_U8Array, data, count, sizeof(uint8_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDWriteStatus write_u16_array(struct PDWriter* writer, const char* id, const uint16_t* data, unsigned int count) {
+    return writeTypedArray((WriterData*)writer->data, id, PDReadType_U16Array, data, count, sizeof(uint16_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDWriteStatus write_u32_array(struct PDWriter* writer, const char* id, const uint32_t* data, unsigned int count) {
+    return writeTypedArray((WriterData*)writer->data, id, PDReadType_U32Array, data, count, sizeof(uint32_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDWriteStatus write_u64_array(struct PDWriter* writer, const char* id, const uint64_t* data, unsigned int count) {
+    return writeTypedArray((WriterData*)writer->data, id, PDReadType_U64Array, data, count, sizeof(uint64_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDWriteStatus write_f32_array(struct PDWriter* writer, const char* id, const float* data, unsigned int count) {
+    return writeTypedArray((WriterData*)writer->data, id, PDReadType_FloatArray, data, count, sizeof(float));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDWriteStatus write_data_ref(struct PDWriter* writer, const char* id, void* data, unsigned int len,
+                                    void (*release)(void* user_data, void* data), void* user_data) {
+    uint8_t* value;
+    WriterData* wData = (WriterData*)writer->data;
+
+    // make sure we have space for the ref (and the segment to send it) before writing anything
+
+    if (wData->refCount == wData->refCapacity) {
+        unsigned int capacity = wData->refCapacity ? wData->refCapacity * 2 : 16;
+        size_t refsSize = wData->refCapacity * sizeof(DataRef);
+        size_t segmentsSize = (wData->refCapacity + 2) * sizeof(PDBinarySegment);
+        DataRef* refs = wData->allocator.alloc(wData->allocator.user_data, capacity * sizeof(DataRef));
+        PDBinarySegment* segments = wData->allocator.alloc(wData->allocator.user_data,
+                                                           (capacity + 2) * sizeof(PDBinarySegment));
 
-    wData->data[0] = PDReadType_Data;
-    wData->data[1] = (totalSize >> 24) & 0xff;
-    wData->data[2] = (totalSize >> 16) & 0xff;
-    wData->data[3] = (totalSize >> 8) & 0xff;
-    wData->data[4] = (totalSize >> 0) & 0xff;
+        // both use refCapacity for their size so either both grow or none of them
 
-    memcpy(wData->data + 5, id, idLen + 1);
-    memcpy(wData->data + 5 + idLen + 1, data, len);
+        if (!refs || !segments) {
+            if (refs)
+                wData->allocator.free(wData->allocator.user_data, refs, capacity * sizeof(DataRef));
 
-    wData->data += totalSize;
+            if (segments)
+                wData->allocator.free(wData->allocator.user_data, segments, (capacity + 2) * sizeof(PDBinarySegment));
+
+            goto fail;
+        }
+
+        if (wData->refs) {
+            memcpy(refs, wData->refs, refsSize);
+            wData->allocator.free(wData->allocator.user_data, wData->refs, refsSize);
+        }
+
+        if (wData->segments)
+            wData->allocator.free(wData->allocator.user_data, wData->segments, segmentsSize);
+
+        wData->refs = refs;
+        wData->segments = segments;
+        wData->refCapacity = capacity;
+    }
+
+    if (wData->writingHeaderArray || !writeIdSize(wData, id, PDReadType_DataRef, PDDataRef_Size))
+        goto fail;
+
+    value = wData->data;
+
+    memcpy(value, &data, sizeof(void*));
+
+    if (sizeof(void*) < 8)
+        memset(value + sizeof(void*), 0, 8 - sizeof(void*));
+
+    value[8] = (len >> 24) & 0xff;
+    value[9] = (len >> 16) & 0xff;
+    value[10] = (len >> 8) & 0xff;
+    value[11] = (len >> 0) & 0xff;
+    value[12] = value[13] = value[14] = value[15] = 0;
+
+    wData->data += PDDataRef_Size;
+
+    wData->refs[wData->refCount].valueOffset = (uint32_t)(value - wData->dataStart);
+    wData->refs[wData->refCount].data = data;
+    wData->refs[wData->refCount].size = len;
+    wData->refs[wData->refCount].release = release;
+    wData->refs[wData->refCount].userData = user_data;
+    wData->refCount++;
 
     if (wData->writingArrayEntry) {
         wData->entryCount++;
     }
 
     return PDWriteStatus_ok;
+
+fail:
+
+    if (release)
+        release(user_data, data);
+
+    return PDWriteStatus_Fail;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void releaseRefs(WriterData* wData) {
+    unsigned int i;
+
+    for (i = 0; i < wData->refCount; ++i) {
+        DataRef* ref = &wData->refs[i];
+
+        if (ref->release)
+            ref->release(ref->userData, ref->data);
+    }
+
+    wData->refCount = 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static PDWriteStatus write_event_begin(struct PDWriter* writer, uint16_t event) {
     WriterData* wData = (WriterData*)writer->data;
-    wData->eventOffset = wData->data + 3;
 
     if (wData->writingEvent) {
         // \todo proper logging here
@@ -304,6 +814,10 @@ static PDWriteStatus write_event_begin(struct PDWriter* writer, uint16_t event)
         return PDWriteStatus_Fail;
     }
 
+    if (!reserve(wData, 7))
+        return PDWriteStatus_Fail;
+
+    wData->eventOffset = wData->data + 3;
     wData->data[0] = PDReadType_Event;
     wData->data[1] = (event >> 8) & 0xff;
     wData->data[2] = (event >> 0) & 0xff;
@@ -341,23 +855,164 @@ static PDWriteStatus write_event_end(struct PDWriter* writer) {
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static PDWriteStatus write_header_array_begin(struct PDWriter* writer, const char** ids) {
-    (void)writer;
-    (void)ids;
-    return PDWriteStatus_Fail;
+    uint8_t* data;
+    size_t size = PDHeaderArray_HeaderSize;
+    unsigned int i, count = 0;
+    WriterData* wData = (WriterData*)writer->data;
+
+    // header arrays are stored in place of the entries of a regular array so the array gets a name and
+    // readers can use PDRead_get_next_entry to go over the rows
+
+    if (!wData->writingArray || wData->writingArrayEntry || wData->writingHeaderArray || wData->arrayEntryCount) {
+        // \todo proper logging here
+        printf("Unable to write headerArrayBegin, it must be the first thing written after arrayBegin\n");
+        return PDWriteStatus_Fail;
+    }
+
+    if (!ids || !ids[0])
+        return PDWriteStatus_Fail;
+
+    for (count = 0; ids[count]; ++count)
+        size += strlen(ids[count]) + 2;   // type (1) name + null terminator
+
+    if (count > PDHeaderArray_MaxColumns) {
+        printf("Unable to write headerArrayBegin, %d columns used but max is %d\n", count, PDHeaderArray_MaxColumns);
+        return PDWriteStatus_Fail;
+    }
+
+    if (!reserve(wData, size))
+        return PDWriteStatus_Fail;
+
+    data = wData->headerArrayOffset = wData->data;
+
+    // sizes, counts and column types are filled in at headerArrayEnd
+
+    memset(data, 0, PDHeaderArray_HeaderSize);
+    data[0] = PDReadType_HeaderArray;
+    data[11] = (uint8_t)count;
+    data += PDHeaderArray_HeaderSize;
+
+    for (i = 0; i < count; ++i) {
+        size_t len = strlen(ids[i]) + 1;
+        *data++ = PDReadType_None;
+        memcpy(data, ids[i], len);
+        data += len;
+    }
+
+    wData->data = data;
+    wData->columnsSize = (unsigned int)size;
+    wData->columnCount = count;
+    wData->currentColumn = 0;
+    wData->rowCount = 0;
+    wData->rowSize = 0;
+    wData->stringPoolSize = 0;
+    wData->writingHeaderArray = 1;
+    wData->arrayIsHeader = 1;
+
+    return PDWriteStatus_ok;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static PDWriteStatus write_header_array_end(struct PDWriter* writer) {
-    (void)writer;
-    return PDWriteStatus_Fail;
+    uint8_t* header;
+    uint8_t* columns;
+    uint32_t size;
+    uint32_t poolOffset;
+    unsigned int i;
+    PDWriteStatus status = PDWriteStatus_ok;
+    WriterData* wData = (WriterData*)writer->data;
+
+    if (!wData->writingHeaderArray) {
+        // \todo proper logging here
+        printf("Unable to write headerArrayEnd as no headerArrayBegin has been called before this call\n");
+        return PDWriteStatus_Fail;
+    }
+
+    wData->writingHeaderArray = 0;
+
+    // throw away a row that hasn't been completed
+
+    if (wData->currentColumn != 0) {
+        printf("Header array row %d isn't complete (%d of %d columns written)\n",
+               wData->rowCount, wData->currentColumn, wData->columnCount);
+        wData->data = wData->headerArrayOffset + wData->columnsSize + wData->rowCount * wData->rowSize;
+        wData->currentColumn = 0;
+        status = PDWriteStatus_Fail;
+
+        if (wData->rowCount == 0)
+            wData->rowSize = 0;
+    }
+
+    poolOffset = (uint32_t)(wData->data - wData->headerArrayOffset);
+
+    if (!reserve(wData, wData->stringPoolSize)) {
+        wData->data = wData->headerArrayOffset;
+        return PDWriteStatus_Fail;
+    }
+
+    memcpy(wData->data, wData->stringPool, wData->stringPoolSize);
+    wData->data += wData->stringPoolSize;
+
+    header = wData->headerArrayOffset;
+    size = (uint32_t)(wData->data - header);
+
+    header[1] = (size >> 24) & 0xff;
+    header[2] = (size >> 16) & 0xff;
+    header[3] = (size >> 8) & 0xff;
+    header[4] = (size >> 0) & 0xff;
+    header[5] = (wData->rowCount >> 24) & 0xff;
+    header[6] = (wData->rowCount >> 16) & 0xff;
+    header[7] = (wData->rowCount >> 8) & 0xff;
+    header[8] = (wData->rowCount >> 0) & 0xff;
+    header[9] = (wData->rowSize >> 8) & 0xff;
+    header[10] = (wData->rowSize >> 0) & 0xff;
+    header[12] = (poolOffset >> 24) & 0xff;
+    header[13] = (poolOffset >> 16) & 0xff;
+    header[14] = (poolOffset >> 8) & 0xff;
+    header[15] = (poolOffset >> 0) & 0xff;
+
+    columns = header + PDHeaderArray_HeaderSize;
+
+    for (i = 0; i < wData->columnCount; ++i) {
+        *columns++ = wData->rowCount ? wData->columnTypes[i] : PDReadType_None;
+        columns += strlen((const char*)columns) + 1;
+    }
+
+    wData->arrayEntryCount++;
+    wData->headerArrayOffset = 0;
+
+    return status;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Offsets to all entries in the current array (relative to the first entry) are kept so they can be written as a
+// table at the end of the array which allows readers to go directly to any entry
+
+static int addEntryOffset(WriterData* wData) {
+    if (wData->entryOffsetCount == wData->entryOffsetCapacity) {
+        unsigned int capacity = wData->entryOffsetCapacity ? wData->entryOffsetCapacity * 2 : 256;
+        uint32_t* offsets = reallocTable(wData, wData->entryOffsets,
+                                         wData->entryOffsetCapacity * sizeof(uint32_t), capacity * sizeof(uint32_t));
+
+        if (!offsets)
+            return 0;
+
+        wData->entryOffsets = offsets;
+        wData->entryOffsetCapacity = capacity;
+    }
+
+    wData->entryOffsets[wData->entryOffsetCount++] =
+        (uint32_t)(wData->data - wData->dataStart) - wData->arrayEntriesOffset;
+
+    return 1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static PDWriteStatus write_array_entry_begin(struct PDWriter* writer) {
     WriterData* wData = (WriterData*)writer->data;
-    wData->entryOffset = wData->data + 1;
 
     if (wData->writingArrayEntry) {
         // \todo proper logging here
@@ -365,9 +1020,22 @@ static PDWriteStatus write_array_entry_begin(struct PDWriter* writer) {
         return PDWriteStatus_Fail;
     }
 
+    if (wData->writingHeaderArray) {
+        printf("Unable to write arrayEntryBegin inside a header array.\n");
+        return PDWriteStatus_Fail;
+    }
+
+    if (!reserve(wData, 7))
+        return PDWriteStatus_Fail;
+
+    if (wData->writingArray && !addEntryOffset(wData))
+        return PDWriteStatus_Fail;
+
+    wData->entryOffset = wData->data + 1;
     wData->data[0] = PDReadType_ArrayEntry;
     wData->writingArrayEntry = 1;
     wData->entryCount = 0;
+    wData->arrayEntryCount++;
 
     // we will store the size and entryCount here (at writeEndEvent) so skip 4 bytes a head
     wData->data += 7;
@@ -404,9 +1072,8 @@ static PDWriteStatus write_array_entry_end(struct PDWriter* writer) {
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static PDWriteStatus write_array_begin(struct PDWriter* writer, const char* name) {
+    size_t offset;
     WriterData* wData = (WriterData*)writer->data;
-    int len = (int)strlen(name) + 1;
-    wData->arrayOffset = wData->data + 1;
 
     if (wData->writingArray) {
         // \todo proper logging here
@@ -414,12 +1081,22 @@ static PDWriteStatus write_array_begin(struct PDWriter* writer, const char* name
         return PDWriteStatus_Fail;
     }
 
-    wData->data[0] = PDReadType_Array;
-    memcpy(wData->data + 5, name, len);
-    wData->writingArray = 1;
+    // the size, entry count and offset to the entry table are stored at writArrayEnd so we only write the
+    // header here and skip the entry count (4 bytes) and table offset (4 bytes)
 
-    // we will store the size here (at writArrayEnd) so skip 4 bytes a head
-    wData->data += len + 5;
+    offset = (size_t)(wData->data - wData->dataStart);
+
+    if (!writeIdSize32(wData, name, PDReadType_Array, 8))
+        return PDWriteStatus_Fail;
+
+    wData->data += 8;
+
+    wData->arrayOffset = wData->dataStart + offset + 1;
+    wData->arrayEntriesOffset = (unsigned int)(wData->data - wData->dataStart);
+    wData->writingArray = 1;
+    wData->arrayEntryCount = 0;
+    wData->entryOffsetCount = 0;
+    wData->arrayIsHeader = 0;
 
     return PDWriteStatus_ok;
 }
@@ -427,7 +1104,11 @@ static PDWriteStatus write_array_begin(struct PDWriter* writer, const char* name
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static PDWriteStatus write_array_end(struct PDWriter* writer) {
+    uint8_t* entries;
     uint32_t size;
+    uint32_t count;
+    uint32_t tableOffset = 0;
+    unsigned int i;
     WriterData* wData = (WriterData*)writer->data;
 
     if (!wData->writingArray) {
@@ -436,11 +1117,47 @@ static PDWriteStatus write_array_end(struct PDWriter* writer) {
         return PDWriteStatus_Fail;
     }
 
+    if (wData->writingHeaderArray)
+        write_header_array_end(writer);
+
+    count = wData->arrayIsHeader ? wData->rowCount : wData->entryOffsetCount;
+
     // write an empty arrayEntry to indicate there are no more entries in the array
 
-    write_array_entry_begin(writer);
+    if (write_array_entry_begin(writer) != PDWriteStatus_ok)
+        goto fail;
+
     write_array_entry_end(writer);
 
+    // rows in header arrays has fixed size so they don't need any table
+
+    if (!wData->arrayIsHeader) {
+        if (!reserve(wData, count * 4))
+            goto fail;
+
+        tableOffset = (uint32_t)(wData->data - wData->dataStart) - wData->arrayEntriesOffset;
+
+        for (i = 0; i < count; ++i) {
+            uint32_t v = wData->entryOffsets[i];
+            wData->data[0] = (v >> 24) & 0xff;
+            wData->data[1] = (v >> 16) & 0xff;
+            wData->data[2] = (v >> 8) & 0xff;
+            wData->data[3] = (v >> 0) & 0xff;
+            wData->data += 4;
+        }
+    }
+
+    entries = wData->dataStart + wData->arrayEntriesOffset;
+
+    entries[-8] = (count >> 24) & 0xff;
+    entries[-7] = (count >> 16) & 0xff;
+    entries[-6] = (count >> 8) & 0xff;
+    entries[-5] = (count >> 0) & 0xff;
+    entries[-4] = (tableOffset >> 24) & 0xff;
+    entries[-3] = (tableOffset >> 16) & 0xff;
+    entries[-2] = (tableOffset >> 8) & 0xff;
+    entries[-1] = (tableOffset >> 0) & 0xff;
+
     // + 1 to include the meta data at the begining with the size
     size = (uint32_t)(uintptr_t)(wData->data - wData->arrayOffset) + 1;
     wData->arrayOffset[0] = (size >> 24) & 0xff;
@@ -450,12 +1167,23 @@ static PDWriteStatus write_array_end(struct PDWriter* writer) {
     wData->writingArray = 0;
 
     return PDWriteStatus_ok;
+
+fail:
+
+    // the array is left unfinished (so is the event) but new arrays can still be written
+
+    wData->writingArray = 0;
+    wData->writingArrayEntry = 0;
+    wData->arrayIsHeader = 0;
+    wData->entryOffsetCount = 0;
+
+    return PDWriteStatus_Fail;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void pd_binary_writer_init(PDWriter* writer) {
+void pd_binary_writer_init_with_allocator(PDWriter* writer, const PDBinaryAllocator* allocator) {
     WriterData* data;
 
     writer->write_event_begin = write_event_begin;
@@ -478,26 +1206,49 @@ void pd_binary_writer_init(PDWriter* writer) {
     writer->write_double = write_double;
     writer->write_string = write_string;
     writer->write_data = write_data;
+    writer->write_data_ref = write_data_ref;
+    writer->write_u8_array = write_u8_array;
+    writer->write_u16_array = write_u16_array;
+    writer->write_u32_array = write_u32_array;
+    writer->write_u64_array = write_u64_array;
+    writer->write_f32_array = write_f32_array;
 
     //printf("pd_binary_writer_init\n");
 
-    writer->data = malloc(sizeof(WriterData));
-    memset(writer->data, 0, sizeof(WriterData));
+    // all memory of the writer (also this) comes from the allocator
+
+    writer->data = data = allocator->alloc(allocator->user_data, sizeof(WriterData));
+
+    if (!data) {
+        printf("Unable to allocate writer\n");
+        return;
+    }
+
+    memset(data, 0, sizeof(WriterData));
+
+    data->allocator = *allocator;
 
-    data = (WriterData*)writer->data;
+    // start small, the buffer will grow if needed and is kept between resets
 
-    // \todo: Make this tweakble/custom allocator 2 meg should be enough most of the time
+    data->data = data->dataStart = data->allocator.alloc(data->allocator.user_data, WriterInitialSize);
+    data->maxSize = data->dataStart ? WriterInitialSize : 0;
 
-    data->data = data->dataStart = malloc(1024 * 1024 * 2);
     // reserve 4 bytes at the start (to be used for size and 2 flags at the top)
     data->data += 4;
-    data->maxSize = 2 * 1024 * 1024;
 
     //printf("data-start %p\n", data->dataStart);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void pd_binary_writer_init(PDWriter* writer) {
+    PDBinaryAllocator allocator;
+    pd_chunk_pool_get_default_allocator(&allocator);
+    pd_binary_writer_init_with_allocator(writer, &allocator);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 PDWriter* pd_binary_writer_create() {
     PDWriter* writer = malloc(sizeof(PDWriter));
     memset(writer, 0, sizeof(PDWriter));
@@ -514,18 +1265,69 @@ unsigned char* pd_binary_writer_get_data(PDWriter* writer) {
     return data->dataStart;
 }
 
+// Appends the table of interned keys to the end of the stream. If nothing has been written since the last
+// finalize the previous table is replaced, otherwise a new one is added and the reader will use the last one
+
+static int writeKeyTable(WriterData* wData) {
+    uint8_t* data;
+    uint32_t size;
+
+    if (wData->keyTableOffset) {
+        uint8_t* t = wData->keyTableOffset;
+        size = (t[1] << 24) | (t[2] << 16) | (t[3] << 8) | t[4];
+
+        if (t + size == wData->data)
+            wData->data = t;
+    }
+
+    if (wData->keys.count == 0)
+        return 1;
+
+    size = wData->keys.namesSize + 7;   // type (1) size (4) count (2)
+
+    if (!reserve(wData, size)) {
+        wData->keyTableOffset = 0;
+        return 0;
+    }
+
+    data = wData->keyTableOffset = wData->data;
+
+    data[0] = PDReadType_KeyTable;
+    data[1] = (size >> 24) & 0xff;
+    data[2] = (size >> 16) & 0xff;
+    data[3] = (size >> 8) & 0xff;
+    data[4] = (size >> 0) & 0xff;
+    data[5] = (wData->keys.count >> 8) & 0xff;
+    data[6] = (wData->keys.count >> 0) & 0xff;
+
+    memcpy(data + 7, wData->keys.names, wData->keys.namesSize);
+
+    wData->data += size;
+
+    return 1;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Write size at the very start of the data
 
 void pd_binary_writer_finalize(PDWriter* writer) {
     WriterData* data = (WriterData*)writer->data;
     uint8_t* wData = data->dataStart;
-    uint32_t v = pd_binary_writer_get_size(writer) + 4;
+    uint32_t v;
+
+    PD_PROFILE_BEGIN("PDWrite finalize");
+
+    if (!writeKeyTable(data))
+        printf("Unable to fit the key table in the writer, stream will be unreadable\n");
+
+    v = pd_binary_writer_get_size(writer) + 4;
 
     wData[0] = (v >> 24) & 0xff;
     wData[1] = (v >> 16) & 0xff;
     wData[2] = (v >> 8) & 0xff;
     wData[3] = (v >> 0) & 0xff;
+
+    PD_PROFILE_END();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -537,22 +1339,145 @@ unsigned int pd_binary_writer_get_size(PDWriter* writer) {
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+const PDBinarySegment* pd_binary_writer_get_segments(PDWriter* writer, int* count) {
+    WriterData* data = (WriterData*)writer->data;
+    uint8_t* header = data->refPayloadsHeader;
+    uint64_t offset;
+    uint64_t payloadSize = 5;
+    uint32_t v;
+    unsigned int i;
+
+    // segments are allocated along with the refs (see write_data_ref)
+
+    if (!data->segments) {
+        if (!(data->segments = data->allocator.alloc(data->allocator.user_data, 2 * sizeof(PDBinarySegment))))
+            return 0;
+    }
+
+    if (data->refCount == 0) {
+        data->segments[0].data = data->dataStart;
+        data->segments[0].size = pd_binary_writer_get_size(writer) + 4;
+        *count = 1;
+        return data->segments;
+    }
+
+    for (i = 0; i < data->refCount; ++i)
+        payloadSize += data->refs[i].size;
+
+    if (pd_binary_writer_get_size(writer) + 4 + payloadSize > WriterMaxSize) {
+        printf("Stream with data references is too large to send (%d bytes)\n", (int)payloadSize);
+        return 0;
+    }
+
+    // offsets are relative to the start of the data (after the 4 bytes with the size) and the payloads
+    // are placed after the payloads header that follows the stream
+
+    offset = pd_binary_writer_get_size(writer) + 5;
+
+    data->segments[0].data = data->dataStart;
+    data->segments[0].size = pd_binary_writer_get_size(writer) + 4;
+    data->segments[1].data = header;
+    data->segments[1].size = 5;
+
+    for (i = 0; i < data->refCount; ++i) {
+        DataRef* ref = &data->refs[i];
+        uint8_t* value = data->dataStart + ref->valueOffset;
+
+        value[12] = (offset >> 24) & 0xff;
+        value[13] = (offset >> 16) & 0xff;
+        value[14] = (offset >> 8) & 0xff;
+        value[15] = (offset >> 0) & 0xff;
+
+        data->segments[i + 2].data = ref->data;
+        data->segments[i + 2].size = ref->size;
+
+        offset += ref->size;
+    }
+
+    header[0] = PDReadType_DataRefPayloads;
+    header[1] = (payloadSize >> 24) & 0xff;
+    header[2] = (payloadSize >> 16) & 0xff;
+    header[3] = (payloadSize >> 8) & 0xff;
+    header[4] = (payloadSize >> 0) & 0xff;
+
+    // the size at the start of the stream has to include the payloads
+
+    v = (uint32_t)(pd_binary_writer_get_size(writer) + 4 + payloadSize);
+
+    data->dataStart[0] = (v >> 24) & 0xff;
+    data->dataStart[1] = (v >> 16) & 0xff;
+    data->dataStart[2] = (v >> 8) & 0xff;
+    data->dataStart[3] = (v >> 0) & 0xff;
+
+    *count = (int)data->refCount + 2;
+
+    return data->segments;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void pd_binary_writer_reset(PDWriter* writer) {
     WriterData* data = (WriterData*)writer->data;
-    void* tempData = data->dataStart;
-    memset(data, 0, sizeof(WriterData));
-    data->data = data->dataStart = tempData;
-    data->data += 4;
+
+    releaseRefs(data);
+
+    data->data = data->dataStart + 4;
+    data->eventOffset = 0;
+    data->arrayOffset = 0;
+    data->entryOffset = 0;
+    data->keyTableOffset = 0;
+    data->headerArrayOffset = 0;
+    data->writingEvent = 0;
+    data->writingArray = 0;
+    data->writingArrayEntry = 0;
+    data->writingHeaderArray = 0;
+    data->entryCount = 0;
+    data->arrayEntryCount = 0;
+    data->entryOffsetCount = 0;
+    data->arrayIsHeader = 0;
+    data->stringPoolSize = 0;
+    data->size = 0;
+
+    pd_key_table_clear(&data->keys);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_binary_writer_set_intern_keys(PDWriter* writer, int enable) {
+    WriterData* data = (WriterData*)writer->data;
+    data->internKeys = !!enable;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void pd_binary_writer_destroy(PDWriter* writer) {
-    //WriterData* data = (WriterData*)writer->data;
-    // TODO: Skip this free due to bad implementation of reader/writer in fake6502, fix!
-    //free(data->dataStart);
-    free(writer->data);
-    //data->dataStart = 0;
+    PDBinaryAllocator allocator;
+    WriterData* data = (WriterData*)writer->data;
+
+    if (!data)
+        return;
+
+    data->allocator.free(data->allocator.user_data, data->dataStart, data->maxSize);
+
+    if (data->stringPool)
+        data->allocator.free(data->allocator.user_data, data->stringPool, data->stringPoolCapacity);
+
+    if (data->entryOffsets) {
+        data->allocator.free(data->allocator.user_data, data->entryOffsets,
+                             data->entryOffsetCapacity * sizeof(uint32_t));
+    }
+
+    releaseRefs(data);
+
+    if (data->refs)
+        data->allocator.free(data->allocator.user_data, data->refs, data->refCapacity * sizeof(DataRef));
+
+    if (data->segments) {
+        data->allocator.free(data->allocator.user_data, data->segments,
+                             (data->refCapacity + 2) * sizeof(PDBinarySegment));
+    }
+
+    allocator = data->allocator;
+    allocator.free(allocator.user_data, data, sizeof(WriterData));
     writer->data = 0;
 }
-
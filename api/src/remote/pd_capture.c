@@ -0,0 +1,324 @@
+#include "pd_capture.h"
+#include "pd_lz4.h"
+#include "pd_readwrite_private.h"
+#include <pd_readwrite.h>
+#include <uv.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum {
+    RecordHeaderSize = 9,
+    CompressedFlag = 0x80,
+    CompressMinSize = 1024,     // smaller streams are stored as is
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct Buffer {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct PDCaptureWriter {
+    FILE* file;
+    uint64_t lastTime;          // uv_hrtime of the last record, 0 before the first one
+    Buffer data;                // the segments gathered together
+    Buffer compressed;
+    PDWriter* copyWriter;       // used by write_reader, created on demand
+} PDCaptureWriter;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct PDCaptureReader {
+    FILE* file;
+    uint64_t time;
+    Buffer data;
+    Buffer compressed;
+} PDCaptureReader;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int reserve(Buffer* buffer, size_t size) {
+    uint8_t* newData;
+
+    if (size <= buffer->capacity)
+        return 1;
+
+    if (!(newData = realloc(buffer->data, size))) {
+        printf("Unable to allocate %d bytes for capture buffer\n", (int)size);
+        return 0;
+    }
+
+    buffer->data = newData;
+    buffer->capacity = size;
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void put32(uint8_t* ptr, uint32_t v) {
+    ptr[0] = (v >> 24) & 0xff;
+    ptr[1] = (v >> 16) & 0xff;
+    ptr[2] = (v >> 8) & 0xff;
+    ptr[3] = (v >> 0) & 0xff;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t get32(const uint8_t* ptr) {
+    return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | ptr[3];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct PDCaptureWriter* pd_capture_writer_create(const char* filename) {
+    PDCaptureWriter* capture;
+    uint8_t header[8];
+    FILE* file;
+
+    if (!(file = fopen(filename, "wb"))) {
+        printf("Unable to create capture file %s\n", filename);
+        return 0;
+    }
+
+    memcpy(header, PD_CAPTURE_MAGIC, 4);
+    put32(header + 4, PDCapture_Version);
+
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        printf("Unable to write to capture file %s\n", filename);
+        fclose(file);
+        return 0;
+    }
+
+    capture = malloc(sizeof(PDCaptureWriter));
+    memset(capture, 0, sizeof(PDCaptureWriter));
+    capture->file = file;
+
+    return capture;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_capture_writer_destroy(struct PDCaptureWriter* capture) {
+    if (!capture)
+        return;
+
+    fclose(capture->file);
+
+    if (capture->copyWriter) {
+        pd_binary_writer_destroy(capture->copyWriter);
+        free(capture->copyWriter);
+    }
+
+    free(capture->data.data);
+    free(capture->compressed.data);
+    free(capture);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Writes what has been gathered in capture->data as a record
+
+static int writeRecord(PDCaptureWriter* capture, PDCaptureRecordType type) {
+    uint8_t header[RecordHeaderSize + 4];
+    const uint8_t* data = capture->data.data;
+    size_t size = capture->data.size;
+    size_t headerSize = RecordHeaderSize;
+    uint64_t time = uv_hrtime();
+    uint64_t delta = capture->lastTime ? (time - capture->lastTime) / 1000 : 0;
+    int compressedSize = 0;
+
+    capture->lastTime = time;
+
+    if (size >= CompressMinSize) {
+        int bound = pd_lz4_compress_bound((int)size);
+
+        if (reserve(&capture->compressed, (size_t)bound))
+            compressedSize = pd_lz4_compress(data, (int)size, capture->compressed.data, bound);
+    }
+
+    header[4] = (uint8_t)type;
+    put32(header, delta > 0xffffffff ? 0xffffffff : (uint32_t)delta);
+    put32(header + 5, (uint32_t)size);
+
+    // only keep the compressed data if it actually saves something
+
+    if (compressedSize > 0 && (size_t)compressedSize < size) {
+        header[4] |= CompressedFlag;
+        put32(header + 9, (uint32_t)compressedSize);
+        headerSize += 4;
+        data = capture->compressed.data;
+        size = (size_t)compressedSize;
+    }
+
+    if (fwrite(header, 1, headerSize, capture->file) != headerSize || fwrite(data, 1, size, capture->file) != size) {
+        printf("Unable to write to capture file\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pd_capture_writer_write_segments(struct PDCaptureWriter* capture, PDCaptureRecordType type,
+                                     const struct PDBinarySegment* segments, int count) {
+    size_t size = 0;
+    int i;
+
+    for (i = 0; i < count; ++i)
+        size += segments[i].size;
+
+    if (!reserve(&capture->data, size))
+        return 0;
+
+    capture->data.size = 0;
+
+    for (i = 0; i < count; ++i) {
+        memcpy(capture->data.data + capture->data.size, segments[i].data, segments[i].size);
+        capture->data.size += segments[i].size;
+    }
+
+    return writeRecord(capture, type);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pd_capture_writer_write_reader(struct PDCaptureWriter* capture, PDCaptureRecordType type, struct PDReader* reader) {
+    const PDBinarySegment* segments;
+    int count;
+
+    if (!capture->copyWriter)
+        capture->copyWriter = pd_binary_writer_create();
+
+    pd_binary_writer_reset(capture->copyWriter);
+    pd_binary_reader_copy_events(reader, capture->copyWriter);
+
+    // nothing to record if there were no events
+
+    if (pd_binary_writer_get_size(capture->copyWriter) == 0)
+        return 1;
+
+    pd_binary_writer_finalize(capture->copyWriter);
+
+    if (!(segments = pd_binary_writer_get_segments(capture->copyWriter, &count)))
+        return 0;
+
+    return pd_capture_writer_write_segments(capture, type, segments, count);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pd_capture_writer_write_action(struct PDCaptureWriter* capture, uint32_t action) {
+    if (!reserve(&capture->data, 4))
+        return 0;
+
+    put32(capture->data.data, action);
+    capture->data.size = 4;
+
+    return writeRecord(capture, PDCaptureRecord_Action);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct PDCaptureReader* pd_capture_reader_create(const char* filename) {
+    PDCaptureReader* capture;
+    uint8_t header[8];
+    FILE* file;
+
+    if (!(file = fopen(filename, "rb"))) {
+        printf("Unable to open capture file %s\n", filename);
+        return 0;
+    }
+
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, PD_CAPTURE_MAGIC, 4) != 0) {
+        printf("%s isn't a capture file\n", filename);
+        fclose(file);
+        return 0;
+    }
+
+    if (get32(header + 4) != PDCapture_Version) {
+        printf("Capture file %s has version %d but only version %d is supported\n", filename,
+               (int)get32(header + 4), PDCapture_Version);
+        fclose(file);
+        return 0;
+    }
+
+    capture = malloc(sizeof(PDCaptureReader));
+    memset(capture, 0, sizeof(PDCaptureReader));
+    capture->file = file;
+
+    return capture;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_capture_reader_destroy(struct PDCaptureReader* capture) {
+    if (!capture)
+        return;
+
+    fclose(capture->file);
+
+    free(capture->data.data);
+    free(capture->compressed.data);
+    free(capture);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pd_capture_reader_next(struct PDCaptureReader* capture, PDCaptureRecord* record) {
+    uint8_t header[RecordHeaderSize + 4];
+    uint32_t size;
+    uint32_t compressedSize;
+
+    if (fread(header, 1, RecordHeaderSize, capture->file) != RecordHeaderSize)
+        return 0;
+
+    size = get32(header + 5);
+
+    if (!reserve(&capture->data, size))
+        return 0;
+
+    if (header[4] & CompressedFlag) {
+        if (fread(header + RecordHeaderSize, 1, 4, capture->file) != 4)
+            return 0;
+
+        compressedSize = get32(header + RecordHeaderSize);
+
+        if (!reserve(&capture->compressed, compressedSize))
+            return 0;
+
+        if (fread(capture->compressed.data, 1, compressedSize, capture->file) != compressedSize)
+            return 0;
+
+        if (pd_lz4_decompress(capture->compressed.data, (int)compressedSize, capture->data.data, (int)size) != (int)size) {
+            printf("Broken record in capture file\n");
+            return 0;
+        }
+    } else {
+        if (fread(capture->data.data, 1, size, capture->file) != size)
+            return 0;
+    }
+
+    capture->time += get32(header);
+
+    record->time = capture->time;
+    record->type = (PDCaptureRecordType)(header[4] & ~CompressedFlag);
+    record->data = capture->data.data;
+    record->size = size;
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_capture_reader_rewind(struct PDCaptureReader* capture) {
+    fseek(capture->file, 8, SEEK_SET);
+    capture->time = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef PDCAPTURE_H_
+#define PDCAPTURE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Capture files store the streams sent between the debugger and a backend (in both directions) with the time they
+// were sent so a session can be played back later without the target (see the replay backend plugin.) The layout
+// of the file is (all values are big endian like the streams themselves):
+//
+// header: magic "PDCP" (4) version (4)
+// record: time since the previous record in microseconds (4) type (1) size (4) [compressed size (4)] data
+//
+// The top bit of the type is set if the data is compressed (see pd_lz4.h) in which case the compressed size follows
+// the uncompressed one. Streams are stored as they would be sent to another process (including the 4 byte size at
+// the start) so they can be given directly to pd_binary_reader_init_stream. Action records has the action as data.
+//
+// This is a private header. Not to to be used by plugins directly
+
+struct PDReader;
+struct PDCaptureWriter;
+struct PDCaptureReader;
+struct PDBinarySegment;
+
+#define PD_CAPTURE_MAGIC "PDCP"
+
+enum {
+    PDCapture_Version = 1,
+};
+
+typedef enum PDCaptureRecordType {
+    PDCaptureRecord_Request = 1,    // stream sent to the backend
+    PDCaptureRecord_Reply = 2,      // stream written by the backend
+    PDCaptureRecord_Action = 3,     // action sent to the backend (4 bytes)
+} PDCaptureRecordType;
+
+typedef struct PDCaptureRecord {
+    uint64_t time;                  // microseconds since the first record
+    PDCaptureRecordType type;
+    const uint8_t* data;            // valid until the next call to pd_capture_reader_next
+    unsigned int size;
+} PDCaptureRecord;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns 0 if the file can't be created
+struct PDCaptureWriter* pd_capture_writer_create(const char* filename);
+void pd_capture_writer_destroy(struct PDCaptureWriter* capture);
+
+// Records a stream given as the segments from pd_binary_writer_get_segments (or a single segment with a received
+// stream.) Returns 0 if writing to the file failed.
+int pd_capture_writer_write_segments(struct PDCaptureWriter* capture, PDCaptureRecordType type,
+                                     const struct PDBinarySegment* segments, int count);
+
+// Records the events of a reader. Slower than write_segments as the events are copied but also works for streams
+// that are only valid in this process (that has data references pointing to memory.) Nothing is recorded if the
+// reader doesn't have any events.
+int pd_capture_writer_write_reader(struct PDCaptureWriter* capture, PDCaptureRecordType type, struct PDReader* reader);
+
+int pd_capture_writer_write_action(struct PDCaptureWriter* capture, uint32_t action);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns 0 if the file can't be opened or isn't a capture file
+struct PDCaptureReader* pd_capture_reader_create(const char* filename);
+void pd_capture_reader_destroy(struct PDCaptureReader* capture);
+
+// Returns 1 and fills in the record if there is one, 0 at the end of the file (or if it's broken)
+int pd_capture_reader_next(struct PDCaptureReader* capture, PDCaptureRecord* record);
+
+// Starts over from the first record
+void pd_capture_reader_rewind(struct PDCaptureReader* capture);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
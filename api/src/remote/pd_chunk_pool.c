@@ -0,0 +1,134 @@
+#include "pd_chunk_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum {
+    MinChunkShift = 4,
+    MaxChunkShift = 31,
+    MaxCachedChunks = 4,  // max number of chunks kept around for each size
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct Chunk {
+    struct Chunk* next;
+} Chunk;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct PDChunkPool {
+    Chunk* freeLists[MaxChunkShift + 1];
+    int freeCount[MaxChunkShift + 1];
+} PDChunkPool;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int sizeToBucket(size_t size) {
+    int shift = MinChunkShift;
+
+    while (((size_t)1 << shift) < size && shift < MaxChunkShift)
+        shift++;
+
+    return shift;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void* poolAlloc(void* user_data, size_t size) {
+    PDChunkPool* pool = (PDChunkPool*)user_data;
+    int bucket = sizeToBucket(size);
+    Chunk* chunk = pool->freeLists[bucket];
+
+    if (((size_t)1 << bucket) < size)
+        return 0;
+
+    if (chunk) {
+        pool->freeLists[bucket] = chunk->next;
+        pool->freeCount[bucket]--;
+        return chunk;
+    }
+
+    return malloc((size_t)1 << bucket);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void poolFree(void* user_data, void* ptr, size_t size) {
+    PDChunkPool* pool = (PDChunkPool*)user_data;
+    int bucket = sizeToBucket(size);
+    Chunk* chunk = (Chunk*)ptr;
+
+    if (!ptr)
+        return;
+
+    if (pool->freeCount[bucket] >= MaxCachedChunks) {
+        free(ptr);
+        return;
+    }
+
+    chunk->next = pool->freeLists[bucket];
+    pool->freeLists[bucket] = chunk;
+    pool->freeCount[bucket]++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void* defaultAlloc(void* user_data, size_t size) {
+    (void)user_data;
+    return malloc(size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void defaultFree(void* user_data, void* ptr, size_t size) {
+    (void)user_data;
+    (void)size;
+    free(ptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct PDChunkPool* pd_chunk_pool_create() {
+    PDChunkPool* pool = malloc(sizeof(PDChunkPool));
+    memset(pool, 0, sizeof(PDChunkPool));
+    return pool;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_chunk_pool_destroy(struct PDChunkPool* pool) {
+    int i;
+
+    if (!pool)
+        return;
+
+    for (i = 0; i <= MaxChunkShift; ++i) {
+        Chunk* chunk = pool->freeLists[i];
+
+        while (chunk) {
+            Chunk* next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+    }
+
+    free(pool);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_chunk_pool_get_allocator(struct PDChunkPool* pool, PDBinaryAllocator* allocator) {
+    allocator->alloc = poolAlloc;
+    allocator->free = poolFree;
+    allocator->user_data = pool;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_chunk_pool_get_default_allocator(PDBinaryAllocator* allocator) {
+    allocator->alloc = defaultAlloc;
+    allocator->free = defaultFree;
+    allocator->user_data = 0;
+}
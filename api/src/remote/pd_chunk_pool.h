@@ -0,0 +1,38 @@
+#ifndef PDCHUNKPOOL_H_
+#define PDCHUNKPOOL_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Allocator used for the stream buffers of the binary writer. The size is passed to free as well so pooling
+// allocators can bucket the memory without storing any headers. This is a private header. Not to to be used by
+// plugins directly
+
+typedef struct PDBinaryAllocator {
+    void* (*alloc)(void* user_data, size_t size);
+    void (*free)(void* user_data, void* ptr, size_t size);
+    void* user_data;
+} PDBinaryAllocator;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pool that keeps released chunks around (bucketed by power of two size) so writers that are created and
+// destroyed, or grow, every frame doesn't need to go to malloc. Not thread safe, use one pool per thread.
+
+struct PDChunkPool;
+
+struct PDChunkPool* pd_chunk_pool_create();
+void pd_chunk_pool_destroy(struct PDChunkPool* pool);
+void pd_chunk_pool_get_allocator(struct PDChunkPool* pool, PDBinaryAllocator* allocator);
+
+// Allocator that just uses malloc/free
+void pd_chunk_pool_get_default_allocator(PDBinaryAllocator* allocator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
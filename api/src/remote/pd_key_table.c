@@ -0,0 +1,96 @@
+#include "pd_key_table.h"
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#define inline __inline
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FNV-1a, keys are short so this is plenty
+
+uint32_t pd_key_table_hash_name(const char* name) {
+    uint32_t hash = 2166136261u;
+
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint32_t findSlot(const PDKeyTable* table, const char* name) {
+    uint32_t slot = pd_key_table_hash_name(name) & (PDKeyTable_HashSize - 1);
+
+    for (;;) {
+        uint16_t entry = table->hash[slot];
+
+        if (entry == 0)
+            return slot;
+
+        if (!strcmp(table->names + table->nameOffsets[entry - 1], name))
+            return slot;
+
+        slot = (slot + 1) & (PDKeyTable_HashSize - 1);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_key_table_clear(PDKeyTable* table) {
+    if (table->count == 0)
+        return;
+
+    memset(table->hash, 0, sizeof(table->hash));
+    table->namesSize = 0;
+    table->count = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pd_key_table_find(const PDKeyTable* table, const char* name) {
+    uint16_t entry;
+
+    if (table->count == 0)
+        return -1;
+
+    entry = table->hash[findSlot(table, name)];
+
+    return (int)entry - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pd_key_table_intern(PDKeyTable* table, const char* name) {
+    uint32_t slot = findSlot(table, name);
+    size_t len;
+
+    if (table->hash[slot] != 0)
+        return table->hash[slot] - 1;
+
+    len = strlen(name) + 1;
+
+    if (table->count >= PDKeyTable_MaxKeys || table->namesSize + len > PDKeyTable_NameBufferSize)
+        return -1;
+
+    memcpy(table->names + table->namesSize, name, len);
+    table->nameOffsets[table->count] = (uint16_t)table->namesSize;
+    table->namesSize += (unsigned int)len;
+
+    table->hash[slot] = (uint16_t)++table->count;
+
+    return (int)table->count - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* pd_key_table_get_name(const PDKeyTable* table, uint16_t id) {
+    if (id >= table->count)
+        return "";
+
+    return table->names + table->nameOffsets[id];
+}
@@ -0,0 +1,49 @@
+#ifndef PDKEYTABLE_H_
+#define PDKEYTABLE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Maps key strings to 16-bit ids so the reader/writer can compare keys as integers instead of doing strcmp on
+// every field. This is a private header. Not to to be used by plugins directly
+
+enum {
+    PDKeyTable_MaxKeys = 1024,
+    PDKeyTable_HashSize = 2048,     // must be power of two and larger than MaxKeys
+    PDKeyTable_NameBufferSize = 16 * 1024,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct PDKeyTable {
+    uint16_t hash[PDKeyTable_HashSize];         // 0 = empty slot, otherwise key id + 1
+    uint16_t nameOffsets[PDKeyTable_MaxKeys];
+    char names[PDKeyTable_NameBufferSize];
+    unsigned int namesSize;
+    unsigned int count;
+} PDKeyTable;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_key_table_clear(PDKeyTable* table);
+
+// returns the id of the key or -1 if it isn't in the table
+int pd_key_table_find(const PDKeyTable* table, const char* name);
+
+// returns the id of the key (adding it if needed) or -1 if the table is full
+int pd_key_table_intern(PDKeyTable* table, const char* name);
+
+const char* pd_key_table_get_name(const PDKeyTable* table, uint16_t id);
+
+// hash function used for the names, exposed so other lookups on keys can use it as well
+uint32_t pd_key_table_hash_name(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,235 @@
+#include "pd_lz4.h"
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum {
+    HashLog = 12,
+    MinMatch = 4,
+    LastLiterals = 5,       // the last 5 bytes are always literals
+    MatchFindLimit = 12,    // the last match has to start at least 12 bytes before the end
+    MaxOffset = 65535,
+    SkipTrigger = 6,        // step faster over data that doesn't compress
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t hash(uint32_t v) {
+    return (v * 2654435761U) >> (32 - HashLog);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint8_t* writeLength(uint8_t* op, int length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+
+    *op++ = (uint8_t)length;
+
+    return op;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Writes a sequence of literals followed by a match (matchLength == 0 for the last sequence which only has literals)
+
+static uint8_t* writeSequence(uint8_t* op, uint8_t* oend, const uint8_t* literals, int literalLength, int offset, int matchLength) {
+    uint8_t* token;
+
+    // worst case size: token + literal length + literals + offset + match length
+
+    if ((oend - op) < 1 + (literalLength / 255 + 1) + literalLength + 2 + (matchLength / 255 + 1))
+        return 0;
+
+    token = op++;
+
+    if (literalLength >= 15) {
+        *token = 15 << 4;
+        op = writeLength(op, literalLength - 15);
+    } else {
+        *token = (uint8_t)(literalLength << 4);
+    }
+
+    memcpy(op, literals, (size_t)literalLength);
+    op += literalLength;
+
+    if (matchLength == 0)
+        return op;
+
+    *op++ = (uint8_t)(offset & 0xff);
+    *op++ = (uint8_t)(offset >> 8);
+
+    matchLength -= MinMatch;
+
+    if (matchLength >= 15) {
+        *token |= 15;
+        op = writeLength(op, matchLength - 15);
+    } else {
+        *token |= (uint8_t)matchLength;
+    }
+
+    return op;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pd_lz4_compress_bound(int srcSize) {
+    return srcSize + (srcSize / 255) + 16;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pd_lz4_compress(const uint8_t* src, int srcSize, uint8_t* dst, int dstCapacity) {
+    uint32_t table[1 << HashLog];
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* end = src + srcSize;
+    const uint8_t* matchFindLimit = end - MatchFindLimit;
+    const uint8_t* matchLimit = end - LastLiterals;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dstCapacity;
+    uint32_t searches = 1 << SkipTrigger;
+
+    if (srcSize < 0)
+        return 0;
+
+    memset(table, 0, sizeof(table));
+
+    if (srcSize > MatchFindLimit) {
+        while (ip < matchFindLimit) {
+            uint32_t v = read32(ip);
+            uint32_t h = hash(v);
+            const uint8_t* match = src + table[h];
+
+            table[h] = (uint32_t)(ip - src);
+
+            if (match < ip && (ip - match) <= MaxOffset && read32(match) == v) {
+                const uint8_t* mp = ip + MinMatch;
+                const uint8_t* cp = match + MinMatch;
+
+                // extend backwards over the literals
+
+                while (ip > anchor && match > src && ip[-1] == match[-1]) {
+                    --ip;
+                    --match;
+                }
+
+                while (mp < matchLimit && *mp == *cp) {
+                    ++mp;
+                    ++cp;
+                }
+
+                if (!(op = writeSequence(op, oend, anchor, (int)(ip - anchor), (int)(ip - match), (int)(mp - ip))))
+                    return 0;
+
+                ip = anchor = mp;
+                searches = 1 << SkipTrigger;
+
+                // the position two bytes back is likely to be the start of the next match as well
+
+                if (ip < matchFindLimit)
+                    table[hash(read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+
+                continue;
+            }
+
+            ip += searches++ >> SkipTrigger;
+        }
+    }
+
+    if (!(op = writeSequence(op, oend, anchor, (int)(end - anchor), 0, 0)))
+        return 0;
+
+    return (int)(op - dst);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pd_lz4_decompress(const uint8_t* src, int srcSize, uint8_t* dst, int dstCapacity) {
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + srcSize;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dstCapacity;
+
+    while (ip < iend) {
+        unsigned int token = *ip++;
+        size_t length = token >> 4;
+        size_t offset;
+        const uint8_t* match;
+
+        if (length == 15) {
+            unsigned int b;
+
+            do {
+                if (ip >= iend)
+                    return -1;
+
+                b = *ip++;
+                length += b;
+            } while (b == 255);
+        }
+
+        if (length > (size_t)(iend - ip) || length > (size_t)(oend - op))
+            return -1;
+
+        memcpy(op, ip, length);
+        op += length;
+        ip += length;
+
+        // last sequence only has literals
+
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return -1;
+
+        offset = (size_t)(ip[0] | (ip[1] << 8));
+        ip += 2;
+
+        if (offset == 0 || offset > (size_t)(op - dst))
+            return -1;
+
+        length = token & 15;
+
+        if (length == 15) {
+            unsigned int b;
+
+            do {
+                if (ip >= iend)
+                    return -1;
+
+                b = *ip++;
+                length += b;
+            } while (b == 255);
+        }
+
+        length += MinMatch;
+
+        if (length > (size_t)(oend - op))
+            return -1;
+
+        match = op - offset;
+
+        // matches can overlap with the output (repeating patterns) so only use memcpy if they don't
+
+        if (offset >= length) {
+            memcpy(op, match, length);
+            op += length;
+        } else {
+            while (length--)
+                *op++ = *match++;
+        }
+    }
+
+    return (int)(op - dst);
+}
@@ -0,0 +1,29 @@
+#ifndef PDLZ4_H_
+#define PDLZ4_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Fast block compression using the LZ4 block format (so the data can be decompressed with any LZ4 implementation
+// using LZ4_decompress_safe.) The compressor is a simple greedy single hash version which trades some ratio for
+// speed as it's used for data sent between the target and the debugger. This is a private header. Not to to be
+// used by plugins directly
+
+// Max size of the compressed data for srcSize bytes
+int pd_lz4_compress_bound(int srcSize);
+
+// Returns the compressed size or 0 if it doesn't fit in dstCapacity
+int pd_lz4_compress(const uint8_t* src, int srcSize, uint8_t* dst, int dstCapacity);
+
+// Returns the decompressed size or -1 if the data is broken or doesn't fit in dstCapacity
+int pd_lz4_decompress(const uint8_t* src, int srcSize, uint8_t* dst, int dstCapacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
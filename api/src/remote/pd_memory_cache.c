@@ -0,0 +1,541 @@
+#include "pd_memory_cache.h"
+#include "pd_readwrite_private.h"
+#include <pd_readwrite.h>
+#include <pd_backend.h>
+#include <pd_host.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum {
+    PageSize = PDMemoryCache_PageSize,
+    MaxPages = 2048,                // 8 MB, the least recently used page is reused after that
+    BucketCount = 4096,             // must be power of two
+    MaxGapPages = 4,                // missing pages closer than this are fetched with one request
+    RetryFrames = 60,               // updates to wait for memory before requesting it again
+};
+
+// Requests from the cache has 01 in the top bits (the request coalescer uses the top bit) and the generation of the
+// cache when the request was sent in the rest so memory that was requested before the target ran is still out of date
+
+static const uint32_t CacheIdFlag = 0x40000000u;
+static const uint32_t CacheIdMask = 0xc0000000u;
+static const uint32_t GenerationMask = 0x3fffffffu;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct Page {
+    uint64_t address;
+    uint32_t addressSpace;
+    uint32_t generation;            // of the cache when the data was requested
+    uint32_t requestFrame;          // when the page was requested (0 if not waiting for it)
+    uint32_t lastUsed;
+    int32_t next;                   // next page in the bucket
+    uint8_t hasData;
+    uint8_t stale;                  // a part of the memory has changed (see invalidateRange)
+    uint8_t data[PageSize];
+} Page;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct Miss {
+    uint64_t address;
+    uint32_t addressSpace;
+} Miss;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct PDMemoryCache {
+    Page* pages;
+    uint32_t pageCount;
+    int32_t buckets[BucketCount];
+    Miss* misses;
+    uint32_t missCount;
+    uint32_t generation;
+    uint32_t changeCount;
+    uint32_t frame;
+    uint32_t epoch;
+    int hasEpoch;
+    uint64_t exceptionLocation;
+    PDMemoryCacheStats stats;
+} PDMemoryCache;
+
+static PDMemoryCache* s_current = 0;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t hashPage(uint32_t addressSpace, uint64_t address) {
+    uint64_t page = address / PageSize;
+    uint32_t hash = (uint32_t)(page ^ (page >> 32)) * 2654435761u;
+
+    return (hash ^ (addressSpace * 0x9e3779b9u)) & (BucketCount - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static Page* findPage(PDMemoryCache* cache, uint32_t addressSpace, uint64_t address) {
+    int32_t index = cache->buckets[hashPage(addressSpace, address)];
+
+    while (index >= 0) {
+        Page* page = &cache->pages[index];
+
+        if (page->address == address && page->addressSpace == addressSpace)
+            return page;
+
+        index = page->next;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void unlinkPage(PDMemoryCache* cache, int32_t index) {
+    Page* page = &cache->pages[index];
+    int32_t* link = &cache->buckets[hashPage(page->addressSpace, page->address)];
+
+    while (*link != index)
+        link = &cache->pages[*link].next;
+
+    *link = page->next;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static Page* allocPage(PDMemoryCache* cache, uint32_t addressSpace, uint64_t address) {
+    uint32_t bucket = hashPage(addressSpace, address);
+    int32_t index;
+    Page* page;
+
+    if (cache->pageCount < MaxPages) {
+        index = (int32_t)cache->pageCount++;
+    } else {
+        uint32_t i, oldest = 0;
+
+        for (i = 1; i < MaxPages; ++i) {
+            if (cache->pages[i].lastUsed < cache->pages[oldest].lastUsed)
+                oldest = i;
+        }
+
+        index = (int32_t)oldest;
+        unlinkPage(cache, index);
+    }
+
+    page = &cache->pages[index];
+    page->address = address;
+    page->addressSpace = addressSpace;
+    page->generation = 0;
+    page->requestFrame = 0;
+    page->lastUsed = cache->frame;
+    page->hasData = 0;
+    page->stale = 0;
+    page->next = cache->buckets[bucket];
+
+    cache->buckets[bucket] = index;
+
+    return page;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int isUpToDate(PDMemoryCache* cache, Page* page) {
+    return page->hasData && !page->stale && page->generation == cache->generation;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void requestPage(PDMemoryCache* cache, Page* page) {
+    Miss* miss;
+
+    if (page->requestFrame && cache->frame - page->requestFrame < RetryFrames)
+        return;
+
+    if (cache->missCount == MaxPages)
+        return;
+
+    page->requestFrame = cache->frame;
+
+    miss = &cache->misses[cache->missCount++];
+    miss->address = page->address;
+    miss->addressSpace = page->addressSpace;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct PDMemoryCache* pd_memory_cache_create() {
+    PDMemoryCache* cache = (PDMemoryCache*)malloc(sizeof(PDMemoryCache));
+
+    memset(cache, 0, sizeof(PDMemoryCache));
+    memset(cache->buckets, 0xff, sizeof(cache->buckets));
+
+    cache->pages = (Page*)malloc(MaxPages * sizeof(Page));
+    cache->misses = (Miss*)malloc(MaxPages * sizeof(Miss));
+    cache->generation = 1;
+    cache->frame = 1;
+
+    return cache;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_memory_cache_destroy(struct PDMemoryCache* cache) {
+    if (s_current == cache)
+        s_current = 0;
+
+    free(cache->pages);
+    free(cache->misses);
+    free(cache);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_memory_cache_clear(struct PDMemoryCache* cache) {
+    memset(cache->buckets, 0xff, sizeof(cache->buckets));
+
+    cache->pageCount = 0;
+    cache->missCount = 0;
+    cache->hasEpoch = 0;
+    cache->exceptionLocation = 0;
+    cache->generation = (cache->generation + 1) & GenerationMask;
+    cache->changeCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pd_memory_cache_read(struct PDMemoryCache* cache, uint32_t addressSpace, uint64_t address, void* dest, uint64_t size) {
+    uint64_t end = address + size;
+    uint64_t pageAddress = address & ~(uint64_t)(PageSize - 1);
+    int upToDate = 1;
+
+    for (; pageAddress < end; pageAddress += PageSize) {
+        Page* page = findPage(cache, addressSpace, pageAddress);
+
+        if (!page)
+            page = allocPage(cache, addressSpace, pageAddress);
+
+        page->lastUsed = cache->frame;
+
+        if (page->hasData) {
+            uint64_t start = address > pageAddress ? address : pageAddress;
+            uint64_t stop = end < pageAddress + PageSize ? end : pageAddress + PageSize;
+
+            memcpy((uint8_t*)dest + (start - address), page->data + (start - pageAddress), (size_t)(stop - start));
+        }
+
+        if (isUpToDate(cache, page))
+            continue;
+
+        upToDate = 0;
+        requestPage(cache, page);
+    }
+
+    return upToDate;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t pd_memory_cache_get_change_count(struct PDMemoryCache* cache) {
+    return cache->changeCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int compareMiss(const void* a, const void* b) {
+    const Miss* ma = (const Miss*)a;
+    const Miss* mb = (const Miss*)b;
+
+    if (ma->addressSpace != mb->addressSpace)
+        return ma->addressSpace < mb->addressSpace ? -1 : 1;
+
+    if (ma->address != mb->address)
+        return ma->address < mb->address ? -1 : 1;
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void writeRequest(PDMemoryCache* cache, PDWriter* writer, uint32_t addressSpace, uint64_t address, uint64_t size) {
+    PDWrite_event_begin(writer, PDEventType_GetMemory);
+    PDWrite_u32(writer, PD_REQUEST_ID, CacheIdFlag | (cache->generation & GenerationMask));
+
+    if (addressSpace)
+        PDWrite_u32(writer, PD_ADDRESS_SPACE, addressSpace);
+
+    PDWrite_u64(writer, "address_start", address);
+    PDWrite_u64(writer, "size", size);
+    PDWrite_event_end(writer);
+
+    cache->stats.requests++;
+    cache->stats.requestedBytes += size;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_memory_cache_write_requests(struct PDMemoryCache* cache, struct PDWriter* writer) {
+    uint64_t start, end;
+    uint32_t i, addressSpace;
+
+    if (cache->missCount == 0)
+        return;
+
+    qsort(cache->misses, cache->missCount, sizeof(Miss), compareMiss);
+
+    addressSpace = cache->misses[0].addressSpace;
+    start = cache->misses[0].address;
+    end = start + PageSize;
+
+    for (i = 1; i < cache->missCount; ++i) {
+        const Miss* miss = &cache->misses[i];
+
+        if (miss->addressSpace == addressSpace && miss->address <= end + MaxGapPages * PageSize) {
+            if (miss->address + PageSize > end)
+                end = miss->address + PageSize;
+
+            continue;
+        }
+
+        writeRequest(cache, writer, addressSpace, start, end - start);
+
+        addressSpace = miss->addressSpace;
+        start = miss->address;
+        end = start + PageSize;
+    }
+
+    writeRequest(cache, writer, addressSpace, start, end - start);
+
+    cache->missCount = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void storeMemory(PDMemoryCache* cache, PDReader* reader) {
+    uint8_t* data;
+    uint64_t address = 0;
+    uint64_t size = 0;
+    uint64_t end, pageAddress;
+    uint32_t addressSpace = 0;
+    uint32_t requestId = 0;
+    uint32_t generation = cache->generation;
+
+    if (PDRead_find_data(reader, (void**)&data, &size, "data", 0) == PDReadStatus_NotFound)
+        return;
+
+    PDRead_find_u64(reader, &address, "address", 0);
+    PDRead_find_u32(reader, &addressSpace, PD_ADDRESS_SPACE, 0);
+
+    // memory the cache asked for is as old as the request, other memory (that views asked for themselves) is seen as
+    // up to date
+
+    if (PDRead_find_u32(reader, &requestId, PD_REQUEST_ID, 0) != PDReadStatus_NotFound) {
+        if ((requestId & CacheIdMask) == CacheIdFlag)
+            generation = requestId & GenerationMask;
+    }
+
+    end = address + size;
+    pageAddress = address & ~(uint64_t)(PageSize - 1);
+
+    for (; pageAddress < end; pageAddress += PageSize) {
+        int full = address <= pageAddress && end >= pageAddress + PageSize;
+        uint64_t start = address > pageAddress ? address : pageAddress;
+        uint64_t stop = end < pageAddress + PageSize ? end : pageAddress + PageSize;
+        Page* page = findPage(cache, addressSpace, pageAddress);
+
+        // parts of pages are only used to update pages that are already there
+
+        if (!page) {
+            if (!full)
+                continue;
+
+            page = allocPage(cache, addressSpace, pageAddress);
+        }
+
+        if (!full && !page->hasData)
+            continue;
+
+        memcpy(page->data + (start - pageAddress), data + (start - address), (size_t)(stop - start));
+
+        if (full) {
+            page->hasData = 1;
+            page->stale = 0;
+            page->generation = generation;
+            page->requestFrame = 0;
+        }
+    }
+
+    cache->stats.receivedBytes += size;
+    cache->changeCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void invalidateAll(PDMemoryCache* cache) {
+    uint32_t i;
+
+    cache->generation = (cache->generation + 1) & GenerationMask;
+
+    // requests in flight are from the old generation so they can be sent again
+
+    for (i = 0; i < cache->pageCount; ++i)
+        cache->pages[i].requestFrame = 0;
+
+    cache->changeCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void invalidateRange(PDMemoryCache* cache, uint64_t address, uint64_t size, uint32_t addressSpace, int anySpace) {
+    uint32_t i;
+
+    for (i = 0; i < cache->pageCount; ++i) {
+        Page* page = &cache->pages[i];
+
+        if (!anySpace && page->addressSpace != addressSpace)
+            continue;
+
+        if (page->address < address + size && page->address + PageSize > address) {
+            page->stale = 1;
+            page->requestFrame = 0;
+        }
+    }
+
+    cache->changeCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The session gives the last StateChanged event to the views each frame so only new epochs are used
+
+static void updateState(PDMemoryCache* cache, PDReader* reader) {
+    PDReaderIterator it;
+    uint32_t epoch = 0;
+    uint32_t changed = PDStateChange_All;
+    int firstEpoch = !cache->hasEpoch;
+
+    PDRead_find_u32(reader, &epoch, PD_STATE_EPOCH, 0);
+    PDRead_find_u32(reader, &changed, PD_STATE_CHANGED, 0);
+
+    if (cache->hasEpoch && cache->epoch == epoch)
+        return;
+
+    cache->hasEpoch = 1;
+    cache->epoch = epoch;
+
+    if (firstEpoch) {
+        invalidateAll(cache);
+        return;
+    }
+
+    if (!(changed & PDStateChange_Memory))
+        return;
+
+    if (PDRead_find_array(reader, &it, PD_STATE_MEMORY, 0) == PDReadStatus_NotFound) {
+        invalidateAll(cache);
+        return;
+    }
+
+    while (PDRead_get_next_entry(reader, &it)) {
+        uint64_t address = 0;
+        uint64_t size = 0;
+        uint32_t addressSpace = 0;
+        int anySpace;
+
+        PDRead_find_u64(reader, &address, "address_start", it);
+        PDRead_find_u64(reader, &size, "size", it);
+        anySpace = PDRead_find_u32(reader, &addressSpace, PD_ADDRESS_SPACE, it) == PDReadStatus_NotFound;
+
+        invalidateRange(cache, address, size, addressSpace, anySpace);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_memory_cache_update(struct PDMemoryCache* cache, struct PDReader* reader) {
+    uint32_t event;
+
+    cache->frame++;
+
+    pd_binary_reader_reset(reader);
+
+    while ((event = PDRead_get_event(reader))) {
+        switch (event) {
+            case PDEventType_SetMemory:
+            {
+                storeMemory(cache, reader);
+                break;
+            }
+
+            case PDEventType_StateChanged:
+            {
+                updateState(cache, reader);
+                break;
+            }
+
+            case PDEventType_SetExceptionLocation:
+            {
+                uint64_t location = 0;
+
+                // backends that doesn't send StateChanged has been running if they stop at a new location
+
+                if (cache->hasEpoch)
+                    break;
+
+                PDRead_find_u64(reader, &location, "address", 0);
+
+                if (location != cache->exceptionLocation) {
+                    cache->exceptionLocation = location;
+                    invalidateAll(cache);
+                }
+
+                break;
+            }
+        }
+    }
+
+    pd_binary_reader_reset(reader);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_memory_cache_get_stats(struct PDMemoryCache* cache, PDMemoryCacheStats* stats) {
+    *stats = cache->stats;
+    stats->pageCount = cache->pageCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int serviceRead(uint32_t addressSpace, uint64_t address, void* dest, uint64_t size) {
+    if (!s_current)
+        return 0;
+
+    return pd_memory_cache_read(s_current, addressSpace, address, dest, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t serviceGetChangeCount(void) {
+    if (!s_current)
+        return 0;
+
+    return s_current->changeCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDMemoryCacheFuncs s_funcs = {
+    serviceRead,
+    serviceGetChangeCount,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_memory_cache_set_current(struct PDMemoryCache* cache) {
+    s_current = cache;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct PDMemoryCacheFuncs* pd_memory_cache_get_funcs() {
+    return &s_funcs;
+}
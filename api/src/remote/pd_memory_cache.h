@@ -0,0 +1,65 @@
+#ifndef PDMEMORYCACHE_H_
+#define PDMEMORYCACHE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Session side of the memory cache (see PDMemoryCacheFuncs in pd_host.h.) Memory is kept in 4k pages keyed by address
+// space and address. Each session owns one cache and the flow for each update is:
+//
+// pd_memory_cache_write_requests: writes GetMemory events for the pages the views missed since the last call.
+//                                 Misses next to each other are merged so usually only one event is written.
+//
+// pd_memory_cache_update:         takes the replies from the backend. All SetMemory events fills the cache (not only
+//                                 the ones it asked for) and StateChanged events (PDStateChange_Memory) makes pages
+//                                 out of date. For backends that doesn't send StateChanged all memory is out of date
+//                                 when the exception location changes.
+//
+// pd_memory_cache_set_current:    the cache the service functions work on (the session of the views being updated)
+//
+// This is a private header. Not to to be used by plugins directly
+
+struct PDReader;
+struct PDWriter;
+struct PDMemoryCache;
+struct PDMemoryCacheFuncs;
+
+typedef struct PDMemoryCacheStats {
+    uint32_t pageCount;         // pages in the cache
+    uint32_t requests;          // GetMemory events written
+    uint64_t requestedBytes;
+    uint64_t receivedBytes;     // bytes from SetMemory events that went into the cache
+} PDMemoryCacheStats;
+
+enum {
+    PDMemoryCache_PageSize = 4096,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct PDMemoryCache* pd_memory_cache_create();
+void pd_memory_cache_destroy(struct PDMemoryCache* cache);
+
+int pd_memory_cache_read(struct PDMemoryCache* cache, uint32_t addressSpace, uint64_t address, void* dest, uint64_t size);
+uint32_t pd_memory_cache_get_change_count(struct PDMemoryCache* cache);
+
+void pd_memory_cache_write_requests(struct PDMemoryCache* cache, struct PDWriter* writer);
+void pd_memory_cache_update(struct PDMemoryCache* cache, struct PDReader* reader);
+
+// Forget all memory (used when the session gets a new backend)
+void pd_memory_cache_clear(struct PDMemoryCache* cache);
+
+void pd_memory_cache_get_stats(struct PDMemoryCache* cache, PDMemoryCacheStats* stats);
+
+void pd_memory_cache_set_current(struct PDMemoryCache* cache);
+struct PDMemoryCacheFuncs* pd_memory_cache_get_funcs();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,17 @@
+#include "pd_profiler.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const struct PDProfilerFuncs* g_pdProfiler = 0;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_profiler_set_funcs(const struct PDProfilerFuncs* funcs) {
+    g_pdProfiler = funcs;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const struct PDProfilerFuncs* pd_profiler_get_funcs(void) {
+    return g_pdProfiler;
+}
@@ -0,0 +1,43 @@
+#ifndef PDPROFILER_H_
+#define PDPROFILER_H_
+
+#include <pd_host.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Samples for the hot paths of the remote api (reading/writing streams and sending them.) The host sets the profiler
+// functions (see PDProfilerFuncs in pd_host.h) when profiling is enabled. Until then a sample only costs a test of a
+// pointer. The functions must be set before any samples are made as begin and end needs to match.
+//
+// This is a private header. Not to be used by plugins directly
+
+extern const struct PDProfilerFuncs* g_pdProfiler;
+
+// 0 disables the samples
+void pd_profiler_set_funcs(const struct PDProfilerFuncs* funcs);
+
+// Returns the functions or 0 if profiling isn't enabled (used for the service of the host)
+const struct PDProfilerFuncs* pd_profiler_get_funcs(void);
+
+#define PD_PROFILE_BEGIN(name) \
+    do { \
+        static uint32_t s_profileHash = 0; \
+        if (g_pdProfiler) \
+            g_pdProfiler->begin_sample(name, &s_profileHash); \
+    } while (0)
+
+#define PD_PROFILE_END() \
+    do { \
+        if (g_pdProfiler) \
+            g_pdProfiler->end_sample(); \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
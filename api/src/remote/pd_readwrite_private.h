@@ -7,22 +7,111 @@ extern "C" {
 
 struct PDReader;
 struct PDWriter;
+struct PDBinaryAllocator;
 
 // This is a private header. Not to to be used by plugins directly
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Stream types that are internal to the binary format and never returned to plugins
+
+enum {
+    // Payloads for data references appended after the stream when sent to another process
+    PDReadType_DataRefPayloads = 0x7c,
+    // Data that isn't stored in the stream, see PDWriter::write_data_ref
+    PDReadType_DataRef = 0x7d,
+    // Array with a fixed set of columns (see PDWriter::write_header_array_begin), stored inside a regular array
+    PDReadType_HeaderArray = 0x7e,
+    // Table of interned key names, written once at the end of the stream
+    PDReadType_KeyTable = 0x7f,
+    // Set in the type byte when the key is stored as 16-bit id instead of a string
+    PDReadType_KeyIdFlag = 0x80,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Layout of a header array:
+//
+// type (1) size (4) row count (4) row size (2) column count (1) string pool offset (4)
+// column count * [type (1) name (null terminated)]
+// row count * row size bytes of values (in column order, strings are stored as 32-bit offset into the pool)
+// string pool
+
+enum {
+    PDHeaderArray_HeaderSize = 16,
+    PDHeaderArray_MaxColumns = 255,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Value of a data reference: pointer (8 bytes, native) size (4) offset (4). If offset is 0 the data is at pointer
+// (same process) otherwise the data is at offset from the start of the stream in the payload block.
+
+enum {
+    PDDataRef_Size = 16,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The values of typed arrays (PDWriter::write_u16_array etc) are always stored little endian
+
+static inline int pd_is_little_endian(void) {
+    const unsigned short v = 1;
+    return *(const unsigned char*)&v == 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct PDBinarySegment {
+    const void* data;
+    unsigned int size;
+} PDBinarySegment;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct PDReader* pd_binary_reader_create();
 void pd_binary_reader_init(struct PDReader* reader);
 void pd_binary_reader_init_stream(struct PDReader* reader, unsigned char* data, unsigned int size);
+// Finalizes the writer and reads its stream. Data references that points to memory in this process (see
+// PDWriter::write_data_ref) are only allowed for streams given this way, init_stream is for received data.
+void pd_binary_reader_init_from_writer(struct PDReader* reader, struct PDWriter* writer);
 void pd_binary_reader_reset(struct PDReader* reader);
 void pd_binary_reader_destroy(struct PDReader* reader);
 
+// When enabled init_stream walks the whole stream once and builds an index of all the fields in events and array
+// entries so the find functions doesn't need to search. Useful when the same stream is read several times.
+void pd_binary_reader_set_use_index(struct PDReader* reader, int enable);
+
+// Makes the reader read the same stream as the source reader (sharing its field index and keys) but with its own
+// position and event filter (see PDRead_set_event_filter) so several views can read one stream. Must be called again
+// each time the source gets a new stream.
+void pd_binary_reader_init_view(struct PDReader* reader, struct PDReader* source);
+
+// Writes all events in the stream of the reader to the writer (using the regular write functions so any writer
+// works.) Data references are resolved and copied as regular data so the result doesn't point to any memory outside
+// the stream. Doesn't change the position of the reader.
+void pd_binary_reader_copy_events(struct PDReader* reader, struct PDWriter* writer);
+
+// Writes the fields of the event last returned by PDRead_get_event (but not the event itself so the caller can change
+// the type or add fields.) The field named skipKey is left out if it isn't 0.
+void pd_binary_reader_copy_event(struct PDReader* reader, struct PDWriter* writer, const char* skipKey);
+
+struct PDWriter* pd_binary_writer_create();
 void pd_binary_writer_init(struct PDWriter* writer);
+// The allocator is used for the stream buffer which starts small and grows on demand (see pd_chunk_pool.h)
+void pd_binary_writer_init_with_allocator(struct PDWriter* writer, const struct PDBinaryAllocator* allocator);
 void pd_binary_writer_destroy(struct PDWriter* writer);
 void pd_binary_writer_finalize(struct PDWriter* writer);
 void pd_binary_writer_reset(struct PDWriter* writer);
 
+// When enabled keys are stored as 16-bit ids and the key table is written once at finalize so the
+// stream must be finalized before it's handed to a reader
+void pd_binary_writer_set_intern_keys(struct PDWriter* writer, int enable);
+
 unsigned int pd_binary_writer_get_size(struct PDWriter* writer);
 unsigned char* pd_binary_writer_get_data(struct PDWriter* writer);
 
+// Returns the list of memory segments to send (in order) to get the stream to another process. If there are no data
+// references this is just the stream, otherwise the payloads of the references are appended after the stream and the
+// stream is patched to point to them. Must be called after finalize. Returns 0 if the stream gets too large.
+const PDBinarySegment* pd_binary_writer_get_segments(struct PDWriter* writer, int* count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,527 @@
+#include "pd_request_coalescer.h"
+#include "pd_readwrite_private.h"
+#include <pd_readwrite.h>
+#include <pd_backend.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum {
+    MaxAge = 256,                   // updates to wait for a reply before forgetting about a merged request
+};
+
+static const uint32_t MergedIdFlag = 0x80000000u;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Get* event that has been sent this frame (the signature is the event without the request id)
+
+typedef struct Request {
+    uint32_t hash;
+    uint32_t offset;                // of the signature in the signatures buffer
+    uint32_t size;
+    uint32_t id;
+    int hasId;
+} Request;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Requester that should get a copy of the reply with replyId. For memory the part of the reply given by address/size.
+
+typedef struct FanOut {
+    uint32_t replyId;
+    uint32_t id;
+    int hasId;
+    int isMemory;
+    uint32_t addressSpace;
+    uint64_t address;
+    uint64_t size;
+    uint32_t frame;
+} FanOut;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct MemoryRequest {
+    uint32_t addressSpace;
+    uint64_t address;
+    uint64_t size;
+    uint32_t id;
+    int hasId;
+} MemoryRequest;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct Array {
+    void* data;
+    uint32_t count;
+    uint32_t capacity;
+} Array;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct PDRequestCoalescer {
+    PDWriter* signatureWriter;
+    Array signatures;               // uint8_t
+    Array requests;                 // Request
+    Array memory;                   // MemoryRequest
+    Array fanOuts;                  // FanOut
+    uint32_t frame;
+    uint32_t mergedId;
+    PDRequestCoalescerStats stats;
+} PDRequestCoalescer;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void* reserve(Array* array, uint32_t count, size_t elementSize) {
+    if (array->count + count > array->capacity) {
+        uint32_t capacity = array->capacity ? array->capacity * 2 : 64;
+        void* data;
+
+        while (capacity < array->count + count)
+            capacity *= 2;
+
+        if (!(data = realloc(array->data, capacity * elementSize))) {
+            printf("Unable to allocate %d bytes for request coalescer\n", (int)(capacity * elementSize));
+            return 0;
+        }
+
+        array->data = data;
+        array->capacity = capacity;
+    }
+
+    return (uint8_t*)array->data + array->count * elementSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int isGetEvent(uint32_t event) {
+    switch (event) {
+        case PDEventType_GetLocals:
+        case PDEventType_GetCallstack:
+        case PDEventType_GetWatch:
+        case PDEventType_GetRegisters:
+        case PDEventType_GetMemory:
+        case PDEventType_GetTty:
+        case PDEventType_GetExceptionLocation:
+        case PDEventType_GetDisassembly:
+        case PDEventType_GetStatus:
+        case PDEventType_GetThreads:
+        case PDEventType_GetSourceFiles:
+        case PDEventType_GetConsole:
+            return 1;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int findRequestId(PDReader* reader, uint32_t* id) {
+    uint32_t status = PDRead_find_u32(reader, id, PD_REQUEST_ID, 0) & ~PDReadStatus_TypeMask;
+    return status == PDReadStatus_Ok || status == PDReadStatus_Converted;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t hashData(const uint8_t* data, uint32_t size) {
+    uint32_t hash = 2166136261u;
+    uint32_t i;
+
+    for (i = 0; i < size; ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+
+    return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int compareMemoryRequest(const void* a, const void* b) {
+    const MemoryRequest* ma = (const MemoryRequest*)a;
+    const MemoryRequest* mb = (const MemoryRequest*)b;
+
+    if (ma->addressSpace != mb->addressSpace)
+        return ma->addressSpace < mb->addressSpace ? -1 : 1;
+
+    if (ma->address != mb->address)
+        return ma->address < mb->address ? -1 : 1;
+
+    return ma->size < mb->size ? -1 : ma->size > mb->size;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct PDRequestCoalescer* pd_request_coalescer_create() {
+    PDRequestCoalescer* coalescer = malloc(sizeof(PDRequestCoalescer));
+    memset(coalescer, 0, sizeof(PDRequestCoalescer));
+
+    // keys are written as strings so the same event always gives the same signature
+
+    coalescer->signatureWriter = pd_binary_writer_create();
+
+    return coalescer;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_request_coalescer_destroy(struct PDRequestCoalescer* coalescer) {
+    if (!coalescer)
+        return;
+
+    pd_binary_writer_destroy(coalescer->signatureWriter);
+    free(coalescer->signatureWriter);
+
+    free(coalescer->signatures.data);
+    free(coalescer->requests.data);
+    free(coalescer->memory.data);
+    free(coalescer->fanOuts.data);
+    free(coalescer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void addFanOut(PDRequestCoalescer* coalescer, uint32_t replyId, const MemoryRequest* request, int isMemory) {
+    FanOut* fanOut = reserve(&coalescer->fanOuts, 1, sizeof(FanOut));
+
+    if (!fanOut)
+        return;
+
+    fanOut->replyId = replyId;
+    fanOut->id = request->id;
+    fanOut->hasId = request->hasId;
+    fanOut->isMemory = isMemory;
+    fanOut->addressSpace = request->addressSpace;
+    fanOut->address = request->address;
+    fanOut->size = request->size;
+    fanOut->frame = coalescer->frame;
+
+    coalescer->fanOuts.count++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns 1 if the event was the same as one that has already been sent this frame
+
+static int isDuplicate(PDRequestCoalescer* coalescer, PDReader* reader, uint32_t event, uint32_t id, int hasId) {
+    PDWriter* writer = coalescer->signatureWriter;
+    Request* requests = (Request*)coalescer->requests.data;
+    const uint8_t* signature;
+    Request* request;
+    uint8_t* data;
+    uint32_t size, hash, i;
+
+    pd_binary_writer_reset(writer);
+    PDWrite_event_begin(writer, (uint16_t)event);
+    pd_binary_reader_copy_event(reader, writer, PD_REQUEST_ID);
+    PDWrite_event_end(writer);
+
+    signature = (const uint8_t*)pd_binary_writer_get_data(writer) + 4;
+    size = pd_binary_writer_get_size(writer);
+    hash = hashData(signature, size);
+
+    for (i = 0; i < coalescer->requests.count; ++i) {
+        const uint8_t* other = (const uint8_t*)coalescer->signatures.data + requests[i].offset;
+
+        if (requests[i].hash != hash || requests[i].size != size || memcmp(other, signature, size) != 0)
+            continue;
+
+        // if the request that was sent doesn't have an id the reply is seen by everyone
+
+        if (requests[i].hasId) {
+            MemoryRequest requester;
+            memset(&requester, 0, sizeof(requester));
+            requester.id = id;
+            requester.hasId = hasId;
+            addFanOut(coalescer, requests[i].id, &requester, 0);
+        }
+
+        return 1;
+    }
+
+    if (!(data = reserve(&coalescer->signatures, size, 1)) || !(request = reserve(&coalescer->requests, 1, sizeof(Request))))
+        return 0;
+
+    memcpy(data, signature, size);
+
+    request->hash = hash;
+    request->offset = coalescer->signatures.count;
+    request->size = size;
+    request->id = id;
+    request->hasId = hasId;
+
+    coalescer->signatures.count += size;
+    coalescer->requests.count++;
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void writeMemoryRequest(PDWriter* writer, const MemoryRequest* request) {
+    PDWrite_event_begin(writer, PDEventType_GetMemory);
+
+    if (request->hasId)
+        PDWrite_u32(writer, PD_REQUEST_ID, request->id);
+
+    if (request->addressSpace)
+        PDWrite_u32(writer, PD_ADDRESS_SPACE, request->addressSpace);
+
+    PDWrite_u64(writer, "address_start", request->address);
+    PDWrite_u64(writer, "size", request->size);
+    PDWrite_event_end(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sorts the memory requests and writes one request for each range of overlapping (or adjacent) requests in the same
+// address space
+
+static void writeMemoryRequests(PDRequestCoalescer* coalescer, PDWriter* writer) {
+    MemoryRequest* requests = (MemoryRequest*)coalescer->memory.data;
+    uint32_t count = coalescer->memory.count;
+    uint32_t first = 0;
+
+    qsort(requests, count, sizeof(MemoryRequest), compareMemoryRequest);
+
+    while (first < count) {
+        uint64_t start = requests[first].address;
+        uint64_t end = start + requests[first].size;
+        MemoryRequest merged;
+        uint32_t last = first + 1;
+        uint32_t i;
+
+        while (last < count && requests[last].addressSpace == requests[first].addressSpace &&
+               requests[last].address <= end) {
+            if (requests[last].address + requests[last].size > end)
+                end = requests[last].address + requests[last].size;
+
+            last++;
+        }
+
+        coalescer->stats.sent++;
+
+        if (last - first == 1) {
+            writeMemoryRequest(writer, &requests[first]);
+            first = last;
+            continue;
+        }
+
+        merged.addressSpace = requests[first].addressSpace;
+        merged.address = start;
+        merged.size = end - start;
+        merged.id = MergedIdFlag | (coalescer->mergedId++ & ~MergedIdFlag);
+        merged.hasId = 1;
+
+        writeMemoryRequest(writer, &merged);
+
+        for (i = first; i < last; ++i)
+            addFanOut(coalescer, merged.id, &requests[i], 1);
+
+        first = last;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Requests that never got a reply (backends that doesn't support request ids for example) are dropped after a while
+
+static void removeOldFanOuts(PDRequestCoalescer* coalescer) {
+    FanOut* fanOuts = (FanOut*)coalescer->fanOuts.data;
+    uint32_t i, count = 0;
+
+    for (i = 0; i < coalescer->fanOuts.count; ++i) {
+        if (coalescer->frame - fanOuts[i].frame <= MaxAge)
+            fanOuts[count++] = fanOuts[i];
+    }
+
+    coalescer->fanOuts.count = count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_request_coalescer_coalesce(struct PDRequestCoalescer* coalescer, struct PDReader* reader, struct PDWriter* writer) {
+    uint32_t event;
+
+    coalescer->frame++;
+    coalescer->signatures.count = 0;
+    coalescer->requests.count = 0;
+    coalescer->memory.count = 0;
+
+    removeOldFanOuts(coalescer);
+
+    pd_binary_reader_reset(reader);
+
+    while ((event = PDRead_get_event(reader))) {
+        uint32_t id = 0;
+        int hasId;
+
+        if (!isGetEvent(event)) {
+            PDWrite_event_begin(writer, (uint16_t)event);
+            pd_binary_reader_copy_event(reader, writer, 0);
+            PDWrite_event_end(writer);
+            continue;
+        }
+
+        coalescer->stats.requests++;
+
+        hasId = findRequestId(reader, &id);
+
+        // memory requests are merged and written last
+
+        if (event == PDEventType_GetMemory) {
+            MemoryRequest* request = reserve(&coalescer->memory, 1, sizeof(MemoryRequest));
+
+            if (request) {
+                memset(request, 0, sizeof(MemoryRequest));
+                PDRead_find_u32(reader, &request->addressSpace, PD_ADDRESS_SPACE, 0);
+                PDRead_find_u64(reader, &request->address, "address_start", 0);
+                PDRead_find_u64(reader, &request->size, "size", 0);
+                request->id = id;
+                request->hasId = hasId;
+                coalescer->memory.count++;
+            }
+
+            continue;
+        }
+
+        if (isDuplicate(coalescer, reader, event, id, hasId))
+            continue;
+
+        coalescer->stats.sent++;
+
+        PDWrite_event_begin(writer, (uint16_t)event);
+        pd_binary_reader_copy_event(reader, writer, 0);
+        PDWrite_event_end(writer);
+    }
+
+    writeMemoryRequests(coalescer, writer);
+
+    pd_binary_reader_reset(reader);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hasFanOut(const PDRequestCoalescer* coalescer, uint32_t replyId) {
+    const FanOut* fanOuts = (const FanOut*)coalescer->fanOuts.data;
+    uint32_t i;
+
+    for (i = 0; i < coalescer->fanOuts.count; ++i) {
+        if (fanOuts[i].replyId == replyId)
+            return 1;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Writes the part of a memory reply that a requester asked for
+
+static void writeMemorySlice(PDWriter* writer, const FanOut* fanOut, uint64_t address, uint8_t* data, uint64_t size) {
+    uint64_t start = fanOut->address > address ? fanOut->address : address;
+    uint64_t end = fanOut->address + fanOut->size;
+
+    if (end > address + size)
+        end = address + size;
+
+    PDWrite_event_begin(writer, PDEventType_SetMemory);
+
+    if (fanOut->hasId)
+        PDWrite_u32(writer, PD_REQUEST_ID, fanOut->id);
+
+    if (fanOut->addressSpace)
+        PDWrite_u32(writer, PD_ADDRESS_SPACE, fanOut->addressSpace);
+
+    PDWrite_u64(writer, "address", start);
+    PDWrite_data(writer, "data", data ? data + (start - address) : 0, end > start ? (uint32_t)(end - start) : 0);
+    PDWrite_event_end(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void fanOutReply(PDRequestCoalescer* coalescer, PDReader* reader, PDWriter* writer, uint32_t event, uint32_t id) {
+    FanOut* fanOuts = (FanOut*)coalescer->fanOuts.data;
+    uint64_t address = 0;
+    uint64_t size = 0;
+    void* data = 0;
+    int isMemory = 0;
+    uint32_t i, count = 0;
+
+    if (event == PDEventType_SetMemory && (id & MergedIdFlag)) {
+        isMemory = 1;
+        PDRead_find_u64(reader, &address, "address", 0);
+        PDRead_find_data(reader, &data, &size, "data", 0);
+    } else {
+        // the requester that was sent gets the reply as it is
+        PDWrite_event_begin(writer, (uint16_t)event);
+        pd_binary_reader_copy_event(reader, writer, 0);
+        PDWrite_event_end(writer);
+    }
+
+    for (i = 0; i < coalescer->fanOuts.count; ++i) {
+        const FanOut* fanOut = &fanOuts[i];
+
+        if (fanOut->replyId != id) {
+            fanOuts[count++] = *fanOut;
+            continue;
+        }
+
+        coalescer->stats.fannedOut++;
+
+        if (isMemory && fanOut->isMemory) {
+            writeMemorySlice(writer, fanOut, address, (uint8_t*)data, size);
+            continue;
+        }
+
+        PDWrite_event_begin(writer, (uint16_t)event);
+
+        if (fanOut->hasId)
+            PDWrite_u32(writer, PD_REQUEST_ID, fanOut->id);
+
+        pd_binary_reader_copy_event(reader, writer, PD_REQUEST_ID);
+        PDWrite_event_end(writer);
+    }
+
+    coalescer->fanOuts.count = count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int pd_request_coalescer_fan_out(struct PDRequestCoalescer* coalescer, struct PDReader* reader, struct PDWriter* writer) {
+    uint32_t event;
+    uint32_t id;
+    int found = 0;
+
+    if (coalescer->fanOuts.count == 0)
+        return 0;
+
+    // most updates has no replies to merged requests so only rewrite the stream if there is any
+
+    pd_binary_reader_reset(reader);
+
+    while (!found && (event = PDRead_get_event(reader))) {
+        if (findRequestId(reader, &id))
+            found = hasFanOut(coalescer, id);
+    }
+
+    pd_binary_reader_reset(reader);
+
+    if (!found)
+        return 0;
+
+    while ((event = PDRead_get_event(reader))) {
+        if (findRequestId(reader, &id) && hasFanOut(coalescer, id)) {
+            fanOutReply(coalescer, reader, writer, event, id);
+            continue;
+        }
+
+        PDWrite_event_begin(writer, (uint16_t)event);
+        pd_binary_reader_copy_event(reader, writer, 0);
+        PDWrite_event_end(writer);
+    }
+
+    pd_binary_reader_reset(reader);
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void pd_request_coalescer_get_stats(struct PDRequestCoalescer* coalescer, PDRequestCoalescerStats* stats) {
+    *stats = coalescer->stats;
+}
@@ -0,0 +1,56 @@
+#ifndef PDREQUESTCOALESCER_H_
+#define PDREQUESTCOALESCER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Views writes the same requests over and over (often each frame) and with several views of the same kind open the
+// backend gets the same question several times per update. The coalescer sits between the views and the backend:
+//
+// pd_request_coalescer_coalesce: copies the requests of a frame but only keeps the first of identical Get* events
+//                                (same type and fields, ignoring PD_REQUEST_ID) and merges GetMemory events with
+//                                overlapping or adjacent ranges into one request.
+//
+// pd_request_coalescer_fan_out:  copies the replies from the backend and gives each requester that was merged away
+//                                its own reply (with its own request id and for memory only the range it asked for.)
+//
+// Requests without a request id are never fanned out as replies without an id are seen by all views anyway. Merged
+// GetMemory requests gets an id with the top bit set so backends must support request ids for the memory replies to
+// be split up again (otherwise all the views gets the merged range which they also handle.)
+//
+// This is a private header. Not to to be used by plugins directly
+
+struct PDReader;
+struct PDWriter;
+struct PDRequestCoalescer;
+
+typedef struct PDRequestCoalescerStats {
+    uint32_t requests;          // Get* events given to coalesce
+    uint32_t sent;              // Get* events that were written to the backend
+    uint32_t fannedOut;         // replies written in addition to the ones from the backend
+} PDRequestCoalescerStats;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct PDRequestCoalescer* pd_request_coalescer_create();
+void pd_request_coalescer_destroy(struct PDRequestCoalescer* coalescer);
+
+// Writes the events from the reader (all the requests of one frame) to the writer with duplicates removed
+void pd_request_coalescer_coalesce(struct PDRequestCoalescer* coalescer, struct PDReader* requests, struct PDWriter* writer);
+
+// Returns 1 and writes the replies (with the extra ones for the merged requests) to the writer if any of the replies
+// needs to be fanned out. Returns 0 (and writes nothing) if the replies can be used as they are.
+int pd_request_coalescer_fan_out(struct PDRequestCoalescer* coalescer, struct PDReader* replies, struct PDWriter* writer);
+
+// Totals since the coalescer was created
+void pd_request_coalescer_get_stats(struct PDRequestCoalescer* coalescer, PDRequestCoalescerStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,147 +1,674 @@
 #include "pd_readwrite_private.h"
-#include "remote_connection.h"
+#include "pd_capture.h"
+#include "remote_connection_uv.h"
+#include "remote_connection_shm.h"
 #include <pd_backend.h>
 #include <pd_remote.h>
+#include <uv.h>
 
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifndef _WIN32
 #include <unistd.h>
-#include <arpa/inet.h>
 #else
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#include <Winsock2.h>
+#include <process.h>
+#define getpid _getpid
 #endif
 
-static struct RemoteConnection* s_conn;
-static struct PDBackendPlugin* s_plugin;
-static void* s_userData;
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static PDWriter s_writerData;
-static PDReader s_readerData;
+enum {
+    DefaultPort = 1340,
+    BroadcastClient = -1,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static PDWriter* s_writer;
-static PDReader* s_reader;
+typedef struct Buffer {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} Buffer;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Each connected debugger gets its own reader/writer. The broadcast client is used when the backend is updated
+// without any request and whatever it writes is sent to all clients. Readers and writers are created the first time
+// a client slot is used and kept around to reuse the buffers.
 
-enum {
-    BlockSize = 1024,
-};
+typedef struct Client {
+    PDReader* reader;
+    PDWriter* writer;
+} Client;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void sleepMs(int ms) {
-#ifdef _MSC_VER
-    Sleep(ms);
+typedef struct PDRemote {
+    // only one of these are used depending on the PDRemoteFlags_SharedMemory flag
+
+    struct RemoteConnectionUV* conn;
+    struct RemoteConnectionShm* shm;
+
+    struct PDBackendPlugin* plugin;
+    void* userData;
+    int port;
+
+    Client clients[RemoteConnectionUV_MaxClients];
+    Client broadcast;
+
+    // Threaded mode (PDRemoteFlags_Threaded.) The connection is only touched by the IO thread which hands over
+    // received frames in incoming and sends what the target has put in outgoing. The backend itself (and the
+    // readers/writers) is still updated on the target thread in update as the backend needs to access the state of
+    // the target but the target only has to call it when pendingRequest is set. Both buffers are a list of
+    // [client index][frame] entries.
+
+    int threaded;
+    uv_thread_t thread;
+    uv_mutex_t mutex;
+    uv_cond_t cond;
+
+    Buffer incoming;        // frames received by the IO thread, protected by mutex
+    Buffer outgoing;        // streams to be sent by the IO thread, protected by mutex
+    Buffer processing;      // frames being processed by the target thread
+    Buffer sending;         // streams being sent by the IO thread
+
+    volatile int pendingRequest;
+    volatile int threadConnected;
+    volatile int threadQuit;
+    volatile int queueDepth[2];  // updated by the IO thread, see PDRemote_getQueueDepth
+
+    // set between PDRemote_startCapture/stopCapture, only used on the target thread
+    struct PDCaptureWriter* capture;
+
+} PDRemote;
+
+// instance used by the PDRemote_create/update/... functions that doesn't take an instance
+
+static PDRemote* s_remote;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if defined(_MSC_VER)
+
+// volatile accesses have acquire/release semantics on MSVC
+
+static int atomicLoad(volatile int* value) {
+    return *value;
+}
+
+static void atomicStore(volatile int* value, int v) {
+    *value = v;
+}
+
 #else
-    usleep((unsigned int)(ms * 1000));
+
+static int atomicLoad(volatile int* value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static void atomicStore(volatile int* value, int v) {
+    __atomic_store_n(value, v, __ATOMIC_RELEASE);
+}
+
 #endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int append(Buffer* buffer, const void* data, size_t size) {
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 64 * 1024;
+        uint8_t* newData;
+
+        while (capacity < buffer->size + size)
+            capacity *= 2;
+
+        if (!(newData = realloc(buffer->data, capacity))) {
+            printf("Unable to allocate %d bytes for remote buffer\n", (int)capacity);
+            return 0;
+        }
+
+        buffer->data = newData;
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+
+    return 1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int PDRemote_create(struct PDBackendPlugin* plugin, int waitForConnection) {
-    s_conn = RemoteConnection_create(RemoteConnectionType_Listener, 1340);
+static void swapBuffers(Buffer* a, Buffer* b) {
+    Buffer temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t getFrameSize(const uint8_t* frame) {
+    if (frame[0] & 0x80)
+        return 4;
+
+    return (uint32_t)(((frame[0] & 0x3f) << 24) | (frame[1] << 16) | (frame[2] << 8) | frame[3]);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int connectionUpdate(PDRemote* remote, int timeoutMs) {
+    if (remote->shm)
+        return RemoteConnectionShm_update(remote->shm, timeoutMs);
+
+    return RemoteConnectionUV_update(remote->conn, timeoutMs);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const uint8_t* connectionNextFrame(PDRemote* remote, int* client, int* size) {
+    if (remote->shm) {
+        *client = 0;
+        return RemoteConnectionShm_nextFrame(remote->shm, size);
+    }
+
+    return RemoteConnectionUV_nextFrame(remote->conn, client, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int connectionSend(PDRemote* remote, int client, const PDBinarySegment* segments, int count) {
+    if (remote->shm)
+        return RemoteConnectionShm_sendSegments(remote->shm, segments, count);
+
+    return RemoteConnectionUV_sendSegments(remote->conn, client, segments, count);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int connectionIsConnected(PDRemote* remote) {
+    if (remote->shm)
+        return RemoteConnectionShm_isConnected(remote->shm);
 
-    if (!s_conn)
+    return RemoteConnectionUV_isConnected(remote->conn);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int connectionQueueDepth(PDRemote* remote, enum PDRemoteLane lane) {
+    // shared memory copies everything into the ring directly so there is no queue
+    if (remote->shm)
         return 0;
 
-    s_writer = &s_writerData;
-    s_reader = &s_readerData;
+    return RemoteConnectionUV_getQueueDepth(remote->conn,
+        lane == PDRemoteLane_Bulk ? RemoteConnectionLane_Bulk : RemoteConnectionLane_Control);
+}
 
-    pd_binary_reader_init(s_reader);
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    // \todo Verify that this plugin is ok
-    s_plugin = plugin;
-    s_userData = plugin->create_instance(0);
+static void connectionWakeup(PDRemote* remote) {
+    if (remote->shm)
+        RemoteConnectionShm_wakeup(remote->shm);
+    else
+        RemoteConnectionUV_wakeup(remote->conn);
+}
 
-    // wait for connection if waitForConnecion > 0
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    waitForConnection *= 1000; // count in ms
+static void ioThread(void* arg) {
+    PDRemote* remote = (PDRemote*)arg;
 
-    while (waitForConnection > 0) {
-        PDRemote_update(100);
+    while (!atomicLoad(&remote->threadQuit)) {
+        const uint8_t* frame;
+        int frameSize;
+        int client;
+        size_t offset = 0;
 
-        if (RemoteConnection_isConnected(s_conn))
-            break;
+        connectionUpdate(remote, 100);
 
-        waitForConnection -= 100;
+        uv_mutex_lock(&remote->mutex);
+
+        while ((frame = connectionNextFrame(remote, &client, &frameSize))) {
+            append(&remote->incoming, &client, sizeof(int));
+            append(&remote->incoming, frame, (size_t)frameSize);
+        }
 
+        if (remote->incoming.size > 0) {
+            atomicStore(&remote->pendingRequest, 1);
+            uv_cond_signal(&remote->cond);
+        }
+
+        swapBuffers(&remote->outgoing, &remote->sending);
+
+        uv_mutex_unlock(&remote->mutex);
+
+        while (offset < remote->sending.size) {
+            PDBinarySegment segment;
+
+            memcpy(&client, remote->sending.data + offset, sizeof(int));
+            offset += sizeof(int);
+
+            segment.data = remote->sending.data + offset;
+            segment.size = getFrameSize(remote->sending.data + offset);
+
+            connectionSend(remote, client, &segment, 1);
+
+            offset += segment.size;
+        }
+
+        remote->sending.size = 0;
+
+        atomicStore(&remote->threadConnected, connectionIsConnected(remote));
+        atomicStore(&remote->queueDepth[PDRemoteLane_Control], connectionQueueDepth(remote, PDRemoteLane_Control));
+        atomicStore(&remote->queueDepth[PDRemoteLane_Bulk], connectionQueueDepth(remote, PDRemoteLane_Bulk));
     }
-    return 1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int PDRemote_update(int sleepTime) {
-    PDDebugState state;
+static Client* getClient(PDRemote* remote, int index) {
+    Client* client = index == BroadcastClient ? &remote->broadcast : &remote->clients[index];
+
+    if (!client->reader) {
+        client->reader = pd_binary_reader_create();
+        client->writer = pd_binary_writer_create();
+    }
+
+    return client;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void destroyClient(Client* client) {
+    if (!client->reader)
+        return;
+
+    // writer_destroy only frees the data of the writer while reader_destroy also frees the reader
+
+    pd_binary_writer_destroy(client->writer);
+    pd_binary_reader_destroy(client->reader);
+    free(client->writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void sendThreaded(PDRemote* remote, int client, const PDBinarySegment* segments, int count) {
+    int i;
+
+    uv_mutex_lock(&remote->mutex);
+
+    append(&remote->outgoing, &client, sizeof(int));
+
+    for (i = 0; i < count; ++i)
+        append(&remote->outgoing, segments[i].data, segments[i].size);
+
+    uv_mutex_unlock(&remote->mutex);
+
+    connectionWakeup(remote);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Updates the backend with the frame from a client and sends back what it wrote to the same client
+
+static void updateBackend(PDRemote* remote, int clientIndex, const uint8_t* frame, int frameSize) {
+    Client* client = getClient(remote, clientIndex);
+    const PDBinarySegment* segments;
+    PDBinarySegment request;
+    int segmentCount;
     uint8_t* recvData = 0;
     int recvSize = 0;
     int action = 0;
-    void* data;
     uint32_t size;
 
-    if (sleepTime > 0)
-        sleepMs(sleepTime);
+    if (frame) {
+        if (frame[0] & (1 << 7)) {
+            action = (frame[2] << 8) | frame[3];
+        } else {
+            recvData = (uint8_t*)frame;
+            recvSize = frameSize;
+        }
+    }
+
+    if (remote->capture) {
+        if (action) {
+            pd_capture_writer_write_action(remote->capture, (uint32_t)action);
+        } else if (recvData) {
+            request.data = recvData;
+            request.size = (unsigned int)recvSize;
+            pd_capture_writer_write_segments(remote->capture, PDCaptureRecord_Request, &request, 1);
+        }
+    }
 
-    RemoteConnection_updateListner(s_conn);
+    pd_binary_reader_init_stream(client->reader, recvData, recvSize);
 
-    // Check if we have some data on the incoming connection
+    remote->plugin->update(remote->userData, (PDAction)action, client->reader, client->writer);
 
-    if (RemoteConnection_pollRead(s_conn)) {
-        uint8_t cmd[4];
+    pd_binary_writer_finalize(client->writer);
 
-        if (RemoteConnection_recv(s_conn, (char*)&cmd, 4, 0)) {
-            if (cmd[0] & (1 << 7)) {
-                action = (cmd[2] << 8) | cmd[3];
-            }else {
-                recvSize  = ((cmd[0] & 0x3f) << 24) | (cmd[1] << 16) | (cmd[2] << 8) | cmd[3];
+    size = pd_binary_writer_get_size(client->writer);
 
-                if ((recvData = RemoteConnection_recvStream(s_conn, 0, recvSize)) == 0) {
-                    printf("Unable to get data from stream\n");
-                    free(recvData);
-                    recvData = 0;
-                    recvSize = 0;
-                }
-            }
+    // make sure to only send data if we have something to send (4 is only the size with no data)
+    // data references (write_data_ref) are sent directly from where they are so we need to gather them.
+    // In threaded mode they are copied over to the IO thread as the target may change the data once we return
+
+    if (size > 4 && PDRemote_isInstanceConnected(remote)) {
+        if ((segments = pd_binary_writer_get_segments(client->writer, &segmentCount))) {
+            if (remote->capture)
+                pd_capture_writer_write_segments(remote->capture, PDCaptureRecord_Reply, segments, segmentCount);
+
+            if (remote->threaded)
+                sendThreaded(remote, clientIndex, segments, segmentCount);
+            else
+                connectionSend(remote, clientIndex, segments, segmentCount);
         }
     }
 
-    pd_binary_writer_init(s_writer);
-    pd_binary_reader_init_stream(s_reader, recvData, recvSize);
+    pd_binary_writer_reset(client->writer);
+}
 
-    state = s_plugin->update(s_userData, (PDAction)action, s_reader, s_writer);
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Runs the backend on the received frames that are actions (or the ones that aren't) in the order they arrived
 
-    //PDWrite_event_begin(s_writer, PDEventType_setStatus);
-    //PDWrite_u32(s_writer, "state", (uint32_t)state);
-    //PDWrite_event_end(s_writer);
+static void processFrames(PDRemote* remote, int actions) {
+    size_t offset = 0;
 
-    pd_binary_writer_finalize(s_writer);
+    while (offset < remote->processing.size) {
+        const uint8_t* frame;
+        int frameSize;
+        int client;
 
-    size = pd_binary_writer_get_size(s_writer);
-    data = pd_binary_writer_get_data(s_writer);
+        memcpy(&client, remote->processing.data + offset, sizeof(int));
+        offset += sizeof(int);
 
-    // make sure to only send data if we have something to send (4 is only the size with no data)
+        frame = remote->processing.data + offset;
+        frameSize = (int)getFrameSize(frame);
+
+        if (!!(frame[0] & 0x80) == actions)
+            updateBackend(remote, client, frame, frameSize);
+
+        offset += (size_t)frameSize;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Gets all the frames the IO thread has received and runs the backend on each of them. Actions (break, step, etc)
+// are handled before any other requests so they don't have to wait behind larger requests from the debugger
+
+static void updateThreaded(PDRemote* remote, int sleepTime) {
+    uv_mutex_lock(&remote->mutex);
+
+    if (remote->incoming.size == 0 && sleepTime > 0)
+        uv_cond_timedwait(&remote->cond, &remote->mutex, (uint64_t)sleepTime * 1000000);
+
+    remote->processing.size = 0;
+    swapBuffers(&remote->incoming, &remote->processing);
+    atomicStore(&remote->pendingRequest, 0);
+
+    uv_mutex_unlock(&remote->mutex);
+
+    if (remote->processing.size == 0) {
+        updateBackend(remote, BroadcastClient, 0, 0);
+        return;
+    }
+
+    processFrames(remote, 1);
+    processFrames(remote, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int startThread(PDRemote* remote) {
+    uv_mutex_init(&remote->mutex);
+    uv_cond_init(&remote->cond);
+
+    if (uv_thread_create(&remote->thread, ioThread, remote) != 0) {
+        printf("Unable to create remote thread\n");
+        uv_cond_destroy(&remote->cond);
+        uv_mutex_destroy(&remote->mutex);
+        return 0;
+    }
+
+    remote->threaded = 1;
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void stopThread(PDRemote* remote) {
+    atomicStore(&remote->threadQuit, 1);
+    connectionWakeup(remote);
+    uv_thread_join(&remote->thread);
+
+    uv_cond_destroy(&remote->cond);
+    uv_mutex_destroy(&remote->mutex);
+
+    free(remote->incoming.data);
+    free(remote->outgoing.data);
+    free(remote->processing.data);
+    free(remote->sending.data);
+
+    remote->threaded = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct PDRemote* PDRemote_createInstance(struct PDBackendPlugin* plugin, int port, int flags) {
+    PDRemote* remote = malloc(sizeof(PDRemote));
+
+    memset(remote, 0, sizeof(PDRemote));
+
+    if (flags & PDRemoteFlags_SharedMemory) {
+        char name[64];
+
+        // there are no ports for shared memory but the number is used to tell the regions apart
+
+        if (port == 0)
+            port = (int)getpid();
+
+        sprintf(name, REMOTE_CONNECTION_SHM_NAME, port);
+
+        remote->shm = RemoteConnectionShm_create(RemoteConnectionType_Listener, name,
+                                                 RemoteConnectionShm_DefaultRingSize);
+        remote->port = port;
+    } else {
+        if ((remote->conn = RemoteConnectionUV_create(RemoteConnectionType_Listener, port))) {
+            remote->port = RemoteConnectionUV_getPort(remote->conn);
+            RemoteConnectionUV_setCompression(remote->conn, !!(flags & PDRemoteFlags_Compression));
+        }
+    }
+
+    if (!remote->shm && !remote->conn) {
+        free(remote);
+        return 0;
+    }
+
+    // \todo Verify that this plugin is ok
+    remote->plugin = plugin;
+    remote->userData = plugin->create_instance(0);
+
+    if ((flags & PDRemoteFlags_Threaded) && !startThread(remote)) {
+        PDRemote_destroyInstance(remote);
+        return 0;
+    }
+
+    return remote;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PDRemote_destroyInstance(struct PDRemote* remote) {
+    int i;
+
+    if (!remote)
+        return;
+
+    if (remote->threaded)
+        stopThread(remote);
+
+    pd_capture_writer_destroy(remote->capture);
+
+    if (remote->plugin && remote->plugin->destroy_instance)
+        remote->plugin->destroy_instance(remote->userData);
+
+    for (i = 0; i < RemoteConnectionUV_MaxClients; ++i)
+        destroyClient(&remote->clients[i]);
+
+    destroyClient(&remote->broadcast);
+
+    RemoteConnectionUV_destroy(remote->conn);
+    RemoteConnectionShm_destroy(remote->shm);
+
+    free(remote);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int PDRemote_getPort(struct PDRemote* remote) {
+    return remote->port;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int PDRemote_updateInstance(struct PDRemote* remote, int sleepTime) {
+    const uint8_t* frame;
+    int frameSize = 0;
+    int client = 0;
+
+    if (remote->threaded) {
+        updateThreaded(remote, sleepTime);
+        return PDRemote_isInstanceConnected(remote);
+    }
+
+    // Instead of sleeping for sleepTime we wait for data to arrive (at most sleepTime) so the backend reacts
+    // directly when the debugger sends something. All frames that has arrived are handled (in order) so a debugger
+    // can have many requests in flight without waiting for the replies one update at the time.
+    // If there is no request what the backend writes goes to all clients
+
+    connectionUpdate(remote, sleepTime);
+
+    if (!(frame = connectionNextFrame(remote, &client, &frameSize))) {
+        updateBackend(remote, BroadcastClient, 0, 0);
+        return PDRemote_isInstanceConnected(remote);
+    }
+
+    do {
+        updateBackend(remote, client, frame, frameSize);
+    } while ((frame = connectionNextFrame(remote, &client, &frameSize)));
+
+    return PDRemote_isInstanceConnected(remote);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int PDRemote_isInstanceConnected(struct PDRemote* remote) {
+    if (remote->threaded)
+        return atomicLoad(&remote->threadConnected);
+
+    return connectionIsConnected(remote);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int PDRemote_instanceHasPendingRequest(struct PDRemote* remote) {
+    if (!remote->threaded)
+        return 1;
+
+    return atomicLoad(&remote->pendingRequest);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int PDRemote_getQueueDepth(struct PDRemote* remote, enum PDRemoteLane lane) {
+    if (remote->threaded)
+        return atomicLoad(&remote->queueDepth[lane]);
+
+    return connectionQueueDepth(remote, lane);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int PDRemote_startCapture(struct PDRemote* remote, const char* filename) {
+    struct PDCaptureWriter* capture;
+
+    if (!(capture = pd_capture_writer_create(filename)))
+        return 0;
+
+    pd_capture_writer_destroy(remote->capture);
+    remote->capture = capture;
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PDRemote_stopCapture(struct PDRemote* remote) {
+    pd_capture_writer_destroy(remote->capture);
+    remote->capture = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int createDefault(struct PDBackendPlugin* plugin, int waitForConnection, int flags) {
+    if (!(s_remote = PDRemote_createInstance(plugin, DefaultPort, flags)))
+        return 0;
+
+    // wait for connection if waitForConnecion > 0
+
+    waitForConnection *= 1000; // count in ms
+
+    while (waitForConnection > 0) {
+        PDRemote_update(100);
+
+        if (PDRemote_isConnected())
+            break;
+
+        waitForConnection -= 100;
 
-    if (size > 4 && RemoteConnection_isConnected(s_conn)) {
-        RemoteConnection_sendStream(s_conn, data);
     }
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int PDRemote_create(struct PDBackendPlugin* plugin, int waitForConnection) {
+    return createDefault(plugin, waitForConnection, 0);
+}
 
-    free(recvData);
-    free(data);
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    pd_binary_writer_destroy(s_writer);
+int PDRemote_createThreaded(struct PDBackendPlugin* plugin, int waitForConnection) {
+    return createDefault(plugin, waitForConnection, PDRemoteFlags_Threaded);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    return PDRemote_isConnected();
+int PDRemote_createShared(struct PDBackendPlugin* plugin, int waitForConnection) {
+    return createDefault(plugin, waitForConnection, PDRemoteFlags_SharedMemory);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int PDRemote_update(int sleepTime) {
+    return PDRemote_updateInstance(s_remote, sleepTime);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int PDRemote_hasPendingRequest() {
+    return PDRemote_instanceHasPendingRequest(s_remote);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 int PDRemote_isConnected() {
-    return RemoteConnection_isConnected(s_conn);
+    return PDRemote_isInstanceConnected(s_remote);
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PDRemote_destroy() {
+    PDRemote_destroyInstance(s_remote);
+    s_remote = 0;
+}
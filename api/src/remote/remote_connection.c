@@ -1,4 +1,6 @@
 #include "remote_connection.h"
+#include "pd_readwrite_private.h"
+#include "pd_profiler.h"
 #include <string.h>
 #include <stdint.h>
 
@@ -14,6 +16,7 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <netinet/in.h>
 #include <netdb.h>
@@ -55,6 +58,11 @@ typedef struct RemoteConnection {
     int serverSocket;     // used when having a listener socket
     int socket;
 
+    // receive buffer owned by the connection so streams can be read without any allocations once it
+    // has grown to the size of the largest message
+    uint8_t* recvBuffer;
+    int recvBufferSize;
+
 } RemoteConnection;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -129,6 +137,8 @@ struct RemoteConnection* RemoteConnection_create(enum RemoteConnectionType type,
     conn->type = type;
     conn->serverSocket = INVALID_SOCKET;
     conn->socket = INVALID_SOCKET;
+    conn->recvBuffer = 0;
+    conn->recvBufferSize = 0;
 
     if (type == RemoteConnectionType_Listener) {
         if (!createListner(conn, port)) {
@@ -199,6 +209,7 @@ void RemoteConnection_destroy(struct RemoteConnection* conn) {
     if (conn->serverSocket != INVALID_SOCKET)
         closesocket(conn->serverSocket);
 
+    free(conn->recvBuffer);
     free(conn);
 }
 
@@ -285,7 +296,9 @@ int RemoteConnection_recv(RemoteConnection* conn, char* buffer, int length, int
     if (!RemoteConnection_connected(conn))
         return 0;
 
+    PD_PROFILE_BEGIN("RemoteConnection recv");
     ret = (int)recv(conn->socket, buffer, (size_t)length, flags);
+    PD_PROFILE_END();
 
     if (ret <= 0) {
         printf("recv %d %d\n", ret, length);
@@ -304,7 +317,11 @@ int RemoteConnection_send(RemoteConnection* conn, const void* buffer, int length
     if (!RemoteConnection_connected(conn))
         return 0;
 
-    if ((ret = (int)send(conn->socket, buffer, (size_t)length, flags)) != (int)length) {
+    PD_PROFILE_BEGIN("RemoteConnection send");
+    ret = (int)send(conn->socket, buffer, (size_t)length, flags);
+    PD_PROFILE_END();
+
+    if (ret != (int)length) {
         RemoteConnection_disconnect(conn);
         return 0;
     }
@@ -340,17 +357,125 @@ int RemoteConnection_sendStream(RemoteConnection* conn, const unsigned char* buf
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sends all segments with as few calls as possible (writev) so data doesn't need to be copied into one buffer first
 
-unsigned char* RemoteConnection_recvStream(RemoteConnection* conn, unsigned char* outputBuffer, int size) {
-    uint8_t* retBuffer = outputBuffer;
-    uint8_t ownBuffer = 0;
+static int sendSegments(RemoteConnection* conn, const PDBinarySegment* segments, int count) {
+    int sizeCount = 0;
+
+    if (!RemoteConnection_connected(conn))
+        return 0;
+
+#if defined(_WIN32)
+    int i;
+
+    for (i = 0; i < count; ++i) {
+        const uint8_t* buffer = (const uint8_t*)segments[i].data;
+        unsigned int size = segments[i].size;
+
+        while (size != 0) {
+            int sizeLeft = size > 0x100000 ? 0x100000 : (int)size;
+
+            if (RemoteConnection_send(conn, buffer, sizeLeft, 0) == 0)
+                return sizeCount;
+
+            buffer += sizeLeft;
+            size -= sizeLeft;
+            sizeCount += sizeLeft;
+        }
+    }
+#else
+    enum { MaxVecs = 64 };
+    struct iovec vecs[MaxVecs];
+    int first = 0;
+    size_t skip = 0;    // bytes already sent of the first segment
+
+    while (first < count) {
+        int i, vecCount = 0;
+        ssize_t sent;
+
+        for (i = first; i < count && vecCount < MaxVecs; ++i) {
+            vecs[vecCount].iov_base = (uint8_t*)segments[i].data + (i == first ? skip : 0);
+            vecs[vecCount].iov_len = segments[i].size - (i == first ? skip : 0);
+            vecCount++;
+        }
+
+        sent = writev(conn->socket, vecs, vecCount);
+
+        if (sent <= 0) {
+            RemoteConnection_disconnect(conn);
+            return sizeCount;
+        }
+
+        sizeCount += (int)sent;
+
+        // step over the segments that has been fully sent
+
+        sent += skip;
+
+        while (first < count && (size_t)sent >= segments[first].size) {
+            sent -= segments[first].size;
+            first++;
+        }
+
+        skip = (size_t)sent;
+    }
+#endif
+
+    return sizeCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnection_sendSegments(RemoteConnection* conn, const PDBinarySegment* segments, int count) {
+    int ret;
+
+    PD_PROFILE_BEGIN("RemoteConnection sendSegments");
+    ret = sendSegments(conn, segments, count);
+    PD_PROFILE_END();
+
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Grows the receive buffer of the connection to fit size. The buffer is never shrunk so when it has reached the size
+// of the largest stream no more allocations are done
+
+static uint8_t* getRecvBuffer(RemoteConnection* conn, int size) {
+    uint8_t* buffer;
+    int newSize;
+
+    if (size <= conn->recvBufferSize)
+        return conn->recvBuffer;
+
+    newSize = conn->recvBufferSize ? conn->recvBufferSize : 64 * 1024;
+
+    while (newSize < size)
+        newSize *= 2;
+
+    if (!(buffer = realloc(conn->recvBuffer, (size_t)newSize))) {
+        printf("Unable to allocate %d bytes for receive buffer\n", newSize);
+        return 0;
+    }
+
+    conn->recvBuffer = buffer;
+    conn->recvBufferSize = newSize;
+
+    return buffer;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static unsigned char* recvStream(RemoteConnection* conn, unsigned char* outputBuffer, int size) {
+    uint8_t* retBuffer;
 
     if (!outputBuffer) {
-        outputBuffer = retBuffer = malloc(size);
-        memset(outputBuffer, 0xcd, size);
-        ownBuffer = 1;
+        if (!(outputBuffer = getRecvBuffer(conn, size)))
+            return 0;
     }
 
+    retBuffer = outputBuffer;
+
     outputBuffer[0] = (size >> 24) & 0xff;
     outputBuffer[1] = (size >> 16) & 0xff;
     outputBuffer[2] = (size >> 8) & 0xff;
@@ -359,33 +484,33 @@ unsigned char* RemoteConnection_recvStream(RemoteConnection* conn, unsigned char
     outputBuffer += 4;
     size -= 4;
 
-    //printf("about to get data (expected size %d)\n", size);
-    //printf("filling buffer %p\n", outputBuffer);
-
-    while (size != 0) {
-        uint32_t currSize = size > 1024 ? 1024 : size;
-
-        int ret = RemoteConnection_recv(conn, (char*)outputBuffer, currSize, 0);
-
-        //printf("got size %d (%d)\n", ret, currSize);
+    while (size > 0) {
+        int ret = RemoteConnection_recv(conn, (char*)outputBuffer, size, 0);
 
         if (ret <= 0) {
             printf("Lost connection or error :(\n");
-
-            if (ownBuffer)
-                free(outputBuffer);
-
             return 0;
         }
 
-        outputBuffer += 1024;
-
-        size -= currSize;
+        outputBuffer += ret;
+        size -= ret;
     }
 
     return retBuffer;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+unsigned char* RemoteConnection_recvStream(RemoteConnection* conn, unsigned char* outputBuffer, int size) {
+    unsigned char* ret;
+
+    PD_PROFILE_BEGIN("RemoteConnection recvStream");
+    ret = recvStream(conn, outputBuffer, size);
+    PD_PROFILE_END();
+
+    return ret;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 struct RemoteConnection;
+struct PDBinarySegment;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -35,6 +36,10 @@ int RemoteConnection_sendFormat(struct RemoteConnection* conn, const char* forma
 int RemoteConnection_sendFormatRecv(unsigned char* dest, int buferSize, struct RemoteConnection* conn, int timeOut, const char* format, ...);
 
 int RemoteConnection_sendStream(struct RemoteConnection* connection, const unsigned char* buffer);
+int RemoteConnection_sendSegments(struct RemoteConnection* connection, const struct PDBinarySegment* segments, int count);
+
+// Reads a stream of size bytes (including the 4 byte header) into out. If out is NULL the stream is read into a buffer
+// owned by the connection which stays valid until the next call to recvStream or until the connection is destroyed
 unsigned char* RemoteConnection_recvStream(struct RemoteConnection* connection, unsigned char* out, int size);
 
 #ifdef __cplusplus
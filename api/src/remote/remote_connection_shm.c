@@ -0,0 +1,775 @@
+#include "remote_connection_shm.h"
+#include "pd_readwrite_private.h"
+#include "pd_profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum {
+    ShmMagic = 0x50444253,      // 'PDBS'
+    ShmVersion = 1,
+    HeaderSize = 4096,
+    PeerCheckInterval = 256,    // number of idle updates between checking if the other process is still alive
+    WaitSliceMs = 100,          // max time to sleep on a futex before checking if the other process is alive
+};
+
+// connectPid is set to this while the debugger resets the rings so the listener doesn't pick it up too early
+static const uint32_t ConnectingPid = 0xffffffff;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Positions are running byte counts (masked with ringSize - 1 when accessing the data) so head - tail is always the
+// number of bytes in the ring. The head and tail are on separate cache lines as they are written by different
+// processes
+
+typedef struct ShmRing {
+    uint32_t head;              // written by the producer
+    uint32_t pad0[15];
+    uint32_t tail;              // written by the consumer
+    uint32_t pad1[15];
+    uint32_t dataSeq;           // futex, bumped by the producer when data has been added
+    uint32_t spaceSeq;          // futex, bumped by the consumer when data has been removed
+    uint32_t consumerWaiting;
+    uint32_t producerWaiting;
+    uint32_t pad2[12];
+} ShmRing;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct ShmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ringSize;
+    uint32_t listenerPid;       // 0 when the listener has been destroyed
+    uint32_t connectPid;        // 0 when no debugger is attached
+    uint32_t pad[11];
+    ShmRing rings[2];           // 0 = listener -> debugger, 1 = debugger -> listener
+} ShmHeader;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct RemoteConnectionShm {
+    enum RemoteConnectionType type;
+
+    char name[128];
+    int fd;
+    ShmHeader* header;
+    uint32_t ringSize;
+
+    ShmRing* sendRing;
+    ShmRing* recvRing;
+    uint8_t* sendData;          // both rings are mapped twice in a row
+    uint8_t* recvData;
+
+    uint32_t frameSize;         // frame handed out from the ring, consumed on the next call
+
+    // frames that are too large to fit in the ring are assembled here
+
+    uint8_t* largeFrame;
+    uint32_t largeCapacity;
+    uint32_t largeSize;
+    uint32_t largeFilled;
+    int largeHandedOut;
+
+    int connected;
+    int idleCount;
+    int woken;
+
+} RemoteConnectionShm;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int futexWait(uint32_t* addr, uint32_t value, int timeoutMs) {
+    struct timespec ts;
+
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000;
+
+    return (int)syscall(SYS_futex, addr, FUTEX_WAIT, value, &ts, 0, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void futexWake(uint32_t* addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t loadAcquire(uint32_t* addr) {
+    return __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bumps the sequence and only does the wake syscall if the other side has said it's waiting. The seq_cst
+// store/load pairs with the waiting side setting the flag and then checking the ring again so a wake up can't be lost
+
+static void signalSeq(uint32_t* seq, uint32_t* waiting) {
+    __atomic_add_fetch(seq, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+        futexWake(seq);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int64_t getMonotonicMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint8_t* mapRing(int fd, off_t offset, uint32_t size) {
+    uint8_t* base = mmap(0, (size_t)size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (base == MAP_FAILED)
+        return 0;
+
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, offset) == MAP_FAILED ||
+        mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, offset) == MAP_FAILED) {
+        munmap(base, (size_t)size * 2);
+        return 0;
+    }
+
+    return base;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int mapRegion(RemoteConnectionShm* conn, uint32_t ringSize) {
+    uint8_t* rings[2];
+    int listener = conn->type == RemoteConnectionType_Listener;
+
+    conn->header = mmap(0, HeaderSize, PROT_READ | PROT_WRITE, MAP_SHARED, conn->fd, 0);
+
+    if (conn->header == MAP_FAILED) {
+        conn->header = 0;
+        return 0;
+    }
+
+    if (!(rings[0] = mapRing(conn->fd, HeaderSize, ringSize)))
+        return 0;
+
+    if (!(rings[1] = mapRing(conn->fd, HeaderSize + (off_t)ringSize, ringSize))) {
+        munmap(rings[0], (size_t)ringSize * 2);
+        return 0;
+    }
+
+    conn->ringSize = ringSize;
+    conn->sendRing = &conn->header->rings[listener ? 0 : 1];
+    conn->recvRing = &conn->header->rings[listener ? 1 : 0];
+    conn->sendData = rings[listener ? 0 : 1];
+    conn->recvData = rings[listener ? 1 : 0];
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void unmapRegion(RemoteConnectionShm* conn) {
+    if (conn->sendData)
+        munmap(conn->sendData, (size_t)conn->ringSize * 2);
+
+    if (conn->recvData)
+        munmap(conn->recvData, (size_t)conn->ringSize * 2);
+
+    if (conn->header)
+        munmap(conn->header, HeaderSize);
+
+    if (conn->fd >= 0)
+        close(conn->fd);
+
+    conn->sendData = conn->recvData = 0;
+    conn->sendRing = conn->recvRing = 0;
+    conn->header = 0;
+    conn->fd = -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void resetFrames(RemoteConnectionShm* conn) {
+    conn->frameSize = 0;
+    conn->largeSize = 0;
+    conn->largeFilled = 0;
+    conn->largeHandedOut = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void wakeAll(ShmHeader* header) {
+    int i;
+
+    for (i = 0; i < 2; ++i) {
+        __atomic_add_fetch(&header->rings[i].dataSeq, 1, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&header->rings[i].spaceSeq, 1, __ATOMIC_SEQ_CST);
+        futexWake(&header->rings[i].dataSeq);
+        futexWake(&header->rings[i].spaceSeq);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void disconnect(RemoteConnectionShm* conn) {
+    if (!conn->connected)
+        return;
+
+    conn->connected = 0;
+    resetFrames(conn);
+
+    __atomic_store_n(&conn->header->connectPid, 0, __ATOMIC_RELEASE);
+
+    // the mapping is kept until the connection is destroyed (or connects again) so wakeup can always touch it
+
+    if (conn->type == RemoteConnectionType_Connect)
+        wakeAll(conn->header);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Checks if the other side has gone away, either nicely (pid cleared) or by the process dying
+
+static int checkPeer(RemoteConnectionShm* conn, int checkProcess) {
+    uint32_t pid;
+
+    if (!conn->connected)
+        return 0;
+
+    if (conn->type == RemoteConnectionType_Listener)
+        pid = loadAcquire(&conn->header->connectPid);
+    else
+        pid = loadAcquire(&conn->header->listenerPid);
+
+    if (pid == 0 || (checkProcess && kill((pid_t)pid, 0) == -1 && errno == ESRCH)) {
+        printf("Lost shared memory connection\n");
+        disconnect(conn);
+        return 0;
+    }
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void updateListener(RemoteConnectionShm* conn) {
+    uint32_t pid;
+
+    if (conn->type != RemoteConnectionType_Listener || conn->connected)
+        return;
+
+    // the debugger resets the rings before publishing its pid so everything is ready when we see it
+
+    pid = loadAcquire(&conn->header->connectPid);
+
+    if (pid != 0 && pid != ConnectingPid) {
+        resetFrames(conn);
+        conn->connected = 1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t getFrameSize(const uint8_t* data) {
+    if (data[0] & 0x80)
+        return 4;
+
+    return (uint32_t)(((data[0] & 0x3f) << 24) | (data[1] << 16) | (data[2] << 8) | data[3]);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void consumeFrame(RemoteConnectionShm* conn) {
+    ShmRing* ring = conn->recvRing;
+
+    if (conn->largeHandedOut)
+        resetFrames(conn);
+
+    if (conn->frameSize == 0)
+        return;
+
+    __atomic_store_n(&ring->tail, ring->tail + conn->frameSize, __ATOMIC_RELEASE);
+    signalSeq(&ring->spaceSeq, &ring->producerWaiting);
+
+    conn->frameSize = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns 1 if there is a complete frame ready. Frames that doesn't fit in the ring are moved over to the large buffer
+// as data arrives so the sender can keep writing
+
+static int frameReady(RemoteConnectionShm* conn) {
+    ShmRing* ring;
+    uint32_t available, tail, size;
+
+    if (!conn->connected)
+        return 0;
+
+    if (conn->frameSize || conn->largeHandedOut)
+        return 1;
+
+    ring = conn->recvRing;
+    tail = ring->tail;
+    available = loadAcquire(&ring->head) - tail;
+
+    if (conn->largeSize == 0) {
+        if (available < 4)
+            return 0;
+
+        size = getFrameSize(conn->recvData + (tail & (conn->ringSize - 1)));
+
+        if (size < 4) {
+            printf("Invalid frame size %d, closing connection\n", size);
+            disconnect(conn);
+            return 0;
+        }
+
+        if (size <= conn->ringSize)
+            return available >= size;
+
+        if (size > conn->largeCapacity) {
+            uint8_t* data = realloc(conn->largeFrame, size);
+
+            if (!data) {
+                printf("Unable to allocate %d bytes for frame\n", size);
+                disconnect(conn);
+                return 0;
+            }
+
+            conn->largeFrame = data;
+            conn->largeCapacity = size;
+        }
+
+        conn->largeSize = size;
+        conn->largeFilled = 0;
+    }
+
+    if (available > 0) {
+        uint32_t count = conn->largeSize - conn->largeFilled;
+
+        if (count > available)
+            count = available;
+
+        memcpy(conn->largeFrame + conn->largeFilled, conn->recvData + (tail & (conn->ringSize - 1)), count);
+        conn->largeFilled += count;
+
+        __atomic_store_n(&ring->tail, tail + count, __ATOMIC_RELEASE);
+        signalSeq(&ring->spaceSeq, &ring->producerWaiting);
+    }
+
+    return conn->largeFilled == conn->largeSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct RemoteConnectionShm* RemoteConnectionShm_create(enum RemoteConnectionType type, const char* name, unsigned int ringSize) {
+    RemoteConnectionShm* conn = malloc(sizeof(RemoteConnectionShm));
+    long pageSize = sysconf(_SC_PAGESIZE);
+
+    memset(conn, 0, sizeof(RemoteConnectionShm));
+
+    conn->type = type;
+    conn->fd = -1;
+
+    if (type != RemoteConnectionType_Listener)
+        return conn;
+
+    if ((ringSize & (ringSize - 1)) || ringSize < (unsigned int)pageSize || HeaderSize % pageSize) {
+        printf("Invalid ring size %d, needs to be power of two and at least the page size\n", ringSize);
+        free(conn);
+        return 0;
+    }
+
+    strncpy(conn->name, name, sizeof(conn->name) - 1);
+
+    // remove any region left behind by a target that wasn't shut down properly
+
+    shm_unlink(name);
+
+    if ((conn->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600)) < 0) {
+        printf("Unable to create shared memory %s (%s)\n", name, strerror(errno));
+        free(conn);
+        return 0;
+    }
+
+    if (ftruncate(conn->fd, HeaderSize + (off_t)ringSize * 2) != 0 || !mapRegion(conn, ringSize)) {
+        printf("Unable to map shared memory %s (%s)\n", name, strerror(errno));
+        RemoteConnectionShm_destroy(conn);
+        return 0;
+    }
+
+    conn->header->version = ShmVersion;
+    conn->header->ringSize = ringSize;
+    conn->header->listenerPid = (uint32_t)getpid();
+    __atomic_store_n(&conn->header->magic, ShmMagic, __ATOMIC_RELEASE);
+
+    return conn;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RemoteConnectionShm_destroy(struct RemoteConnectionShm* conn) {
+    if (!conn)
+        return;
+
+    if (conn->type == RemoteConnectionType_Listener) {
+        if (conn->header) {
+            __atomic_store_n(&conn->header->listenerPid, 0, __ATOMIC_RELEASE);
+            wakeAll(conn->header);
+        }
+
+        unmapRegion(conn);
+
+        if (conn->name[0])
+            shm_unlink(conn->name);
+    } else {
+        disconnect(conn);
+        unmapRegion(conn);
+    }
+
+    free(conn->largeFrame);
+    free(conn);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionShm_connect(struct RemoteConnectionShm* conn, const char* name) {
+    ShmHeader header;
+    ShmHeader* shared;
+    struct stat st;
+    long pageSize = sysconf(_SC_PAGESIZE);
+    uint32_t expected = 0;
+    int i;
+
+    if (conn->type != RemoteConnectionType_Connect || conn->connected)
+        return conn->connected;
+
+    unmapRegion(conn);
+
+    if ((conn->fd = shm_open(name, O_RDWR, 0600)) < 0)
+        return 0;
+
+    if (pread(conn->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || header.magic != ShmMagic ||
+        header.version != ShmVersion || header.listenerPid == 0) {
+        unmapRegion(conn);
+        return 0;
+    }
+
+    // the ring size comes from the segment so make sure it is one the listener could have created before using it
+
+    if ((header.ringSize & (header.ringSize - 1)) || header.ringSize < (uint32_t)pageSize || fstat(conn->fd, &st) != 0 ||
+        st.st_size < HeaderSize + (off_t)header.ringSize * 2) {
+        printf("Invalid ring size %u in shared memory %s\n", header.ringSize, name);
+        unmapRegion(conn);
+        return 0;
+    }
+
+    if (!mapRegion(conn, header.ringSize)) {
+        unmapRegion(conn);
+        return 0;
+    }
+
+    shared = conn->header;
+
+    if (!__atomic_compare_exchange_n(&shared->connectPid, &expected, ConnectingPid, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        printf("Unable to connect, another debugger is already connected\n");
+        unmapRegion(conn);
+        return 0;
+    }
+
+    // reset the rings before telling the listener that we are here
+
+    for (i = 0; i < 2; ++i) {
+        shared->rings[i].head = 0;
+        shared->rings[i].tail = 0;
+        shared->rings[i].consumerWaiting = 0;
+        shared->rings[i].producerWaiting = 0;
+    }
+
+    __atomic_store_n(&shared->connectPid, (uint32_t)getpid(), __ATOMIC_RELEASE);
+
+    resetFrames(conn);
+    conn->connected = 1;
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionShm_isConnected(struct RemoteConnectionShm* conn) {
+    updateListener(conn);
+    return conn->connected;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int update(struct RemoteConnectionShm* conn, int timeoutMs) {
+    int64_t endTime = getMonotonicMs() + timeoutMs;
+
+    consumeFrame(conn);
+    updateListener(conn);
+
+    __atomic_store_n(&conn->woken, 0, __ATOMIC_SEQ_CST);
+
+    while (conn->connected) {
+        ShmRing* ring = conn->recvRing;
+        uint32_t seq;
+        int64_t waitTime;
+        int timedOut = 0;
+
+        if (frameReady(conn)) {
+            conn->idleCount = 0;
+            return 1;
+        }
+
+        if (timeoutMs == 0) {
+            if (++conn->idleCount >= PeerCheckInterval) {
+                conn->idleCount = 0;
+                checkPeer(conn, 1);
+            }
+
+            return 0;
+        }
+
+        waitTime = timeoutMs < 0 ? WaitSliceMs : endTime - getMonotonicMs();
+
+        if (waitTime <= 0)
+            return 0;
+
+        if (waitTime > WaitSliceMs)
+            waitTime = WaitSliceMs;
+
+        // flag that we are about to wait and check again so we don't miss any data that was added in between
+
+        seq = __atomic_load_n(&ring->dataSeq, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&ring->consumerWaiting, 1, __ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&conn->woken, __ATOMIC_SEQ_CST))
+            return 0;
+
+        if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == ring->tail && checkPeer(conn, 0))
+            timedOut = futexWait(&ring->dataSeq, seq, (int)waitTime) == -1 && errno == ETIMEDOUT;
+
+        if (conn->connected) {
+            __atomic_store_n(&ring->consumerWaiting, 0, __ATOMIC_SEQ_CST);
+
+            if (timedOut)
+                checkPeer(conn, 1);
+        }
+    }
+
+    // wait for a debugger to attach (in small steps so wakeup is still quick)
+
+    if (conn->type == RemoteConnectionType_Listener && timeoutMs != 0) {
+        int waitTime = timeoutMs < 0 ? WaitSliceMs : timeoutMs;
+
+        while (waitTime > 0 && !__atomic_load_n(&conn->woken, __ATOMIC_SEQ_CST)) {
+            usleep(1000);
+            waitTime--;
+        }
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionShm_update(struct RemoteConnectionShm* conn, int timeoutMs) {
+    int ret;
+
+    PD_PROFILE_BEGIN("RemoteConnectionShm update");
+    ret = update(conn, timeoutMs);
+    PD_PROFILE_END();
+
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RemoteConnectionShm_wakeup(struct RemoteConnectionShm* conn) {
+    ShmRing* ring = conn->recvRing;
+
+    __atomic_store_n(&conn->woken, 1, __ATOMIC_SEQ_CST);
+
+    // the thread in update can only be sleeping on the futex if the region is mapped
+
+    if (ring) {
+        __atomic_add_fetch(&ring->dataSeq, 1, __ATOMIC_SEQ_CST);
+        futexWake(&ring->dataSeq);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint8_t* RemoteConnectionShm_nextFrame(struct RemoteConnectionShm* conn, int* size) {
+    const uint8_t* frame;
+
+    consumeFrame(conn);
+
+    if (!frameReady(conn))
+        return 0;
+
+    if (conn->largeSize) {
+        conn->largeHandedOut = 1;
+        *size = (int)conn->largeSize;
+        return conn->largeFrame;
+    }
+
+    frame = conn->recvData + (conn->recvRing->tail & (conn->ringSize - 1));
+    conn->frameSize = getFrameSize(frame);
+    *size = (int)conn->frameSize;
+
+    return frame;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int waitForSpace(RemoteConnectionShm* conn) {
+    ShmRing* ring = conn->sendRing;
+    uint32_t seq = __atomic_load_n(&ring->spaceSeq, __ATOMIC_SEQ_CST);
+    int timedOut = 0;
+
+    __atomic_store_n(&ring->producerWaiting, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) - __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == conn->ringSize)
+        timedOut = futexWait(&ring->spaceSeq, seq, WaitSliceMs) == -1 && errno == ETIMEDOUT;
+
+    __atomic_store_n(&ring->producerWaiting, 0, __ATOMIC_SEQ_CST);
+
+    return checkPeer(conn, timedOut);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int sendSegments(struct RemoteConnectionShm* conn, const PDBinarySegment* segments, int count) {
+    int sizeCount = 0;
+    int i;
+
+    updateListener(conn);
+
+    if (!conn->connected)
+        return 0;
+
+    for (i = 0; i < count; ++i) {
+        const uint8_t* data = (const uint8_t*)segments[i].data;
+        uint32_t size = segments[i].size;
+
+        while (size > 0) {
+            ShmRing* ring = conn->sendRing;
+            uint32_t head = ring->head;
+            uint32_t space = conn->ringSize - (head - loadAcquire(&ring->tail));
+            uint32_t copySize = size < space ? size : space;
+
+            if (space == 0) {
+                if (!waitForSpace(conn))
+                    return 0;
+
+                continue;
+            }
+
+            // the ring is mapped twice so this never needs to be split up at the end
+
+            memcpy(conn->sendData + (head & (conn->ringSize - 1)), data, copySize);
+
+            __atomic_store_n(&ring->head, head + copySize, __ATOMIC_RELEASE);
+            signalSeq(&ring->dataSeq, &ring->consumerWaiting);
+
+            data += copySize;
+            size -= copySize;
+            sizeCount += (int)copySize;
+        }
+    }
+
+    return sizeCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionShm_sendSegments(struct RemoteConnectionShm* conn, const PDBinarySegment* segments, int count) {
+    int ret;
+
+    PD_PROFILE_BEGIN("RemoteConnectionShm sendSegments");
+    ret = sendSegments(conn, segments, count);
+    PD_PROFILE_END();
+
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#else
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct RemoteConnectionShm* RemoteConnectionShm_create(enum RemoteConnectionType type, const char* name, unsigned int ringSize) {
+    (void)type;
+    (void)name;
+    (void)ringSize;
+    printf("Shared memory connections are not supported on this platform\n");
+    return 0;
+}
+
+void RemoteConnectionShm_destroy(struct RemoteConnectionShm* conn) {
+    (void)conn;
+}
+
+int RemoteConnectionShm_connect(struct RemoteConnectionShm* conn, const char* name) {
+    (void)conn;
+    (void)name;
+    return 0;
+}
+
+int RemoteConnectionShm_isConnected(struct RemoteConnectionShm* conn) {
+    (void)conn;
+    return 0;
+}
+
+int RemoteConnectionShm_update(struct RemoteConnectionShm* conn, int timeoutMs) {
+    (void)conn;
+    (void)timeoutMs;
+    return 0;
+}
+
+void RemoteConnectionShm_wakeup(struct RemoteConnectionShm* conn) {
+    (void)conn;
+}
+
+const uint8_t* RemoteConnectionShm_nextFrame(struct RemoteConnectionShm* conn, int* size) {
+    (void)conn;
+    (void)size;
+    return 0;
+}
+
+int RemoteConnectionShm_sendSegments(struct RemoteConnectionShm* conn, const PDBinarySegment* segments, int count) {
+    (void)conn;
+    (void)segments;
+    (void)count;
+    return 0;
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionShm_send(struct RemoteConnectionShm* conn, const void* data, int size) {
+    PDBinarySegment segment;
+
+    segment.data = data;
+    segment.size = (unsigned int)size;
+
+    return RemoteConnectionShm_sendSegments(conn, &segment, 1);
+}
@@ -0,0 +1,62 @@
+#ifndef REMOTECONNECTIONSHM_H_
+#define REMOTECONNECTIONSHM_H_
+
+#include "remote_connection.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Connection for when the target and the debugger runs on the same machine. The listener (target) creates a shared
+// memory region with two single producer/single consumer byte rings (one for each direction) and the debugger maps
+// the same region by name. Waiting for data/space is done with futexes in the shared memory so an idle connection
+// doesn't spin and a busy one doesn't do any syscalls besides the wake ups.
+//
+// Each ring is mapped twice after each other so a frame that wraps around the end of the ring can still be read
+// directly from the ring without copying. The frames are the same as on the socket connections (4 byte header
+// where the top bit is an action packet, otherwise a 30 bit size including the header.)
+//
+// Only implemented on Linux, create/connect fails on other platforms. This is a private header. Not to to be used
+// by plugins directly
+
+struct RemoteConnectionShm;
+struct PDBinarySegment;
+
+enum {
+    RemoteConnectionShm_DefaultRingSize = 16 * 1024 * 1024,     // needs to be power of two and multiple of page size
+};
+
+// format for the name of the region, the number is the port the target would otherwise listen on
+#define REMOTE_CONNECTION_SHM_NAME "/prodbg_remote_%d"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Listener creates the shared memory (ringSize is the size of each ring) and the connect type just allocates the
+// connection which can then be attached with RemoteConnectionShm_connect
+struct RemoteConnectionShm* RemoteConnectionShm_create(enum RemoteConnectionType type, const char* name, unsigned int ringSize);
+void RemoteConnectionShm_destroy(struct RemoteConnectionShm* conn);
+
+int RemoteConnectionShm_connect(struct RemoteConnectionShm* conn, const char* name);
+int RemoteConnectionShm_isConnected(struct RemoteConnectionShm* conn);
+
+// Same behavior as RemoteConnectionUV_update/nextFrame. The frame returned points directly into the ring (unless it's
+// larger than the ring in which case it's assembled in a buffer owned by the connection) and is valid until the next
+// call to nextFrame or update
+int RemoteConnectionShm_update(struct RemoteConnectionShm* conn, int timeoutMs);
+const uint8_t* RemoteConnectionShm_nextFrame(struct RemoteConnectionShm* conn, int* size);
+
+// Makes a call to update that is waiting return directly. Safe to call from another thread
+void RemoteConnectionShm_wakeup(struct RemoteConnectionShm* conn);
+
+// Copies the segments into the ring, waiting for the other side to make room if it's full. Returns the number of
+// bytes sent or 0 if the connection was lost
+int RemoteConnectionShm_sendSegments(struct RemoteConnectionShm* conn, const struct PDBinarySegment* segments, int count);
+int RemoteConnectionShm_send(struct RemoteConnectionShm* conn, const void* data, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
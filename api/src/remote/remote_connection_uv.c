@@ -0,0 +1,1115 @@
+#include "remote_connection_uv.h"
+#include "pd_readwrite_private.h"
+#include "pd_lz4.h"
+#include "pd_profiler.h"
+#include <uv.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum {
+    MinReadSpace = 64 * 1024,   // free space we make sure to have in the receive buffer before each read
+    MaxWriteBufs = 64,
+    ChunkSize = 64 * 1024,      // streams larger than this are sent in chunks on the bulk lane
+    CompressMinSize = 1024,     // streams smaller than this are never compressed
+};
+
+// The top two bits of the frame header is the type of the frame
+
+enum FrameType {
+    FrameType_Stream = 0x00,
+    FrameType_Chunk = 0x40,
+    FrameType_Action = 0x80,
+    FrameType_Compressed = 0xc0,    // u32 uncompressed size + lz4 block, with no data it tells that the
+                                    // sender can receive compressed frames
+};
+
+enum ClientState {
+    ClientState_Free,
+    ClientState_Open,
+    ClientState_Closing,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct Buffer {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Clients are allocated the first time a slot is used and then kept around (also when disconnected) so the buffers
+// can be reused by the next client in the same slot
+
+typedef struct Client {
+    struct RemoteConnectionUV* conn;
+
+    uv_tcp_t tcp;
+    uv_write_t writeReq;
+
+    // All buffers only grow so when they have reached the size of the largest frames no more allocations are done
+
+    Buffer recv;            // frames are consumed from readOffset and the rest is partially received data
+    Buffer sending;         // data being written by libuv right now
+    Buffer pending;         // control lane, data queued up while a write is in flight
+    Buffer bulk;            // bulk lane, streams waiting to be sent in chunks from bulkOffset
+    Buffer assembly;        // stream being put together from received chunks
+    Buffer inflated;        // decompressed version of the frame handed out by nextFrame
+
+    size_t readOffset;
+    size_t frameSize;       // size of the frame handed out by nextFrame, consumed on the next call
+    size_t bulkOffset;
+    size_t bulkStreamLeft;  // bytes left to send of the stream at bulkOffset
+
+    int assemblyHandedOut;  // the frame handed out by nextFrame is the assembly buffer
+    int peerCompression;    // the other side can receive compressed frames
+
+    enum ClientState state;
+    int connected;
+    int writing;
+
+} Client;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct RemoteConnectionUV {
+    enum RemoteConnectionType type;
+
+    uv_loop_t loop;
+    uv_tcp_t server;
+    uv_timer_t timer;
+    uv_async_t async;
+    uv_connect_t connectReq;
+
+    Client* clients[RemoteConnectionUV_MaxClients];
+
+    Buffer gather;          // segments put together before being compressed
+    Buffer compressed;      // the last sent stream in compressed form
+
+    int nextClient;         // where nextFrame starts looking so all clients gets served
+    int port;
+    int hasServer;
+    int connecting;
+    int timedOut;
+    int lostConnection;
+    int woken;
+    int compression;
+
+} RemoteConnectionUV;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int reserve(Buffer* buffer, size_t size) {
+    size_t capacity;
+    uint8_t* data;
+
+    if (buffer->size + size <= buffer->capacity)
+        return 1;
+
+    capacity = buffer->capacity ? buffer->capacity : MinReadSpace;
+
+    while (capacity < buffer->size + size)
+        capacity *= 2;
+
+    if (!(data = realloc(buffer->data, capacity))) {
+        printf("Unable to allocate %d bytes for connection buffer\n", (int)capacity);
+        return 0;
+    }
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int append(Buffer* buffer, const void* data, size_t size) {
+    if (!reserve(buffer, size))
+        return 0;
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void onClientClosed(uv_handle_t* handle) {
+    Client* client = (Client*)handle->data;
+    client->state = ClientState_Free;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void onRejectClosed(uv_handle_t* handle) {
+    free(handle);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void disconnect(Client* client) {
+    if (client->state != ClientState_Open)
+        return;
+
+    if (client->connected)
+        client->conn->lostConnection = 1;
+
+    // any write in flight will get cancelled and the callback will clear the writing state
+
+    uv_close((uv_handle_t*)&client->tcp, onClientClosed);
+
+    client->state = ClientState_Closing;
+    client->connected = 0;
+    client->recv.size = 0;
+    client->readOffset = 0;
+    client->frameSize = 0;
+    client->pending.size = 0;
+    client->bulk.size = 0;
+    client->bulkOffset = 0;
+    client->bulkStreamLeft = 0;
+    client->assembly.size = 0;
+    client->assemblyHandedOut = 0;
+    client->peerCompression = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static enum FrameType getFrameType(const uint8_t* data) {
+    return (enum FrameType)(data[0] & 0xc0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static size_t getFrameSize(const uint8_t* data) {
+    if (getFrameType(data) == FrameType_Action)
+        return 4;
+
+    return (size_t)(((data[0] & 0x3f) << 24) | (data[1] << 16) | (data[2] << 8) | data[3]);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int isAssembled(Client* client) {
+    return client->assembly.size >= 4 && client->assembly.size == getFrameSize(client->assembly.data);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The first 4 bytes of the stream being assembled tell its size so a chunk that goes past it is caught before it is
+// appended (the header may be split over the first chunks)
+
+static int chunkFits(Client* client, const uint8_t* data, size_t size) {
+    uint8_t header[4];
+    size_t have = client->assembly.size < 4 ? client->assembly.size : 4;
+
+    if (have + size < 4)
+        return 1;
+
+    if (have)
+        memcpy(header, client->assembly.data, have);
+
+    memcpy(header + have, data, 4 - have);
+
+    return client->assembly.size + size <= getFrameSize(header);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns the frame at readOffset if it has been fully received (chunks are only returned if they are broken so
+// nextFrame can close the connection)
+
+static const uint8_t* headFrame(Client* client) {
+    size_t left = client->recv.size - client->readOffset;
+    const uint8_t* frame = client->recv.data + client->readOffset;
+    size_t frameSize;
+
+    if (left < 4)
+        return 0;
+
+    frameSize = getFrameSize(frame);
+
+    if (left < frameSize)
+        return 0;
+
+    if (getFrameType(frame) == FrameType_Chunk && frameSize >= 4)
+        return 0;
+
+    return frame;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Chunks at the start of the receive buffer are moved over to the assembly buffer so the frames after them can be
+// handed out while a large stream is still coming in. Frames telling that the other side supports compression are
+// handled here as well
+
+static int clientHasFrame(Client* client) {
+    if (!client->connected)
+        return 0;
+
+    for (;;) {
+        const uint8_t* frame = client->recv.data + client->readOffset;
+        size_t left = client->recv.size - client->readOffset;
+        size_t frameSize;
+
+        if (left < 4)
+            break;
+
+        frameSize = getFrameSize(frame);
+
+        if (left < frameSize)
+            break;
+
+        if (getFrameType(frame) == FrameType_Compressed && frameSize == 4) {
+            client->peerCompression = 1;
+        } else {
+            if (getFrameType(frame) != FrameType_Chunk || frameSize < 4 || isAssembled(client))
+                return 1;
+
+            if (!chunkFits(client, frame + 4, frameSize - 4)) {
+                printf("Chunk goes past the size of the stream it is part of, closing connection\n");
+                disconnect(client);
+                return 0;
+            }
+
+            if (!append(&client->assembly, frame + 4, frameSize - 4)) {
+                disconnect(client);
+                return 0;
+            }
+        }
+
+        client->readOffset += frameSize;
+
+        if (client->readOffset == client->recv.size)
+            client->readOffset = client->recv.size = 0;
+    }
+
+    return isAssembled(client);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hasFrame(RemoteConnectionUV* conn) {
+    int i;
+
+    for (i = 0; i < RemoteConnectionUV_MaxClients; ++i) {
+        if (conn->clients[i] && clientHasFrame(conn->clients[i]))
+            return 1;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void consumeFrames(RemoteConnectionUV* conn) {
+    int i;
+
+    for (i = 0; i < RemoteConnectionUV_MaxClients; ++i) {
+        Client* client = conn->clients[i];
+
+        if (!client || client->frameSize == 0)
+            continue;
+
+        if (client->assemblyHandedOut) {
+            client->assembly.size = 0;
+            client->assemblyHandedOut = 0;
+            client->frameSize = 0;
+            continue;
+        }
+
+        client->readOffset += client->frameSize;
+        client->frameSize = 0;
+
+        if (client->readOffset == client->recv.size)
+            client->readOffset = client->recv.size = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void onAlloc(uv_handle_t* handle, size_t suggestedSize, uv_buf_t* buf) {
+    Client* client = (Client*)handle->data;
+    Buffer* recv = &client->recv;
+
+    (void)suggestedSize;
+
+    // move the partially received data down to the start before growing the buffer
+
+    if (recv->capacity - recv->size < MinReadSpace && client->readOffset > 0) {
+        memmove(recv->data, recv->data + client->readOffset, recv->size - client->readOffset);
+        recv->size -= client->readOffset;
+        client->readOffset = 0;
+    }
+
+    if (!reserve(recv, MinReadSpace)) {
+        *buf = uv_buf_init(0, 0);
+        return;
+    }
+
+    *buf = uv_buf_init((char*)recv->data + recv->size, (unsigned int)(recv->capacity - recv->size));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void onRead(uv_stream_t* stream, ssize_t readSize, const uv_buf_t* buf) {
+    Client* client = (Client*)stream->data;
+
+    (void)buf;
+
+    if (readSize < 0) {
+        if (readSize != UV_EOF)
+            printf("Lost connection (%s)\n", uv_strerror((int)readSize));
+
+        disconnect(client);
+        return;
+    }
+
+    client->recv.size += (size_t)readSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns a free client slot (allocating the client if needed) with the tcp handle initialized
+
+static Client* openClient(RemoteConnectionUV* conn) {
+    Client* client = 0;
+    int i;
+
+    for (i = 0; i < RemoteConnectionUV_MaxClients; ++i) {
+        if (!conn->clients[i]) {
+            client = malloc(sizeof(Client));
+            memset(client, 0, sizeof(Client));
+            client->conn = conn;
+            conn->clients[i] = client;
+            break;
+        }
+
+        if (conn->clients[i]->state == ClientState_Free) {
+            client = conn->clients[i];
+            break;
+        }
+    }
+
+    if (!client)
+        return 0;
+
+    uv_tcp_init(&conn->loop, &client->tcp);
+
+    client->tcp.data = client;
+    client->writeReq.data = client;
+    client->state = ClientState_Open;
+    client->recv.size = 0;
+    client->readOffset = 0;
+    client->frameSize = 0;
+
+    return client;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int sendClient(Client* client, const PDBinarySegment* segments, int count, size_t totalSize);
+
+static void sendHello(Client* client) {
+    static const uint8_t hello[4] = { FrameType_Compressed, 0, 0, 4 };
+    PDBinarySegment segment;
+
+    segment.data = hello;
+    segment.size = sizeof(hello);
+
+    sendClient(client, &segment, 1, sizeof(hello));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void startClient(Client* client) {
+    uv_tcp_nodelay(&client->tcp, 1);
+
+    if (uv_read_start((uv_stream_t*)&client->tcp, onAlloc, onRead) != 0) {
+        disconnect(client);
+        return;
+    }
+
+    client->connected = 1;
+
+    if (client->conn->compression)
+        sendHello(client);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void onConnection(uv_stream_t* server, int status) {
+    RemoteConnectionUV* conn = (RemoteConnectionUV*)server->data;
+    Client* client;
+    uv_tcp_t* reject;
+
+    if (status < 0)
+        return;
+
+    if (!(client = openClient(conn))) {
+        reject = malloc(sizeof(uv_tcp_t));
+        uv_tcp_init(&conn->loop, reject);
+
+        if (uv_accept(server, (uv_stream_t*)reject) == 0)
+            printf("Rejected connection, too many debuggers connected\n");
+
+        uv_close((uv_handle_t*)reject, onRejectClosed);
+        return;
+    }
+
+    if (uv_accept(server, (uv_stream_t*)&client->tcp) != 0) {
+        disconnect(client);
+        return;
+    }
+
+    startClient(client);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void onConnect(uv_connect_t* req, int status) {
+    Client* client = (Client*)req->data;
+
+    client->conn->connecting = 0;
+
+    if (status < 0) {
+        printf("Unable to connect (%s)\n", uv_strerror(status));
+        disconnect(client);
+        return;
+    }
+
+    startClient(client);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void onTimeout(uv_timer_t* timer) {
+    RemoteConnectionUV* conn = (RemoteConnectionUV*)timer->data;
+    conn->timedOut = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void onWakeup(uv_async_t* async) {
+    RemoteConnectionUV* conn = (RemoteConnectionUV*)async->data;
+    conn->woken = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void onWrite(uv_write_t* req, int status);
+
+// Moves the next chunk of the bulk lane over to the control lane. Only done when there is nothing else to send so
+// control data never has to wait for more than the chunk currently being written
+
+static void queueChunk(Client* client) {
+    size_t size;
+    uint8_t header[4];
+
+    if (client->bulkOffset == client->bulk.size)
+        return;
+
+    if (client->bulkStreamLeft == 0)
+        client->bulkStreamLeft = getFrameSize(client->bulk.data + client->bulkOffset);
+
+    size = client->bulkStreamLeft < ChunkSize ? client->bulkStreamLeft : ChunkSize;
+
+    header[0] = (uint8_t)(FrameType_Chunk | (((size + 4) >> 24) & 0x3f));
+    header[1] = (uint8_t)((size + 4) >> 16);
+    header[2] = (uint8_t)((size + 4) >> 8);
+    header[3] = (uint8_t)((size + 4) >> 0);
+
+    if (!reserve(&client->pending, size + 4))
+        return;
+
+    append(&client->pending, header, 4);
+    append(&client->pending, client->bulk.data + client->bulkOffset, size);
+
+    client->bulkOffset += size;
+    client->bulkStreamLeft -= size;
+
+    if (client->bulkOffset == client->bulk.size)
+        client->bulkOffset = client->bulk.size = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void startWrite(Client* client) {
+    Buffer temp;
+    uv_buf_t buf;
+
+    if (client->writing || !client->connected)
+        return;
+
+    if (client->pending.size == 0)
+        queueChunk(client);
+
+    if (client->pending.size == 0)
+        return;
+
+    temp = client->sending;
+    client->sending = client->pending;
+    client->pending = temp;
+    client->pending.size = 0;
+
+    buf = uv_buf_init((char*)client->sending.data, (unsigned int)client->sending.size);
+
+    if (uv_write(&client->writeReq, (uv_stream_t*)&client->tcp, &buf, 1, onWrite) != 0) {
+        disconnect(client);
+        return;
+    }
+
+    client->writing = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void onWrite(uv_write_t* req, int status) {
+    Client* client = (Client*)req->data;
+
+    client->writing = 0;
+    client->sending.size = 0;
+
+    if (status < 0) {
+        if (status != UV_ECANCELED)
+            disconnect(client);
+
+        return;
+    }
+
+    startWrite(client);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Try to write directly from the segments first and only copy what the socket didn't accept. If there is data
+// queued up already we need to go through the queue to keep the order
+
+static int sendClient(Client* client, const PDBinarySegment* segments, int count, size_t totalSize) {
+    uv_buf_t bufs[MaxWriteBufs];
+    size_t written = 0;
+    int i;
+
+    // large streams goes to the bulk lane and are sent in chunks when there is no control data to send
+
+    if (totalSize > ChunkSize) {
+        for (i = 0; i < count; ++i) {
+            if (!append(&client->bulk, segments[i].data, segments[i].size)) {
+                disconnect(client);
+                return 0;
+            }
+        }
+
+        startWrite(client);
+
+        return (int)totalSize;
+    }
+
+    if (!client->writing && client->pending.size == 0) {
+        int first = 0;
+
+        while (first < count) {
+            size_t batchSize = 0;
+            int bufCount = 0;
+            int ret;
+
+            for (i = first; i < count && bufCount < MaxWriteBufs; ++i) {
+                bufs[bufCount++] = uv_buf_init((char*)segments[i].data, segments[i].size);
+                batchSize += segments[i].size;
+            }
+
+            ret = uv_try_write((uv_stream_t*)&client->tcp, bufs, (unsigned int)bufCount);
+
+            if (ret < 0 && ret != UV_EAGAIN && ret != UV_ENOSYS) {
+                disconnect(client);
+                return 0;
+            }
+
+            if (ret > 0)
+                written += (size_t)ret;
+
+            if (ret < 0 || (size_t)ret < batchSize)
+                break;
+
+            first = i;
+        }
+    }
+
+    // queue up the rest
+
+    if (written < totalSize) {
+        size_t offset = 0;
+
+        for (i = 0; i < count; ++i) {
+            size_t segmentSize = segments[i].size;
+            size_t skip = 0;
+
+            if (offset + segmentSize <= written) {
+                offset += segmentSize;
+                continue;
+            }
+
+            if (offset < written)
+                skip = written - offset;
+
+            if (!append(&client->pending, (const uint8_t*)segments[i].data + skip, segmentSize - skip)) {
+                disconnect(client);
+                return 0;
+            }
+
+            offset += segmentSize;
+        }
+
+        startWrite(client);
+    }
+
+    return (int)totalSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Compresses the stream into conn->compressed. Returns 0 if it didn't get any smaller
+
+static int compressStream(RemoteConnectionUV* conn, const PDBinarySegment* segments, int count, size_t totalSize) {
+    const uint8_t* src = (const uint8_t*)segments[0].data;
+    uint8_t* dst;
+    size_t frameSize;
+    int size;
+    int i;
+
+    if (count > 1) {
+        conn->gather.size = 0;
+
+        for (i = 0; i < count; ++i) {
+            if (!append(&conn->gather, segments[i].data, segments[i].size))
+                return 0;
+        }
+
+        src = conn->gather.data;
+    }
+
+    conn->compressed.size = 0;
+
+    if (!reserve(&conn->compressed, (size_t)pd_lz4_compress_bound((int)totalSize) + 8))
+        return 0;
+
+    dst = conn->compressed.data;
+
+    if (!(size = pd_lz4_compress(src, (int)totalSize, dst + 8, (int)(conn->compressed.capacity - 8))))
+        return 0;
+
+    frameSize = (size_t)size + 8;
+
+    if (frameSize >= totalSize)
+        return 0;
+
+    dst[0] = (uint8_t)(FrameType_Compressed | ((frameSize >> 24) & 0x3f));
+    dst[1] = (uint8_t)(frameSize >> 16);
+    dst[2] = (uint8_t)(frameSize >> 8);
+    dst[3] = (uint8_t)(frameSize >> 0);
+    dst[4] = (uint8_t)(totalSize >> 24);
+    dst[5] = (uint8_t)(totalSize >> 16);
+    dst[6] = (uint8_t)(totalSize >> 8);
+    dst[7] = (uint8_t)(totalSize >> 0);
+
+    conn->compressed.size = frameSize;
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Decompresses a compressed frame into the inflated buffer of the client
+
+static const uint8_t* decompressFrame(Client* client, const uint8_t* frame, size_t frameSize, size_t* size) {
+    size_t inflatedSize;
+
+    if (frameSize < 8)
+        return 0;
+
+    inflatedSize = (size_t)((frame[4] << 24) | (frame[5] << 16) | (frame[6] << 8) | frame[7]);
+
+    client->inflated.size = 0;
+
+    if (inflatedSize < 4 || !reserve(&client->inflated, inflatedSize))
+        return 0;
+
+    if (pd_lz4_decompress(frame + 8, (int)(frameSize - 8), client->inflated.data, (int)inflatedSize) != (int)inflatedSize)
+        return 0;
+
+    if (getFrameSize(client->inflated.data) != inflatedSize || getFrameType(client->inflated.data) != FrameType_Stream)
+        return 0;
+
+    *size = inflatedSize;
+
+    return client->inflated.data;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct RemoteConnectionUV* RemoteConnectionUV_create(enum RemoteConnectionType type, int port) {
+    RemoteConnectionUV* conn = malloc(sizeof(RemoteConnectionUV));
+    struct sockaddr_in addr;
+    struct sockaddr_in bound;
+    int boundSize = sizeof(bound);
+    int r;
+
+    memset(conn, 0, sizeof(RemoteConnectionUV));
+
+    conn->type = type;
+
+    if (uv_loop_init(&conn->loop) != 0) {
+        free(conn);
+        return 0;
+    }
+
+    uv_timer_init(&conn->loop, &conn->timer);
+    uv_async_init(&conn->loop, &conn->async, onWakeup);
+
+    conn->server.data = conn;
+    conn->timer.data = conn;
+    conn->async.data = conn;
+
+    if (type == RemoteConnectionType_Listener) {
+        uv_tcp_init(&conn->loop, &conn->server);
+        conn->hasServer = 1;
+
+        uv_ip4_addr("0.0.0.0", port, &addr);
+
+        if ((r = uv_tcp_bind(&conn->server, (const struct sockaddr*)&addr, 0)) != 0 ||
+            (r = uv_listen((uv_stream_t*)&conn->server, RemoteConnectionUV_MaxClients, onConnection)) != 0) {
+            printf("Unable to listen on port %d (%s)\n", port, uv_strerror(r));
+            RemoteConnectionUV_destroy(conn);
+            return 0;
+        }
+
+        // port 0 means the OS picks one so get the port we actually ended up with
+
+        conn->port = port;
+
+        if (uv_tcp_getsockname(&conn->server, (struct sockaddr*)&bound, &boundSize) == 0)
+            conn->port = ntohs(bound.sin_port);
+    }
+
+    return conn;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RemoteConnectionUV_destroy(struct RemoteConnectionUV* conn) {
+    int i;
+
+    if (!conn)
+        return;
+
+    for (i = 0; i < RemoteConnectionUV_MaxClients; ++i) {
+        if (conn->clients[i])
+            disconnect(conn->clients[i]);
+    }
+
+    if (conn->hasServer)
+        uv_close((uv_handle_t*)&conn->server, 0);
+
+    uv_close((uv_handle_t*)&conn->timer, 0);
+    uv_close((uv_handle_t*)&conn->async, 0);
+
+    // run the loop until all the handles has been closed
+
+    uv_run(&conn->loop, UV_RUN_DEFAULT);
+    uv_loop_close(&conn->loop);
+
+    for (i = 0; i < RemoteConnectionUV_MaxClients; ++i) {
+        Client* client = conn->clients[i];
+
+        if (!client)
+            continue;
+
+        free(client->recv.data);
+        free(client->sending.data);
+        free(client->pending.data);
+        free(client->bulk.data);
+        free(client->assembly.data);
+        free(client->inflated.data);
+        free(client);
+    }
+
+    free(conn->gather.data);
+    free(conn->compressed.data);
+
+    free(conn);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionUV_connect(struct RemoteConnectionUV* conn, const char* address, int port) {
+    struct sockaddr_in addr;
+    Client* client = conn->clients[0];
+
+    // wait for a previous connection to be fully closed
+
+    while (client && client->state == ClientState_Closing)
+        uv_run(&conn->loop, UV_RUN_ONCE);
+
+    if (client && client->state != ClientState_Free)
+        return client->connected;
+
+    if (uv_ip4_addr(address, port, &addr) != 0)
+        return 0;
+
+    if (!(client = openClient(conn)))
+        return 0;
+
+    conn->connectReq.data = client;
+    conn->connecting = 1;
+
+    if (uv_tcp_connect(&conn->connectReq, &client->tcp, (const struct sockaddr*)&addr, onConnect) != 0) {
+        conn->connecting = 0;
+        disconnect(client);
+        return 0;
+    }
+
+    while (conn->connecting)
+        uv_run(&conn->loop, UV_RUN_ONCE);
+
+    return client->connected;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionUV_getPort(struct RemoteConnectionUV* conn) {
+    return conn->port;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionUV_isConnected(struct RemoteConnectionUV* conn) {
+    int i;
+
+    for (i = 0; i < RemoteConnectionUV_MaxClients; ++i) {
+        if (conn->clients[i] && conn->clients[i]->connected)
+            return 1;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionUV_isClientConnected(struct RemoteConnectionUV* conn, int client) {
+    if (client < 0 || client >= RemoteConnectionUV_MaxClients || !conn->clients[client])
+        return 0;
+
+    return conn->clients[client]->connected;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int update(struct RemoteConnectionUV* conn, int timeoutMs) {
+    consumeFrames(conn);
+
+    conn->lostConnection = 0;
+    conn->woken = 0;
+
+    // always process pending events (new connections, writes) even if we already have data
+
+    uv_run(&conn->loop, UV_RUN_NOWAIT);
+
+    if (hasFrame(conn) || timeoutMs == 0)
+        return hasFrame(conn);
+
+    conn->timedOut = 0;
+
+    if (timeoutMs > 0)
+        uv_timer_start(&conn->timer, onTimeout, (uint64_t)timeoutMs, 0);
+
+    while (!hasFrame(conn) && !conn->timedOut && !conn->lostConnection && !conn->woken) {
+        if (!uv_run(&conn->loop, UV_RUN_ONCE))
+            break;  // nothing left that can wake us up
+    }
+
+    uv_timer_stop(&conn->timer);
+
+    return hasFrame(conn);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionUV_update(struct RemoteConnectionUV* conn, int timeoutMs) {
+    int ret;
+
+    PD_PROFILE_BEGIN("RemoteConnectionUV update");
+    ret = update(conn, timeoutMs);
+    PD_PROFILE_END();
+
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RemoteConnectionUV_wakeup(struct RemoteConnectionUV* conn) {
+    uv_async_send(&conn->async);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const uint8_t* nextFrame(struct RemoteConnectionUV* conn, int* clientIndex, int* size) {
+    int i;
+
+    consumeFrames(conn);
+
+    // go over the clients round robin so one busy client can't starve the others
+
+    for (i = 0; i < RemoteConnectionUV_MaxClients; ++i) {
+        int index = (conn->nextClient + i) % RemoteConnectionUV_MaxClients;
+        Client* client = conn->clients[index];
+        const uint8_t* frame;
+        size_t frameSize;
+
+        if (!client || !clientHasFrame(client))
+            continue;
+
+        // frames that came in between the chunks are handed out before the assembled stream
+
+        if (!(frame = headFrame(client))) {
+            frame = client->assembly.data;
+            client->assemblyHandedOut = 1;
+        }
+
+        if ((client->frameSize = getFrameSize(frame)) < 4) {
+            printf("Invalid frame size %d, closing connection\n", (int)client->frameSize);
+            disconnect(client);
+            continue;
+        }
+
+        frameSize = client->frameSize;
+
+        if (getFrameType(frame) == FrameType_Compressed) {
+            if (!(frame = decompressFrame(client, frame, client->frameSize, &frameSize))) {
+                printf("Unable to decompress frame, closing connection\n");
+                disconnect(client);
+                continue;
+            }
+        }
+
+        conn->nextClient = (index + 1) % RemoteConnectionUV_MaxClients;
+
+        *clientIndex = index;
+        *size = (int)frameSize;
+
+        return frame;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint8_t* RemoteConnectionUV_nextFrame(struct RemoteConnectionUV* conn, int* clientIndex, int* size) {
+    const uint8_t* frame;
+
+    PD_PROFILE_BEGIN("RemoteConnectionUV nextFrame");
+    frame = nextFrame(conn, clientIndex, size);
+    PD_PROFILE_END();
+
+    return frame;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int sendSegments(struct RemoteConnectionUV* conn, int client, const PDBinarySegment* segments, int count) {
+    PDBinarySegment compressed;
+    size_t totalSize = 0;
+    int hasCompressed = 0;
+    int sent = 0;
+    int ret;
+    int i;
+
+    for (i = 0; i < count; ++i)
+        totalSize += segments[i].size;
+
+    if (client >= 0 && !RemoteConnectionUV_isClientConnected(conn, client))
+        return 0;
+
+    // compress once and send that to all clients that supports it
+
+    if (conn->compression && totalSize >= CompressMinSize && getFrameType((const uint8_t*)segments[0].data) == FrameType_Stream) {
+        if ((hasCompressed = compressStream(conn, segments, count, totalSize))) {
+            compressed.data = conn->compressed.data;
+            compressed.size = (unsigned int)conn->compressed.size;
+        }
+    }
+
+    for (i = 0; i < RemoteConnectionUV_MaxClients; ++i) {
+        Client* c = conn->clients[i];
+
+        if ((client >= 0 && i != client) || !c || !c->connected)
+            continue;
+
+        if (hasCompressed && c->peerCompression)
+            ret = sendClient(c, &compressed, 1, compressed.size);
+        else
+            ret = sendClient(c, segments, count, totalSize);
+
+        if (ret)
+            sent = (int)totalSize;
+    }
+
+    return sent;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionUV_sendSegments(struct RemoteConnectionUV* conn, int client, const PDBinarySegment* segments, int count) {
+    int ret;
+
+    PD_PROFILE_BEGIN("RemoteConnectionUV sendSegments");
+    ret = sendSegments(conn, client, segments, count);
+    PD_PROFILE_END();
+
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionUV_send(struct RemoteConnectionUV* conn, int client, const void* data, int size) {
+    PDBinarySegment segment;
+
+    segment.data = data;
+    segment.size = (unsigned int)size;
+
+    return RemoteConnectionUV_sendSegments(conn, client, &segment, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RemoteConnectionUV_setCompression(struct RemoteConnectionUV* conn, int enable) {
+    int i;
+
+    if (enable && !conn->compression) {
+        for (i = 0; i < RemoteConnectionUV_MaxClients; ++i) {
+            if (conn->clients[i] && conn->clients[i]->connected)
+                sendHello(conn->clients[i]);
+        }
+    }
+
+    conn->compression = enable;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RemoteConnectionUV_getQueueDepth(struct RemoteConnectionUV* conn, enum RemoteConnectionLane lane) {
+    size_t depth = 0;
+    int i;
+
+    for (i = 0; i < RemoteConnectionUV_MaxClients; ++i) {
+        Client* client = conn->clients[i];
+
+        if (!client)
+            continue;
+
+        if (lane == RemoteConnectionLane_Control)
+            depth += client->pending.size;
+        else
+            depth += client->bulk.size - client->bulkOffset;
+    }
+
+    return (int)depth;
+}
@@ -0,0 +1,91 @@
+#ifndef REMOTECONNECTIONUV_H_
+#define REMOTECONNECTIONUV_H_
+
+#include "remote_connection.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Event driven version of RemoteConnection on top of libuv. Instead of polling the socket with select and reading
+// full streams in a blocking way data is read when the socket is readable and split up into frames incrementally
+// so a partially received stream never blocks the caller. Each connection runs its own loop which is only
+// driven by RemoteConnectionUV_update, so the connection can be used from any (single) thread.
+//
+// Frames are the same as on the select based connection: 4 byte header where the top bit set means an action
+// packet (the action in the lower 16 bits) otherwise the lower 30 bits is the size of the stream including the
+// header.
+//
+// Sending is done in two lanes. Streams up to 64k go on the control lane and are written as soon as possible while
+// larger streams go on the bulk lane and are split up in chunk frames (bit 30 set in the header) which are only
+// written when there is no control data waiting. So a break or step reply never has to wait for more than one chunk
+// of a large memory reply. The chunks are put together again on the receiving side so nextFrame always returns full
+// streams.
+//
+// Compression can be enabled on each side of the connection. Both sides tell the other one that they can receive
+// compressed frames when it's enabled and streams of 1k or more are then compressed (lz4) if the other side supports
+// it and it makes them smaller. The frame type is stored in the top two bits of the header: 00 stream, 01 chunk,
+// 10 action and 11 compressed.
+//
+// A listener accepts up to MaxClients debuggers at the same time. Each client is identified by an index which is
+// returned with each frame and used when sending back to it. This is a private header. Not to to be used by plugins
+// directly
+
+struct RemoteConnectionUV;
+struct PDBinarySegment;
+
+enum {
+    RemoteConnectionUV_MaxClients = 16,
+};
+
+enum RemoteConnectionLane {
+    RemoteConnectionLane_Control,
+    RemoteConnectionLane_Bulk,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// port 0 for a listener means that the OS picks a free port which can then be fetched with getPort
+struct RemoteConnectionUV* RemoteConnectionUV_create(enum RemoteConnectionType type, int port);
+void RemoteConnectionUV_destroy(struct RemoteConnectionUV* conn);
+
+int RemoteConnectionUV_connect(struct RemoteConnectionUV* conn, const char* address, int port);
+int RemoteConnectionUV_getPort(struct RemoteConnectionUV* conn);
+
+// isConnected is true if any client is connected
+int RemoteConnectionUV_isConnected(struct RemoteConnectionUV* conn);
+int RemoteConnectionUV_isClientConnected(struct RemoteConnectionUV* conn, int client);
+
+// Processes socket events (accepting connections, reading and writing) and waits up to timeoutMs for a frame to
+// arrive if there isn't already one available. 0 never waits and -1 waits until a frame arrives or the connection
+// is lost. Returns 1 if a frame is ready to be fetched with nextFrame
+int RemoteConnectionUV_update(struct RemoteConnectionUV* conn, int timeoutMs);
+
+// Makes a call to update that is waiting return directly. This is the only function that is safe to call from
+// another thread than the one using the connection
+void RemoteConnectionUV_wakeup(struct RemoteConnectionUV* conn);
+
+// Returns the next complete frame (including the 4 byte header) from any of the clients or NULL if there are no more
+// frames. The index of the client that sent it is stored in client. The data is owned by the connection and is
+// valid until the next call to nextFrame or update
+const uint8_t* RemoteConnectionUV_nextFrame(struct RemoteConnectionUV* conn, int* client, int* size);
+
+// Sends the segments as one stream to client (-1 sends to all connected clients). Data that can't be written
+// directly is copied and sent when the socket is writable again so this never blocks. Returns the number of bytes
+// sent or queued, 0 on error
+int RemoteConnectionUV_sendSegments(struct RemoteConnectionUV* conn, int client, const struct PDBinarySegment* segments, int count);
+int RemoteConnectionUV_send(struct RemoteConnectionUV* conn, int client, const void* data, int size);
+
+// Enables compression of streams sent to clients that support it. Received compressed frames are always handled
+void RemoteConnectionUV_setCompression(struct RemoteConnectionUV* conn, int enable);
+
+// Number of bytes queued up in a lane (for all clients) that hasn't been handed over to the socket yet
+int RemoteConnectionUV_getQueueDepth(struct RemoteConnectionUV* conn, enum RemoteConnectionLane lane);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
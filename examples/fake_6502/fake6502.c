@@ -953,6 +953,11 @@ void exec6502(uint32_t tickcount) {
 
 static void updateDebugger()
 {
+    // the connection is handled on a background thread so we only need to update when the debugger wants something
+
+    if (!PDRemote_hasPendingRequest())
+        return;
+
     // if we aren't connected with the debugger just update the connection every 128 cycles to save some CPU
 
     if (!PDRemote_isConnected())
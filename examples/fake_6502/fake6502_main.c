@@ -45,6 +45,7 @@ int main(int argc, const char* argv[])
 {
     FILE* f;
     int size;
+    int connected;
 
     (void)argc;
     (void)argv;
@@ -52,7 +53,7 @@ int main(int argc, const char* argv[])
 
     if (argc < 2)
     {
-        printf("Usage: Fake6502 image.bin (max 64k in size)\n");
+        printf("Usage: Fake6502 image.bin (max 64k in size) [-shm]\n");
         return 0;
     }
 
@@ -77,7 +78,14 @@ int main(int argc, const char* argv[])
 
     disassemble(0, (unsigned short)size);
 
-    if (!PDRemote_create(&s_debuggerPlugin, 0))
+    // -shm talks to a debugger on the same machine over shared memory instead of a socket
+
+    if (argc > 2 && !strcmp(argv[2], "-shm"))
+        connected = PDRemote_createShared(&s_debuggerPlugin, 0);
+    else
+        connected = PDRemote_createThreaded(&s_debuggerPlugin, 0);
+
+    if (!connected)
     {
         printf("Unable to setup debugger connection\n");
     }
@@ -131,7 +131,7 @@ Engine::Engine()
     , m_lastCommandAtStackLevel(0)
     , m_lastFunction(nullptr)
     , m_connected(false) {
-    if (!PDRemote_create(&s_asdebuggerPlugin, 0)) {
+    if (!PDRemote_createThreaded(&s_asdebuggerPlugin, 0)) {
         output("Unable to setup debugger connection\n");
         return;
     }
@@ -148,6 +148,11 @@ Engine::~Engine() {
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void Engine::tick() {
+    // the connection is handled on a background thread so only update when the debugger has sent something
+
+    if (!PDRemote_hasPendingRequest())
+        return;
+
     if (!PDRemote_isConnected()) {
         //if ((instructions & 127) == 0)
         PDRemote_update(0);
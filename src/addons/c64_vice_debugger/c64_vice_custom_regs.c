@@ -4,15 +4,16 @@
 #include <stdbool.h>
 #include "pd_view.h"
 #include "pd_backend.h"
+#include "pd_host.h"
 #include "c64_vice_custom_regs.h"
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 typedef struct CustomRegsData {
     uint8_t regs[0x30];
-    bool hasMemory;
-    bool requestMemory;
-    uint64_t location;
+    PDMemoryCacheFuncs* memory;
+    uint32_t changeCount;
+    bool upToDate;
 } CustomRegsData;
 
 static PDColor s_colorRed = PDUI_COLOR(255, 0, 0, 0);
@@ -51,7 +52,6 @@ void printSpriteY(PDUI* uiFuncs, uint16_t v, uint32_t i) {
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static void* createInstance(PDUI* uiFuncs, ServiceFunc* serviceFunc) {
-    (void)serviceFunc;
     CustomRegsData* user_data = (CustomRegsData*)malloc(sizeof(CustomRegsData));
 
     static uint8_t tempData[] =
@@ -65,11 +65,13 @@ static void* createInstance(PDUI* uiFuncs, ServiceFunc* serviceFunc) {
         0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
     };
 
-    user_data->hasMemory = true;
     memcpy(user_data->regs, tempData, 0x30);
 
+    user_data->memory = (PDMemoryCacheFuncs*)serviceFunc(PDMEMORYCACHE_GLOBAL);
+    user_data->changeCount = 0;
+    user_data->upToDate = false;
+
     (void)uiFuncs;
-    (void)serviceFunc;
 
     return user_data;
 }
@@ -344,74 +346,46 @@ static void showUI(CustomRegsData* data, PDUI* uiFuncs) {
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void updateMemory(CustomRegsData* user_data, PDReader* reader) {
-    void* data;
-    uint64_t address = 0;
-    uint64_t size = 0;
-
-    PDRead_find_u64(reader, &address, "address", 0);
-
-    if (PDRead_find_data(reader, &data, &size, "data", 0) == PDReadStatus_NotFound)
-        return;
-
-    if (address != 0xd000 || size != 0x30)
-        return;
-
-    memcpy(user_data->regs, data, 0x30);
-    user_data->hasMemory = true;
-}
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 static int update(void* user_data, PDUI* uiFuncs, PDReader* reader, PDWriter* writer) {
-    uint32_t event;
     CustomRegsData* data = (CustomRegsData*)user_data;
 
-    data->requestMemory = false;
-
-    while ((event = PDRead_get_event(reader)) != 0) {
-        switch (event) {
-            case PDEventType_SetExceptionLocation:
-            {
-                uint64_t location = 0;
+    (void)reader;
+    (void)writer;
 
-                PDRead_find_u64(reader, &location, "address", 0);
+    // Only read the registers again when the memory cache has changed (or they haven't all arrived yet)
 
-                if (location != data->location) {
-                    data->location = location;
-                    data->requestMemory = true;
-                }
+    if (data->memory) {
+        uint32_t changeCount = data->memory->get_change_count();
 
-                break;
-            }
-
-            case PDEventType_SetMemory:
-            {
-                updateMemory(data, reader);
-                data->hasMemory = true;
-                break;
-            }
+        if (!data->upToDate || changeCount != data->changeCount) {
+            data->changeCount = changeCount;
+            data->upToDate = !!data->memory->read(0, 0xd000, data->regs, 0x30);
         }
     }
 
     showUI(data, uiFuncs);
 
-    if (data->requestMemory) {
-        PDWrite_event_begin(writer, PDEventType_GetMemory);
-        PDWrite_u64(writer, "address_start", 0xd000);
-        PDWrite_u64(writer, "size", 0x30);
-        PDWrite_event_end(writer);
-    }
-
     return 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// The registers are read from the memory cache so no events are needed
+
+static const uint16_t s_eventTypes[] =
+{
+    PDEventType_None,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 PDViewPlugin g_c64CustomViewPlugin =
 {
     "C64 VICE Custom Registers",
     createInstance,
     destroyInstance,
     update,
+    0,
+    0,
+    s_eventTypes,
 };
@@ -877,16 +877,41 @@ static void write_status_registers(PDWriter* writer, const char* name, uint16_t
     PDWrite_entry_end(writer);
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Writes back the request id (if any) of the Get* event being replied to
+
+static void write_request_id(PDReader* reader, PDWriter* writer) {
+    uint32_t request_id;
+
+    if (PDRead_find_u32(reader, &request_id, PD_REQUEST_ID, 0) != PDReadStatus_NotFound)
+        PDWrite_u32(writer, PD_REQUEST_ID, request_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void release_memory(void* user_data, void* data) {
+    (void)data;
+    free(user_data);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static void get_memory(PluginData* data, PDReader* reader, PDWriter* writer) {
     uint64_t address;
     uint64_t size;
+    uint64_t address_end;
     size_t read_size = 0;
 
     PDRead_find_u64(reader, &address, "address_start", 0);
     PDRead_find_u64(reader, &size, "size", 0);
 
+    // the C64 only has 64k so the end is clamped instead of wrapping around to 0 (which VICE would save nothing for)
+
+    address_end = address + size;
+
+    if (address_end > 0xffff)
+        address_end = 0xffff;
+
     // so this is a bit of a hack. If we request memory d000 we switch to io and then back
     // this isn't really correct but will do for now
 
@@ -894,7 +919,7 @@ static void get_memory(PluginData* data, PDReader* reader, PDWriter* writer) {
         send_command(data, "bank io\n");
 	}
 
-    uint8_t* memory = get_memory_internal(data, data->temp_file_full, &read_size, (uint16_t)(address), (uint16_t)(address + size));
+    uint8_t* memory = get_memory_internal(data, data->temp_file_full, &read_size, (uint16_t)(address), (uint16_t)(address_end));
 
     if (address == 0xdd00) {
         send_command(data, "bank ram\n");
@@ -908,13 +933,12 @@ static void get_memory(PluginData* data, PDReader* reader, PDWriter* writer) {
         log_debug("c64_vice: sending memory\n", "");
 
         PDWrite_event_begin(writer, PDEventType_SetMemory);
+        write_request_id(reader, writer);
         PDWrite_u64(writer, "address", address);
-        PDWrite_data(writer, "data", memory + 2, (uint32_t)(read_size - 3));
+        PDWrite_data_ref(writer, "data", memory + 2, (uint32_t)(read_size - 3), release_memory, memory);
         PDWrite_event_end(writer);
 
-        // writer takes a copy
-
-        free(memory);
+        // writer owns the memory now and will release it when it's done with it
     }
 }
 
@@ -1071,13 +1095,13 @@ bool parse_disassassembly_call(PluginData* plugin, const char* res, int len, PDR
     TEMP_BUFFER[len] = 0;
 
     (void)plugin;
-    (void)reader;
 
     // parse the buffer
 
     char* pch = strtok(TEMP_BUFFER, "\n");
 
     PDWrite_event_begin(writer, PDEventType_SetDisassembly);
+    write_request_id(reader, writer);
     PDWrite_array_begin(writer, "disassembly");
 
     bool hasAllDisasembly = false;
@@ -1251,7 +1275,6 @@ static bool parse_for_callstack(PluginData* data, const char* res, int length, P
     int callstack_count = 0;
 
     (void)data;
-    (void)reader;
 
     memcpy(TEMP_BUFFER, res, length);
     TEMP_BUFFER[length] = 0;
@@ -1280,6 +1303,7 @@ static bool parse_for_callstack(PluginData* data, const char* res, int length, P
         return false;
 
     PDWrite_event_begin(writer, PDEventType_SetCallstack);
+    write_request_id(reader, writer);
     PDWrite_array_begin(writer, "callstack");
 
     for (int i = 0; i < callstack_count; ++i) {
@@ -0,0 +1,73 @@
+#include "alloc_counter.h"
+#include <stddef.h>
+
+#if defined(__linux__) && defined(__GLIBC__)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The real ones in glibc
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static uint64_t s_count;
+static uint64_t s_bytes;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void addAllocation(size_t size) {
+    __atomic_fetch_add(&s_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s_bytes, (uint64_t)size, __ATOMIC_RELAXED);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void* malloc(size_t size) {
+    addAllocation(size);
+    return __libc_malloc(size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void* calloc(size_t count, size_t size) {
+    addAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void* realloc(void* ptr, size_t size) {
+    addAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int alloc_counter_is_supported(void) {
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void alloc_counter_get(AllocCounts* counts) {
+    counts->count = __atomic_load_n(&s_count, __ATOMIC_RELAXED);
+    counts->bytes = __atomic_load_n(&s_bytes, __ATOMIC_RELAXED);
+}
+
+#else
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int alloc_counter_is_supported(void) {
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void alloc_counter_get(AllocCounts* counts) {
+    counts->count = 0;
+    counts->bytes = 0;
+}
+
+#endif
+
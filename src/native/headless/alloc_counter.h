@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Counts the allocations made by the whole process (the host, the plugins and all threads.) Only supported on Linux
+// with glibc where malloc/calloc/realloc are replaced (the executable linking this overrides the ones in libc for
+// the plugins as well.) Elsewhere nothing is counted and alloc_counter_is_supported returns 0.
+
+typedef struct AllocCounts {
+    uint64_t count;
+    uint64_t bytes;
+} AllocCounts;
+
+int alloc_counter_is_supported(void);
+
+// Allocations (malloc, calloc and realloc) since the process started
+void alloc_counter_get(AllocCounts* counts);
+
+#ifdef __cplusplus
+}
+#endif
+
@@ -0,0 +1,1504 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pd_ui.h>
+#include "null_ui.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// PDUI that doesn't draw anything so views can be run without a window (see src/prodbg/headless.) Every call is
+// counted. Windows are always NullUI_DefaultWidth x NullUI_DefaultHeight (unless changed) and widgets are never
+// hovered, clicked or changed (apart from text set with null_ui_set_input_text.) Tree nodes, collapsing headers and
+// list boxes are open and everything is visible so views do all of their drawing. Popups and menus are closed.
+
+enum {
+    MaxInputTexts = 16,
+    MaxLabelLength = 64,
+    MaxTextLength = 256,
+    FuncCount = sizeof(PDUI) / sizeof(void*),
+};
+
+static const float FontWidth = 7.0f;
+static const float FontHeight = 13.0f;
+static const float ItemSpacing = 4.0f;
+
+struct InputText {
+    char label[MaxLabelLength];
+    char text[MaxTextLength];
+};
+
+static NullUICallCount s_calls[FuncCount];
+static uint64_t s_totalCalls;
+static int s_frameCount;
+static PDVec2 s_windowSize = { (float)NullUI_DefaultWidth, (float)NullUI_DefaultHeight };
+static InputText s_inputTexts[MaxInputTexts];
+static int s_inputTextCount;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline void countCall(size_t index, const char* name) {
+    s_calls[index].name = name;
+    s_calls[index].count++;
+    s_totalCalls++;
+}
+
+// Counts the call using the place of the function in PDUI
+
+#define COUNT(func) countCall(offsetof(PDUI, func) / sizeof(void*), #func)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDVec2 makeVec2(float x, float y) {
+    PDVec2 v = { x, y };
+    return v;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool takeInputText(const char* label, char* buf, size_t size) {
+    for (int i = 0; i < s_inputTextCount; ++i) {
+        if (strcmp(s_inputTexts[i].label, label) != 0)
+            continue;
+
+        if (size > 0) {
+            strncpy(buf, s_inputTexts[i].text, size - 1);
+            buf[size - 1] = 0;
+        }
+
+        s_inputTexts[i] = s_inputTexts[--s_inputTextCount];
+
+        return true;
+    }
+
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static intptr_t sc_send_command(void*, unsigned int, uintptr_t, intptr_t) {
+    return 0;
+}
+
+static void sc_update(void*) {
+}
+
+static void sc_draw(void*) {
+}
+
+static PDUISCInterface s_scInterface = { sc_send_command, sc_update, sc_draw, 0 };
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Window
+
+static void set_title(void*, const char*) {
+    COUNT(set_title);
+}
+
+static PDVec2 get_window_size() {
+    COUNT(get_window_size);
+    return s_windowSize;
+}
+
+static PDVec2 get_window_pos() {
+    COUNT(get_window_pos);
+    return makeVec2(0.0f, 0.0f);
+}
+
+static void begin_child(const char*, PDVec2, bool, int) {
+    COUNT(begin_child);
+}
+
+static void end_child() {
+    COUNT(end_child);
+}
+
+static float get_scroll_y() {
+    COUNT(get_scroll_y);
+    return 0.0f;
+}
+
+static float get_scroll_max_y() {
+    COUNT(get_scroll_max_y);
+    return 0.0f;
+}
+
+static void set_scroll_y(float) {
+    COUNT(set_scroll_y);
+}
+
+static void set_scroll_here(float) {
+    COUNT(set_scroll_here);
+}
+
+static void set_scroll_from_pos_y(float, float) {
+    COUNT(set_scroll_from_pos_y);
+}
+
+static void set_keyboard_focus_here(int) {
+    COUNT(set_keyboard_focus_here);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Parameters stacks (shared)
+
+static void push_font(PDUIFont) {
+    COUNT(push_font);
+}
+
+static void pop_font() {
+    COUNT(pop_font);
+}
+
+static void push_style_color(PDUICol, PDColor) {
+    COUNT(push_style_color);
+}
+
+static void pop_style_color(int) {
+    COUNT(pop_style_color);
+}
+
+static void push_style_var(PDUIStyleVar, float) {
+    COUNT(push_style_var);
+}
+
+static void push_style_varVec(PDUIStyleVar, PDVec2) {
+    COUNT(push_style_varVec);
+}
+
+static void pop_style_var(int) {
+    COUNT(pop_style_var);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Parameters stacks (current window)
+
+static void push_item_width(float) {
+    COUNT(push_item_width);
+}
+
+static void pop_item_width() {
+    COUNT(pop_item_width);
+}
+
+static float calc_item_width() {
+    COUNT(calc_item_width);
+    return s_windowSize.x * 0.65f;
+}
+
+static void push_allow_keyboard_focus(bool) {
+    COUNT(push_allow_keyboard_focus);
+}
+
+static void pop_allow_keyboard_focus() {
+    COUNT(pop_allow_keyboard_focus);
+}
+
+static void push_text_wrap_pos(float) {
+    COUNT(push_text_wrap_pos);
+}
+
+static void pop_text_wrap_pos() {
+    COUNT(pop_text_wrap_pos);
+}
+
+static void push_button_repeat(bool) {
+    COUNT(push_button_repeat);
+}
+
+static void pop_button_repeat() {
+    COUNT(pop_button_repeat);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Layout
+
+static void begin_group() {
+    COUNT(begin_group);
+}
+
+static void end_group() {
+    COUNT(end_group);
+}
+
+static void separator() {
+    COUNT(separator);
+}
+
+static void same_line(int, int) {
+    COUNT(same_line);
+}
+
+static void spacing() {
+    COUNT(spacing);
+}
+
+static void dummy(PDVec2) {
+    COUNT(dummy);
+}
+
+static void indent() {
+    COUNT(indent);
+}
+
+static void un_indent() {
+    COUNT(un_indent);
+}
+
+static void columns(int, const char*, bool) {
+    COUNT(columns);
+}
+
+static void next_column() {
+    COUNT(next_column);
+}
+
+static int get_column_index() {
+    COUNT(get_column_index);
+    return 0;
+}
+
+static float get_column_offset(int) {
+    COUNT(get_column_offset);
+    return 0.0f;
+}
+
+static void set_column_offset(int, float) {
+    COUNT(set_column_offset);
+}
+
+static float get_column_width(int) {
+    COUNT(get_column_width);
+    return s_windowSize.x;
+}
+
+static int get_columns_count() {
+    COUNT(get_columns_count);
+    return 1;
+}
+
+static PDVec2 get_cursor_pos() {
+    COUNT(get_cursor_pos);
+    return makeVec2(0.0f, 0.0f);
+}
+
+static float get_cursor_pos_x() {
+    COUNT(get_cursor_pos_x);
+    return 0.0f;
+}
+
+static float get_cursor_pos_y() {
+    COUNT(get_cursor_pos_y);
+    return 0.0f;
+}
+
+static void set_cursor_pos(PDVec2) {
+    COUNT(set_cursor_pos);
+}
+
+static void set_cursor_pos_x(float) {
+    COUNT(set_cursor_pos_x);
+}
+
+static void set_cursor_pos_y(float) {
+    COUNT(set_cursor_pos_y);
+}
+
+static PDVec2 get_cursor_screen_pos() {
+    COUNT(get_cursor_screen_pos);
+    return makeVec2(0.0f, 0.0f);
+}
+
+static void set_cursor_screen_pos(PDVec2) {
+    COUNT(set_cursor_screen_pos);
+}
+
+static void align_first_text_height_to_widgets() {
+    COUNT(align_first_text_height_to_widgets);
+}
+
+static float get_text_line_height() {
+    COUNT(get_text_line_height);
+    return FontHeight;
+}
+
+static float get_text_line_height_with_spacing() {
+    COUNT(get_text_line_height_with_spacing);
+    return FontHeight + ItemSpacing;
+}
+
+static float get_items_line_height_with_spacing() {
+    COUNT(get_items_line_height_with_spacing);
+    return FontHeight + ItemSpacing;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ID scopes
+
+static void push_id_str(const char*) {
+    COUNT(push_id_str);
+}
+
+static void push_id_str_range(const char*, const char*) {
+    COUNT(push_id_str_range);
+}
+
+static void push_id_ptr(const void*) {
+    COUNT(push_id_ptr);
+}
+
+static void push_id_int(const int) {
+    COUNT(push_id_int);
+}
+
+static void pop_id() {
+    COUNT(pop_id);
+}
+
+static PDID get_id_str(const char*) {
+    COUNT(get_id_str);
+    return 0;
+}
+
+static PDID get_id_str_range(const char*, const char*) {
+    COUNT(get_id_str_range);
+    return 0;
+}
+
+static PDID get_id_ptr(const void*) {
+    COUNT(get_id_ptr);
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Widgets
+
+static void text(const char*, ...) {
+    COUNT(text);
+}
+
+static void text_v(const char*, va_list) {
+    COUNT(text_v);
+}
+
+static void text_colored(const PDColor, const char*, ...) {
+    COUNT(text_colored);
+}
+
+static void text_colored_v(const PDColor, const char*, va_list) {
+    COUNT(text_colored_v);
+}
+
+static void text_disabled(const char*, ...) {
+    COUNT(text_disabled);
+}
+
+static void text_disabled_v(const char*, va_list) {
+    COUNT(text_disabled_v);
+}
+
+static void text_wrapped(const char*, ...) {
+    COUNT(text_wrapped);
+}
+
+static void text_wrapped_v(const char*, va_list) {
+    COUNT(text_wrapped_v);
+}
+
+static void text_unformatted(const char*, const char*) {
+    COUNT(text_unformatted);
+}
+
+static void label_text(const char*, const char*, ...) {
+    COUNT(label_text);
+}
+
+static void label_text_v(const char*, const char*, va_list) {
+    COUNT(label_text_v);
+}
+
+static void bullet() {
+    COUNT(bullet);
+}
+
+static void bullet_text(const char*, ...) {
+    COUNT(bullet_text);
+}
+
+static void bullet_text_v(const char*, va_list) {
+    COUNT(bullet_text_v);
+}
+
+static bool button(const char*, const PDVec2) {
+    COUNT(button);
+    return false;
+}
+
+static bool small_button(const char*) {
+    COUNT(small_button);
+    return false;
+}
+
+static bool invisible_button(const char*, const PDVec2) {
+    COUNT(invisible_button);
+    return false;
+}
+
+static void image(PDUITextureID, const PDVec2, const PDVec2, const PDVec2, const PDColor, const PDColor) {
+    COUNT(image);
+}
+
+static bool image_button(PDUITextureID, const PDVec2, const PDVec2, const PDVec2, int, const PDColor, const PDColor) {
+    COUNT(image_button);
+    return false;
+}
+
+static bool collapsing_header(const char*, const char*, bool, bool) {
+    COUNT(collapsing_header);
+    return true;
+}
+
+static bool checkbox(const char*, bool*) {
+    COUNT(checkbox);
+    return false;
+}
+
+static bool checkbox_flags(const char*, unsigned int*, unsigned int) {
+    COUNT(checkbox_flags);
+    return false;
+}
+
+static bool radio_buttonBool(const char*, bool) {
+    COUNT(radio_buttonBool);
+    return false;
+}
+
+static bool radio_button(const char*, int*, int) {
+    COUNT(radio_button);
+    return false;
+}
+
+static bool combo(const char*, int*, const char**, int, int) {
+    COUNT(combo);
+    return false;
+}
+
+static bool combo2(const char*, int*, const char*, int) {
+    COUNT(combo2);
+    return false;
+}
+
+static bool combo3(const char*, int*, bool (*)(void*, int, const char**), void*, int, int) {
+    COUNT(combo3);
+    return false;
+}
+
+static bool color_button(const PDColor, bool, bool) {
+    COUNT(color_button);
+    return false;
+}
+
+static bool color_edit3(const char*, float[3]) {
+    COUNT(color_edit3);
+    return false;
+}
+
+static bool color_edit4(const char*, float[4], bool) {
+    COUNT(color_edit4);
+    return false;
+}
+
+static void color_edit_mode(PDUIColorEditMode) {
+    COUNT(color_edit_mode);
+}
+
+static void plot_lines(const char*, const float*, int, int, const char*, float, float, PDVec2, size_t) {
+    COUNT(plot_lines);
+}
+
+static void plot_lines2(const char*, float (*)(void*, int), void*, int, int, const char*, float, float, PDVec2) {
+    COUNT(plot_lines2);
+}
+
+static void plot_histogram(const char*, const float*, int, int, const char*, float, float, PDVec2, size_t) {
+    COUNT(plot_histogram);
+}
+
+static void plot_histogram2(const char*, float (*)(void*, int), void*, int, int, const char*, float, float, PDVec2) {
+    COUNT(plot_histogram2);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Widgets: Scintilla text interface
+
+static PDUISCInterface* sc_input_text(const char*, float, float, void (*)(void*), void*) {
+    COUNT(sc_input_text);
+    return &s_scInterface;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Widgets: Sliders
+
+static bool slider_float(const char*, float*, float, float, const char*, float) {
+    COUNT(slider_float);
+    return false;
+}
+
+static bool slider_float2(const char*, float[2], float, float, const char*, float) {
+    COUNT(slider_float2);
+    return false;
+}
+
+static bool slider_float3(const char*, float[3], float, float, const char*, float) {
+    COUNT(slider_float3);
+    return false;
+}
+
+static bool slider_float4(const char*, float[4], float, float, const char*, float) {
+    COUNT(slider_float4);
+    return false;
+}
+
+static bool slider_angle(const char*, float*, float, float) {
+    COUNT(slider_angle);
+    return false;
+}
+
+static bool slider_int(const char*, int*, int, int, const char*) {
+    COUNT(slider_int);
+    return false;
+}
+
+static bool slider_int2(const char*, int[2], int, int, const char*) {
+    COUNT(slider_int2);
+    return false;
+}
+
+static bool slider_int3(const char*, int[3], int, int, const char*) {
+    COUNT(slider_int3);
+    return false;
+}
+
+static bool slider_int4(const char*, int[4], int, int, const char*) {
+    COUNT(slider_int4);
+    return false;
+}
+
+static bool vslider_float(const char*, const PDVec2, float*, float, float, const char*, float) {
+    COUNT(vslider_float);
+    return false;
+}
+
+static bool vslider_int(const char*, const PDVec2, int*, int, int, const char*) {
+    COUNT(vslider_int);
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Widgets: Drags
+
+static bool drag_float(const char*, float*, float, float, float, const char*, float) {
+    COUNT(drag_float);
+    return false;
+}
+
+static bool drag_float2(const char*, float[2], float, float, float, const char*, float) {
+    COUNT(drag_float2);
+    return false;
+}
+
+static bool drag_float3(const char*, float[3], float, float, float, const char*, float) {
+    COUNT(drag_float3);
+    return false;
+}
+
+static bool drag_float4(const char*, float[4], float, float, float, const char*, float) {
+    COUNT(drag_float4);
+    return false;
+}
+
+static bool drag_int(const char*, int*, float, int, int, const char*) {
+    COUNT(drag_int);
+    return false;
+}
+
+static bool drag_int2(const char*, int[2], float, int, int, const char*) {
+    COUNT(drag_int2);
+    return false;
+}
+
+static bool drag_int3(const char*, int[3], float, int, int, const char*) {
+    COUNT(drag_int3);
+    return false;
+}
+
+static bool drag_int4(const char*, int[4], float, int, int, const char*) {
+    COUNT(drag_int4);
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Widgets: Input
+
+static bool input_text(const char* label, char* buf, int buf_size, int, void (*)(PDUIInputTextCallbackData*), void*) {
+    COUNT(input_text);
+    return takeInputText(label, buf, (size_t)buf_size);
+}
+
+static bool input_text_multiline(const char* label, char* buf, size_t buf_size, const PDVec2, PDUIInputTextFlags,
+                                 void (*)(PDUIInputTextCallbackData*), void*) {
+    COUNT(input_text_multiline);
+    return takeInputText(label, buf, buf_size);
+}
+
+static bool input_float(const char*, float*, float, float, int, PDUIInputTextFlags) {
+    COUNT(input_float);
+    return false;
+}
+
+static bool input_float2(const char*, float[2], int, PDUIInputTextFlags) {
+    COUNT(input_float2);
+    return false;
+}
+
+static bool input_float3(const char*, float[3], int, PDUIInputTextFlags) {
+    COUNT(input_float3);
+    return false;
+}
+
+static bool input_float4(const char*, float[4], int, PDUIInputTextFlags) {
+    COUNT(input_float4);
+    return false;
+}
+
+static bool input_int(const char*, int*, int, int, PDUIInputTextFlags) {
+    COUNT(input_int);
+    return false;
+}
+
+static bool input_int2(const char*, int[2], PDUIInputTextFlags) {
+    COUNT(input_int2);
+    return false;
+}
+
+static bool input_int3(const char*, int[3], PDUIInputTextFlags) {
+    COUNT(input_int3);
+    return false;
+}
+
+static bool input_int4(const char*, int[4], PDUIInputTextFlags) {
+    COUNT(input_int4);
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Widgets: Trees
+
+static bool tree_node(const char*) {
+    COUNT(tree_node);
+    return true;
+}
+
+static bool tree_node_str(const char*, const char*, ...) {
+    COUNT(tree_node_str);
+    return true;
+}
+
+static bool tree_node_ptr(const void*, const char*, ...) {
+    COUNT(tree_node_ptr);
+    return true;
+}
+
+static bool tree_node_str_v(const char*, const char*, va_list) {
+    COUNT(tree_node_str_v);
+    return true;
+}
+
+static bool tree_node_ptr_v(const void*, const char*, va_list) {
+    COUNT(tree_node_ptr_v);
+    return true;
+}
+
+static void tree_push_str(const char*) {
+    COUNT(tree_push_str);
+}
+
+static void tree_push_ptr(const void*) {
+    COUNT(tree_push_ptr);
+}
+
+static void tree_pop() {
+    COUNT(tree_pop);
+}
+
+static void set_next_tree_node_opened(bool, PDUISetCond) {
+    COUNT(set_next_tree_node_opened);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Widgets: Selectable / Lists
+
+static bool selectable(const char*, bool, PDUISelectableFlags, const PDVec2) {
+    COUNT(selectable);
+    return false;
+}
+
+static bool selectable_ex(const char*, bool*, PDUISelectableFlags, const PDVec2) {
+    COUNT(selectable_ex);
+    return false;
+}
+
+static bool list_box(const char*, int*, const char**, int, int) {
+    COUNT(list_box);
+    return false;
+}
+
+static bool list_box2(const char*, int*, bool (*)(void*, int, const char**), void*, int, int) {
+    COUNT(list_box2);
+    return false;
+}
+
+static bool list_box_header(const char*, const PDVec2) {
+    COUNT(list_box_header);
+    return true;
+}
+
+static bool list_box_header2(const char*, int, int) {
+    COUNT(list_box_header2);
+    return true;
+}
+
+static void list_box_footer() {
+    COUNT(list_box_footer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tooltip
+
+static void set_tooltip(const char*, ...) {
+    COUNT(set_tooltip);
+}
+
+static void set_tooltip_v(const char*, va_list) {
+    COUNT(set_tooltip_v);
+}
+
+static void begin_tooltip() {
+    COUNT(begin_tooltip);
+}
+
+static void end_tooltip() {
+    COUNT(end_tooltip);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Widgets: Menus
+
+static bool begin_main_menu_bar() {
+    COUNT(begin_main_menu_bar);
+    return false;
+}
+
+static void end_main_menu_bar() {
+    COUNT(end_main_menu_bar);
+}
+
+static bool begin_menuBar() {
+    COUNT(begin_menuBar);
+    return false;
+}
+
+static void end_menu_bar() {
+    COUNT(end_menu_bar);
+}
+
+static bool begin_menu(const char*, bool) {
+    COUNT(begin_menu);
+    return false;
+}
+
+static void end_menu() {
+    COUNT(end_menu);
+}
+
+static bool menu_item(const char*, const char*, bool, bool) {
+    COUNT(menu_item);
+    return false;
+}
+
+static bool menu_itemPtr(const char*, const char*, bool*, bool) {
+    COUNT(menu_itemPtr);
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Popup
+
+static void open_popup(const char*) {
+    COUNT(open_popup);
+}
+
+static bool begin_popup(const char*) {
+    COUNT(begin_popup);
+    return false;
+}
+
+static bool begin_popup_modal(const char*, bool*, PDUIWindowFlags) {
+    COUNT(begin_popup_modal);
+    return false;
+}
+
+static bool begin_popup_context_item(const char*, int) {
+    COUNT(begin_popup_context_item);
+    return false;
+}
+
+static bool begin_popup_context_window(bool, const char*, int) {
+    COUNT(begin_popup_context_window);
+    return false;
+}
+
+static bool begin_popupContext_void(const char*, int) {
+    COUNT(begin_popupContext_void);
+    return false;
+}
+
+static void end_popup() {
+    COUNT(end_popup);
+}
+
+static void close_current_popup() {
+    COUNT(close_current_popup);
+}
+
+static bool begin_popup_context(void*) {
+    COUNT(begin_popup_context);
+    return false;
+}
+
+static void end_popup_context(void*) {
+    COUNT(end_popup_context);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Widgets: value() helpers
+
+static void value_bool(const char*, bool) {
+    COUNT(value_bool);
+}
+
+static void value_int(const char*, int) {
+    COUNT(value_int);
+}
+
+static void value_u_int(const char*, unsigned int) {
+    COUNT(value_u_int);
+}
+
+static void value_float(const char*, float, const char*) {
+    COUNT(value_float);
+}
+
+static void color(const char*, const PDColor) {
+    COUNT(color);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Logging
+
+static void log_to_tty(int) {
+    COUNT(log_to_tty);
+}
+
+static void log_to_file(int, const char*) {
+    COUNT(log_to_file);
+}
+
+static void log_to_clipboard(int) {
+    COUNT(log_to_clipboard);
+}
+
+static void log_finish() {
+    COUNT(log_finish);
+}
+
+static void log_buttons() {
+    COUNT(log_buttons);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Utilities
+
+static bool is_item_hovered() {
+    COUNT(is_item_hovered);
+    return false;
+}
+
+static bool is_item_hovered_rect() {
+    COUNT(is_item_hovered_rect);
+    return false;
+}
+
+static bool is_item_active() {
+    COUNT(is_item_active);
+    return false;
+}
+
+static bool is_item_visible() {
+    COUNT(is_item_visible);
+    return true;
+}
+
+static bool is_any_item_hovered() {
+    COUNT(is_any_item_hovered);
+    return false;
+}
+
+static bool is_any_item_active() {
+    COUNT(is_any_item_active);
+    return false;
+}
+
+static PDVec2 get_item_rect_min() {
+    COUNT(get_item_rect_min);
+    return makeVec2(0.0f, 0.0f);
+}
+
+static PDVec2 get_item_rect_max() {
+    COUNT(get_item_rect_max);
+    return makeVec2(0.0f, 0.0f);
+}
+
+static PDVec2 get_item_rect_size() {
+    COUNT(get_item_rect_size);
+    return makeVec2(0.0f, 0.0f);
+}
+
+static bool is_window_hovered() {
+    COUNT(is_window_hovered);
+    return false;
+}
+
+static bool is_window_focused() {
+    COUNT(is_window_focused);
+    return false;
+}
+
+static bool is_root_window_focused() {
+    COUNT(is_root_window_focused);
+    return false;
+}
+
+static bool is_root_window_or_any_child_focused() {
+    COUNT(is_root_window_or_any_child_focused);
+    return false;
+}
+
+static bool is_rect_visible(const PDVec2) {
+    COUNT(is_rect_visible);
+    return true;
+}
+
+static bool is_pos_hovering_any_window(const PDVec2) {
+    COUNT(is_pos_hovering_any_window);
+    return false;
+}
+
+static float get_time() {
+    COUNT(get_time);
+    return (float)s_frameCount / 60.0f;
+}
+
+static int get_frame_count() {
+    COUNT(get_frame_count);
+    return s_frameCount;
+}
+
+static const char* get_style_col_name(PDUICol) {
+    COUNT(get_style_col_name);
+    return "";
+}
+
+static PDVec2 calc_item_rect_closest_point(const PDVec2, bool, float) {
+    COUNT(calc_item_rect_closest_point);
+    return makeVec2(0.0f, 0.0f);
+}
+
+static PDVec2 calc_text_size(const char* text, const char* text_end, bool, float) {
+    size_t length = text_end ? (size_t)(text_end - text) : strlen(text);
+
+    COUNT(calc_text_size);
+
+    return makeVec2((float)length * FontWidth, FontHeight);
+}
+
+static void calc_list_clipping(int items_count, float items_height, int* out_items_display_start, int* out_items_display_end) {
+    int visible = items_height > 0.0f ? (int)(s_windowSize.y / items_height) + 1 : items_count;
+
+    COUNT(calc_list_clipping);
+
+    *out_items_display_start = 0;
+    *out_items_display_end = visible < items_count ? visible : items_count;
+}
+
+static bool begin_childFrame(PDID, const struct PDVec2) {
+    COUNT(begin_childFrame);
+    return true;
+}
+
+static void end_child_frame() {
+    COUNT(end_child_frame);
+}
+
+static void color_convert_rg_bto_hsv(float, float, float, float* out_h, float* out_s, float* out_v) {
+    COUNT(color_convert_rg_bto_hsv);
+    *out_h = *out_s = *out_v = 0.0f;
+}
+
+static void color_convert_hs_vto_rgb(float, float, float, float* out_r, float* out_g, float* out_b) {
+    COUNT(color_convert_hs_vto_rgb);
+    *out_r = *out_g = *out_b = 0.0f;
+}
+
+static bool is_key_down(int) {
+    COUNT(is_key_down);
+    return false;
+}
+
+static bool is_key_pressed(int, bool) {
+    COUNT(is_key_pressed);
+    return false;
+}
+
+static bool is_key_released(int) {
+    COUNT(is_key_released);
+    return false;
+}
+
+static bool is_key_down_id(uint32_t, int) {
+    COUNT(is_key_down_id);
+    return false;
+}
+
+static bool is_mouse_down(int) {
+    COUNT(is_mouse_down);
+    return false;
+}
+
+static bool is_mouse_clicked(int, bool) {
+    COUNT(is_mouse_clicked);
+    return false;
+}
+
+static bool is_mouse_double_clicked(int) {
+    COUNT(is_mouse_double_clicked);
+    return false;
+}
+
+static bool is_mouse_released(int) {
+    COUNT(is_mouse_released);
+    return false;
+}
+
+static bool is_mouse_hovering_window() {
+    COUNT(is_mouse_hovering_window);
+    return false;
+}
+
+static bool is_mouse_hovering_any_window() {
+    COUNT(is_mouse_hovering_any_window);
+    return false;
+}
+
+static bool is_mouse_hovering_rect(const PDVec2, const PDVec2) {
+    COUNT(is_mouse_hovering_rect);
+    return false;
+}
+
+static bool is_mouse_dragging(int, float) {
+    COUNT(is_mouse_dragging);
+    return false;
+}
+
+static PDVec2 get_mouse_pos() {
+    COUNT(get_mouse_pos);
+    return makeVec2(0.0f, 0.0f);
+}
+
+static PDVec2 get_mouse_drag_delta(int, float) {
+    COUNT(get_mouse_drag_delta);
+    return makeVec2(0.0f, 0.0f);
+}
+
+static void reset_mouse_drag_delta(int) {
+    COUNT(reset_mouse_drag_delta);
+}
+
+static PDUIMouseCursor get_mouse_cursor() {
+    COUNT(get_mouse_cursor);
+    return PDUIMouseCursor_Arrow;
+}
+
+static void set_mouse_cursor(PDUIMouseCursor) {
+    COUNT(set_mouse_cursor);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rendering
+
+static void fill_rect(PDRect, unsigned int) {
+    COUNT(fill_rect);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDUI s_uiFuncs[] =
+{
+    0,
+
+    // Window
+
+    set_title,
+    get_window_size,
+    get_window_pos,
+    begin_child,
+    end_child,
+    get_scroll_y,
+    get_scroll_max_y,
+    set_scroll_y,
+    set_scroll_here,
+    set_scroll_from_pos_y,
+    set_keyboard_focus_here,
+
+    // Parameters stacks (shared)
+
+    push_font,
+    pop_font,
+    push_style_color,
+    pop_style_color,
+    push_style_var,
+    push_style_varVec,
+    pop_style_var,
+
+    // Parameters stacks (current window)
+
+    push_item_width,
+    pop_item_width,
+    calc_item_width,
+    push_allow_keyboard_focus,
+    pop_allow_keyboard_focus,
+    push_text_wrap_pos,
+    pop_text_wrap_pos,
+    push_button_repeat,
+    pop_button_repeat,
+
+    // Layout
+
+    begin_group,
+    end_group,
+    separator,
+    same_line,
+    spacing,
+    dummy,
+    indent,
+    un_indent,
+    columns,
+    next_column,
+    get_column_index,
+    get_column_offset,
+    set_column_offset,
+    get_column_width,
+    get_columns_count,
+    get_cursor_pos,
+    get_cursor_pos_x,
+    get_cursor_pos_y,
+    set_cursor_pos,
+    set_cursor_pos_x,
+    set_cursor_pos_y,
+    get_cursor_screen_pos,
+    set_cursor_screen_pos,
+    align_first_text_height_to_widgets,
+    get_text_line_height,
+    get_text_line_height_with_spacing,
+    get_items_line_height_with_spacing,
+
+    // ID scopes
+
+    push_id_str,
+    push_id_str_range,
+    push_id_ptr,
+    push_id_int,
+    pop_id,
+    get_id_str,
+    get_id_str_range,
+    get_id_ptr,
+
+    // Widgets
+
+    text,
+    text_v,
+    text_colored,
+    text_colored_v,
+    text_disabled,
+    text_disabled_v,
+    text_wrapped,
+    text_wrapped_v,
+    text_unformatted,
+    label_text,
+    label_text_v,
+    bullet,
+    bullet_text,
+    bullet_text_v,
+    button,
+    small_button,
+    invisible_button,
+    image,
+    image_button,
+    collapsing_header,
+    checkbox,
+    checkbox_flags,
+    radio_buttonBool,
+    radio_button,
+    combo,
+    combo2,
+    combo3,
+    color_button,
+    color_edit3,
+    color_edit4,
+    color_edit_mode,
+    plot_lines,
+    plot_lines2,
+    plot_histogram,
+    plot_histogram2,
+
+    // Widgets: Scintilla text interface
+
+    sc_input_text,
+
+    // Widgets: Sliders
+
+    slider_float,
+    slider_float2,
+    slider_float3,
+    slider_float4,
+    slider_angle,
+    slider_int,
+    slider_int2,
+    slider_int3,
+    slider_int4,
+    vslider_float,
+    vslider_int,
+
+    // Widgets: Drags
+
+    drag_float,
+    drag_float2,
+    drag_float3,
+    drag_float4,
+    drag_int,
+    drag_int2,
+    drag_int3,
+    drag_int4,
+
+    // Widgets: Input
+
+    input_text,
+    input_text_multiline,
+    input_float,
+    input_float2,
+    input_float3,
+    input_float4,
+    input_int,
+    input_int2,
+    input_int3,
+    input_int4,
+
+    // Widgets: Trees
+
+    tree_node,
+    tree_node_str,
+    tree_node_ptr,
+    tree_node_str_v,
+    tree_node_ptr_v,
+    tree_push_str,
+    tree_push_ptr,
+    tree_pop,
+    set_next_tree_node_opened,
+
+    // Widgets: Selectable / Lists
+
+    selectable,
+    selectable_ex,
+    list_box,
+    list_box2,
+    list_box_header,
+    list_box_header2,
+    list_box_footer,
+
+    // Tooltip
+
+    set_tooltip,
+    set_tooltip_v,
+    begin_tooltip,
+    end_tooltip,
+
+    // Widgets: Menus
+
+    begin_main_menu_bar,
+    end_main_menu_bar,
+    begin_menuBar,
+    end_menu_bar,
+    begin_menu,
+    end_menu,
+    menu_item,
+    menu_itemPtr,
+
+    // Popup
+
+    open_popup,
+    begin_popup,
+    begin_popup_modal,
+    begin_popup_context_item,
+    begin_popup_context_window,
+    begin_popupContext_void,
+    end_popup,
+    close_current_popup,
+    begin_popup_context,
+    end_popup_context,
+
+    // Widgets: value() helpers
+
+    value_bool,
+    value_int,
+    value_u_int,
+    value_float,
+    color,
+
+    // Logging
+
+    log_to_tty,
+    log_to_file,
+    log_to_clipboard,
+    log_finish,
+    log_buttons,
+
+    // Utilities
+
+    is_item_hovered,
+    is_item_hovered_rect,
+    is_item_active,
+    is_item_visible,
+    is_any_item_hovered,
+    is_any_item_active,
+    get_item_rect_min,
+    get_item_rect_max,
+    get_item_rect_size,
+    is_window_hovered,
+    is_window_focused,
+    is_root_window_focused,
+    is_root_window_or_any_child_focused,
+    is_rect_visible,
+    is_pos_hovering_any_window,
+    get_time,
+    get_frame_count,
+    get_style_col_name,
+    calc_item_rect_closest_point,
+    calc_text_size,
+    calc_list_clipping,
+    begin_childFrame,
+    end_child_frame,
+    color_convert_rg_bto_hsv,
+    color_convert_hs_vto_rgb,
+    is_key_down,
+    is_key_pressed,
+    is_key_released,
+    is_key_down_id,
+    is_mouse_down,
+    is_mouse_clicked,
+    is_mouse_double_clicked,
+    is_mouse_released,
+    is_mouse_hovering_window,
+    is_mouse_hovering_any_window,
+    is_mouse_hovering_rect,
+    is_mouse_dragging,
+    get_mouse_pos,
+    get_mouse_drag_delta,
+    reset_mouse_drag_delta,
+    get_mouse_cursor,
+    set_mouse_cursor,
+
+    // Rendering
+
+    fill_rect,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+extern "C" void* null_ui_create() {
+    PDUI* ui = (PDUI*)malloc(sizeof(PDUI));
+    *ui = *s_uiFuncs;
+    return ui;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+extern "C" void null_ui_destroy(void* ui) {
+    free(ui);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+extern "C" void null_ui_begin_frame() {
+    s_frameCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+extern "C" void null_ui_set_window_size(float width, float height) {
+    s_windowSize = makeVec2(width, height);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+extern "C" int null_ui_set_input_text(const char* label, const char* text) {
+    InputText* input;
+
+    if (s_inputTextCount == MaxInputTexts)
+        return 0;
+
+    input = &s_inputTexts[s_inputTextCount++];
+
+    strncpy(input->label, label, MaxLabelLength - 1);
+    input->label[MaxLabelLength - 1] = 0;
+    strncpy(input->text, text, MaxTextLength - 1);
+    input->text[MaxTextLength - 1] = 0;
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+extern "C" uint64_t null_ui_get_total_calls() {
+    return s_totalCalls;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+extern "C" int null_ui_get_calls(NullUICallCount* calls, int max_count) {
+    int count = 0;
+
+    for (int i = 0; i < FuncCount && count < max_count; ++i) {
+        if (s_calls[i].count != 0)
+            calls[count++] = s_calls[i];
+    }
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+extern "C" void null_ui_reset_calls() {
+    for (int i = 0; i < FuncCount; ++i)
+        s_calls[i].count = 0;
+
+    s_totalCalls = 0;
+}
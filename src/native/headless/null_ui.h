@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// PDUI implementation that doesn't draw anything. Used to run views without a window (see src/prodbg/headless) and
+// counts the calls made to it so the cost of a view can be tracked. Only to be used from one thread.
+
+enum {
+    NullUI_DefaultWidth = 800,
+    NullUI_DefaultHeight = 600,
+};
+
+typedef struct NullUICallCount {
+    const char* name;
+    uint64_t count;
+} NullUICallCount;
+
+// Returns a PDUI (freed with null_ui_destroy)
+void* null_ui_create(void);
+void null_ui_destroy(void* ui);
+
+// Advances the frame count views gets from get_frame_count/get_time
+void null_ui_begin_frame(void);
+
+// Size returned by get_window_size for all views
+void null_ui_set_window_size(float width, float height);
+
+// The next input_text with the label is changed to text (as if the user typed it.) Returns 0 if there are too many
+// texts waiting
+int null_ui_set_input_text(const char* label, const char* text);
+
+// Calls made since the last reset
+uint64_t null_ui_get_total_calls(void);
+
+// Fills calls with the functions that has been called since the last reset (in the order of PDUI) and returns the
+// number written
+int null_ui_get_calls(NullUICallCount* calls, int max_count);
+
+void null_ui_reset_calls(void);
+
+#ifdef __cplusplus
+}
+#endif
+
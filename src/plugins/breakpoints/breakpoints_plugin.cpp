@@ -285,12 +285,24 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter*
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static const uint16_t s_eventTypes[] =
+{
+    PDEventType_SetBreakpoint,
+    PDEventType_ReplyBreakpoint,
+    PDEventType_None,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static PDViewPlugin plugin =
 {
     "Breakpoint View",
     createInstance,
     destroyInstance,
     update,
+    0,
+    0,
+    s_eventTypes,
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
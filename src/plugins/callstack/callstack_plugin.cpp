@@ -24,6 +24,7 @@ struct CallstackData {
     uint32_t selectedFrame;
     bool request;
     bool setSelectedFrame;
+    PDStateTracker state;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -38,6 +39,7 @@ static void* createInstance(PDUI* uiFuncs, ServiceFunc* serviceFunc) {
     user_data->location = 0;
     user_data->request = false;
     user_data->selectedFrame = 0;
+    memset(&user_data->state, 0, sizeof(user_data->state));
 
     (void)uiFuncs;
     (void)serviceFunc;
@@ -243,6 +245,16 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* reader, PDWriter* wr
                     data->line = (int)line;
                     data->request = true;
                 }
+
+                break;
+            }
+
+            case PDEventType_StateChanged:
+            {
+                if (PDStateTracker_update(&data->state, reader) & PDStateChange_Callstack)
+                    data->request = true;
+
+                break;
             }
         }
     }
@@ -265,12 +277,26 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* reader, PDWriter* wr
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static const uint16_t s_eventTypes[] =
+{
+    PDEventType_SetCallstack,
+    PDEventType_SelectFrame,
+    PDEventType_SetExceptionLocation,
+    PDEventType_StateChanged,
+    PDEventType_None,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static PDViewPlugin plugin =
 {
     "CallStack",
     createInstance,
     destroyInstance,
     update,
+    0,
+    0,
+    s_eventTypes,
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
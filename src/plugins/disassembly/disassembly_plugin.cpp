@@ -268,12 +268,25 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter*
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static const uint16_t s_eventTypes[] =
+{
+    PDEventType_SetDisassembly,
+    PDEventType_SetExceptionLocation,
+    PDEventType_SetRegisters,
+    PDEventType_None,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static PDViewPlugin plugin =
 {
     "Disassembly",
     createInstance,
     destroyInstance,
     update,
+    0,
+    0,
+    s_eventTypes,
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -7,7 +7,7 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 typedef struct DummyPlugin {
-	int dummy;
+	uint32_t epoch;
 
 } DummyPlugin;
 
@@ -66,16 +66,33 @@ static void send_6502_registers(PDWriter* writer) {
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// The state of the dummy never changes so it's only published once and the registers are only sent when asked for
+
+static void send_state_changed(DummyPlugin* plugin, PDWriter* writer) {
+	PDWrite_event_begin(writer, PDEventType_StateChanged);
+	PDWrite_u32(writer, PD_STATE_EPOCH, ++plugin->epoch);
+	PDWrite_u32(writer, PD_STATE_CHANGED, PDStateChange_All);
+	PDWrite_event_end(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static PDDebugState update(void* user_data,
 						   PDAction action,
 						   PDReader* reader,
 						   PDWriter* writer) {
-	(void)user_data;
+	uint32_t event;
+	DummyPlugin* plugin = (DummyPlugin*)user_data;
+
     (void)action;
-    (void)reader;
-    (void)writer;
 
-	send_6502_registers(writer);
+	if (plugin->epoch == 0)
+		send_state_changed(plugin, writer);
+
+	while ((event = PDRead_get_event(reader))) {
+		if (event == PDEventType_GetRegisters)
+			send_6502_registers(writer);
+	}
 
     // printf("Update backend\n");
 
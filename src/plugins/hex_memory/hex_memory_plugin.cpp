@@ -1,49 +1,72 @@
 #include "pd_view.h"
 #include "pd_backend.h"
+#include "pd_host.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The memory is read from the memory cache of the session (see PDMemoryCacheFuncs) which requests the pages that are
+// missing so several views showing the same memory only fetches it once. The memory after the range is read as well
+// so scrolling forward usually doesn't need to wait for the backend
+
+enum {
+    PrefetchSize = 4096,
+    MaxRangeSize = 1024 * 1024,
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct HexMemoryData {
-    unsigned char* data;
-    unsigned char* oldData;
-    int dataSize;
+    PDMemoryCacheFuncs* memory;
+    unsigned char* data;        // memory of the range (starting at sa)
+    unsigned char* oldData;     // memory before the last change (used for showing the changes)
+    uint64_t dataSize;
     int addressSize;
     char startAddress[64];
     char endAddress[64];
-    bool requestData;
+    bool rangeChanged;
+    bool upToDate;
     uint64_t sa;
     uint64_t ea;
-    uint64_t exceptionLocation;
+    uint32_t changeCount;
 };
 
+static uint8_t s_prefetch[PrefetchSize];
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void resizeData(HexMemoryData* data, uint64_t size) {
+    if (size == 0)
+        size = 1;
+
+    if (size == data->dataSize)
+        return;
+
+    data->data = (unsigned char*)realloc(data->data, (size_t)size);
+    data->oldData = (unsigned char*)realloc(data->oldData, (size_t)size);
+    data->dataSize = size;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static void* createInstance(PDUI* uiFuncs, ServiceFunc* serviceFunc) {
-    (void)serviceFunc;
     (void)uiFuncs;
 
     HexMemoryData* user_data = (HexMemoryData*)malloc(sizeof(HexMemoryData));
-    memset(user_data, 0, sizeof(sizeof(HexMemoryData)));
+    memset(user_data, 0, sizeof(HexMemoryData));
+
+    user_data->memory = (PDMemoryCacheFuncs*)serviceFunc(PDMEMORYCACHE_GLOBAL);
 
     strcpy(user_data->startAddress, "0x00000000");
     strcpy(user_data->endAddress, "0x00001000");
 
     user_data->sa = 0;
     user_data->ea = 0x00000fff;
-
-    user_data->data = (unsigned char*)malloc(1024 * 1024);
     user_data->addressSize = 2;
+    user_data->rangeChanged = true;
 
-    user_data->oldData = (unsigned char*)malloc(1024 * 1024);
-    user_data->addressSize = 2;
-
-    // clear
-
-    memset(user_data->data, 0xff, 1024 * 1024);
-    memset(user_data->oldData, 0xff, 1024 * 1024);
+    resizeData(user_data, user_data->ea - user_data->sa + 1);
 
     return user_data;
 }
@@ -51,7 +74,11 @@ static void* createInstance(PDUI* uiFuncs, ServiceFunc* serviceFunc) {
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static void destroyInstance(void* user_data) {
-    free(user_data);
+    HexMemoryData* data = (HexMemoryData*)user_data;
+
+    free(data->data);
+    free(data->oldData);
+    free(data);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -72,14 +99,17 @@ static void getAddressLine(char* adressText, uint64_t address, int adressSize) {
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static void drawData(HexMemoryData* data, PDUI* uiFuncs, int lineCount, int charsPerLine) {
-    uint64_t address = (uint64_t)strtol(data->startAddress, 0, 16);
+    uint64_t address = data->sa;
     int adressSize = data->addressSize;
-    uint8_t* memoryData = data->data + address;
-    uint8_t* oldMemoryData = data->oldData + address;
+    uint8_t* memoryData = data->data;
+    uint8_t* oldMemoryData = data->oldData;
 
     if (charsPerLine > 1024)
         charsPerLine = 1024;
 
+    if (charsPerLine > 0 && (uint64_t)(lineCount * charsPerLine) > data->dataSize)
+        lineCount = (int)(data->dataSize / (uint64_t)charsPerLine);
+
     for (int i = 0; i < lineCount; ++i) {
         char addressText[64] = { 0 };
 
@@ -137,6 +167,38 @@ static void drawData(HexMemoryData* data, PDUI* uiFuncs, int lineCount, int char
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Reads the range from the memory cache when something has changed (or when waiting for memory to arrive)
+
+static void readMemory(HexMemoryData* data) {
+    uint64_t size = data->ea >= data->sa ? data->ea - data->sa + 1 : 0;
+    uint32_t changeCount = data->memory->get_change_count();
+
+    if (size > MaxRangeSize)
+        size = MaxRangeSize;
+
+    // when the memory has changed what was shown before is kept (once per change) to show what changed. While
+    // waiting for the memory it's still read each frame so the cache keeps requesting it
+
+    if (data->rangeChanged) {
+        resizeData(data, size);
+        memset(data->data, 0xff, (size_t)data->dataSize);
+        memset(data->oldData, 0xff, (size_t)data->dataSize);
+        data->upToDate = false;
+    } else if (changeCount != data->changeCount) {
+        memcpy(data->oldData, data->data, (size_t)size);
+    } else if (data->upToDate) {
+        return;
+    }
+
+    data->rangeChanged = false;
+    data->changeCount = changeCount;
+    data->upToDate = !!data->memory->read(0, data->sa, data->data, size);
+
+    data->memory->read(0, data->sa + size, s_prefetch, sizeof(s_prefetch));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void drawUI(HexMemoryData* data, PDUI* uiFuncs) {
     uiFuncs->push_item_width(100);
     uiFuncs->input_text("Start Address", data->startAddress, sizeof(data->startAddress), PDUIInputTextFlags_CharsHexadecimal, 0, 0);
@@ -149,19 +211,23 @@ void drawUI(HexMemoryData* data, PDUI* uiFuncs) {
     long startAddress = strtol(data->startAddress, 0, 16);
     long endAddress = strtol(data->endAddress, 0, 16);
 
-    if ((endAddress >= startAddress) && !data->data)
+    if (!data->memory) {
+        uiFuncs->text("No memory cache service");
         return;
+    }
 
     if (data->sa != (uint64_t)startAddress) {
-        data->requestData = true;
+        data->rangeChanged = true;
         data->sa = (uint64_t)startAddress;
     }
 
     if (data->ea != (uint64_t)endAddress) {
-        data->requestData = true;
+        data->rangeChanged = true;
         data->ea = (uint64_t)endAddress;
     }
 
+    readMemory(data);
+
     //PDVec2 textStart = uiFuncs->get_cursor_pos();
     PDVec2 windowSize = uiFuncs->get_window_size();
 
@@ -189,86 +255,14 @@ void drawUI(HexMemoryData* data, PDUI* uiFuncs) {
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void updateMemory(HexMemoryData* user_data, PDReader* reader) {
-    void* data;
-    uint64_t address = 0;
-    uint64_t size = 0;
-
-    PDRead_find_u64(reader, &address, "address", 0);
-
-    if (PDRead_find_data(reader, &data, &size, "data", 0) == PDReadStatus_NotFound)
-        return;
-
-    //printf("%s(%d) update memory\n", __FILE__, __LINE__);
-
-    // TODO: Currently we just copy the memory into a predefined memory range. This needs to really be fixed
-    // We need some overlapping memory ranges and such here to handle this correctly
-
-    if (address + size >= 1024 * 1024) {
-        printf("%s(%d) address (0x%16llx %x) + size larger than 1 mb which isn't supported right now\n", __FILE__, __LINE__, address, (int)size);
-        return;
-    }
-
-    // TODO: VirtualMemory manager that can requestmemory on a per 4k page or something similar instead of this
-
-    // save the old data that is used for showing the changes
-    memcpy(user_data->oldData + address, user_data->data + address, (size_t)size);
-
-    // And update with the new data
-    memcpy(user_data->data + address, data, (size_t)size);
-}
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-static void updateExceptionLocation(HexMemoryData* data, PDReader* reader) {
-    uint64_t address = 0;
-
-    PDRead_find_u64(reader, &address, "address", 0);
-
-    if (data->exceptionLocation == address)
-        return;
-
-    data->requestData = true;
-    data->exceptionLocation = address;
-}
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter* writer) {
-    uint32_t event;
-
     HexMemoryData* data = (HexMemoryData*)user_data;
 
-    data->requestData = false;
-
-    // Loop over all the in events
-
-    while ((event = PDRead_get_event(inEvents)) != 0) {
-        switch (event) {
-            case PDEventType_SetMemory:
-            {
-                updateMemory(data, inEvents);
-                break;
-            }
-
-            case PDEventType_SetExceptionLocation:
-            {
-                updateExceptionLocation(data, inEvents);
-                break;
-            }
-        }
-    }
+    (void)inEvents;
+    (void)writer;
 
     drawUI(data, uiFuncs);
 
-    if (data->requestData) {
-        //printf("requesting memory range %04x - %04x\n", (uint16_t)data->sa, (uint16_t)data->ea);
-        PDWrite_event_begin(writer, PDEventType_GetMemory);
-        PDWrite_u64(writer, "address_start", data->sa);
-        PDWrite_u64(writer, "size", data->ea - data->sa);
-        PDWrite_event_end(writer);
-    }
-
     return 0;
 }
 
@@ -296,6 +290,15 @@ static int loadState(void* user_data, struct PDLoadState* loadState) {
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// All memory comes from the memory cache so no events are needed
+
+static const uint16_t s_eventTypes[] =
+{
+    PDEventType_None,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static PDViewPlugin plugin =
 {
     "Hex Memory View",
@@ -304,6 +307,7 @@ static PDViewPlugin plugin =
     update,
     saveState,
     loadState,
+    s_eventTypes,
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
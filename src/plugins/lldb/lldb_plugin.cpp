@@ -41,6 +41,7 @@ typedef struct LLDBPlugin
     PDDebugState state;
     bool hasValidTarget;
     uint64_t selectedThreadId;
+    uint32_t stateEpoch;
     const char* targetName;
 	std::map<lldb::tid_t, uint32_t> frameSelection;
 	std::vector<Breakpoint> breakpoints;
@@ -63,6 +64,7 @@ void* createInstance(ServiceFunc* serviceFunc)
     plugin->listener = plugin->debugger.GetListener(); 
     plugin->hasValidTarget = false;
     plugin->selectedThreadId = 0;
+    plugin->stateEpoch = 0;
 
     return plugin;
 }
@@ -505,6 +507,17 @@ static const char* eventTypes[] =
 };
 */
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Lets the views know what to request again (see PDStateChange)
+
+static void sendStateChanged(LLDBPlugin* plugin, PDWriter* writer, uint32_t changed)
+{
+    PDWrite_event_begin(writer, PDEventType_StateChanged);
+    PDWrite_u32(writer, PD_STATE_EPOCH, ++plugin->stateEpoch);
+    PDWrite_u32(writer, PD_STATE_CHANGED, changed);
+    PDWrite_event_end(writer);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static void selectThread(LLDBPlugin* plugin, PDReader* reader, PDWriter* writer)
@@ -527,6 +540,8 @@ static void selectThread(LLDBPlugin* plugin, PDReader* reader, PDWriter* writer)
     PDWrite_event_begin(writer, PDEventType_SelectFrame);
     PDWrite_u32(writer, "frame", getThreadFrame(plugin, threadId));
     PDWrite_event_end(writer);
+
+    sendStateChanged(plugin, writer, PDStateChange_Callstack | PDStateChange_Locals | PDStateChange_Registers);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -542,6 +557,8 @@ static void selectFrame(LLDBPlugin* plugin, PDReader* reader, PDWriter* writer)
 	plugin->frameSelection[plugin->selectedThreadId] = frameIndex;
 
 	setExceptionLocation(plugin, writer);
+
+    sendStateChanged(plugin, writer, PDStateChange_Locals | PDStateChange_Registers);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -628,6 +645,9 @@ static void sendExceptionState(LLDBPlugin* plugin, PDWriter* writer)
     //setCallstack(plugin, writer);
     setExceptionLocation(plugin, writer);
     //setLocals(plugin, writer);
+
+    // everything may have changed while the target was running
+    sendStateChanged(plugin, writer, PDStateChange_All);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
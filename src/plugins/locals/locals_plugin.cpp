@@ -2,14 +2,31 @@
 #include "pd_backend.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-struct LocalsData {
-    int dummy;
+enum {
+    ValueSize = 256,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Local {
+    char name[ValueSize];
+    char value[ValueSize];
+    char type[ValueSize];
 };
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The locals are kept between updates as they are only sent again when they have changed
 
+struct LocalsData {
+    PDStateTracker state;
+    Local* locals;
+    int localCount;
+    int maxLocals;
+};
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -17,6 +34,7 @@ static void* createInstance(PDUI* uiFuncs, ServiceFunc* serviceFunc) {
     (void)serviceFunc;
     (void)uiFuncs;
     LocalsData* user_data = (LocalsData*)malloc(sizeof(LocalsData));
+    memset(user_data, 0, sizeof(LocalsData));
 
     return user_data;
 }
@@ -24,37 +42,64 @@ static void* createInstance(PDUI* uiFuncs, ServiceFunc* serviceFunc) {
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static void destroyInstance(void* user_data) {
-    free(user_data);
+    LocalsData* data = (LocalsData*)user_data;
+    free(data->locals);
+    free(data);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void copyString(char* dest, const char* src) {
+    strncpy(dest, src, ValueSize);
+    dest[ValueSize - 1] = 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void showInUI(LocalsData* data, PDReader* reader, PDUI* uiFuncs) {
+static void updateLocals(LocalsData* data, PDReader* reader) {
     PDReaderIterator it;
-    (void)data;
 
     if (PDRead_find_array(reader, &it, "locals", 0) == PDReadStatus_NotFound)
         return;
 
-    uiFuncs->text("");
-
-    uiFuncs->columns(3, "callstack", true);
-    uiFuncs->text("Name"); uiFuncs->next_column();
-    uiFuncs->text("Value"); uiFuncs->next_column();
-    uiFuncs->text("Type"); uiFuncs->next_column();
+    data->localCount = 0;
 
     while (PDRead_get_next_entry(reader, &it)) {
         const char* name = "";
         const char* value = "";
         const char* type = "";
 
+        if (data->localCount == data->maxLocals) {
+            data->maxLocals = data->maxLocals ? data->maxLocals * 2 : 32;
+            data->locals = (Local*)realloc(data->locals, sizeof(Local) * (size_t)data->maxLocals);
+        }
+
         PDRead_find_string(reader, &name, "name", it);
         PDRead_find_string(reader, &value, "value", it);
         PDRead_find_string(reader, &type, "type", it);
 
-        uiFuncs->text(name); uiFuncs->next_column();
-        uiFuncs->text(value); uiFuncs->next_column();
-        uiFuncs->text(type); uiFuncs->next_column();
+        Local* local = &data->locals[data->localCount++];
+
+        copyString(local->name, name);
+        copyString(local->value, value);
+        copyString(local->type, type);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void showInUI(LocalsData* data, PDUI* uiFuncs) {
+    uiFuncs->text("");
+
+    uiFuncs->columns(3, "callstack", true);
+    uiFuncs->text("Name"); uiFuncs->next_column();
+    uiFuncs->text("Value"); uiFuncs->next_column();
+    uiFuncs->text("Type"); uiFuncs->next_column();
+
+    for (int i = 0; i < data->localCount; ++i) {
+        uiFuncs->text(data->locals[i].name); uiFuncs->next_column();
+        uiFuncs->text(data->locals[i].value); uiFuncs->next_column();
+        uiFuncs->text(data->locals[i].type); uiFuncs->next_column();
     }
 }
 
@@ -63,18 +108,30 @@ static void showInUI(LocalsData* data, PDReader* reader, PDUI* uiFuncs) {
 static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter* outEvents) {
     uint32_t event = 0;
 
+    LocalsData* data = (LocalsData*)user_data;
+
     while ((event = PDRead_get_event(inEvents)) != 0) {
         switch (event) {
             case PDEventType_SetLocals:
             {
-                showInUI((LocalsData*)user_data, inEvents, uiFuncs);
+                updateLocals(data, inEvents);
+                break;
+            }
+
+            case PDEventType_StateChanged:
+            {
+                PDStateTracker_update(&data->state, inEvents);
                 break;
             }
         }
     }
 
-    // Request callstack data
-    // TODO: Dont' request locals all the time
+    showInUI(data, uiFuncs);
+
+    // Request locals (only when they have changed if the backend tells us)
+
+    if (!PDStateTracker_should_request(&data->state, PDStateChange_Locals))
+        return 0;
 
     PDWrite_event_begin(outEvents, PDEventType_GetLocals);
     PDWrite_u8(outEvents, "dummy_remove", 0);   // TODO: Remove me
@@ -85,12 +142,24 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter*
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static const uint16_t s_eventTypes[] =
+{
+    PDEventType_SetLocals,
+    PDEventType_StateChanged,
+    PDEventType_None,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static PDViewPlugin plugin =
 {
     "Locals",
     createInstance,
     destroyInstance,
     update,
+    0,
+    0,
+    s_eventTypes,
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -24,6 +24,7 @@ struct RegistersData {
     Register* registers;
     int registerCount;
     int maxRegisters;
+    PDStateTracker state;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -35,6 +36,7 @@ static void* createInstance(PDUI* uiFuncs, ServiceFunc* serviceFunc) {
     user_data->maxRegisters = 256;
     user_data->registers = (Register*)malloc(sizeof(Register) * (size_t)user_data->maxRegisters);
     user_data->registerCount = 0;
+    memset(&user_data->state, 0, sizeof(user_data->state));
 
     (void)uiFuncs;
     (void)serviceFunc;
@@ -168,6 +170,18 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter*
 		switch (event) {
             case PDEventType_SetRegisters:
                 updateRegisters(data, inEvents); break;
+
+            case PDEventType_StateChanged:
+            {
+                // Backends that doesn't send StateChanged sends the registers without being asked
+
+                if (PDStateTracker_update(&data->state, inEvents) & PDStateChange_Registers) {
+                    PDWrite_event_begin(outEvents, PDEventType_GetRegisters);
+                    PDWrite_event_end(outEvents);
+                }
+
+                break;
+            }
         }
     }
 
@@ -178,12 +192,24 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter*
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static const uint16_t s_eventTypes[] =
+{
+    PDEventType_SetRegisters,
+    PDEventType_StateChanged,
+    PDEventType_None,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static PDViewPlugin plugin =
 {
     "Registers View",
     createInstance,
     destroyInstance,
     update,
+    0,
+    0,
+    s_eventTypes,
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,262 @@
+#include "pd_backend.h"
+#include "pd_host.h"
+#include "api/src/remote/pd_readwrite_private.h"
+#include "api/src/remote/remote_connection_uv.h"
+#include "api/src/remote/remote_connection_shm.h"
+#include <uv.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Backend that talks to a target using the remote API (PDRemote_create etc) in another process. This is the debugger
+// side of the connection: the requests and actions of the views are sent to the target and whatever the target
+// replies with is handed to the views as if the backend was running in ProDBG.
+//
+// The target is set with PDEventType_AttachToRemoteSession ("address") or the PRODBG_REMOTE environment variable.
+// "host:port" (or just host for port 1340) connects over TCP and "shm:port" maps the shared memory of a target
+// created with PDRemote_createShared on this machine.
+
+enum {
+    DefaultPort = 1340,
+    RetryIntervalMs = 1000,     // how often to try connecting again when the target isn't there
+};
+
+typedef struct RemotePlugin {
+    struct RemoteConnectionUV* conn;
+    struct RemoteConnectionShm* shm;
+    PDReader* reader;
+    PDWriter* requests;
+    char address[256];
+    char shmName[64];
+    int port;
+    uint64_t lastConnectTime;   // uv_hrtime of the last connect attempt
+    int connected;
+} RemotePlugin;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void disconnect(RemotePlugin* plugin) {
+    RemoteConnectionUV_destroy(plugin->conn);
+    RemoteConnectionShm_destroy(plugin->shm);
+
+    plugin->conn = 0;
+    plugin->shm = 0;
+    plugin->connected = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void set_address(RemotePlugin* plugin, const char* address) {
+    const char* port;
+
+    disconnect(plugin);
+
+    plugin->address[0] = 0;
+    plugin->shmName[0] = 0;
+    plugin->port = DefaultPort;
+    plugin->lastConnectTime = 0;
+
+    if (!strncmp(address, "shm:", 4)) {
+        sprintf(plugin->shmName, REMOTE_CONNECTION_SHM_NAME, atoi(address + 4));
+        return;
+    }
+
+    strncpy(plugin->address, address, sizeof(plugin->address) - 1);
+
+    if ((port = strchr(address, ':')) != 0) {
+        plugin->address[port - address] = 0;
+        plugin->port = atoi(port + 1);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int is_connected(RemotePlugin* plugin) {
+    if (plugin->shm)
+        return RemoteConnectionShm_isConnected(plugin->shm);
+
+    if (plugin->conn)
+        return RemoteConnectionUV_isConnected(plugin->conn);
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void try_connect(RemotePlugin* plugin) {
+    uint64_t now = uv_hrtime();
+
+    if (!plugin->address[0] && !plugin->shmName[0])
+        return;
+
+    if (plugin->lastConnectTime && (now - plugin->lastConnectTime) / 1000000 < RetryIntervalMs)
+        return;
+
+    plugin->lastConnectTime = now;
+
+    if (plugin->shmName[0]) {
+        if (!plugin->shm)
+            plugin->shm = RemoteConnectionShm_create(RemoteConnectionType_Connect, plugin->shmName, 0);
+
+        if (plugin->shm)
+            RemoteConnectionShm_connect(plugin->shm, plugin->shmName);
+    } else {
+        if (!plugin->conn)
+            plugin->conn = RemoteConnectionUV_create(RemoteConnectionType_Connect, 0);
+
+        if (plugin->conn) {
+            RemoteConnectionUV_setCompression(plugin->conn, 1);
+            RemoteConnectionUV_connect(plugin->conn, plugin->address, plugin->port);
+        }
+    }
+
+    if ((plugin->connected = is_connected(plugin)))
+        printf("Connected to remote target %s\n", plugin->shmName[0] ? plugin->shmName : plugin->address);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void send_segments(RemotePlugin* plugin, const PDBinarySegment* segments, int count) {
+    if (plugin->shm)
+        RemoteConnectionShm_sendSegments(plugin->shm, segments, count);
+    else
+        RemoteConnectionUV_sendSegments(plugin->conn, 0, segments, count);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const uint8_t* next_frame(RemotePlugin* plugin, int* size) {
+    int client;
+
+    if (plugin->shm) {
+        RemoteConnectionShm_update(plugin->shm, 0);
+        return RemoteConnectionShm_nextFrame(plugin->shm, size);
+    }
+
+    RemoteConnectionUV_update(plugin->conn, 0);
+    return RemoteConnectionUV_nextFrame(plugin->conn, &client, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void* create_instance(ServiceFunc* serviceFunc) {
+    const char* address = getenv("PRODBG_REMOTE");
+    RemotePlugin* plugin = (RemotePlugin*)malloc(sizeof(RemotePlugin));
+
+    (void)serviceFunc;
+
+    memset(plugin, 0, sizeof(RemotePlugin));
+
+    plugin->reader = pd_binary_reader_create();
+    plugin->requests = pd_binary_writer_create();
+
+    if (address)
+        set_address(plugin, address);
+
+    return plugin;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void destroy_instance(void* user_data) {
+    RemotePlugin* plugin = (RemotePlugin*)user_data;
+
+    disconnect(plugin);
+
+    pd_binary_reader_destroy(plugin->reader);
+    pd_binary_writer_destroy(plugin->requests);
+    free(plugin->requests);
+
+    free(plugin);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDDebugState update(void* user_data, PDAction action, PDReader* reader, PDWriter* writer) {
+    RemotePlugin* plugin = (RemotePlugin*)user_data;
+    const PDBinarySegment* segments;
+    const uint8_t* frame;
+    uint32_t event;
+    int count;
+    int size;
+
+    while ((event = PDRead_get_event(reader)) != 0) {
+        if (event == PDEventType_AttachToRemoteSession) {
+            const char* address = 0;
+
+            if (PDRead_find_string(reader, &address, "address", 0) != PDReadStatus_NotFound && address)
+                set_address(plugin, address);
+        }
+    }
+
+    if (!is_connected(plugin)) {
+        if (plugin->connected)
+            printf("Lost connection to remote target\n");
+
+        plugin->connected = 0;
+        try_connect(plugin);
+
+        if (!plugin->connected)
+            return PDDebugState_NoTarget;
+    }
+
+    // actions are sent as 4 byte frames with the top bit set and the requests as a stream (the target ignores the
+    // AttachToRemoteSession event)
+
+    if (action != PDAction_None) {
+        uint8_t actionFrame[4];
+        PDBinarySegment segment;
+
+        actionFrame[0] = 0x80;
+        actionFrame[1] = 0;
+        actionFrame[2] = (uint8_t)(action >> 8);
+        actionFrame[3] = (uint8_t)(action >> 0);
+
+        segment.data = actionFrame;
+        segment.size = sizeof(actionFrame);
+
+        send_segments(plugin, &segment, 1);
+    }
+
+    pd_binary_writer_reset(plugin->requests);
+    pd_binary_reader_copy_events(reader, plugin->requests);
+    pd_binary_writer_finalize(plugin->requests);
+
+    if (pd_binary_writer_get_size(plugin->requests) > 4) {
+        if ((segments = pd_binary_writer_get_segments(plugin->requests, &count)))
+            send_segments(plugin, segments, count);
+    }
+
+    // hand over everything the target has sent since the last update
+
+    while ((frame = next_frame(plugin, &size))) {
+        if (frame[0] & 0x80)
+            continue;
+
+        pd_binary_reader_init_stream(plugin->reader, (uint8_t*)frame, (unsigned int)size);
+        pd_binary_reader_copy_events(plugin->reader, writer);
+    }
+
+    return PDDebugState_Running;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDBackendPlugin plugin =
+{
+    "Remote Backend",
+    create_instance,
+    destroy_instance,
+    0,
+    update,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PD_EXPORT void InitPlugin(RegisterPlugin* registerPlugin, void* private_data) {
+    registerPlugin(PD_BACKEND_API_VERSION, &plugin, private_data);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,183 @@
+#include "pd_backend.h"
+#include "pd_host.h"
+#include "api/src/remote/pd_capture.h"
+#include "api/src/remote/pd_readwrite_private.h"
+#include <uv.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Backend that plays back a capture file (see PDRemote_startCapture and pd_capture.h) instead of talking to a target.
+// The replies of the recorded backend are written in the same order they were recorded, either at the same pace as
+// they were recorded or one reply per update (as fast as possible) so views can be tested/benchmarked against real
+// traffic without the target. The requests the views sends are ignored.
+//
+// The file is set with PDEventType_SetExecutable ("filename") or the PRODBG_REPLAY_FILE environment variable.
+// Set PRODBG_REPLAY_FAST to play back as fast as possible.
+
+typedef struct ReplayPlugin {
+    struct PDCaptureReader* capture;
+    PDReader* reader;
+    PDCaptureRecord record;     // next reply to write
+    int hasRecord;
+    int fast;
+    uint64_t startTime;         // uv_hrtime when the first reply was written (0 before that)
+    uint64_t firstTime;         // capture time of the first reply
+    uint64_t replyCount;
+    uint64_t replyBytes;
+} ReplayPlugin;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void open_capture(ReplayPlugin* plugin, const char* filename) {
+    pd_capture_reader_destroy(plugin->capture);
+
+    plugin->capture = pd_capture_reader_create(filename);
+    plugin->hasRecord = 0;
+    plugin->startTime = 0;
+    plugin->replyCount = 0;
+    plugin->replyBytes = 0;
+
+    if (plugin->capture)
+        printf("Replaying %s (%s)\n", filename, plugin->fast ? "as fast as possible" : "recorded speed");
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void* create_instance(ServiceFunc* serviceFunc) {
+    const char* filename = getenv("PRODBG_REPLAY_FILE");
+    ReplayPlugin* plugin = (ReplayPlugin*)malloc(sizeof(ReplayPlugin));
+
+    (void)serviceFunc;
+
+    memset(plugin, 0, sizeof(ReplayPlugin));
+
+    plugin->reader = pd_binary_reader_create();
+    plugin->fast = getenv("PRODBG_REPLAY_FAST") != 0;
+
+    if (filename)
+        open_capture(plugin, filename);
+
+    return plugin;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void destroy_instance(void* user_data) {
+    ReplayPlugin* plugin = (ReplayPlugin*)user_data;
+
+    pd_capture_reader_destroy(plugin->capture);
+    pd_binary_reader_destroy(plugin->reader);
+
+    free(plugin);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Skips the requests and actions in the capture, returns 0 at the end of the file
+
+static int next_reply(ReplayPlugin* plugin) {
+    if (plugin->hasRecord)
+        return 1;
+
+    while (pd_capture_reader_next(plugin->capture, &plugin->record)) {
+        if (plugin->record.type == PDCaptureRecord_Reply) {
+            plugin->hasRecord = 1;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void write_reply(ReplayPlugin* plugin, PDWriter* writer) {
+    pd_binary_reader_init_stream(plugin->reader, (uint8_t*)plugin->record.data, plugin->record.size);
+    pd_binary_reader_copy_events(plugin->reader, writer);
+
+    plugin->replyCount++;
+    plugin->replyBytes += plugin->record.size;
+    plugin->hasRecord = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void finish(ReplayPlugin* plugin) {
+    double time = plugin->startTime ? (double)(uv_hrtime() - plugin->startTime) / 1000000.0 : 0.0;
+
+    printf("Replay done: %d replies, %d bytes in %.2f ms\n", (int)plugin->replyCount, (int)plugin->replyBytes, time);
+
+    pd_capture_reader_destroy(plugin->capture);
+    plugin->capture = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDDebugState update(void* user_data, PDAction action, PDReader* reader, PDWriter* writer) {
+    ReplayPlugin* plugin = (ReplayPlugin*)user_data;
+    uint64_t now;
+    uint32_t event;
+
+    (void)action;
+
+    while ((event = PDRead_get_event(reader)) != 0) {
+        if (event == PDEventType_SetExecutable) {
+            const char* filename = 0;
+
+            if (PDRead_find_string(reader, &filename, "filename", 0) != PDReadStatus_NotFound && filename)
+                open_capture(plugin, filename);
+        }
+    }
+
+    if (!plugin->capture)
+        return PDDebugState_NoTarget;
+
+    if (!next_reply(plugin)) {
+        finish(plugin);
+        return PDDebugState_NoTarget;
+    }
+
+    if (!plugin->startTime) {
+        plugin->startTime = uv_hrtime();
+        plugin->firstTime = plugin->record.time;
+    }
+
+    if (plugin->fast) {
+        write_reply(plugin, writer);
+        return PDDebugState_Running;
+    }
+
+    // write all replies that was recorded up until now (relative to the first one)
+
+    now = (uv_hrtime() - plugin->startTime) / 1000;
+
+    while (plugin->record.time - plugin->firstTime <= now) {
+        write_reply(plugin, writer);
+
+        if (!next_reply(plugin))
+            break;
+    }
+
+    return PDDebugState_Running;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PDBackendPlugin plugin =
+{
+    "Replay Backend",
+    create_instance,
+    destroy_instance,
+    0,
+    update,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PD_EXPORT void InitPlugin(RegisterPlugin* registerPlugin, void* private_data) {
+    registerPlugin(PD_BACKEND_API_VERSION, &plugin, private_data);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
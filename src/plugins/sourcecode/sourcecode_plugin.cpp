@@ -18,6 +18,7 @@ struct SourceCodeData {
     bool hasFiles;
     uint32_t fastOpenKey;
     uint32_t toggleBreakpointKey;
+    PDStateTracker state;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -224,6 +225,16 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter*
                 data->hasFiles = true;
                 break;
             }
+
+            case PDEventType_StateChanged:
+            {
+                // new modules may come with new source files
+
+                if (PDStateTracker_update(&data->state, inEvents) & PDStateChange_Modules)
+                    data->hasFiles = false;
+
+                break;
+            }
         }
     }
 
@@ -234,8 +245,10 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter*
 
     //showInUI(data, uiFuncs);
 
-    PDWrite_event_begin(writer, PDEventType_GetExceptionLocation);
-    PDWrite_event_end(writer);
+    if (PDStateTracker_should_request(&data->state, PDStateChange_ExceptionLocation)) {
+        PDWrite_event_begin(writer, PDEventType_GetExceptionLocation);
+        PDWrite_event_end(writer);
+    }
 
     if (!data->hasFiles && data->requestFiles) {
         PDWrite_event_begin(writer, PDEventType_GetSourceFiles);
@@ -247,12 +260,27 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter*
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static const uint16_t s_eventTypes[] =
+{
+    PDEventType_SetExceptionLocation,
+    PDEventType_SetSourceCodeFile,
+    PDEventType_ToggleBreakpointCurrentLine,
+    PDEventType_SetSourceFiles,
+    PDEventType_StateChanged,
+    PDEventType_None,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static PDViewPlugin plugin =
 {
     "Source Code View",
     createInstance,
     destroyInstance,
     update,
+    0,
+    0,
+    s_eventTypes,
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2,14 +2,34 @@
 #include "pd_backend.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+enum {
+    ValueSize = 256,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Thread {
+    uint64_t id;
+    char name[ValueSize];
+    char function[ValueSize];
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The threads are kept between updates as they are only sent again when they have changed
+
 struct ThreadsData {
     int selectedThread;
     int threadId;
     bool requestData;
     bool setSelectedThread;
+    PDStateTracker state;
+    Thread* threads;
+    int threadCount;
+    int maxThreads;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -19,6 +39,7 @@ static void* createInstance(PDUI* uiFuncs, ServiceFunc* serviceFunc) {
     (void)uiFuncs;
 
     ThreadsData* user_data = (ThreadsData*)malloc(sizeof(ThreadsData));
+    memset(user_data, 0, sizeof(ThreadsData));
 
     user_data->selectedThread = 0;
     user_data->threadId = 0;
@@ -29,18 +50,56 @@ static void* createInstance(PDUI* uiFuncs, ServiceFunc* serviceFunc) {
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static void destroyInstance(void* user_data) {
-    free(user_data);
+    ThreadsData* data = (ThreadsData*)user_data;
+    free(data->threads);
+    free(data);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void showInUI(ThreadsData* user_data, PDReader* reader, PDUI* uiFuncs) {
+static void copyString(char* dest, const char* src) {
+    strncpy(dest, src, ValueSize);
+    dest[ValueSize - 1] = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void updateThreads(ThreadsData* data, PDReader* reader) {
     PDReaderIterator it;
-    ThreadsData* data = (ThreadsData*)user_data;
 
     if (PDRead_find_array(reader, &it, "threads", 0) == PDReadStatus_NotFound)
         return;
 
+    data->threadCount = 0;
+
+    while (PDRead_get_next_entry(reader, &it)) {
+        uint64_t id = 0;
+        const char* name = "";
+        const char* function = "";
+
+        if (data->threadCount == data->maxThreads) {
+            data->maxThreads = data->maxThreads ? data->maxThreads * 2 : 16;
+            data->threads = (Thread*)realloc(data->threads, sizeof(Thread) * (size_t)data->maxThreads);
+        }
+
+        PDRead_find_u64(reader, &id, "id", it);
+        PDRead_find_string(reader, &name, "name", it);
+        PDRead_find_string(reader, &function, "function", it);
+
+        Thread* thread = &data->threads[data->threadCount++];
+
+        thread->id = id;
+        copyString(thread->name, name);
+        copyString(thread->function, function);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void showInUI(ThreadsData* data, PDUI* uiFuncs) {
+    if (data->threadCount == 0)
+        return;
+
     uiFuncs->text("");
 
     uiFuncs->columns(3, "threads", true);
@@ -48,36 +107,24 @@ static void showInUI(ThreadsData* user_data, PDReader* reader, PDUI* uiFuncs) {
     uiFuncs->text("Name"); uiFuncs->next_column();
     uiFuncs->text("Function"); uiFuncs->next_column();
 
-    int i = 0;
-
     PDVec2 size = { 0.0f, 0.0f };
 
-    data->setSelectedThread = false;
-
     int oldSelectedThread = data->selectedThread;
 
-    while (PDRead_get_next_entry(reader, &it)) {
-        uint64_t id;
-        const char* name = "";
-        const char* function = "";
-
-        PDRead_find_u64(reader, &id, "id", it);
-        PDRead_find_string(reader, &name, "name", it);
-        PDRead_find_string(reader, &function, "function", it);
+    for (int i = 0; i < data->threadCount; ++i) {
+        const Thread* thread = &data->threads[i];
 
         char label[32];
-        sprintf(label, "%llx", id);
+        sprintf(label, "%llx", (unsigned long long)thread->id);
 
         if (uiFuncs->selectable(label, data->selectedThread == i, 1 << 1, size)) {
             data->selectedThread = i;
-            data->threadId = (int)id;
+            data->threadId = (int)thread->id;
         }
 
         uiFuncs->next_column();
-        uiFuncs->text(name); uiFuncs->next_column();
-        uiFuncs->text(function); uiFuncs->next_column();
-
-        i++;
+        uiFuncs->text(thread->name); uiFuncs->next_column();
+        uiFuncs->text(thread->function); uiFuncs->next_column();
     }
 
     if (oldSelectedThread != data->selectedThread) {
@@ -99,7 +146,7 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter*
         switch (event) {
             case PDEventType_SetThreads:
             {
-                showInUI((ThreadsData*)user_data, inEvents, uiFuncs);
+                updateThreads(data, inEvents);
                 break;
             }
 
@@ -108,9 +155,19 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter*
                 data->requestData = true;
                 break;
             }
+
+            case PDEventType_StateChanged:
+            {
+                if (PDStateTracker_update(&data->state, inEvents) & PDStateChange_Threads)
+                    data->requestData = true;
+
+                break;
+            }
         }
     }
 
+    showInUI(data, uiFuncs);
+
     // Request threads data
 
     if (data->setSelectedThread) {
@@ -130,12 +187,25 @@ static int update(void* user_data, PDUI* uiFuncs, PDReader* inEvents, PDWriter*
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static const uint16_t s_eventTypes[] =
+{
+    PDEventType_SetThreads,
+    PDEventType_SetExceptionLocation,
+    PDEventType_StateChanged,
+    PDEventType_None,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static PDViewPlugin plugin =
 {
     "Threads",
     createInstance,
     destroyInstance,
     update,
+    0,
+    0,
+    s_eventTypes,
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
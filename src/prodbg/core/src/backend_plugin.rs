@@ -1,18 +1,75 @@
-use libc::{c_void, c_uchar};
+use libc::{c_char, c_void, c_uchar};
 use std::rc::Rc;
+use std::sync::{Arc, Condvar, Mutex};
 use plugin::Plugin;
 use plugins::PluginHandler;
 use prodbg_api::backend::CBackendCallbacks;
 use std::ptr;
+use profiler;
+use slot_map::SlotMap;
 use Lib;
 
 #[derive(PartialEq, Eq, Clone, Copy, Debug)]
-pub struct BackendHandle(pub usize);
+pub struct BackendHandle(pub u64);
 
 pub struct BackendInstance {
     pub plugin_data: *mut c_void,
     pub handle: BackendHandle,
     pub plugin_type: Rc<Plugin>,
+    /// Backends are updated on their session's thread (see backend_thread.rs.) Killed before the
+    /// instance goes away.
+    pub alive: Arc<BackendAlive>,
+}
+
+struct AliveState {
+    alive: bool,
+    updating: bool,
+}
+
+/// Keeps the backend thread from calling into an instance that has gone away. The lock is only
+/// held to check and flip the state (not during the update) so killing an instance only waits
+/// for the update that is running at the time.
+pub struct BackendAlive {
+    state: Mutex<AliveState>,
+    update_done: Condvar,
+}
+
+impl BackendAlive {
+    pub fn new() -> BackendAlive {
+        BackendAlive {
+            state: Mutex::new(AliveState {
+                alive: true,
+                updating: false,
+            }),
+            update_done: Condvar::new(),
+        }
+    }
+
+    /// Returns false if the instance is gone. Otherwise it's kept around until end_update
+    pub fn begin_update(&self) -> bool {
+        let mut state = self.state.lock().unwrap();
+        state.updating = state.alive;
+        state.alive
+    }
+
+    pub fn end_update(&self) {
+        self.state.lock().unwrap().updating = false;
+        self.update_done.notify_all();
+    }
+
+    /// No updates are started after this but the one running (if any) is left to finish (see
+    /// wait_for_update)
+    pub fn kill(&self) {
+        self.state.lock().unwrap().alive = false;
+    }
+
+    pub fn wait_for_update(&self) {
+        let mut state = self.state.lock().unwrap();
+
+        while state.updating {
+            state = self.update_done.wait(state).unwrap();
+        }
+    }
 }
 
 #[derive(Clone)]
@@ -22,10 +79,9 @@ struct ReloadState {
 }
 
 pub struct BackendPlugins {
-    pub instances: Vec<BackendInstance>,
+    pub instances: SlotMap<BackendInstance>,
     plugin_types: Vec<Rc<Plugin>>,
     reload_state: Vec<ReloadState>,
-    handle_counter: BackendHandle,
 }
 
 impl PluginHandler for BackendPlugins {
@@ -40,16 +96,27 @@ impl PluginHandler for BackendPlugins {
 
     fn unload_plugin(&mut self, lib: &Rc<Lib>) {
         self.reload_state.clear();
-        for i in (0..self.instances.len()).rev() {
-            if &self.instances[i].plugin_type.lib == lib {
-                let state = ReloadState {
-                    name: self.instances[i].plugin_type.name.clone(),
-                    handle: self.instances[i].handle,
-                };
-
-                self.reload_state.push(state);
-                self.instances.swap_remove(i);
+
+        for instance in self.instances.iter() {
+            if &instance.plugin_type.lib == lib {
+                self.reload_state.push(ReloadState {
+                    name: instance.plugin_type.name.clone(),
+                    handle: instance.handle,
+                });
+
+                instance.alive.kill();
+            }
+        }
+
+        // all instances are killed first so their backend threads finishes the updates at the same
+        // time. The code can't be unloaded until they are done
+
+        for state in &self.reload_state {
+            if let Some(instance) = self.instances.get(state.handle.0) {
+                instance.alive.wait_for_update();
             }
+
+            self.instances.remove(state.handle.0);
         }
 
         for i in (0..self.plugin_types.len()).rev() {
@@ -61,8 +128,14 @@ impl PluginHandler for BackendPlugins {
 
     fn reload_plugin(&mut self) {
         let t = self.reload_state.clone();
+        // the backends are created with the same handles so the sessions keeps using them
         for reload_plugin in &t {
-            Self::create_instance(self, &reload_plugin.name);
+            for i in 0..self.plugin_types.len() {
+                if self.plugin_types[i].name == reload_plugin.name {
+                    self.create_instance_from_type(i, Some(reload_plugin.handle));
+                    break;
+                }
+            }
         }
     }
 
@@ -72,40 +145,55 @@ impl PluginHandler for BackendPlugins {
 impl BackendPlugins {
     pub fn new() -> BackendPlugins {
         BackendPlugins {
-            instances: Vec::new(),
+            instances: SlotMap::new(),
             plugin_types: Vec::new(),
             reload_state: Vec::new(),
-            handle_counter: BackendHandle(0),
         }
     }
 
-    extern "C" fn service_fun(_name: *const c_uchar) -> *mut c_void {
+    extern "C" fn service_fun(name: *const c_uchar) -> *mut c_void {
+        if let Some(service) = profiler::get_service(name as *const c_char) {
+            return service;
+        }
+
         ptr::null_mut()
     }
 
-    fn create_instance_from_type(&mut self, index: usize) -> Option<BackendHandle> {
+    fn create_instance_from_type(&mut self,
+                                 index: usize,
+                                 backend_handle: Option<BackendHandle>)
+                                 -> Option<BackendHandle> {
+        if let Some(handle) = backend_handle {
+            if !self.instances.can_insert_at(handle.0) {
+                return None;
+            }
+        }
+
         let user_data = unsafe {
             let callbacks = self.plugin_types[index].plugin_funcs as *mut CBackendCallbacks;
             (*callbacks).create_instance.unwrap()(Self::service_fun)
         };
 
-        let handle = self.handle_counter;
+        let plugin_type = self.plugin_types[index].clone();
 
-        let instance = BackendInstance {
+        let create = |handle: BackendHandle| BackendInstance {
             plugin_data: user_data,
             handle: handle,
-            plugin_type: self.plugin_types[index].clone(),
+            plugin_type: plugin_type,
+            alive: Arc::new(BackendAlive::new()),
         };
 
-        self.handle_counter.0 += 1;
-
-        self.instances.push(instance);
-
-        Some(handle)
+        match backend_handle {
+            Some(handle) => {
+                self.instances.insert_at(handle.0, create(handle));
+                Some(handle)
+            }
+            None => Some(BackendHandle(self.instances.insert_with(|handle| create(BackendHandle(handle))))),
+        }
     }
 
     pub fn create_instance_from_index(mut self, index: usize) -> Option<BackendHandle> {
-        Self::create_instance_from_type(&mut self, index)
+        Self::create_instance_from_type(&mut self, index, None)
     }
 
     pub fn create_instance(&mut self, plugin_type: &String) -> Option<BackendHandle> {
@@ -114,21 +202,16 @@ impl BackendPlugins {
                 continue;
             }
 
-            return self.create_instance_from_type(i);
+            return self.create_instance_from_type(i, None);
         }
 
         None
     }
 
     pub fn get_backend(&mut self, backend_handle: Option<BackendHandle>) -> Option<&mut BackendInstance> {
-        if let Some(handle) = backend_handle {
-            for i in 0..self.instances.len() {
-                if self.instances[i].handle == handle {
-                    return Some(&mut self.instances[i]);
-                }
-            }
+        match backend_handle {
+            Some(handle) => self.instances.get_mut(handle.0),
+            None => None,
         }
-
-        None
     }
 }
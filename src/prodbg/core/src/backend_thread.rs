@@ -0,0 +1,332 @@
+use std::sync::{Arc, Mutex};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, Instant};
+use std::mem;
+use libc::{c_int, c_void};
+use prodbg_api::backend::CBackendCallbacks;
+use prodbg_api::read_write::Writer;
+use reader_wrapper::{ReaderWrapper, WriterWrapper};
+use spsc_queue::{spsc_queue, Producer, Consumer};
+use backend_plugin::{BackendAlive, BackendInstance};
+use frame_scheduler::FrameWaker;
+use profiler::{self, SampleName};
+
+///! Runs a backend on its own thread so a backend that blocks (waiting for the target, etc) doesn't stall
+///! the UI. The UI thread and the backend thread exchange finished writers through lock-free queues:
+///!
+///! requests:      UI -> backend, what the views has written during a frame
+///! replies:       backend -> UI, what the backend wrote in one update
+///! free_*:        the buffers going back to the side that writes to them so they can be reused
+///!
+///! Each writer is only owned by one thread at the time. When there are no requests the backend is still
+///! updated so it can poll the target. This starts at MIN_IDLE_UPDATE_MS and backs off to MAX_IDLE_UPDATE_MS
+///! while the backend has nothing to say (requests are handled right away as sending them wakes the thread.)
+///!
+
+const QUEUE_SIZE: usize = 16;
+const MIN_IDLE_UPDATE_MS: u64 = 16;
+const MAX_IDLE_UPDATE_MS: u64 = 128;
+
+type UpdateFunc = fn(*mut c_void, c_int, *mut c_void, *mut c_void);
+
+/// Time spent in the update function of the backend (see BackendThread::get_stats)
+#[derive(Clone, Copy, Default, Debug)]
+pub struct BackendStats {
+    pub updates: u64,
+    pub update_time: Duration,
+}
+
+struct Stream(Writer);
+
+unsafe impl Send for Stream {}
+
+struct Backend {
+    plugin_data: *mut c_void,
+    update: UpdateFunc,
+    alive: Arc<BackendAlive>,
+    name: String,
+}
+
+unsafe impl Send for Backend {}
+
+struct Queues {
+    requests: Consumer<Stream>,
+    replies: Producer<Stream>,
+    free_requests: Producer<Stream>,
+    free_replies: Consumer<Stream>,
+}
+
+pub struct BackendThread {
+    requests: Producer<Stream>,
+    replies: Consumer<Stream>,
+    free_requests: Consumer<Stream>,
+    free_replies: Producer<Stream>,
+    quit: Arc<AtomicBool>,
+    stopped: Arc<AtomicBool>,
+    stats: Arc<Mutex<BackendStats>>,
+    // the thread gives back its ends of the queues when it's done
+    thread: Option<JoinHandle<Queues>>,
+}
+
+impl BackendThread {
+    /// The waker (if any) is used to wake up the main loop each time there is a new reply
+    pub fn new(instance: &BackendInstance, waker: Option<FrameWaker>) -> Option<BackendThread> {
+        let update = unsafe {
+            let plugin_funcs = instance.plugin_type.plugin_funcs as *mut CBackendCallbacks;
+            match (*plugin_funcs).update {
+                Some(update) => update,
+                None => return None,
+            }
+        };
+
+        let backend = Backend {
+            plugin_data: instance.plugin_data,
+            update: update,
+            alive: instance.alive.clone(),
+            name: instance.plugin_type.name.clone(),
+        };
+
+        let (requests, requests_consumer) = spsc_queue(QUEUE_SIZE);
+        let (replies_producer, replies) = spsc_queue(QUEUE_SIZE);
+        let (free_requests_producer, free_requests) = spsc_queue(QUEUE_SIZE);
+        let (free_replies, free_replies_consumer) = spsc_queue(QUEUE_SIZE);
+
+        let queues = Queues {
+            requests: requests_consumer,
+            replies: replies_producer,
+            free_requests: free_requests_producer,
+            free_replies: free_replies_consumer,
+        };
+
+        let quit = Arc::new(AtomicBool::new(false));
+        let stopped = Arc::new(AtomicBool::new(false));
+        let stats = Arc::new(Mutex::new(BackendStats::default()));
+        let thread_quit = quit.clone();
+        let thread_stopped = stopped.clone();
+        let thread_stats = stats.clone();
+
+        let thread = thread::Builder::new()
+            .name("backend".to_owned())
+            .spawn(move || {
+                let queues = run(backend, queues, waker, &thread_quit, &thread_stats);
+                thread_stopped.store(true, Ordering::Release);
+                queues
+            });
+
+        match thread {
+            Ok(thread) => {
+                Some(BackendThread {
+                    requests: requests,
+                    replies: replies,
+                    free_requests: free_requests,
+                    free_replies: free_replies,
+                    quit: quit,
+                    stopped: stopped,
+                    stats: stats,
+                    thread: Some(thread),
+                })
+            }
+            Err(e) => {
+                println!("Unable to create backend thread: {}", e);
+                None
+            }
+        }
+    }
+
+    /// The thread stops if the backend instance goes away (such as when the plugin is reloaded)
+    pub fn is_stopped(&self) -> bool {
+        self.stopped.load(Ordering::Acquire)
+    }
+
+    /// Updates of the backend since the thread was started
+    pub fn get_stats(&self) -> BackendStats {
+        *self.stats.lock().unwrap()
+    }
+
+    /// If there is room for more requests (the backend is keeping up)
+    pub fn can_send(&self) -> bool {
+        !self.requests.is_full()
+    }
+
+    /// Sends the requests in the writer to the backend and replaces it with an empty one. If the
+    /// backend is behind the writer is left as is so the views can keep adding to it.
+    pub fn send_requests(&mut self, writer: &mut Writer) {
+        if self.requests.is_full() {
+            return;
+        }
+
+        let mut empty = match self.free_requests.pop() {
+            Some(stream) => stream.0,
+            None => WriterWrapper::create_writer(),
+        };
+
+        ReaderWrapper::reset_writer(&mut empty);
+
+        let requests = mem::replace(writer, empty);
+
+        if let Err(stream) = self.requests.push(Stream(requests)) {
+            WriterWrapper::destroy_writer(stream.0);
+        }
+
+        if let Some(ref thread) = self.thread {
+            thread.thread().unpark();
+        }
+    }
+
+    /// Returns the next reply from the backend. The writer is finalized and should be given back
+    /// with release_reply when it's no longer used.
+    pub fn receive_reply(&mut self) -> Option<Writer> {
+        self.replies.pop().map(|stream| stream.0)
+    }
+
+    pub fn release_reply(&mut self, writer: Writer) {
+        if let Err(stream) = self.free_replies.push(Stream(writer)) {
+            WriterWrapper::destroy_writer(stream.0);
+        }
+    }
+}
+
+impl Drop for BackendThread {
+    fn drop(&mut self) {
+        self.quit.store(true, Ordering::Release);
+
+        if let Some(thread) = self.thread.take() {
+            thread.thread().unpark();
+
+            // requests the backend never got and replies given back after the thread stopped (the
+            // session releases its replies just before dropping this)
+
+            if let Ok(mut queues) = thread.join() {
+                destroy_all(&mut queues.requests);
+                destroy_all(&mut queues.free_replies);
+            }
+        }
+
+        // the backend thread has given back what it had so everything left is in the queues
+
+        while let Some(stream) = self.replies.pop() {
+            WriterWrapper::destroy_writer(stream.0);
+        }
+
+        while let Some(stream) = self.free_requests.pop() {
+            WriterWrapper::destroy_writer(stream.0);
+        }
+    }
+}
+
+fn destroy_all(consumer: &mut Consumer<Stream>) {
+    while let Some(stream) = consumer.pop() {
+        WriterWrapper::destroy_writer(stream.0);
+    }
+}
+
+fn give_back(producer: &mut Producer<Stream>, writer: Writer) {
+    if let Err(stream) = producer.push(Stream(writer)) {
+        WriterWrapper::destroy_writer(stream.0);
+    }
+}
+
+fn run(backend: Backend,
+       mut queues: Queues,
+       waker: Option<FrameWaker>,
+       quit: &AtomicBool,
+       stats: &Mutex<BackendStats>)
+       -> Queues {
+    let mut reader = ReaderWrapper::create_reader();
+    let empty = WriterWrapper::create_writer();
+    // reply that couldn't be sent as the UI is behind, the backend keeps adding to it
+    let mut pending: Option<Writer> = None;
+    let mut idle_update_ms = MIN_IDLE_UPDATE_MS;
+    let mut sample_name = SampleName::new(&backend.name);
+
+    profiler::set_thread_name(&format!("Backend {}", backend.name));
+
+    while !quit.load(Ordering::Acquire) {
+        let request = match queues.requests.pop() {
+            Some(stream) => Some(stream.0),
+            None => {
+                thread::park_timeout(Duration::from_millis(idle_update_ms));
+                queues.requests.pop().map(|stream| stream.0)
+            }
+        };
+
+        if request.is_some() {
+            idle_update_ms = MIN_IDLE_UPDATE_MS;
+        }
+
+        match request {
+            Some(ref writer) => ReaderWrapper::init_from_writer(&mut reader, writer),
+            None => ReaderWrapper::init_from_writer(&mut reader, &empty),
+        }
+
+        let mut reply = match pending.take() {
+            Some(writer) => writer,
+            None => {
+                match queues.free_replies.pop() {
+                    Some(stream) => {
+                        let mut writer = stream.0;
+                        ReaderWrapper::reset_writer(&mut writer);
+                        writer
+                    }
+                    None => WriterWrapper::create_writer(),
+                }
+            }
+        };
+
+        let alive = backend.alive.begin_update();
+
+        if alive {
+            let start = Instant::now();
+
+            {
+                let _sample = profiler::begin(&mut sample_name);
+                (backend.update)(backend.plugin_data, 0, reader.api as *mut c_void, reply.api as *mut c_void);
+            }
+
+            backend.alive.end_update();
+
+            let update_time = start.elapsed();
+            let mut stats = stats.lock().unwrap();
+            stats.updates += 1;
+            stats.update_time += update_time;
+        }
+
+        if let Some(writer) = request {
+            give_back(&mut queues.free_requests, writer);
+        }
+
+        if !alive {
+            WriterWrapper::destroy_writer(reply);
+            break;
+        }
+
+        if WriterWrapper::get_size(&reply) == 0 {
+            pending = Some(reply);
+            idle_update_ms = (idle_update_ms * 2).min(MAX_IDLE_UPDATE_MS);
+            continue;
+        }
+
+        idle_update_ms = MIN_IDLE_UPDATE_MS;
+
+        WriterWrapper::finalize(&mut reply);
+
+        match queues.replies.push(Stream(reply)) {
+            Ok(()) => {
+                if let Some(ref waker) = waker {
+                    waker.wake();
+                }
+            }
+            Err(stream) => pending = Some(stream.0),
+        }
+    }
+
+    if let Some(writer) = pending {
+        WriterWrapper::destroy_writer(writer);
+    }
+
+    WriterWrapper::destroy_writer(empty);
+    ReaderWrapper::destroy_reader(reader);
+
+    queues
+}
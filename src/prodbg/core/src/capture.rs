@@ -0,0 +1,70 @@
+use std::ffi::CString;
+use libc::{c_char, c_int, c_void};
+use prodbg_api::read_write::{CPDReaderAPI, Reader, Writer};
+use reader_wrapper::ReaderWrapper;
+
+///! Records the streams sent to and from a backend in a session to a capture file (see pd_capture.h for the
+///! format.) The file can then be played back with the Replay Backend plugin.
+///!
+pub struct Capture {
+    handle: *mut c_void,
+    reader: Reader,
+}
+
+#[derive(Clone, Copy)]
+enum RecordType {
+    Request = 1,
+    Reply = 2,
+}
+
+impl Capture {
+    pub fn new(filename: &str) -> Option<Capture> {
+        let name = match CString::new(filename) {
+            Ok(name) => name,
+            Err(_) => return None,
+        };
+
+        let handle = unsafe { pd_capture_writer_create(name.as_ptr()) };
+
+        if handle.is_null() {
+            return None;
+        }
+
+        Some(Capture {
+            handle: handle,
+            reader: ReaderWrapper::create_reader(),
+        })
+    }
+
+    /// Records the requests that are about to be sent to the backend
+    pub fn write_request(&mut self, writer: &Writer) {
+        ReaderWrapper::init_from_writer(&mut self.reader, writer);
+
+        unsafe {
+            pd_capture_writer_write_reader(self.handle, RecordType::Request as c_int, self.reader.api);
+        }
+    }
+
+    /// Records the replies from the backend
+    pub fn write_reply(&mut self, reader: &Reader) {
+        unsafe {
+            pd_capture_writer_write_reader(self.handle, RecordType::Reply as c_int, reader.api);
+        }
+    }
+}
+
+impl Drop for Capture {
+    fn drop(&mut self) {
+        unsafe {
+            pd_capture_writer_destroy(self.handle);
+        }
+
+        ReaderWrapper::destroy_reader(Reader::new(self.reader.api, 0));
+    }
+}
+
+extern "C" {
+    fn pd_capture_writer_create(filename: *const c_char) -> *mut c_void;
+    fn pd_capture_writer_destroy(capture: *mut c_void);
+    fn pd_capture_writer_write_reader(capture: *mut c_void, record_type: c_int, reader: *mut CPDReaderAPI) -> c_int;
+}
@@ -0,0 +1,252 @@
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::thread::{self, Thread};
+use std::time::{Duration, Instant};
+
+///! Decides when the main loop runs a full frame (updating the sessions and views and rendering.)
+///! Nothing is drawn unless something has marked the scheduler dirty:
+///!
+///! input:     the user moved the mouse, pressed a button or a key (see Windows::poll_input)
+///! backend:   a backend thread has sent a reply (through the FrameWaker)
+///! timer:     a timer added with add_timer has expired (there is also a heartbeat frame every
+///!            HEARTBEAT_MS so things like memory cache retries still happen)
+///! reload:    a plugin has been reloaded
+///!
+///! When nothing is dirty the main loop waits in wait() until a backend wakes it or it's time to
+///! poll the input again. A backend that keeps sending replies without any input from the user
+///! (such as a running target printing output) only gets a frame every RUNNING_TICK_MS.
+///!
+
+/// How often the input is polled when idle (the windows has no way to wait for events)
+const INPUT_POLL_MS: u64 = 16;
+/// Frames caused only by backend traffic are at most this often
+const RUNNING_TICK_MS: u64 = 100;
+const HEARTBEAT_MS: u64 = 1000;
+/// Frames drawn after something has changed as the UI needs a frame or two to settle (layout, hovering)
+const SETTLE_FRAMES: u32 = 2;
+
+/// The reasons for a frame (returned by begin_frame)
+pub mod dirty {
+    pub const INPUT: u32 = 1 << 0;
+    pub const BACKEND: u32 = 1 << 1;
+    pub const TIMER: u32 = 1 << 2;
+    pub const RELOAD: u32 = 1 << 3;
+    /// One of the frames after a change (see SETTLE_FRAMES)
+    pub const SETTLE: u32 = 1 << 4;
+}
+
+///
+/// Given to the backend threads so they can wake up the main loop when there is a reply
+///
+#[derive(Clone)]
+pub struct FrameWaker {
+    thread: Thread,
+    woken: Arc<AtomicBool>,
+}
+
+impl FrameWaker {
+    pub fn wake(&self) {
+        self.woken.store(true, Ordering::Release);
+        self.thread.unpark();
+    }
+}
+
+pub struct FrameScheduler {
+    dirty: u32,
+    settle_frames: u32,
+    timers: Vec<Instant>,
+    last_frame: Instant,
+    last_backend_frame: Option<Instant>,
+    waker: FrameWaker,
+}
+
+impl FrameScheduler {
+    /// Needs to be created on the thread that runs the main loop (as that is the thread being woken)
+    pub fn new() -> FrameScheduler {
+        FrameScheduler {
+            // the first frame is always drawn
+            dirty: dirty::INPUT,
+            settle_frames: 0,
+            timers: Vec::new(),
+            last_frame: Instant::now(),
+            last_backend_frame: None,
+            waker: FrameWaker {
+                thread: thread::current(),
+                woken: Arc::new(AtomicBool::new(false)),
+            },
+        }
+    }
+
+    pub fn get_waker(&self) -> FrameWaker {
+        self.waker.clone()
+    }
+
+    pub fn mark_dirty(&mut self, reason: u32) {
+        self.dirty |= reason;
+    }
+
+    /// Draw a frame after the delay (even if nothing else has changed)
+    pub fn add_timer(&mut self, delay: Duration) {
+        self.timers.push(Instant::now() + delay);
+    }
+
+    ///
+    /// Returns the reasons for running a frame now (see the dirty mod) or 0 if the frame should be
+    /// skipped and the main loop should call wait()
+    ///
+    pub fn begin_frame(&mut self, now: Instant) -> u32 {
+        if self.waker.woken.swap(false, Ordering::AcqRel) {
+            self.dirty |= dirty::BACKEND;
+        }
+
+        let timer_count = self.timers.len();
+        self.timers.retain(|timer| *timer > now);
+
+        if self.timers.len() != timer_count || now >= self.last_frame + Duration::from_millis(HEARTBEAT_MS) {
+            self.dirty |= dirty::TIMER;
+        }
+
+        // replies keeps coming without anything else happening so only show them at a low rate. The dirty
+        // state is kept so the replies are shown when the tick is up
+
+        let throttled = self.dirty == dirty::BACKEND &&
+                        self.last_backend_frame.map_or(false, |last| now < last + Duration::from_millis(RUNNING_TICK_MS));
+
+        let reasons = if self.dirty != 0 && !throttled {
+            if self.dirty == dirty::BACKEND {
+                self.last_backend_frame = Some(now);
+            } else {
+                self.last_backend_frame = None;
+            }
+
+            self.settle_frames = SETTLE_FRAMES;
+            let reasons = self.dirty;
+            self.dirty = 0;
+            reasons
+        } else if self.settle_frames > 0 {
+            self.settle_frames -= 1;
+            dirty::SETTLE
+        } else {
+            return 0;
+        };
+
+        self.last_frame = now;
+
+        reasons
+    }
+
+    ///
+    /// Waits until a backend has sent something, a timer is due or it's time to poll the input again
+    ///
+    pub fn wait(&self) {
+        let now = Instant::now();
+        let mut until = now + Duration::from_millis(INPUT_POLL_MS);
+
+        for timer in &self.timers {
+            if *timer < until {
+                until = *timer;
+            }
+        }
+
+        if self.dirty == dirty::BACKEND {
+            if let Some(last) = self.last_backend_frame {
+                let tick = last + Duration::from_millis(RUNNING_TICK_MS);
+
+                if tick < until {
+                    until = tick;
+                }
+            }
+        }
+
+        if until <= now || self.waker.woken.load(Ordering::Acquire) {
+            return;
+        }
+
+        thread::park_timeout(until - now);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::thread;
+    use std::time::{Duration, Instant};
+
+    #[test]
+    fn idle_after_settle() {
+        let mut scheduler = FrameScheduler::new();
+        let now = Instant::now();
+
+        assert_eq!(scheduler.begin_frame(now), dirty::INPUT);
+
+        for _ in 0..SETTLE_FRAMES {
+            assert_eq!(scheduler.begin_frame(now), dirty::SETTLE);
+        }
+
+        assert_eq!(scheduler.begin_frame(now), 0);
+
+        scheduler.mark_dirty(dirty::RELOAD);
+        assert_eq!(scheduler.begin_frame(now), dirty::RELOAD);
+    }
+
+    #[test]
+    fn heartbeat() {
+        let mut scheduler = FrameScheduler::new();
+        let now = Instant::now();
+
+        scheduler.begin_frame(now);
+
+        for _ in 0..SETTLE_FRAMES {
+            scheduler.begin_frame(now);
+        }
+
+        assert_eq!(scheduler.begin_frame(now + Duration::from_millis(HEARTBEAT_MS / 2)), 0);
+        assert_eq!(scheduler.begin_frame(now + Duration::from_millis(HEARTBEAT_MS)), dirty::TIMER);
+    }
+
+    #[test]
+    fn backend_traffic_is_throttled() {
+        let mut scheduler = FrameScheduler::new();
+        let waker = scheduler.get_waker();
+        let now = Instant::now();
+
+        scheduler.begin_frame(now);
+
+        waker.wake();
+        assert_eq!(scheduler.begin_frame(now), dirty::BACKEND);
+
+        // more replies right after only gets the settle frames and then waits for the tick
+
+        waker.wake();
+
+        for _ in 0..SETTLE_FRAMES {
+            assert_eq!(scheduler.begin_frame(now), dirty::SETTLE);
+        }
+
+        assert_eq!(scheduler.begin_frame(now), 0);
+
+        let tick = now + Duration::from_millis(RUNNING_TICK_MS);
+        assert_eq!(scheduler.begin_frame(tick), dirty::BACKEND);
+
+        // input isn't throttled
+
+        waker.wake();
+        scheduler.mark_dirty(dirty::INPUT);
+        assert_eq!(scheduler.begin_frame(tick), dirty::INPUT | dirty::BACKEND);
+    }
+
+    #[test]
+    fn wake_from_other_thread() {
+        let scheduler = FrameScheduler::new();
+        let waker = scheduler.get_waker();
+        let start = Instant::now();
+
+        let thread = thread::spawn(move || waker.wake());
+        thread.join().unwrap();
+
+        // returns right away as there is a pending wake
+        scheduler.wait();
+
+        assert!(start.elapsed() < Duration::from_millis(INPUT_POLL_MS * 10));
+    }
+}
@@ -8,6 +8,14 @@ pub mod plugin;
 pub mod view_plugins;
 pub mod backend_plugin;
 pub mod reader_wrapper;
+pub mod spsc_queue;
+pub mod slot_map;
+pub mod capture;
+pub mod request_coalescer;
+pub mod memory_cache;
+pub mod frame_scheduler;
+pub mod profiler;
+pub mod backend_thread;
 pub mod session;
 
 pub use dynamic_reload::*;
@@ -0,0 +1,91 @@
+use std::ffi::CStr;
+use libc::{c_char, c_void};
+use prodbg_api::read_write::{CPDReaderAPI, CPDWriterAPI, Reader, Writer};
+
+///! Memory of the target shared by all the views of a session (see pd_memory_cache.h.) Views reads it
+///! through the "Memory Cache 1" service and the session sends one batch of GetMemory events for what
+///! they missed.
+///!
+pub struct MemoryCache {
+    handle: *mut c_void,
+}
+
+#[derive(Default, Clone, Copy, Debug)]
+#[repr(C)]
+pub struct MemoryCacheStats {
+    pub page_count: u32,
+    pub requests: u32,
+    pub requested_bytes: u64,
+    pub received_bytes: u64,
+}
+
+static SERVICE_NAME: &'static [u8] = b"Memory Cache 1\0";
+
+impl MemoryCache {
+    pub fn new() -> MemoryCache {
+        MemoryCache { handle: unsafe { pd_memory_cache_create() } }
+    }
+
+    /// Writes GetMemory events for the memory the views missed since the last call
+    pub fn write_requests(&mut self, writer: &mut Writer) {
+        unsafe {
+            pd_memory_cache_write_requests(self.handle, writer.api);
+        }
+    }
+
+    /// Takes the memory (and StateChanged events) from the replies of the backend
+    pub fn update(&mut self, reader: &Reader) {
+        unsafe {
+            pd_memory_cache_update(self.handle, reader.api);
+        }
+    }
+
+    pub fn clear(&mut self) {
+        unsafe {
+            pd_memory_cache_clear(self.handle);
+        }
+    }
+
+    /// The views updated after this uses this cache through the service
+    pub fn make_current(&self) {
+        unsafe {
+            pd_memory_cache_set_current(self.handle);
+        }
+    }
+
+    pub fn get_stats(&self) -> MemoryCacheStats {
+        let mut stats = MemoryCacheStats::default();
+        unsafe { pd_memory_cache_get_stats(self.handle, &mut stats) };
+        stats
+    }
+
+    /// Returns the service functions if name is the memory cache service
+    pub fn get_service(name: *const c_char) -> Option<*mut c_void> {
+        let name = unsafe { CStr::from_ptr(name) };
+
+        if name.to_bytes_with_nul() == SERVICE_NAME {
+            Some(unsafe { pd_memory_cache_get_funcs() })
+        } else {
+            None
+        }
+    }
+}
+
+impl Drop for MemoryCache {
+    fn drop(&mut self) {
+        unsafe {
+            pd_memory_cache_destroy(self.handle);
+        }
+    }
+}
+
+extern "C" {
+    fn pd_memory_cache_create() -> *mut c_void;
+    fn pd_memory_cache_destroy(cache: *mut c_void);
+    fn pd_memory_cache_write_requests(cache: *mut c_void, writer: *mut CPDWriterAPI);
+    fn pd_memory_cache_update(cache: *mut c_void, reader: *mut CPDReaderAPI);
+    fn pd_memory_cache_clear(cache: *mut c_void);
+    fn pd_memory_cache_get_stats(cache: *mut c_void, stats: *mut MemoryCacheStats);
+    fn pd_memory_cache_set_current(cache: *mut c_void);
+    fn pd_memory_cache_get_funcs() -> *mut c_void;
+}
@@ -25,6 +25,7 @@ pub struct ReloadHandler<'a> {
     pub plugins: &'a mut Plugins,
     pub instance_count: i32,
     pub name: String,
+    pub reloaded: bool,
 }
 
 pub trait PluginHandler {
@@ -61,6 +62,7 @@ impl<'a> ReloadHandler<'a> {
             plugins: plugins,
             instance_count: 0,
             name: "".to_string(),
+            reloaded: false,
         }
     }
 
@@ -91,6 +93,8 @@ impl<'a> ReloadHandler<'a> {
     }
 
     fn callback(&mut self, state: UpdateState, lib: Option<&Rc<Lib>>) {
+        self.reloaded = true;
+
         match state {
             UpdateState::Before => Self::unload_plugins(self, lib.unwrap()),
             UpdateState::After => Self::reload_plugins(self, lib.unwrap()),
@@ -122,9 +126,11 @@ impl Plugins {
         }
     }
 
-    pub fn update(&mut self, lib_handler: &mut DynamicReload) {
+    /// Reloads the plugins that has changed. Returns true if anything was (or failed to be) reloaded
+    pub fn update(&mut self, lib_handler: &mut DynamicReload) -> bool {
         let mut handler = ReloadHandler::new(self);
         lib_handler.update(ReloadHandler::callback, &mut handler);
+        handler.reloaded
     }
 
     unsafe fn add_p(&mut self, library: &Rc<Lib>) {
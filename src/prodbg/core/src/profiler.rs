@@ -0,0 +1,196 @@
+use std::ffi::{CStr, CString};
+use std::ptr;
+use std::sync::{Mutex, Once};
+use std::sync::atomic::{AtomicBool, AtomicPtr, Ordering};
+use libc::{c_char, c_int, c_void};
+
+///! Hot path instrumentation using Remotery (src/native/external/remotery.) Profiling is off unless
+///! started (ProDBG does it when given --profile) and until then a sample only costs the test of a
+///! flag. When running open vis/index.html in the Remotery directory to see the samples.
+///!
+///! Samples are made for the frame, the session updates, the update of each backend and view (named
+///! after the plugin) and in the C code for reading/writing streams and sending them (pd_profiler.h.)
+///! Plugins can add their own through the "Profiler 1" service (PDProfilerFuncs in pd_host.h.)
+///!
+
+#[repr(C)]
+pub struct CProfilerFuncs {
+    pub begin_sample: unsafe extern "C" fn(name: *const c_char, hash_cache: *mut u32),
+    pub end_sample: unsafe extern "C" fn(),
+}
+
+static FUNCS: CProfilerFuncs = CProfilerFuncs {
+    begin_sample: _rmt_BeginCPUSample,
+    end_sample: _rmt_EndCPUSample,
+};
+
+static SERVICE_NAME: &'static [u8] = b"Profiler 1\0";
+
+static ENABLED: AtomicBool = AtomicBool::new(false);
+static INSTANCE: AtomicPtr<c_void> = AtomicPtr::new(0 as *mut c_void);
+
+/// Starts profiling. Needs to be done before any plugins are created as they look for the service
+/// when created. Returns false if Remotery couldn't be started.
+pub fn start() -> bool {
+    if is_enabled() {
+        return true;
+    }
+
+    let mut instance = ptr::null_mut();
+
+    if unsafe { _rmt_CreateGlobalInstance(&mut instance) } != 0 {
+        println!("Unable to start the profiler");
+        return false;
+    }
+
+    INSTANCE.store(instance, Ordering::Release);
+    ENABLED.store(true, Ordering::Release);
+
+    unsafe { pd_profiler_set_funcs(&FUNCS) };
+
+    true
+}
+
+pub fn stop() {
+    if !ENABLED.swap(false, Ordering::AcqRel) {
+        return;
+    }
+
+    unsafe {
+        pd_profiler_set_funcs(ptr::null());
+        _rmt_DestroyGlobalInstance(INSTANCE.swap(ptr::null_mut(), Ordering::AcqRel));
+    }
+}
+
+pub fn is_enabled() -> bool {
+    ENABLED.load(Ordering::Acquire)
+}
+
+/// Name of the current thread in the profiler
+pub fn set_thread_name(name: &str) {
+    if is_enabled() {
+        unsafe { _rmt_SetCurrentThreadName(intern(name)) };
+    }
+}
+
+/// Returns the service functions if name is the profiler service (null if profiling isn't enabled)
+pub fn get_service(name: *const c_char) -> Option<*mut c_void> {
+    let name = unsafe { CStr::from_ptr(name) };
+
+    if name.to_bytes_with_nul() != SERVICE_NAME {
+        return None;
+    }
+
+    if is_enabled() {
+        Some(&FUNCS as *const CProfilerFuncs as *mut c_void)
+    } else {
+        Some(ptr::null_mut())
+    }
+}
+
+///
+/// Name of a sample. Remotery keeps the pointer to the name until the sample has been sent so the names
+/// are never freed (the same name is only stored once.) Each SampleName has its own hash cache so only
+/// use it from one thread.
+///
+pub struct SampleName {
+    name: *const c_char,
+    hash: u32,
+}
+
+impl SampleName {
+    pub fn new(name: &str) -> SampleName {
+        SampleName {
+            name: intern(name),
+            hash: 0,
+        }
+    }
+}
+
+///
+/// Ends the sample when dropped
+///
+pub struct Sample {
+    active: bool,
+}
+
+/// Starts a sample that lasts until the returned value is dropped
+pub fn begin(name: &mut SampleName) -> Sample {
+    if !is_enabled() {
+        return Sample { active: false };
+    }
+
+    unsafe { _rmt_BeginCPUSample(name.name, &mut name.hash) };
+
+    Sample { active: true }
+}
+
+impl Drop for Sample {
+    fn drop(&mut self) {
+        if self.active {
+            unsafe { _rmt_EndCPUSample() };
+        }
+    }
+}
+
+static NAMES_INIT: Once = Once::new();
+static mut NAMES: *const Mutex<Vec<CString>> = 0 as *const Mutex<Vec<CString>>;
+
+fn intern(name: &str) -> *const c_char {
+    let names = unsafe {
+        NAMES_INIT.call_once(|| NAMES = Box::into_raw(Box::new(Mutex::new(Vec::new()))));
+        &*NAMES
+    };
+
+    let mut names = names.lock().unwrap();
+
+    if let Some(interned) = names.iter().find(|interned| interned.to_bytes() == name.as_bytes()) {
+        return interned.as_ptr();
+    }
+
+    let interned = CString::new(name).unwrap_or_else(|_| CString::new("invalid name").unwrap());
+    let ptr = interned.as_ptr();
+
+    names.push(interned);
+
+    ptr
+}
+
+extern "C" {
+    fn _rmt_CreateGlobalInstance(remotery: *mut *mut c_void) -> c_int;
+    fn _rmt_DestroyGlobalInstance(remotery: *mut c_void);
+    fn _rmt_SetCurrentThreadName(thread_name: *const c_char);
+    fn _rmt_BeginCPUSample(name: *const c_char, hash_cache: *mut u32);
+    fn _rmt_EndCPUSample();
+
+    fn pd_profiler_set_funcs(funcs: *const CProfilerFuncs);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn names_are_interned() {
+        let a = SampleName::new("Interned");
+        let b = SampleName::new("Interned");
+        let c = SampleName::new("Other");
+
+        assert_eq!(a.name, b.name);
+        assert!(a.name != c.name);
+    }
+
+    #[test]
+    fn disabled_service() {
+        let name = CString::new("Profiler 1").unwrap();
+        let other = CString::new("Profiler 2").unwrap();
+
+        assert_eq!(get_service(name.as_ptr()), Some(ptr::null_mut()));
+        assert_eq!(get_service(other.as_ptr()), None);
+
+        // samples are no-ops when not enabled
+        let mut sample_name = SampleName::new("Disabled");
+        let sample = begin(&mut sample_name);
+        assert!(!sample.active);
+    }
+}
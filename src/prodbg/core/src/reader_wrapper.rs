@@ -1,4 +1,6 @@
-use std::os::raw::c_void;
+use std::os::raw::{c_char, c_void};
+use std::ptr;
+use libc::free;
 
 use prodbg_api::read_write::{CPDReaderAPI, CPDWriterAPI, Reader, Writer};
 
@@ -8,18 +10,33 @@ pub struct WriterWrapper;
 impl ReaderWrapper {
     pub fn create_reader() -> Reader {
         unsafe {
-            Reader::new(pd_binary_reader_create(), 0)
+            let api = pd_binary_reader_create();
+            // All views reads the same stream so build the field index once up front
+            pd_binary_reader_set_use_index(api, 1);
+            Reader::new(api, 0)
         }
     }
 
+    /// Reader for a view. It shares the field index with the session reader (see init_view) so it doesn't
+    /// build one itself.
+    pub fn create_view_reader() -> Reader {
+        unsafe { Reader::new(pd_binary_reader_create(), 0) }
+    }
+
+    /// Reads the stream of a writer in this process. Data references to memory in this process are only
+    /// allowed for readers set up this way (see pd_binary_reader_init_from_writer)
     pub fn init_from_writer(reader: &mut Reader, writer: &Writer) {
         unsafe {
-            pd_binary_writer_finalize(writer.api);
-
-            let data = pd_binary_writer_get_data(writer.api);
-            let size = pd_binary_writer_get_size(writer.api);
+            pd_binary_reader_init_from_writer(reader.api, writer.api);
+        }
+    }
 
-            pd_binary_reader_init_stream(reader.api, data, size);
+    /// Sets up a reader to read the same stream as source with its own position and event filter (see
+    /// pd_binary_reader_init_view.) Needs to be done each time the source has a new stream.
+    #[inline]
+    pub fn init_view(reader: &mut Reader, source: &Reader) {
+        unsafe {
+            pd_binary_reader_init_view(reader.api, source.api);
         }
     }
 
@@ -36,14 +53,58 @@ impl ReaderWrapper {
             pd_binary_reader_reset(reader.api);
         }
     }
+
+    /// Writes all events of the reader to the writer (see pd_binary_reader_copy_events)
+    pub fn copy_events(reader: &Reader, writer: &mut Writer) {
+        unsafe {
+            pd_binary_reader_copy_events(reader.api, writer.api);
+        }
+    }
+
+    /// Writes the fields of the current event of the reader to the writer. The writer has to be
+    /// inside an event (see pd_binary_reader_copy_event)
+    pub fn copy_event(reader: &Reader, writer: &mut Writer) {
+        unsafe {
+            pd_binary_reader_copy_event(reader.api, writer.api, ptr::null());
+        }
+    }
+
+    pub fn destroy_reader(reader: Reader) {
+        unsafe {
+            pd_binary_reader_destroy(reader.api);
+        }
+    }
 }
 
 impl WriterWrapper {
     pub fn create_writer() -> Writer {
         unsafe {
-            Writer {
-                api: pd_binary_writer_create(),
-            }
+            let api = pd_binary_writer_create();
+            // Session streams are always finalized before being read so it's safe to intern the keys
+            pd_binary_writer_set_intern_keys(api, 1);
+            Writer { api: api }
+        }
+    }
+
+    /// Writes the size header (and key table) so the stream can be read
+    #[inline]
+    pub fn finalize(writer: &mut Writer) {
+        unsafe {
+            pd_binary_writer_finalize(writer.api);
+        }
+    }
+
+    /// Size of what has been written (0 if nothing has been written since the last reset)
+    #[inline]
+    pub fn get_size(writer: &Writer) -> u32 {
+        unsafe { pd_binary_writer_get_size(writer.api) }
+    }
+
+    pub fn destroy_writer(writer: Writer) {
+        unsafe {
+            // destroy only frees the data of the writer
+            pd_binary_writer_destroy(writer.api);
+            free(writer.api as *mut c_void);
         }
     }
 }
@@ -52,10 +113,16 @@ extern "C" {
     fn pd_binary_writer_finalize(api: *mut CPDWriterAPI);
     fn pd_binary_writer_reset(api: *mut CPDWriterAPI);
     fn pd_binary_writer_create() -> *mut CPDWriterAPI;
-    fn pd_binary_writer_get_data(api: *mut CPDWriterAPI) -> *mut c_void;
     fn pd_binary_writer_get_size(api: *mut CPDWriterAPI) -> u32;
+    fn pd_binary_writer_set_intern_keys(api: *mut CPDWriterAPI, enable: i32);
+    fn pd_binary_writer_destroy(api: *mut CPDWriterAPI);
 
     fn pd_binary_reader_create() -> *mut CPDReaderAPI;
-    fn pd_binary_reader_init_stream(api: *mut CPDReaderAPI, data: *mut c_void, size: u32);
+    fn pd_binary_reader_init_from_writer(api: *mut CPDReaderAPI, writer: *mut CPDWriterAPI);
     fn pd_binary_reader_reset(api: *mut CPDReaderAPI);
+    fn pd_binary_reader_set_use_index(api: *mut CPDReaderAPI, enable: i32);
+    fn pd_binary_reader_init_view(api: *mut CPDReaderAPI, source: *mut CPDReaderAPI);
+    fn pd_binary_reader_copy_events(api: *mut CPDReaderAPI, writer: *mut CPDWriterAPI);
+    fn pd_binary_reader_copy_event(api: *mut CPDReaderAPI, writer: *mut CPDWriterAPI, skip_key: *const c_char);
+    fn pd_binary_reader_destroy(api: *mut CPDReaderAPI);
 }
@@ -0,0 +1,70 @@
+use libc::{c_int, c_void};
+use prodbg_api::read_write::{CPDReaderAPI, CPDWriterAPI, Reader, Writer};
+use reader_wrapper::ReaderWrapper;
+
+///! Removes duplicated Get* requests that several views writes during the same frame before they are
+///! sent to the backend and gives each view its own reply when the replies comes back
+///! (see pd_request_coalescer.h for the details.)
+///!
+pub struct RequestCoalescer {
+    handle: *mut c_void,
+    reader: Reader,
+}
+
+#[derive(Default, Clone, Copy, Debug)]
+#[repr(C)]
+pub struct RequestCoalescerStats {
+    pub requests: u32,
+    pub sent: u32,
+    pub fanned_out: u32,
+}
+
+impl RequestCoalescer {
+    pub fn new() -> RequestCoalescer {
+        RequestCoalescer {
+            handle: unsafe { pd_request_coalescer_create() },
+            reader: ReaderWrapper::create_reader(),
+        }
+    }
+
+    /// Writes the requests of a frame to output with duplicates removed
+    pub fn coalesce(&mut self, requests: &Writer, output: &mut Writer) {
+        ReaderWrapper::init_from_writer(&mut self.reader, requests);
+
+        unsafe {
+            pd_request_coalescer_coalesce(self.handle, self.reader.api, output.api);
+        }
+    }
+
+    /// Returns true if the replies had to be fanned out in which case output holds the replies
+    /// that should be used instead.
+    pub fn fan_out(&mut self, replies: &Reader, output: &mut Writer) -> bool {
+        ReaderWrapper::reset_writer(output);
+
+        unsafe { pd_request_coalescer_fan_out(self.handle, replies.api, output.api) != 0 }
+    }
+
+    pub fn get_stats(&self) -> RequestCoalescerStats {
+        let mut stats = RequestCoalescerStats::default();
+        unsafe { pd_request_coalescer_get_stats(self.handle, &mut stats) };
+        stats
+    }
+}
+
+impl Drop for RequestCoalescer {
+    fn drop(&mut self) {
+        unsafe {
+            pd_request_coalescer_destroy(self.handle);
+        }
+
+        ReaderWrapper::destroy_reader(Reader::new(self.reader.api, 0));
+    }
+}
+
+extern "C" {
+    fn pd_request_coalescer_create() -> *mut c_void;
+    fn pd_request_coalescer_destroy(coalescer: *mut c_void);
+    fn pd_request_coalescer_coalesce(coalescer: *mut c_void, requests: *mut CPDReaderAPI, writer: *mut CPDWriterAPI);
+    fn pd_request_coalescer_fan_out(coalescer: *mut c_void, replies: *mut CPDReaderAPI, writer: *mut CPDWriterAPI) -> c_int;
+    fn pd_request_coalescer_get_stats(coalescer: *mut c_void, stats: *mut RequestCoalescerStats);
+}
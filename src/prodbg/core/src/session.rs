@@ -1,9 +1,15 @@
 use prodbg_api::read_write::{Reader, Writer};
-use prodbg_api::backend::{CBackendCallbacks};
+use prodbg_api::backend::{EVENT_STATE_CHANGED, STATE_EPOCH};
 use plugins::PluginHandler;
 use reader_wrapper::{ReaderWrapper, WriterWrapper};
 use backend_plugin::{BackendHandle, BackendPlugins};
-use libc::{c_void};
+use backend_thread::{BackendThread, BackendStats};
+use capture::Capture;
+use request_coalescer::RequestCoalescer;
+use memory_cache::MemoryCache;
+use frame_scheduler::FrameWaker;
+use profiler::{self, SampleName};
+use slot_map::SlotMap;
 
 #[derive(PartialEq, Eq, Clone, Copy, Debug)]
 pub struct SessionHandle(pub u64);
@@ -25,10 +31,35 @@ pub struct Session {
     pub handle: SessionHandle,
     pub reader: Reader,
 
-    current_writer: usize,
-    writers: [Writer; 2],
+    /// Views writes their requests here during a frame
+    writer: Writer,
+    /// Used when the backend has sent more than one reply since the last frame
+    merge_writer: Writer,
+    /// Replies from the backend thread that the reader currently points into
+    replies: Vec<Writer>,
+    /// The requests from writer with duplicates removed (these are what the backend gets)
+    coalesced_writer: Writer,
+    /// Used when replies to coalesced requests needs to be given to several views
+    fan_out_writer: Writer,
+    coalescer: RequestCoalescer,
+
+    /// Finds the StateChanged events in the replies
+    state_reader: Reader,
+    /// The last StateChanged event from the backend. It's given to the views each frame so views
+    /// that are opened later also see the current epoch (see PDStateChange in pd_backend.h)
+    state_writer: Writer,
+    /// Used when the last StateChanged event needs to be added in front of the replies
+    state_merge_writer: Writer,
+    state_epoch: Option<u32>,
+
+    memory_cache: MemoryCache,
 
     backend: Option<BackendHandle>,
+    backend_thread: Option<BackendThread>,
+    /// Given to the backend thread so replies wakes up the main loop
+    frame_waker: Option<FrameWaker>,
+    capture: Option<Capture>,
+    sample_name: SampleName,
 }
 
 ///! Connection options for Remote connections. Currently just one Ip adderss
@@ -41,46 +72,258 @@ impl Session {
     pub fn new(handle: SessionHandle) -> Session {
         Session {
             handle: handle,
-            writers: [
-                WriterWrapper::create_writer(),
-                WriterWrapper::create_writer(),
-            ],
             reader: ReaderWrapper::create_reader(),
-            current_writer: 0,
+            writer: WriterWrapper::create_writer(),
+            merge_writer: WriterWrapper::create_writer(),
+            replies: Vec::new(),
+            coalesced_writer: WriterWrapper::create_writer(),
+            fan_out_writer: WriterWrapper::create_writer(),
+            coalescer: RequestCoalescer::new(),
+            state_reader: Self::create_state_reader(),
+            state_writer: WriterWrapper::create_writer(),
+            state_merge_writer: WriterWrapper::create_writer(),
+            state_epoch: None,
+            memory_cache: MemoryCache::new(),
             backend: None,
+            backend_thread: None,
+            frame_waker: None,
+            capture: None,
+            sample_name: SampleName::new("Session update"),
         }
     }
 
+    fn create_state_reader() -> Reader {
+        let mut reader = ReaderWrapper::create_view_reader();
+        reader.set_event_filter(&[EVENT_STATE_CHANGED]);
+        reader
+    }
+
     pub fn get_current_writer(&mut self) -> &mut Writer {
-        &mut self.writers[self.current_writer]
+        &mut self.writer
+    }
+
+    /// The epoch of the last StateChanged event from the backend (None if the backend hasn't
+    /// sent any)
+    pub fn get_state_epoch(&self) -> Option<u32> {
+        self.state_epoch
+    }
+
+    /// How much time the current backend has spent updating (None if there is no backend)
+    pub fn get_backend_stats(&self) -> Option<BackendStats> {
+        self.backend_thread.as_ref().map(|thread| thread.get_stats())
     }
 
     pub fn start_remote(_plugin_handler: &PluginHandler, _settings: &ConnectionSettings) {}
 
     pub fn start_local(_: &str, _: usize) {}
 
+    /// Used for backend threads started after this (see frame_scheduler.rs)
+    pub fn set_frame_waker(&mut self, waker: Option<FrameWaker>) {
+        self.frame_waker = waker;
+    }
+
     pub fn set_backend(&mut self, backend: Option<BackendHandle>) {
-        self.backend = backend
+        self.release_replies();
+        self.backend_thread = None;
+        self.backend = backend;
+        self.clear_state();
+    }
+
+    fn clear_state(&mut self) {
+        ReaderWrapper::reset_writer(&mut self.state_writer);
+        self.state_epoch = None;
+        self.memory_cache.clear();
+    }
+
+    /// Views updated after this reads memory from the cache of this session
+    pub fn make_memory_cache_current(&self) {
+        self.memory_cache.make_current();
+    }
+
+    ///
+    /// Keeps the last StateChanged event of the backend and adds it to the replies of frames
+    /// that has none. Views only request data when the epoch changes so they need to see it.
+    ///
+    fn update_state(&mut self, has_replies: bool) {
+        let mut found = false;
+
+        ReaderWrapper::init_view(&mut self.state_reader, &self.reader);
+
+        while let Some(_) = self.state_reader.get_event() {
+            ReaderWrapper::reset_writer(&mut self.state_writer);
+            self.state_writer.event_begin(EVENT_STATE_CHANGED);
+            ReaderWrapper::copy_event(&self.state_reader, &mut self.state_writer);
+            self.state_writer.event_end();
+
+            self.state_epoch = self.state_reader.find_u32(STATE_EPOCH).ok();
+            found = true;
+        }
+
+        if found || WriterWrapper::get_size(&self.state_writer) == 0 {
+            return;
+        }
+
+        if !has_replies {
+            ReaderWrapper::init_from_writer(&mut self.reader, &self.state_writer);
+            return;
+        }
+
+        ReaderWrapper::reset_writer(&mut self.state_merge_writer);
+
+        ReaderWrapper::init_from_writer(&mut self.state_reader, &self.state_writer);
+        ReaderWrapper::copy_events(&self.state_reader, &mut self.state_merge_writer);
+        ReaderWrapper::copy_events(&self.reader, &mut self.state_merge_writer);
+
+        ReaderWrapper::init_from_writer(&mut self.reader, &self.state_merge_writer);
+    }
+
+    /// Records everything sent to and from the backend to a file that can be played back with the
+    /// Replay Backend plugin. Returns false if the file can't be created.
+    pub fn start_capture(&mut self, filename: &str) -> bool {
+        self.capture = Capture::new(filename);
+        self.capture.is_some()
+    }
+
+    pub fn stop_capture(&mut self) {
+        self.capture = None;
+    }
+
+    fn release_replies(&mut self) {
+        for reply in self.replies.drain(..) {
+            match self.backend_thread {
+                Some(ref mut thread) => thread.release_reply(reply),
+                None => WriterWrapper::destroy_writer(reply),
+            }
+        }
+    }
+
+    ///
+    /// Sends what the views has requested to the backend without touching the replies (the views keeps
+    /// reading the ones they have.) The main loop calls this for frames it skips so requests doesn't wait
+    /// for the next frame being drawn
+    ///
+    pub fn flush_requests(&mut self) {
+        let thread = match self.backend_thread {
+            Some(ref mut thread) => thread,
+            None => return,
+        };
+
+        // memory the views missed last frame (see memory_cache.rs)
+        self.memory_cache.write_requests(&mut self.writer);
+
+        // if the backend is behind the requests stays in the writer and the views keeps adding to it
+
+        if WriterWrapper::get_size(&self.writer) > 0 && thread.can_send() {
+            // several views often asks for the same thing so only send each request once
+            ReaderWrapper::reset_writer(&mut self.coalesced_writer);
+            self.coalescer.coalesce(&self.writer, &mut self.coalesced_writer);
+            ReaderWrapper::reset_writer(&mut self.writer);
+
+            if WriterWrapper::get_size(&self.coalesced_writer) > 0 {
+                if let Some(ref mut capture) = self.capture {
+                    capture.write_request(&self.coalesced_writer);
+                }
+
+                thread.send_requests(&mut self.coalesced_writer);
+            }
+        }
     }
 
+    ///
+    /// The backend runs on its own thread (see backend_thread.rs) so this never waits for it. The
+    /// requests the views wrote last frame are sent to the backend and the reader is set up with
+    /// the replies that has arrived since the last update.
+    ///
     pub fn update(&mut self, backend_plugins: &mut BackendPlugins) {
-        // swap the writers
-        let c_writer = self.current_writer;
-        let p_writer = (self.current_writer + 1) & 1;
-        self.current_writer = p_writer;
-
-        ReaderWrapper::init_from_writer(&mut self.reader, &self.writers[p_writer]);
-        ReaderWrapper::reset_writer(&mut self.writers[c_writer]);
-
-        if let Some(backend) = backend_plugins.get_backend(self.backend) {
-            unsafe {
-                let plugin_funcs = backend.plugin_type.plugin_funcs as *mut CBackendCallbacks;
-                ((*plugin_funcs).update.unwrap())(backend.plugin_data,
-                                                  0,
-                                                  self.reader.api as *mut c_void,
-                                                  self.writers[p_writer].api as *mut c_void);
+        let _sample = profiler::begin(&mut self.sample_name);
+
+        // the thread stops when the backend goes away (plugin reload) so start a new one for the
+        // reloaded instance
+
+        if self.backend_thread.as_ref().map_or(false, |thread| thread.is_stopped()) {
+            self.release_replies();
+            self.backend_thread = None;
+            // the reloaded backend starts over with its epochs
+            self.clear_state();
+        }
+
+        if self.backend_thread.is_none() {
+            if let Some(backend) = backend_plugins.get_backend(self.backend) {
+                self.backend_thread = BackendThread::new(backend, self.frame_waker.clone());
+            }
+        }
+
+        // the views are done reading last frames replies
+
+        self.release_replies();
+
+        if self.backend_thread.is_none() {
+            ReaderWrapper::reset_writer(&mut self.writer);
+            ReaderWrapper::reset_writer(&mut self.merge_writer);
+            ReaderWrapper::init_from_writer(&mut self.reader, &self.merge_writer);
+            return;
+        }
+
+        self.flush_requests();
+
+        if let Some(ref mut thread) = self.backend_thread {
+            while let Some(reply) = thread.receive_reply() {
+                self.replies.push(reply);
+            }
+        }
+
+        match self.replies.len() {
+            0 => {
+                ReaderWrapper::reset_writer(&mut self.merge_writer);
+                ReaderWrapper::init_from_writer(&mut self.reader, &self.merge_writer);
+            }
+            1 => {
+                ReaderWrapper::init_from_writer(&mut self.reader, &self.replies[0]);
             }
+            _ => {
+                // views only have one reader so gather all the replies into one stream
+                ReaderWrapper::reset_writer(&mut self.merge_writer);
+
+                for reply in &self.replies {
+                    ReaderWrapper::init_from_writer(&mut self.reader, reply);
+                    ReaderWrapper::copy_events(&self.reader, &mut self.merge_writer);
+                }
+
+                ReaderWrapper::init_from_writer(&mut self.reader, &self.merge_writer);
+            }
+        }
+
+        // captures holds what the backend actually sent
+
+        if let Some(ref mut capture) = self.capture {
+            capture.write_reply(&self.reader);
         }
+
+        if self.coalescer.fan_out(&self.reader, &mut self.fan_out_writer) {
+            ReaderWrapper::init_from_writer(&mut self.reader, &self.fan_out_writer);
+        }
+
+        let has_replies = !self.replies.is_empty();
+        self.update_state(has_replies);
+
+        self.memory_cache.update(&self.reader);
+    }
+}
+
+impl Drop for Session {
+    fn drop(&mut self) {
+        self.release_replies();
+        // joins the thread so the backend is done with its writers
+        self.backend_thread = None;
+
+        WriterWrapper::destroy_writer(Writer { api: self.writer.api });
+        WriterWrapper::destroy_writer(Writer { api: self.merge_writer.api });
+        WriterWrapper::destroy_writer(Writer { api: self.coalesced_writer.api });
+        WriterWrapper::destroy_writer(Writer { api: self.fan_out_writer.api });
+        WriterWrapper::destroy_writer(Writer { api: self.state_writer.api });
+        WriterWrapper::destroy_writer(Writer { api: self.state_merge_writer.api });
+        ReaderWrapper::destroy_reader(Reader::new(self.state_reader.api, 0));
+        ReaderWrapper::destroy_reader(Reader::new(self.reader.api, 0));
     }
 }
 
@@ -89,26 +332,28 @@ impl Session {
 /// Sessions handler
 ///
 pub struct Sessions {
-    instances: Vec<Session>,
-    current: usize,
-    session_counter: SessionHandle,
+    instances: SlotMap<Session>,
+    current: SessionHandle,
+    frame_waker: Option<FrameWaker>,
 }
 
 impl Sessions {
     pub fn new() -> Sessions {
         Sessions {
-            instances: Vec::new(),
-            current: 0,
-            session_counter: SessionHandle(0),
+            instances: SlotMap::new(),
+            current: SessionHandle(0),
+            frame_waker: None,
         }
     }
 
     pub fn create_instance(&mut self) -> SessionHandle {
-        let s = Session::new(self.session_counter);
-        let handle = s.handle;
-        self.instances.push(s);
-        self.session_counter.0 += 1;
-        handle
+        let frame_waker = self.frame_waker.clone();
+
+        SessionHandle(self.instances.insert_with(|handle| {
+            let mut s = Session::new(SessionHandle(handle));
+            s.set_frame_waker(frame_waker);
+            s
+        }))
     }
 
     pub fn update(&mut self, backend_plugins: &mut BackendPlugins) {
@@ -117,19 +362,28 @@ impl Sessions {
         }
     }
 
+    pub fn flush_requests(&mut self) {
+        for session in self.instances.iter_mut() {
+            session.flush_requests();
+        }
+    }
+
+    /// Given to all sessions (also the ones created after this) so their backends can wake up the main loop
+    pub fn set_frame_waker(&mut self, waker: FrameWaker) {
+        for session in self.instances.iter_mut() {
+            session.set_frame_waker(Some(waker.clone()));
+        }
+
+        self.frame_waker = Some(waker);
+    }
+
     pub fn get_current(&mut self) -> &mut Session {
         let current = self.current;
-        &mut self.instances[current]
+        self.instances.get_mut(current.0).expect("No current session")
     }
 
     pub fn get_session(&mut self, handle: SessionHandle) -> Option<&mut Session> {
-        for i in 0..self.instances.len() {
-            if self.instances[i].handle == handle {
-                return Some(&mut self.instances[i]);
-            }
-        }
-
-        None
+        self.instances.get_mut(handle.0)
     }
 }
 
@@ -147,10 +401,10 @@ mod tests {
     fn write_simple_event() {
         let mut session = Session::new();
 
-        session.writers[0].event_begin(0x44);
-        session.writers[0].event_end();
+        session.writer.event_begin(0x44);
+        session.writer.event_end();
 
-        ReaderWrapper::init_from_writer(&mut session.reader, &session.writers[0]);
+        ReaderWrapper::init_from_writer(&mut session.reader, &session.writer);
 
         assert_eq!(session.reader.get_event().unwrap(), 0x44);
     }
@@ -0,0 +1,342 @@
+///! Storage for the instances (sessions, views and backends) that are referred to by handles.
+///!
+///! A handle is the index of a slot with the generation of the slot in the upper 32 bits so a
+///! lookup is an index and a compare. When an instance is removed the generation of its slot is
+///! increased so old handles (a view that has been closed, a backend that failed to reload) are
+///! found to be stale instead of finding whatever got the slot next.
+///!
+///! The instances themselves are kept packed in one Vec (removing moves the last one into the
+///! hole) so going over all of them each frame doesn't step over empty slots.
+///!
+///! Handles for the first slots in a new map are 0, 1, 2... (generation 0) so handles saved
+///! before (such as in layouts) still works and can be given to insert_at.
+///!
+
+/// Value of Slot::value when the slot is free
+const FREE: u32 = !0;
+
+struct Slot {
+    generation: u32,
+    /// Index into values
+    value: u32,
+}
+
+pub struct SlotMap<T> {
+    slots: Vec<Slot>,
+    values: Vec<T>,
+    /// The slot each value is in (same order as values)
+    value_slots: Vec<u32>,
+    free_slots: Vec<u32>,
+}
+
+pub fn make_handle(index: u32, generation: u32) -> u64 {
+    ((generation as u64) << 32) | index as u64
+}
+
+fn split_handle(handle: u64) -> (usize, u32) {
+    ((handle & 0xffffffff) as usize, (handle >> 32) as u32)
+}
+
+impl<T> SlotMap<T> {
+    pub fn new() -> SlotMap<T> {
+        SlotMap {
+            slots: Vec::new(),
+            values: Vec::new(),
+            value_slots: Vec::new(),
+            free_slots: Vec::new(),
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        self.values.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.values.is_empty()
+    }
+
+    pub fn insert(&mut self, value: T) -> u64 {
+        self.insert_with(|_| value)
+    }
+
+    /// Same as insert but the value is created with the handle it gets (for values that keeps
+    /// their own handle)
+    pub fn insert_with<F: FnOnce(u64) -> T>(&mut self, create: F) -> u64 {
+        let index = match self.free_slots.pop() {
+            Some(index) => index,
+            None => {
+                self.slots.push(Slot { generation: 0, value: FREE });
+                (self.slots.len() - 1) as u32
+            }
+        };
+
+        let handle = make_handle(index, self.slots[index as usize].generation);
+        self.place(index, create(handle));
+        handle
+    }
+
+    /// True if insert_at can be used with the handle (nothing is in its slot)
+    pub fn can_insert_at(&self, handle: u64) -> bool {
+        let (index, _) = split_handle(handle);
+        index >= self.slots.len() || self.slots[index].value == FREE
+    }
+
+    ///
+    /// Inserts the value so it's found with a handle given out earlier. Used when an instance is
+    /// created again after a plugin reload or when restoring a layout. The slot must be free (see
+    /// can_insert_at)
+    ///
+    pub fn insert_at(&mut self, handle: u64, value: T) {
+        let (index, generation) = split_handle(handle);
+
+        assert!(self.can_insert_at(handle), "slot of handle {:x} is in use", handle);
+
+        while self.slots.len() <= index {
+            self.free_slots.push(self.slots.len() as u32);
+            self.slots.push(Slot { generation: 0, value: FREE });
+        }
+
+        if let Some(pos) = self.free_slots.iter().position(|&slot| slot as usize == index) {
+            self.free_slots.swap_remove(pos);
+        }
+
+        self.slots[index].generation = generation;
+        self.place(index as u32, value);
+    }
+
+    fn place(&mut self, index: u32, value: T) {
+        self.slots[index as usize].value = self.values.len() as u32;
+        self.values.push(value);
+        self.value_slots.push(index);
+    }
+
+    fn value_index(&self, handle: u64) -> Option<usize> {
+        let (index, generation) = split_handle(handle);
+
+        match self.slots.get(index) {
+            Some(slot) if slot.generation == generation && slot.value != FREE => Some(slot.value as usize),
+            _ => None,
+        }
+    }
+
+    pub fn contains(&self, handle: u64) -> bool {
+        self.value_index(handle).is_some()
+    }
+
+    pub fn get(&self, handle: u64) -> Option<&T> {
+        match self.value_index(handle) {
+            Some(index) => Some(&self.values[index]),
+            None => None,
+        }
+    }
+
+    pub fn get_mut(&mut self, handle: u64) -> Option<&mut T> {
+        match self.value_index(handle) {
+            Some(index) => Some(&mut self.values[index]),
+            None => None,
+        }
+    }
+
+    /// Removes the value. The handle (and any copies of it) is stale after this
+    pub fn remove(&mut self, handle: u64) -> Option<T> {
+        let value_index = match self.value_index(handle) {
+            Some(index) => index,
+            None => return None,
+        };
+
+        let (index, _) = split_handle(handle);
+
+        let value = self.values.swap_remove(value_index);
+        self.value_slots.swap_remove(value_index);
+
+        // the last value has been moved into the hole
+
+        if value_index < self.values.len() {
+            let moved_slot = self.value_slots[value_index] as usize;
+            self.slots[moved_slot].value = value_index as u32;
+        }
+
+        let slot = &mut self.slots[index];
+        slot.generation = slot.generation.wrapping_add(1);
+        slot.value = FREE;
+
+        self.free_slots.push(index as u32);
+
+        Some(value)
+    }
+
+    pub fn iter(&self) -> ::std::slice::Iter<T> {
+        self.values.iter()
+    }
+
+    pub fn iter_mut(&mut self) -> ::std::slice::IterMut<T> {
+        self.values.iter_mut()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::Instant;
+
+    #[test]
+    fn insert_get_remove() {
+        let mut map = SlotMap::new();
+
+        let a = map.insert("a");
+        let b = map.insert("b");
+        let c = map.insert("c");
+
+        assert_eq!(a, 0);
+        assert_eq!(b, 1);
+        assert_eq!(map.get(b), Some(&"b"));
+
+        assert_eq!(map.remove(a), Some("a"));
+        assert_eq!(map.len(), 2);
+
+        // c was moved into the hole of a but is still found
+
+        assert_eq!(map.get(c), Some(&"c"));
+        assert_eq!(map.get(b), Some(&"b"));
+        assert_eq!(map.iter().count(), 2);
+    }
+
+    #[test]
+    fn stale_handles() {
+        let mut map = SlotMap::new();
+
+        let a = map.insert(1);
+        map.remove(a);
+
+        // the slot is reused with a new generation
+
+        let b = map.insert(2);
+
+        assert!(a != b);
+        assert_eq!(map.get(a), None);
+        assert_eq!(map.remove(a), None);
+        assert_eq!(map.get(b), Some(&2));
+    }
+
+    #[test]
+    fn insert_at_old_handle() {
+        let mut map = SlotMap::new();
+
+        let a = map.insert(1);
+        map.insert(2);
+        map.remove(a);
+
+        assert!(map.can_insert_at(a));
+        map.insert_at(a, 3);
+        assert_eq!(map.get(a), Some(&3));
+
+        // handles from a saved layout
+
+        let saved = make_handle(5, 0);
+        assert!(map.can_insert_at(saved));
+        map.insert_at(saved, 4);
+        assert!(!map.can_insert_at(saved));
+
+        assert_eq!(map.get(saved), Some(&4));
+
+        // the slots skipped to get to 5 are used for new values
+
+        for _ in 0..10 {
+            let handle = map.insert(0);
+            assert!(handle != a && handle != saved);
+        }
+
+        assert_eq!(map.len(), 13);
+    }
+
+    struct BenchSession {
+        handle: u64,
+        frame: u64,
+    }
+
+    struct BenchView {
+        handle: u64,
+        session: u64,
+        data: [u64; 16],
+    }
+
+    ///
+    /// Benchmark of the lookups Windows::update does each frame (each view and the session of it)
+    /// with a few hundred views over several sessions compared with searching Vecs (what was done
+    /// before the slot maps.) Not run by default, use
+    ///
+    /// cargo test --release bench_view_lookups -- --ignored --nocapture
+    ///
+    #[test]
+    #[ignore]
+    fn bench_view_lookups() {
+        const SESSION_COUNT: usize = 8;
+        const VIEW_COUNT: usize = 400;
+        const FRAMES: usize = 10000;
+
+        let mut sessions = SlotMap::new();
+        let mut views = SlotMap::new();
+        let mut session_vec = Vec::new();
+        let mut view_vec = Vec::new();
+
+        for _ in 0..SESSION_COUNT {
+            let handle = sessions.insert_with(|handle| BenchSession { handle: handle, frame: 0 });
+            session_vec.push(BenchSession { handle: handle, frame: 0 });
+        }
+
+        let session_handles: Vec<u64> = sessions.iter().map(|s| s.handle).collect();
+
+        for i in 0..VIEW_COUNT {
+            let session = session_handles[i % SESSION_COUNT];
+            let handle = views.insert_with(|handle| BenchView { handle: handle, session: session, data: [0; 16] });
+            view_vec.push(BenchView { handle: handle, session: session, data: [0; 16] });
+        }
+
+        // windows has the views in the order they were docked
+
+        let mut window_views: Vec<u64> = views.iter().map(|v| v.handle).collect();
+        window_views.reverse();
+
+        let start = Instant::now();
+
+        for _ in 0..FRAMES {
+            for handle in &window_views {
+                if let Some(view) = views.get_mut(*handle) {
+                    if let Some(session) = sessions.get_mut(view.session) {
+                        session.frame += 1;
+                        view.data[0] += session.frame;
+                    }
+                }
+            }
+        }
+
+        let slot_map_time = start.elapsed();
+        let start = Instant::now();
+
+        for _ in 0..FRAMES {
+            for handle in &window_views {
+                if let Some(view) = view_vec.iter_mut().find(|v| v.handle == *handle) {
+                    if let Some(session) = session_vec.iter_mut().find(|s| s.handle == view.session) {
+                        session.frame += 1;
+                        view.data[0] += session.frame;
+                    }
+                }
+            }
+        }
+
+        let vec_time = start.elapsed();
+
+        assert_eq!(sessions.iter().map(|s| s.frame).sum::<u64>(), (FRAMES * VIEW_COUNT) as u64);
+        assert_eq!(session_vec.iter().map(|s| s.frame).sum::<u64>(), (FRAMES * VIEW_COUNT) as u64);
+
+        let per_frame = |time: ::std::time::Duration| {
+            (time.as_secs() as f64 * 1e9 + time.subsec_nanos() as f64) / FRAMES as f64
+        };
+
+        println!("{} views, {} sessions: slot map {:.0} ns/frame, vec search {:.0} ns/frame",
+                 VIEW_COUNT,
+                 SESSION_COUNT,
+                 per_frame(slot_map_time),
+                 per_frame(vec_time));
+    }
+}
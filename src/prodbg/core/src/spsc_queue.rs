@@ -0,0 +1,139 @@
+use std::cell::UnsafeCell;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+///! Bounded lock-free queue between exactly one producer thread and one consumer thread. The producer only
+///! writes the tail and the consumer only writes the head so no locks or CAS loops are needed, just an
+///! acquire/release pair on each side.
+///!
+struct Queue<T> {
+    slots: Vec<UnsafeCell<Option<T>>>,
+    mask: usize,
+    head: AtomicUsize,
+    tail: AtomicUsize,
+}
+
+unsafe impl<T: Send> Sync for Queue<T> {}
+
+pub struct Producer<T> {
+    queue: Arc<Queue<T>>,
+}
+
+pub struct Consumer<T> {
+    queue: Arc<Queue<T>>,
+}
+
+/// Creates a queue that can hold capacity (rounded up to power of two) items
+pub fn spsc_queue<T>(capacity: usize) -> (Producer<T>, Consumer<T>) {
+    let capacity = capacity.next_power_of_two();
+    let mut slots = Vec::with_capacity(capacity);
+
+    for _ in 0..capacity {
+        slots.push(UnsafeCell::new(None));
+    }
+
+    let queue = Arc::new(Queue {
+        slots: slots,
+        mask: capacity - 1,
+        head: AtomicUsize::new(0),
+        tail: AtomicUsize::new(0),
+    });
+
+    (Producer { queue: queue.clone() }, Consumer { queue: queue })
+}
+
+impl<T> Producer<T> {
+    /// Gives back the value if the queue is full
+    pub fn push(&mut self, value: T) -> Result<(), T> {
+        let queue = &self.queue;
+        let tail = queue.tail.load(Ordering::Relaxed);
+
+        if tail.wrapping_sub(queue.head.load(Ordering::Acquire)) == queue.slots.len() {
+            return Err(value);
+        }
+
+        unsafe {
+            *queue.slots[tail & queue.mask].get() = Some(value);
+        }
+
+        queue.tail.store(tail.wrapping_add(1), Ordering::Release);
+
+        Ok(())
+    }
+
+    pub fn is_full(&self) -> bool {
+        let queue = &self.queue;
+        queue.tail.load(Ordering::Relaxed).wrapping_sub(queue.head.load(Ordering::Acquire)) == queue.slots.len()
+    }
+}
+
+impl<T> Consumer<T> {
+    pub fn pop(&mut self) -> Option<T> {
+        let queue = &self.queue;
+        let head = queue.head.load(Ordering::Relaxed);
+
+        if head == queue.tail.load(Ordering::Acquire) {
+            return None;
+        }
+
+        let value = unsafe { (*queue.slots[head & queue.mask].get()).take() };
+
+        queue.head.store(head.wrapping_add(1), Ordering::Release);
+
+        value
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::thread;
+
+    #[test]
+    fn push_pop() {
+        let (mut producer, mut consumer) = spsc_queue(3);
+
+        assert_eq!(consumer.pop(), None);
+
+        for i in 0..4 {
+            assert_eq!(producer.push(i), Ok(()));
+        }
+
+        assert!(producer.is_full());
+        assert_eq!(producer.push(4), Err(4));
+
+        for i in 0..4 {
+            assert_eq!(consumer.pop(), Some(i));
+        }
+
+        assert_eq!(consumer.pop(), None);
+    }
+
+    #[test]
+    fn threaded() {
+        let (mut producer, mut consumer) = spsc_queue(16);
+        let count = 10000;
+
+        let thread = thread::spawn(move || {
+            for i in 0..count {
+                let mut value = i;
+
+                while let Err(v) = producer.push(value) {
+                    value = v;
+                    thread::yield_now();
+                }
+            }
+        });
+
+        let mut expected = 0;
+
+        while expected < count {
+            if let Some(value) = consumer.pop() {
+                assert_eq!(value, expected);
+                expected += 1;
+            }
+        }
+
+        thread.join().unwrap();
+    }
+}
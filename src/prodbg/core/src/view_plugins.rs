@@ -1,12 +1,17 @@
-use prodbg_api::view::CViewCallbacks;
-use libc::{c_void, c_uchar};
+use prodbg_api::view::{CViewCallbacks, VIEW_API_VERSION};
+use libc::{c_char, c_void, c_uchar};
 use std::rc::Rc;
 use plugin::Plugin;
 use plugins::PluginHandler;
 use dynamic_reload::Lib;
-use session::SessionHandle;
+use session::{Session, SessionHandle};
+use memory_cache::MemoryCache;
+use profiler::{self, SampleName};
 use std::ptr;
 use prodbg_api::ui::Ui;
+use prodbg_api::read_write::Reader;
+use reader_wrapper::ReaderWrapper;
+use slot_map::SlotMap;
 
 #[derive(PartialEq, Eq, Clone, Copy, Debug)]
 pub struct ViewHandle(pub u64);
@@ -22,6 +27,25 @@ pub struct ViewInstance {
     pub width: f32,
     pub height: f32,
     pub plugin_type: Rc<Plugin>,
+    /// Reads the stream of the session but only returns the events the view wants (see begin_update)
+    pub reader: Reader,
+    /// Name of the samples of the update (see profiler.rs)
+    pub sample_name: SampleName,
+}
+
+impl ViewInstance {
+    /// Points the reader of the view to the stream the session has for this frame and makes the
+    /// services of the session (memory cache) the ones the view sees. Call before updating the view.
+    pub fn begin_update(&mut self, session: &Session) {
+        ReaderWrapper::init_view(&mut self.reader, &session.reader);
+        session.make_memory_cache_current();
+    }
+}
+
+impl Drop for ViewInstance {
+    fn drop(&mut self) {
+        ReaderWrapper::destroy_reader(Reader::new(self.reader.api, 0));
+    }
 }
 
 #[derive(Clone)]
@@ -33,15 +57,29 @@ struct ReloadState {
 }
 
 pub struct ViewPlugins {
-    pub instances: Vec<ViewInstance>,
+    pub instances: SlotMap<ViewInstance>,
     plugin_types: Vec<Rc<Plugin>>,
     reload_state: Vec<ReloadState>,
-    handle_counter: ViewHandle,
 }
 
 impl PluginHandler for ViewPlugins {
     fn is_correct_plugin_type(&self, plugin: &Plugin) -> bool {
-        plugin.type_name.contains("View")
+        if !plugin.type_name.contains("View") {
+            return false;
+        }
+
+        // views built against an older version have a smaller PDViewPlugin (no event_types)
+        let version = &VIEW_API_VERSION[..VIEW_API_VERSION.len() - 1];
+
+        if plugin.type_name.as_bytes() != version {
+            println!("Skipping view plugin {} as it is for {} and not {}",
+                     plugin.name,
+                     plugin.type_name,
+                     String::from_utf8_lossy(version));
+            return false;
+        }
+
+        true
     }
 
     fn add_plugin(&mut self, plugin: &Rc<Plugin>) {
@@ -51,20 +89,22 @@ impl PluginHandler for ViewPlugins {
 
     fn unload_plugin(&mut self, lib: &Rc<Lib>) {
         self.reload_state.clear();
-        for i in (0..self.instances.len()).rev() {
-            if &self.instances[i].plugin_type.lib == lib {
-                let state = ReloadState {
-                    ui: self.instances[i].ui,
-                    name: self.instances[i].plugin_type.name.clone(),
-                    handle: self.instances[i].handle,
-                    session_handle: self.instances[i].session_handle,
-                };
-
-                self.reload_state.push(state);
-                self.instances.swap_remove(i);
+
+        for instance in self.instances.iter() {
+            if &instance.plugin_type.lib == lib {
+                self.reload_state.push(ReloadState {
+                    ui: instance.ui,
+                    name: instance.plugin_type.name.clone(),
+                    handle: instance.handle,
+                    session_handle: instance.session_handle,
+                });
             }
         }
 
+        for state in &self.reload_state {
+            self.instances.remove(state.handle.0);
+        }
+
         for i in (0..self.plugin_types.len()).rev() {
             if &self.plugin_types[i].lib == lib {
                 self.plugin_types.swap_remove(i);
@@ -74,11 +114,13 @@ impl PluginHandler for ViewPlugins {
 
     fn reload_plugin(&mut self) {
         let t = self.reload_state.clone();
+        // the views are created with the same handles so the windows keeps them
         for reload_plugin in &t {
-            Self::create_instance(self,
-                                  reload_plugin.ui,
-                                  &reload_plugin.name,
-                                  reload_plugin.session_handle);
+            Self::create_instance_with_handle(self,
+                                              reload_plugin.ui,
+                                              &reload_plugin.name,
+                                              reload_plugin.session_handle,
+                                              reload_plugin.handle);
         }
     }
 
@@ -90,25 +132,50 @@ impl PluginHandler for ViewPlugins {
 impl ViewPlugins {
     pub fn new() -> ViewPlugins {
         ViewPlugins {
-            instances: Vec::new(),
+            instances: SlotMap::new(),
             plugin_types: Vec::new(),
             reload_state: Vec::new(),
-            handle_counter: ViewHandle(0),
         }
     }
 
-    pub extern "C" fn service_fun(_name: *const c_uchar) -> *mut c_void {
+    pub extern "C" fn service_fun(name: *const c_uchar) -> *mut c_void {
+        if let Some(service) = MemoryCache::get_service(name as *const c_char) {
+            return service;
+        }
+
+        if let Some(service) = profiler::get_service(name as *const c_char) {
+            return service;
+        }
+
         ptr::null_mut()
     }
 
-    pub fn get_view(&mut self, view_handle: ViewHandle) -> Option<&mut ViewInstance> {
-        for i in 0..self.instances.len() {
-            if self.instances[i].handle == view_handle {
-                return Some(&mut self.instances[i]);
-            }
+    /// Event types from PDViewPlugin::event_types (ended with PDEventType_None.) None if the view
+    /// wants all events.
+    unsafe fn get_event_types(mut event_types: *const u16) -> Option<Vec<u16>> {
+        let mut types = Vec::new();
+
+        if event_types.is_null() {
+            return None;
         }
 
-        None
+        while *event_types != 0 {
+            types.push(*event_types);
+            event_types = event_types.offset(1);
+        }
+
+        // views that doesn't want any events filters on PDEventType_None which is never sent
+
+        if types.is_empty() {
+            types.push(0);
+        }
+
+        Some(types)
+    }
+
+    /// None if the view has been destroyed (or is being reloaded)
+    pub fn get_view(&mut self, view_handle: ViewHandle) -> Option<&mut ViewInstance> {
+        self.instances.get_mut(view_handle.0)
     }
 
     pub fn create_instance_from_index(&mut self,
@@ -117,26 +184,29 @@ impl ViewPlugins {
                                       session_handle: SessionHandle,
                                       view_handle: Option<ViewHandle>)
                                       -> Option<ViewHandle> {
+        if let Some(handle) = view_handle {
+            if !self.instances.can_insert_at(handle.0) {
+                println!("Unable to create view as handle {} is already used", handle.0);
+                return None;
+            }
+        }
+
+        let mut reader = ReaderWrapper::create_view_reader();
+
         let plugin_data = unsafe {
             let callbacks = self.plugin_types[index].plugin_funcs as *mut CViewCallbacks;
-            (*callbacks).create_instance.unwrap()(ui.api as *mut c_void, Self::service_fun)
-        };
+            let event_types = Self::get_event_types((*callbacks).event_types);
 
-        let handle = match view_handle {
-            Some(h) => {
-                if h.0 >= self.handle_counter.0 {
-                    self.handle_counter.0 = h.0 + 1
-                }
-                h
-            },
-            _ => {
-                let counter = self.handle_counter;
-                self.handle_counter.0 += 1;
-                counter
+            if let Some(event_types) = event_types {
+                reader.set_event_filter(&event_types);
             }
+
+            (*callbacks).create_instance.unwrap()(ui.api as *mut c_void, Self::service_fun)
         };
 
-        let instance = ViewInstance {
+        let plugin_type = self.plugin_types[index].clone();
+
+        let create = |handle: ViewHandle| ViewInstance {
             plugin_data: plugin_data,
             name: format!("Plugin {}", handle.0),
             ui: ui,
@@ -146,12 +216,18 @@ impl ViewPlugins {
             y: 0.0,
             width: 0.0,
             height: 0.0,
-            plugin_type: self.plugin_types[index].clone(),
+            sample_name: SampleName::new(&plugin_type.name),
+            plugin_type: plugin_type,
+            reader: reader,
         };
 
-        self.instances.push(instance);
-
-        Some(handle)
+        match view_handle {
+            Some(handle) => {
+                self.instances.insert_at(handle.0, create(handle));
+                Some(handle)
+            }
+            None => Some(ViewHandle(self.instances.insert_with(|handle| create(ViewHandle(handle))))),
+        }
     }
 
     pub fn create_instance(&mut self,
@@ -188,12 +264,7 @@ impl ViewPlugins {
     }
 
     pub fn destroy_instance(&mut self, handle: ViewHandle) {
-        for i in (0..self.instances.len()).rev() {
-            if self.instances[i].handle.0 == handle.0 {
-                self.instances.swap_remove(i);
-                return;
-            }
-        }
+        self.instances.remove(handle.0);
     }
 
     // TODO: Would be nice to use something stack-base instead or return an iterator to interate
@@ -0,0 +1,120 @@
+///! Runs ProDBG without a window to measure the views and backends (see runner.rs and script.rs)
+///!
+///! headless [script] [--csv <file>] [--profile]
+///!
+///! Runs script.rs DEFAULT_SCRIPT when no script is given, --csv writes the time and allocations of
+///! each frame and --profile starts Remotery like ProDBG does.
+///!
+
+extern crate core;
+extern crate libc;
+extern crate prodbg_api;
+
+mod native;
+mod runner;
+mod script;
+
+use core::profiler;
+use runner::Runner;
+use std::env;
+use std::fs::File;
+use std::io::Read;
+use std::process;
+
+struct Args {
+    script: Option<String>,
+    csv: Option<String>,
+    profile: bool,
+}
+
+fn parse_args() -> Result<Args, String> {
+    let mut args = Args {
+        script: None,
+        csv: None,
+        profile: false,
+    };
+
+    let mut iter = env::args().skip(1);
+
+    while let Some(arg) = iter.next() {
+        match arg.as_str() {
+            "--profile" => args.profile = true,
+            "--csv" => {
+                match iter.next() {
+                    Some(filename) => args.csv = Some(filename),
+                    None => return Err("--csv needs a filename".to_owned()),
+                }
+            }
+            _ => {
+                if args.script.is_some() {
+                    return Err(format!("Unknown argument {}", arg));
+                }
+
+                args.script = Some(arg);
+            }
+        }
+    }
+
+    Ok(args)
+}
+
+fn load_script(filename: &Option<String>) -> Result<Vec<script::Command>, String> {
+    let text = match *filename {
+        Some(ref filename) => {
+            let mut text = String::new();
+            let mut file = try!(File::open(filename).map_err(|e| format!("Unable to open {}: {}", filename, e)));
+            try!(file.read_to_string(&mut text).map_err(|e| format!("Unable to read {}: {}", filename, e)));
+            text
+        }
+        None => script::DEFAULT_SCRIPT.to_owned(),
+    };
+
+    script::parse(&text)
+}
+
+fn run(args: &Args) -> Result<(), String> {
+    let commands = try!(load_script(&args.script));
+    let mut runner = Runner::new();
+
+    let result = runner.run(&commands);
+
+    runner.print_report();
+
+    if let Some(ref filename) = args.csv {
+        try!(runner.write_frames_csv(filename).map_err(|e| format!("Unable to write {}: {}", filename, e)));
+    }
+
+    // the views and backend threads needs to be done before the profiler goes away
+    drop(runner);
+
+    result
+}
+
+fn main() {
+    let args = match parse_args() {
+        Ok(args) => args,
+        Err(e) => {
+            println!("{}", e);
+            println!("Usage: headless [script] [--csv <file>] [--profile]");
+            process::exit(1);
+        }
+    };
+
+    if args.profile {
+        profiler::start();
+    }
+
+    let result = run(&args);
+
+    profiler::stop();
+
+    if let Err(e) = result {
+        println!("Error: {}", e);
+        process::exit(1);
+    }
+}
+
+// dummy
+#[no_mangle]
+pub fn init_plugin() {
+}
@@ -0,0 +1,102 @@
+///! Bindings for src/native/headless (the null PDUI and the allocation counter)
+
+use libc::{c_char, c_int, c_void};
+use std::ffi::CStr;
+
+#[repr(C)]
+struct NullUICallCount {
+    name: *const c_char,
+    count: u64,
+}
+
+#[repr(C)]
+#[derive(Clone, Copy, Default, Debug)]
+pub struct AllocCounts {
+    pub count: u64,
+    pub bytes: u64,
+}
+
+impl AllocCounts {
+    /// Allocations made by the process so far (see alloc_counter.h)
+    pub fn get() -> AllocCounts {
+        let mut counts = AllocCounts::default();
+        unsafe { alloc_counter_get(&mut counts) };
+        counts
+    }
+
+    pub fn is_supported() -> bool {
+        unsafe { alloc_counter_is_supported() != 0 }
+    }
+
+    pub fn since(&self, start: &AllocCounts) -> AllocCounts {
+        AllocCounts {
+            count: self.count - start.count,
+            bytes: self.bytes - start.bytes,
+        }
+    }
+}
+
+pub struct NullUi;
+
+impl NullUi {
+    pub fn create() -> *mut c_void {
+        unsafe { null_ui_create() }
+    }
+
+    pub fn destroy(ui: *mut c_void) {
+        unsafe { null_ui_destroy(ui) }
+    }
+
+    pub fn begin_frame() {
+        unsafe { null_ui_begin_frame() }
+    }
+
+    pub fn set_window_size(width: f32, height: f32) {
+        unsafe { null_ui_set_window_size(width, height) }
+    }
+
+    pub fn set_input_text(label: &str, text: &str) -> bool {
+        let label = format!("{}\0", label);
+        let text = format!("{}\0", text);
+        unsafe { null_ui_set_input_text(label.as_ptr() as *const c_char, text.as_ptr() as *const c_char) != 0 }
+    }
+
+    pub fn get_total_calls() -> u64 {
+        unsafe { null_ui_get_total_calls() }
+    }
+
+    /// Calls for each PDUI function that has been called since the last reset
+    pub fn get_calls() -> Vec<(&'static str, u64)> {
+        let mut calls = Vec::with_capacity(256);
+
+        unsafe {
+            let count = null_ui_get_calls(calls.as_mut_ptr(), calls.capacity() as c_int);
+            calls.set_len(count as usize);
+        }
+
+        calls.iter()
+             .map(|call: &NullUICallCount| {
+                 let name = unsafe { CStr::from_ptr(call.name) };
+                 (name.to_str().unwrap_or("?"), call.count)
+             })
+             .collect()
+    }
+
+    pub fn reset_calls() {
+        unsafe { null_ui_reset_calls() }
+    }
+}
+
+extern "C" {
+    fn null_ui_create() -> *mut c_void;
+    fn null_ui_destroy(ui: *mut c_void);
+    fn null_ui_begin_frame();
+    fn null_ui_set_window_size(width: f32, height: f32);
+    fn null_ui_set_input_text(label: *const c_char, text: *const c_char) -> c_int;
+    fn null_ui_get_total_calls() -> u64;
+    fn null_ui_get_calls(calls: *mut NullUICallCount, max_count: c_int) -> c_int;
+    fn null_ui_reset_calls();
+
+    fn alloc_counter_is_supported() -> c_int;
+    fn alloc_counter_get(counts: *mut AllocCounts);
+}
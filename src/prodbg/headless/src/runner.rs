@@ -0,0 +1,428 @@
+///! Runs the sessions, backends and views of ProDBG without a window. The views draw to the null
+///! PDUI (src/native/headless/null_ui.cpp) and the runner keeps track of how long each frame and
+///! each plugin takes, how many UI calls the views make and how many allocations are made.
+///!
+///! A frame is what the main loop of ProDBG does for a full frame: the session update (sending the
+///! requests to the backend and getting the replies) and updating the views. The backends run on
+///! their own threads so their time isn't part of the frame but is reported for each backend.
+///! Allocations are counted for the whole process so the ones of the frames and views also include
+///! what the backend threads did at the same time.
+///!
+
+use std::cell::RefCell;
+use std::fs::File;
+use std::io::{self, Write};
+use std::rc::Rc;
+use std::time::{Duration, Instant};
+use libc::c_void;
+use core::{DynamicReload, Search};
+use core::plugins::Plugins;
+use core::session::{Sessions, SessionHandle};
+use core::view_plugins::{ViewPlugins, ViewHandle};
+use core::backend_plugin::BackendPlugins;
+use core::frame_scheduler::FrameScheduler;
+use core::profiler::{self, SampleName};
+use prodbg_api::ui::Ui;
+use prodbg_api::ui_ffi::CPdUI;
+use prodbg_api::view::CViewCallbacks;
+use prodbg_api::backend::{EVENT_ACTION, ACTION, action};
+use native::{AllocCounts, NullUi};
+use script::Command;
+
+/// Label of the address fields in the hex memory view (used by the scroll command)
+const HEX_VIEW_NAME: &'static str = "Hex Memory View";
+const HEX_VIEW_START: &'static str = "Start Address";
+const HEX_VIEW_END: &'static str = "End Address";
+
+/// How many of the most used UI functions are shown for each view
+const TOP_UI_CALLS: usize = 5;
+
+struct FrameStats {
+    time: Duration,
+    allocs: AllocCounts,
+}
+
+struct ViewStats {
+    name: String,
+    updates: u64,
+    time: Duration,
+    max_time: Duration,
+    ui_calls: u64,
+    allocs: AllocCounts,
+    ui_call_counts: Vec<(&'static str, u64)>,
+}
+
+struct View {
+    handle: ViewHandle,
+    ui: *mut c_void,
+}
+
+pub struct Runner {
+    lib_handler: DynamicReload,
+    plugins: Plugins,
+    view_plugins: Rc<RefCell<ViewPlugins>>,
+    backend_plugins: Rc<RefCell<BackendPlugins>>,
+    sessions: Sessions,
+    session: SessionHandle,
+    backend_name: Option<String>,
+    views: Vec<View>,
+    /// Only used to wait for the backend between frames
+    scheduler: FrameScheduler,
+    frames: Vec<FrameStats>,
+    view_stats: Vec<ViewStats>,
+    frame_sample: SampleName,
+}
+
+fn to_us(time: Duration) -> f64 {
+    time.as_secs() as f64 * 1000000.0 + time.subsec_nanos() as f64 / 1000.0
+}
+
+fn add_calls(counts: &mut Vec<(&'static str, u64)>, calls: &[(&'static str, u64)]) {
+    for &(name, count) in calls {
+        match counts.iter_mut().find(|entry| entry.0 == name) {
+            Some(entry) => entry.1 += count,
+            None => counts.push((name, count)),
+        }
+    }
+}
+
+impl Runner {
+    pub fn new() -> Runner {
+        let scheduler = FrameScheduler::new();
+        let mut sessions = Sessions::new();
+        let mut plugins = Plugins::new();
+
+        let view_plugins = Rc::new(RefCell::new(ViewPlugins::new()));
+        let backend_plugins = Rc::new(RefCell::new(BackendPlugins::new()));
+
+        sessions.set_frame_waker(scheduler.get_waker());
+        let session = sessions.create_instance();
+
+        plugins.add_handler(&view_plugins);
+        plugins.add_handler(&backend_plugins);
+
+        Runner {
+            lib_handler: DynamicReload::new(None, Some("t2-output"), Search::Backwards),
+            plugins: plugins,
+            view_plugins: view_plugins,
+            backend_plugins: backend_plugins,
+            sessions: sessions,
+            session: session,
+            backend_name: None,
+            views: Vec::new(),
+            scheduler: scheduler,
+            frames: Vec::new(),
+            view_stats: Vec::new(),
+            frame_sample: SampleName::new("Frame"),
+        }
+    }
+
+    pub fn run(&mut self, commands: &[Command]) -> Result<(), String> {
+        for command in commands {
+            try!(self.run_command(command));
+        }
+
+        Ok(())
+    }
+
+    fn run_command(&mut self, command: &Command) -> Result<(), String> {
+        match *command {
+            Command::Plugin(ref name) => {
+                self.plugins.add_plugin(&mut self.lib_handler, name);
+            }
+
+            Command::Backend(ref name) => {
+                let backend = self.backend_plugins.borrow_mut().create_instance(name);
+
+                if backend.is_none() {
+                    return Err(format!("Unable to create backend {} (is the plugin loaded?)", name));
+                }
+
+                if let Some(session) = self.sessions.get_session(self.session) {
+                    session.set_backend(backend);
+                }
+
+                self.backend_name = Some(name.clone());
+            }
+
+            Command::View(ref name) => {
+                let ui = NullUi::create();
+
+                match self.view_plugins
+                          .borrow_mut()
+                          .create_instance(Ui::new(ui as *mut CPdUI), name, self.session) {
+                    Some(handle) => {
+                        self.views.push(View {
+                            handle: handle,
+                            ui: ui,
+                        })
+                    }
+                    None => {
+                        NullUi::destroy(ui);
+                        return Err(format!("Unable to create view {} (is the plugin loaded?)", name));
+                    }
+                }
+            }
+
+            Command::Window(width, height) => NullUi::set_window_size(width, height),
+
+            Command::Frames(count) => {
+                for _ in 0..count {
+                    self.run_frame();
+                }
+            }
+
+            Command::Step(count) => {
+                for _ in 0..count {
+                    self.write_action(action::STEP);
+                    self.run_frame();
+                }
+            }
+
+            Command::Scroll { address, size, delta, count } => {
+                let hex_views = self.count_views(HEX_VIEW_NAME);
+
+                if hex_views == 0 {
+                    return Err(format!("scroll needs a {}", HEX_VIEW_NAME));
+                }
+
+                for i in 0..count {
+                    let start = (address as i64 + delta * i as i64) as u64;
+
+                    // each view takes its own copy of the text
+
+                    for _ in 0..hex_views {
+                        NullUi::set_input_text(HEX_VIEW_START, &format!("{:x}", start));
+                        NullUi::set_input_text(HEX_VIEW_END, &format!("{:x}", start + size));
+                    }
+
+                    self.run_frame();
+                }
+            }
+        }
+
+        Ok(())
+    }
+
+    fn count_views(&self, name: &str) -> usize {
+        let mut view_plugins = self.view_plugins.borrow_mut();
+
+        self.views
+            .iter()
+            .filter(|view| view_plugins.get_view(view.handle).map_or(false, |v| v.plugin_type.name == name))
+            .count()
+    }
+
+    /// Writes the action as if a view had sent it (the backend gets it in the next frame)
+    fn write_action(&mut self, action: u32) {
+        if let Some(session) = self.sessions.get_session(self.session) {
+            let writer = session.get_current_writer();
+            writer.event_begin(EVENT_ACTION);
+            writer.write_u32(ACTION, action);
+            writer.event_end();
+        }
+    }
+
+    fn get_view_stats<'a>(view_stats: &'a mut Vec<ViewStats>, name: &str) -> &'a mut ViewStats {
+        if let Some(pos) = view_stats.iter().position(|stats| stats.name == name) {
+            return &mut view_stats[pos];
+        }
+
+        view_stats.push(ViewStats {
+            name: name.to_owned(),
+            updates: 0,
+            time: Duration::new(0, 0),
+            max_time: Duration::new(0, 0),
+            ui_calls: 0,
+            allocs: AllocCounts::default(),
+            ui_call_counts: Vec::new(),
+        });
+
+        view_stats.last_mut().unwrap()
+    }
+
+    ///
+    /// Runs one frame and then waits for the backend to reply to what the views asked for (or
+    /// until the time the main loop would poll for input)
+    ///
+    fn run_frame(&mut self) {
+        // the replies from the backend that woke us up are picked up by the session update
+        self.scheduler.begin_frame(Instant::now());
+
+        let frame_allocs = AllocCounts::get();
+        let frame_start = Instant::now();
+        let sample = profiler::begin(&mut self.frame_sample);
+
+        NullUi::begin_frame();
+
+        self.sessions.update(&mut self.backend_plugins.borrow_mut());
+
+        let mut view_plugins = self.view_plugins.borrow_mut();
+
+        for view in &self.views {
+            let instance = match view_plugins.get_view(view.handle) {
+                Some(instance) => instance,
+                None => continue,
+            };
+
+            let session = match self.sessions.get_session(instance.session_handle) {
+                Some(session) => session,
+                None => continue,
+            };
+
+            instance.begin_update(session);
+
+            NullUi::reset_calls();
+
+            let allocs = AllocCounts::get();
+            let start = Instant::now();
+            let view_sample = profiler::begin(&mut instance.sample_name);
+
+            unsafe {
+                let plugin_funcs = instance.plugin_type.plugin_funcs as *mut CViewCallbacks;
+                ((*plugin_funcs).update.unwrap())(instance.plugin_data,
+                                                    view.ui,
+                                                    instance.reader.api as *mut c_void,
+                                                    session.get_current_writer().api as *mut c_void);
+            }
+
+            drop(view_sample);
+
+            let time = start.elapsed();
+            let allocs = AllocCounts::get().since(&allocs);
+
+            let stats = Self::get_view_stats(&mut self.view_stats, &instance.plugin_type.name);
+            stats.updates += 1;
+            stats.time += time;
+            stats.max_time = stats.max_time.max(time);
+            stats.ui_calls += NullUi::get_total_calls();
+            stats.allocs.count += allocs.count;
+            stats.allocs.bytes += allocs.bytes;
+            add_calls(&mut stats.ui_call_counts, &NullUi::get_calls());
+        }
+
+        drop(view_plugins);
+
+        // what the views asked for goes to the backend right away
+        self.sessions.flush_requests();
+
+        drop(sample);
+
+        self.frames.push(FrameStats {
+            time: frame_start.elapsed(),
+            allocs: AllocCounts::get().since(&frame_allocs),
+        });
+
+        self.scheduler.wait();
+    }
+
+    pub fn print_report(&mut self) {
+        let frame_count = self.frames.len();
+
+        if frame_count == 0 {
+            println!("No frames were run");
+            return;
+        }
+
+        let mut times: Vec<f64> = self.frames.iter().map(|frame| to_us(frame.time)).collect();
+        times.sort_by(|a, b| a.partial_cmp(b).unwrap());
+
+        let total: f64 = times.iter().sum();
+        let percentile = |p: usize| times[((frame_count - 1) * p) / 100];
+
+        println!("Frames: {}", frame_count);
+        println!("  time (us)      avg {:.1}  min {:.1}  median {:.1}  p95 {:.1}  max {:.1}",
+                 total / frame_count as f64,
+                 times[0],
+                 percentile(50),
+                 percentile(95),
+                 times[frame_count - 1]);
+
+        if AllocCounts::is_supported() {
+            let count: u64 = self.frames.iter().map(|frame| frame.allocs.count).sum();
+            let bytes: u64 = self.frames.iter().map(|frame| frame.allocs.bytes).sum();
+
+            println!("  allocations    {:.1} ({:.0} bytes) per frame",
+                     count as f64 / frame_count as f64,
+                     bytes as f64 / frame_count as f64);
+        } else {
+            println!("  allocations    not counted on this platform");
+        }
+
+        println!("");
+        println!("{:<24} {:>8} {:>10} {:>10} {:>12} {:>12}",
+                 "View",
+                 "updates",
+                 "avg us",
+                 "max us",
+                 "UI calls",
+                 "allocations");
+
+        for stats in &mut self.view_stats {
+            let updates = stats.updates.max(1) as f64;
+
+            println!("{:<24} {:>8} {:>10.1} {:>10.1} {:>12.1} {:>12.1}",
+                     stats.name,
+                     stats.updates,
+                     to_us(stats.time) / updates,
+                     to_us(stats.max_time),
+                     stats.ui_calls as f64 / updates,
+                     stats.allocs.count as f64 / updates);
+
+            stats.ui_call_counts.sort_by(|a, b| b.1.cmp(&a.1));
+
+            let top: Vec<String> = stats.ui_call_counts
+                                        .iter()
+                                        .take(TOP_UI_CALLS)
+                                        .map(|&(name, count)| format!("{} {:.1}", name, count as f64 / updates))
+                                        .collect();
+
+            if !top.is_empty() {
+                println!("    {}", top.join(", "));
+            }
+        }
+
+        let backend_stats = self.sessions.get_session(self.session).and_then(|session| session.get_backend_stats());
+
+        if let (Some(name), Some(stats)) = (self.backend_name.as_ref(), backend_stats) {
+            let updates = stats.updates.max(1) as f64;
+
+            println!("");
+            println!("{:<24} {:>8} {:>10} {:>10}", "Backend", "updates", "avg us", "total ms");
+            println!("{:<24} {:>8} {:>10.1} {:>10.1}",
+                     name,
+                     stats.updates,
+                     to_us(stats.update_time) / updates,
+                     to_us(stats.update_time) / 1000.0);
+        }
+    }
+
+    /// One line for each frame (time in us and allocations) so runs can be compared
+    pub fn write_frames_csv(&self, filename: &str) -> io::Result<()> {
+        let mut file = try!(File::create(filename));
+
+        try!(writeln!(file, "frame,time_us,allocations,allocated_bytes"));
+
+        for (i, frame) in self.frames.iter().enumerate() {
+            try!(writeln!(file,
+                          "{},{:.1},{},{}",
+                          i,
+                          to_us(frame.time),
+                          frame.allocs.count,
+                          frame.allocs.bytes));
+        }
+
+        Ok(())
+    }
+}
+
+impl Drop for Runner {
+    fn drop(&mut self) {
+        let mut view_plugins = self.view_plugins.borrow_mut();
+
+        for view in &self.views {
+            view_plugins.destroy_instance(view.handle);
+            NullUi::destroy(view.ui);
+        }
+    }
+}
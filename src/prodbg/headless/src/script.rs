@@ -0,0 +1,180 @@
+///! Scripts for the headless runner. One command on each line and # starts a comment:
+///!
+///! plugin <library>           loads a plugin library (such as hex_memory_plugin)
+///! backend <name>             creates a backend (such as Dummy Backend) and uses it for the session
+///! view <name>                opens a view (such as Hex Memory View or Disassembly)
+///! window <width> <height>    size of all views (800 x 600 if not set)
+///! frames <count>             runs frames without doing anything
+///! step <count>               steps the target once each frame
+///! scroll <address> <size> <delta> <count>
+///!                            shows address..address + size in the hex memory views and moves the
+///!                            range by delta bytes each frame
+///!
+///! Numbers can be given in hex with 0x. Each command that runs frames waits for the backend between
+///! the frames (see Runner::run_frame)
+///!
+
+/// Used when no script is given
+pub static DEFAULT_SCRIPT: &'static str = "
+plugin dummy_backend_plugin
+plugin hex_memory_plugin
+plugin registers_plugin
+plugin disassembly_plugin
+
+backend Dummy Backend
+view Hex Memory View
+view Registers View
+
+frames 10
+scroll 0x0 0x400 0x40 100
+step 50
+view Disassembly
+frames 50
+";
+
+#[derive(Debug, PartialEq)]
+pub enum Command {
+    Plugin(String),
+    Backend(String),
+    View(String),
+    Window(f32, f32),
+    Frames(usize),
+    Step(usize),
+    Scroll {
+        address: u64,
+        size: u64,
+        delta: i64,
+        count: usize,
+    },
+}
+
+fn parse_u64(text: &str) -> Result<u64, String> {
+    let result = if text.starts_with("0x") {
+        u64::from_str_radix(&text[2..], 16)
+    } else {
+        text.parse::<u64>()
+    };
+
+    result.map_err(|_| format!("Invalid number {}", text))
+}
+
+fn parse_i64(text: &str) -> Result<i64, String> {
+    if text.starts_with("-") {
+        parse_u64(&text[1..]).map(|v| -(v as i64))
+    } else {
+        parse_u64(text).map(|v| v as i64)
+    }
+}
+
+fn parse_line(line: &str) -> Result<Option<Command>, String> {
+    let line = match line.find('#') {
+        Some(pos) => &line[..pos],
+        None => line,
+    }.trim();
+
+    if line.is_empty() {
+        return Ok(None);
+    }
+
+    let (command, rest) = match line.find(char::is_whitespace) {
+        Some(pos) => (&line[..pos], line[pos..].trim()),
+        None => (line, ""),
+    };
+
+    let args: Vec<&str> = rest.split_whitespace().collect();
+
+    let expect_args = |count: usize| {
+        if args.len() == count {
+            Ok(())
+        } else {
+            Err(format!("{} expects {} arguments", command, count))
+        }
+    };
+
+    if rest.is_empty() {
+        return Err(format!("{} is missing arguments", command));
+    }
+
+    let command = match command {
+        "plugin" => Command::Plugin(rest.to_owned()),
+        "backend" => Command::Backend(rest.to_owned()),
+        "view" => Command::View(rest.to_owned()),
+        "window" => {
+            try!(expect_args(2));
+            Command::Window(try!(parse_u64(args[0])) as f32, try!(parse_u64(args[1])) as f32)
+        }
+        "frames" => {
+            try!(expect_args(1));
+            Command::Frames(try!(parse_u64(args[0])) as usize)
+        }
+        "step" => {
+            try!(expect_args(1));
+            Command::Step(try!(parse_u64(args[0])) as usize)
+        }
+        "scroll" => {
+            try!(expect_args(4));
+            Command::Scroll {
+                address: try!(parse_u64(args[0])),
+                size: try!(parse_u64(args[1])),
+                delta: try!(parse_i64(args[2])),
+                count: try!(parse_u64(args[3])) as usize,
+            }
+        }
+        _ => return Err(format!("Unknown command {}", command)),
+    };
+
+    Ok(Some(command))
+}
+
+pub fn parse(text: &str) -> Result<Vec<Command>, String> {
+    let mut commands = Vec::new();
+
+    for (i, line) in text.lines().enumerate() {
+        match parse_line(line) {
+            Ok(Some(command)) => commands.push(command),
+            Ok(None) => (),
+            Err(e) => return Err(format!("line {}: {}", i + 1, e)),
+        }
+    }
+
+    Ok(commands)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn parse_commands() {
+        let commands = parse("# test\n\
+                              plugin hex_memory_plugin\n\
+                              view Hex Memory View  # comment\n\
+                              window 640 480\n\
+                              scroll 0x1000 256 -16 10\n")
+                           .unwrap();
+
+        assert_eq!(commands,
+                   vec![Command::Plugin("hex_memory_plugin".to_owned()),
+                        Command::View("Hex Memory View".to_owned()),
+                        Command::Window(640.0, 480.0),
+                        Command::Scroll {
+                            address: 0x1000,
+                            size: 256,
+                            delta: -16,
+                            count: 10,
+                        }]);
+    }
+
+    #[test]
+    fn parse_errors() {
+        assert!(parse("frames").is_err());
+        assert!(parse("frames ten").is_err());
+        assert!(parse("scroll 0 1 2").is_err());
+        assert!(parse("jump 10").is_err());
+    }
+
+    #[test]
+    fn default_script() {
+        assert!(parse(DEFAULT_SCRIPT).is_ok());
+    }
+}
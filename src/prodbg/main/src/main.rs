@@ -13,12 +13,22 @@ use windows::Windows;
 use core::{DynamicReload, Search};
 use core::view_plugins::{ViewPlugins};
 use core::backend_plugin::{BackendPlugins};
+use core::frame_scheduler::{FrameScheduler, dirty};
+use core::profiler::{self, SampleName};
 use std::cell::RefCell;
 use std::rc::Rc;
+use std::time::Instant;
+use std::env;
 
 use core::plugins::*;
 
 fn main() {
+    // --profile shows where the time goes in Remotery (see profiler.rs.) Started first so plugins
+    // created below gets the profiler service
+    if env::args().any(|arg| arg == "--profile") {
+        profiler::start();
+    }
+
     let bgfx = Bgfx::new();
     let mut sessions = Sessions::new();
     let mut windows = Windows::new();
@@ -29,6 +39,10 @@ fn main() {
     let view_plugins = Rc::new(RefCell::new(ViewPlugins::new()));
     let backend_plugins = Rc::new(RefCell::new(BackendPlugins::new()));
 
+    // nothing is drawn unless something has changed (see frame_scheduler.rs)
+    let mut scheduler = FrameScheduler::new();
+    sessions.set_frame_waker(scheduler.get_waker());
+
     let session = sessions.create_instance();
 
     plugins.add_handler(&view_plugins);
@@ -49,19 +63,41 @@ fn main() {
         }
     }
 
+    let mut frame_sample = SampleName::new("Frame");
+
     loop {
-        bgfx.pre_update();
+        if windows.poll_input() {
+            scheduler.mark_dirty(dirty::INPUT);
+        }
 
-        plugins.update(&mut lib_handler);
-        sessions.update(&mut backend_plugins.borrow_mut());
-        windows.update(&mut sessions, &mut view_plugins.borrow_mut());
+        if plugins.update(&mut lib_handler) {
+            scheduler.mark_dirty(dirty::RELOAD);
+        }
 
         if windows.should_exit() {
             break;
         }
 
+        if scheduler.begin_frame(Instant::now()) == 0 {
+            // views may have requested things in the last frame that the backends haven't got yet
+            sessions.flush_requests();
+            scheduler.wait();
+            continue;
+        }
+
+        let _sample = profiler::begin(&mut frame_sample);
+
+        bgfx.pre_update();
+
+        sessions.update(&mut backend_plugins.borrow_mut());
+        windows.update(&mut sessions, &mut view_plugins.borrow_mut());
+
         bgfx.post_update();
     }
+
+    // the backend threads needs to be done before the profiler goes away
+    drop(sessions);
+    profiler::stop();
 }
 
 // dummy
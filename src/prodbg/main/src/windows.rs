@@ -7,6 +7,7 @@ use libc::{c_void, c_int};
 use minifb::{Scale, WindowOptions, MouseMode, MouseButton, Key, KeyRepeat};
 use core::view_plugins::{ViewHandle, ViewPlugins, ViewInstance};
 use core::session::{Sessions, Session, SessionHandle};
+use core::profiler;
 use self::viewdock::{Workspace, Rect, Direction, DockHandle, SplitHandle};
 use imgui_sys::Imgui;
 use prodbg_api::ui_ffi::{PDVec2};
@@ -36,6 +37,14 @@ impl MouseState {
     }
 }
 
+/// What the input looked like last time it was polled (used to tell if anything has changed)
+#[derive(PartialEq, Clone, Copy)]
+pub struct InputState {
+    mouse: (f32, f32),
+    buttons: (bool, bool, bool),
+    size: (usize, usize),
+}
+
 pub struct Window {
     /// minifb window
     pub win: minifb::Window,
@@ -47,6 +56,8 @@ pub struct Window {
     pub ws: Workspace,
 
     pub mouse_state: MouseState,
+
+    pub input_state: InputState,
 }
 
 struct WindowState {
@@ -104,6 +115,11 @@ impl Windows {
                     win: win,
                     views: Vec::new(),
                     mouse_state: MouseState::new(),
+                    input_state: InputState {
+                        mouse: (0.0, 0.0),
+                        buttons: (false, false, false),
+                        size: (width, height),
+                    },
                     ws: Workspace::new(Rect::new(0.0, 0.0, width as f32, (height - 20) as f32)).unwrap(),
                 })
             }
@@ -125,6 +141,26 @@ impl Windows {
         Ok(window)
     }
 
+    ///
+    /// Handles the events of all windows (without drawing anything) and returns true if there has been any
+    /// input since the last call. This is done even when the main loop skips frames so the windows stays
+    /// responsive.
+    ///
+    pub fn poll_input(&mut self) -> bool {
+        let mut has_input = false;
+
+        for i in (0..self.windows.len()).rev() {
+            has_input |= self.windows[i].poll_input();
+
+            if !self.windows[i].win.is_open() {
+                self.windows.swap_remove(i);
+                has_input = true;
+            }
+        }
+
+        has_input
+    }
+
     pub fn update(&mut self, sessions: &mut Sessions, view_plugins: &mut ViewPlugins) {
         for i in (0..self.windows.len()).rev() {
             self.windows[i].update(sessions, view_plugins);
@@ -186,14 +222,20 @@ impl Window {
             Imgui::mark_show_popup(ui.api, false);
         }
 
+        instance.begin_update(session);
+
+        let sample = profiler::begin(&mut instance.sample_name);
+
         unsafe {
             let plugin_funcs = instance.plugin_type.plugin_funcs as *mut CViewCallbacks;
             ((*plugin_funcs).update.unwrap())(instance.plugin_data,
                                                 ui.api as *mut c_void,
-                                                session.reader.api as *mut c_void,
+                                                instance.reader.api as *mut c_void,
                                                 session.get_current_writer().api as *mut c_void);
         }
 
+        drop(sample);
+
         let has_shown_menu = Imgui::has_showed_popup(ui.api);
 
         Imgui::end_window();
@@ -273,11 +315,34 @@ impl Window {
         self.mouse_state.prev_mouse = mouse_pos;
     }
 
+    fn poll_input(&mut self) -> bool {
+        self.win.update();
+
+        let state = InputState {
+            mouse: self.win.get_mouse_pos(MouseMode::Clamp).unwrap_or((0.0, 0.0)),
+            buttons: (self.win.get_mouse_down(MouseButton::Left),
+                      self.win.get_mouse_down(MouseButton::Middle),
+                      self.win.get_mouse_down(MouseButton::Right)),
+            // resizing the window needs a frame to lay out the views again
+            size: self.win.get_size(),
+        };
+
+        // held buttons and keys keeps the frames coming (dragging, key repeat)
+
+        let buttons_down = state.buttons.0 || state.buttons.1 || state.buttons.2;
+        let keys_down = self.win.get_keys().map_or(false, |keys| !keys.is_empty());
+        let changed = state != self.input_state;
+
+        self.input_state = state;
+
+        changed || buttons_down || keys_down
+    }
+
     pub fn update(&mut self, sessions: &mut Sessions, view_plugins: &mut ViewPlugins) {
         let mut views_to_delete = Vec::new();
         let mut has_shown_menu = 0u32;
 
-        self.win.update();
+        // the events has already been handled in poll_input
         self.ws.update();
 
         let mouse = self.win.get_mouse_pos(MouseMode::Clamp).unwrap_or((0.0, 0.0));
@@ -83,7 +83,7 @@ fn main() {
 
         let show_context_menu = window.get_mouse_down(MouseButton::Right);
 
-        for instance in &view_plugins.borrow_mut().instances {
+        for instance in view_plugins.borrow_mut().instances.iter_mut() {
             let ui = instance.ui;
 
             //bgfx_imgui_set_window_pos(0.0, 0.0);
@@ -104,9 +104,10 @@ fn main() {
             unsafe {
                 let plugin_funcs = instance.plugin_type.plugin_funcs as *mut CViewCallbacks;
                 let session = sessions.get_session(SessionHandle(0)).unwrap();
+                instance.begin_update(session);
                 ((*plugin_funcs).update.unwrap())(instance.plugin_data,
                                                     ui.api as *mut c_void,
-                                                    session.reader.api as *mut c_void,
+                                                    instance.reader.api as *mut c_void,
                                                     session.get_current_writer().api as *mut c_void);
             }
 
@@ -6,12 +6,21 @@
 #include <pd_readwrite.h>
 #include <pd_backend.h> // For eventTypes
 #include "api/src/remote/pd_readwrite_private.h"
-#include "core/log.h"
+#include "api/src/remote/pd_chunk_pool.h"
+#include "api/src/remote/pd_lz4.h"
+#include "api/src/remote/pd_capture.h"
+#include "api/src/remote/pd_request_coalescer.h"
+#include "api/src/remote/pd_memory_cache.h"
+#include "api/src/remote/pd_profiler.h"
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "api/src/remote/log.h"
+}
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static PDReader readerData;
-static PDWriter writerData;
 static PDReader* reader = 0;
 static PDWriter* writer = 0;
 
@@ -25,20 +34,20 @@ void testWriteReadEvent(void**) {
     unsigned char* data;
     unsigned int size;
 
-    PDBinaryWriter_reset(writer);
+    pd_binary_writer_reset(writer);
 
     assert_true(PDWrite_event_begin(writer, 10) == PDWriteStatus_ok);
     assert_true(PDWrite_event_end(writer) == PDWriteStatus_ok);
 
-    PDBinaryWriter_finalize(writer);
+    pd_binary_writer_finalize(writer);
 
-    data = PDBinaryWriter_getData(writer);
-    size = PDBinaryWriter_getSize(writer);
+    data = pd_binary_writer_get_data(writer);
+    size = pd_binary_writer_get_size(writer);
 
     assert_true(data != 0);
     assert_true(size != 0);
 
-    PDBinaryReader_initStream(reader, data, size);
+    pd_binary_reader_init_stream(reader, data, size);
     assert_true(PDRead_get_event(reader) == 10);
 
     assert_true(PDRead_get_event(reader) == 0);    // should be 0 as no more events
@@ -51,21 +60,21 @@ void testDataReadWrite(void**) {
     unsigned int size;
     uint64_t dataSize;
 
-    PDBinaryWriter_reset(writer);
+    pd_binary_writer_reset(writer);
 
     assert_true(PDWrite_event_begin(writer, 10) == PDWriteStatus_ok);
     assert_true(PDWrite_data(writer, "my_data", s_data, sizeof(s_data)) == PDWriteStatus_ok);
     assert_true(PDWrite_event_end(writer) == PDWriteStatus_ok);
 
-    PDBinaryWriter_finalize(writer);
+    pd_binary_writer_finalize(writer);
 
-    data = PDBinaryWriter_getData(writer);
-    size = PDBinaryWriter_getSize(writer);
+    data = pd_binary_writer_get_data(writer);
+    size = pd_binary_writer_get_size(writer);
 
     assert_true(data != 0);
     assert_true(size != 0);
 
-    PDBinaryReader_initStream(reader, data, size);
+    pd_binary_reader_init_stream(reader, data, size);
     assert_true(PDRead_get_event(reader) == 10);
 
     assert_true((PDRead_find_data(reader, (void**)&data, &dataSize, "my_data", 0) & PDReadStatus_TypeMask) == PDReadType_Data);
@@ -94,7 +103,7 @@ void testDataReadWrite(void**) {
 void testWriteReadAction(void**) {
     const char* filename = 0;
     uint32_t value = 0xfadebabe;
-    PDBinaryWriter_reset(writer);
+    pd_binary_writer_reset(writer);
 
     PDWrite_event_begin(writer, PDEventType_SetExecutable);
     PDWrite_string(writer, "filename", "/Users/emoon/code/ProDBG/testbed/tundra-output/macosx-clang-debug-default/TestReadWrite");
@@ -105,7 +114,7 @@ void testWriteReadAction(void**) {
     PDWrite_u32(writer, "action", 3);
     PDWrite_event_end(writer);
 
-    PDBinaryReader_initStream(reader, PDBinaryWriter_getData(writer), PDBinaryWriter_getSize(writer));
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
 
     assert_true(PDRead_get_event(reader) == PDEventType_SetExecutable);
     assert_true(PDRead_find_string(reader, &filename, "filename", 0) == (PDReadStatus_Ok | PDReadType_String));
@@ -119,7 +128,7 @@ void testWriteReadAction(void**) {
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void testWriteSingleString(void**) {
-    PDBinaryWriter_reset(writer);
+    pd_binary_writer_reset(writer);
 
     assert_true(PDWrite_event_begin(writer, 2) == PDWriteStatus_ok);
     assert_true(PDWrite_string(writer, "my_id", "my_string") == PDWriteStatus_ok);
@@ -136,10 +145,10 @@ void testWriteSingleString(void**) {
     const char* stringVal;
     unsigned int size;
 
-    assert_true((data = PDBinaryWriter_getData(writer)) != 0);
-    assert_true((size = PDBinaryWriter_getSize(writer)) != 0);
+    assert_true((data = pd_binary_writer_get_data(writer)) != 0);
+    assert_true((size = pd_binary_writer_get_size(writer)) != 0);
 
-    PDBinaryReader_initStream(reader, data, size);
+    pd_binary_reader_init_stream(reader, data, size);
 
     assert_true(PDRead_get_event(reader) == 2);
 
@@ -171,7 +180,7 @@ void testAllValueTypes(void**) {
 
     // Write
 
-    PDBinaryWriter_reset(writer);
+    pd_binary_writer_reset(writer);
 
     PDWrite_event_begin(writer, 3);
 
@@ -199,11 +208,11 @@ void testAllValueTypes(void**) {
 
     PDWrite_event_end(writer);
 
-    PDBinaryWriter_finalize(writer);
+    pd_binary_writer_finalize(writer);
 
     // Read
 
-    PDBinaryReader_initStream(reader, PDBinaryWriter_getData(writer), PDBinaryWriter_getSize(writer));
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
 
     assert_true(PDRead_get_event(reader) == 3);
 
@@ -287,18 +296,155 @@ void testAllValueTypes(void**) {
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void testHeaderArray(void**) {
-    PDBinaryWriter_reset(writer);
+    static const char* ids[] =
+    {
+        "address",
+        "code",
+        "size",
+        0,
+    };
+
+    static const char* codes[] = { "lda #$00", "sta $d020", "rts" };
+
+    PDReaderIterator arrayIter;
+    const char* code;
+    uint32_t address;
+    uint16_t size16;
+    uint8_t size8;
+    int i;
+
+    pd_binary_writer_reset(writer);
+
+    // must be inside an array
+
+    assert_true(PDWrite_header_array_begin(writer, ids) == PDWriteStatus_Fail);
+    assert_true(PDWrite_header_array_end(writer) == PDWriteStatus_Fail);
+
+    PDWrite_event_begin(writer, 3);
+    PDWrite_u32(writer, "before", 1);
+    PDWrite_array_begin(writer, "disassembly");
+    assert_true(PDWrite_header_array_begin(writer, ids) == PDWriteStatus_ok);
+
+    for (i = 0; i < 3; ++i) {
+        assert_true(PDWrite_u32(writer, 0, 0x1000 + i) == PDWriteStatus_ok);
+        assert_true(PDWrite_string(writer, 0, codes[i]) == PDWriteStatus_ok);
+        assert_true(PDWrite_u8(writer, 0, (uint8_t)(i + 1)) == PDWriteStatus_ok);
+    }
+
+    // column types are fixed by the first row
+
+    assert_true(PDWrite_u16(writer, 0, 0x2000) == PDWriteStatus_Fail);
+    assert_true(PDWrite_data(writer, 0, (void*)codes, 4) == PDWriteStatus_Fail);
+
+    assert_true(PDWrite_header_array_end(writer) == PDWriteStatus_ok);
+    PDWrite_array_end(writer);
+    PDWrite_u32(writer, "after", 2);
+    PDWrite_event_end(writer);
+
+    pd_binary_writer_finalize(writer);
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    assert_int_equal(PDRead_get_event(reader), 3);
+    assert_true(PDRead_find_array(reader, &arrayIter, "disassembly", 0) == (PDReadType_Array | PDReadStatus_Ok));
+
+    for (i = 0; i < 3; ++i) {
+        assert_int_equal(PDRead_get_next_entry(reader, &arrayIter), 3);
+
+        assert_true(PDRead_find_u32(reader, &address, "address", arrayIter) == (PDReadType_U32 | PDReadStatus_Ok));
+        assert_int_equal(address, 0x1000 + i);
+
+        assert_true(PDRead_find_string(reader, &code, "code", arrayIter) == (PDReadType_String | PDReadStatus_Ok));
+        assert_string_equal(code, codes[i]);
+
+        assert_true(PDRead_find_u8(reader, &size8, "size", arrayIter) == (PDReadType_U8 | PDReadStatus_Ok));
+        assert_int_equal(size8, i + 1);
+
+        assert_true(PDRead_find_u16(reader, &size16, "size", arrayIter) == (PDReadType_U8 | PDReadStatus_Converted));
+        assert_int_equal(size16, i + 1);
+
+        assert_true(PDRead_find_u32(reader, &address, "missing", arrayIter) == PDReadStatus_NotFound);
+        assert_true(PDRead_find_u32(reader, &address, "code", arrayIter) == (PDReadType_String | PDReadStatus_IllegalType));
+    }
+
+    assert_int_equal(PDRead_get_next_entry(reader, &arrayIter), 0);
+
+    assert_true(PDRead_find_u32(reader, &address, "after", 0) == (PDReadType_U32 | PDReadStatus_Ok));
+    assert_int_equal(address, 2);
+
+    assert_int_equal(PDRead_get_event(reader), 0);
+}
 
-    // Not implemented so expect it to always fail
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testHeaderArraySize(void**) {
+    static const char* ids[] = { "address", "register", 0 };
+    unsigned int headerSize;
+    unsigned int entrySize;
+    PDReaderIterator arrayIter;
+    int i;
+
+    pd_binary_writer_reset(writer);
+
+    PDWrite_event_begin(writer, 1);
+    PDWrite_array_begin(writer, "items");
+    PDWrite_header_array_begin(writer, ids);
+
+    for (i = 0; i < 100; ++i) {
+        PDWrite_u16(writer, 0, (uint16_t)i);
+        PDWrite_u16(writer, 0, (uint16_t)(i * 2));
+    }
+
+    // header array is closed by array_end as well
+    PDWrite_array_end(writer);
+    PDWrite_event_end(writer);
+
+    headerSize = pd_binary_writer_get_size(writer);
+
+    pd_binary_writer_reset(writer);
+
+    PDWrite_event_begin(writer, 1);
+    PDWrite_array_begin(writer, "items");
+
+    for (i = 0; i < 100; ++i) {
+        PDWrite_array_entry_begin(writer);
+        PDWrite_u16(writer, "address", (uint16_t)i);
+        PDWrite_u16(writer, "register", (uint16_t)(i * 2));
+        PDWrite_entry_end(writer);
+    }
+
+    PDWrite_array_end(writer);
+    PDWrite_event_end(writer);
+
+    entrySize = pd_binary_writer_get_size(writer);
+
+    assert_true(headerSize * 4 < entrySize);
+
+    // empty header array
+
+    pd_binary_writer_reset(writer);
 
-    assert_true(PDWrite_header_array_begin(writer, 0) == PDWriteStatus_Fail);
+    PDWrite_event_begin(writer, 1);
+    PDWrite_array_begin(writer, "items");
+    PDWrite_header_array_begin(writer, ids);
+    PDWrite_u16(writer, 0, 1);  // incomplete row is dropped
     assert_true(PDWrite_header_array_end(writer) == PDWriteStatus_Fail);
+    PDWrite_array_end(writer);
+    PDWrite_event_end(writer);
+
+    pd_binary_writer_finalize(writer);
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    assert_int_equal(PDRead_get_event(reader), 1);
+    assert_true(PDRead_find_array(reader, &arrayIter, "items", 0) == (PDReadType_Array | PDReadStatus_Ok));
+    assert_int_equal(PDRead_get_next_entry(reader, &arrayIter), 0);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void testArrayWriteBreakage(void**) {
-    PDBinaryWriter_reset(writer);
+    pd_binary_writer_reset(writer);
 
     assert_true(PDWrite_array_begin(writer, "test") == PDWriteStatus_ok);
     assert_true(PDWrite_array_begin(writer, "test") == PDWriteStatus_Fail); // Should fail here as we are already writing an array
@@ -306,7 +452,7 @@ void testArrayWriteBreakage(void**) {
     assert_true(PDWrite_array_end(writer) == PDWriteStatus_ok);
     assert_true(PDWrite_array_end(writer) == PDWriteStatus_Fail); // Should fail here as we are ended the array
 
-    PDBinaryWriter_reset(writer);
+    pd_binary_writer_reset(writer);
 
     assert_true(PDWrite_array_begin(writer, "test") == PDWriteStatus_ok);
     assert_true(PDWrite_array_entry_begin(writer) == PDWriteStatus_ok);
@@ -317,7 +463,7 @@ void testArrayWriteBreakage(void**) {
 
     assert_true(PDWrite_array_end(writer) == PDWriteStatus_ok);
 
-    PDBinaryWriter_reset(writer);
+    pd_binary_writer_reset(writer);
 
     assert_true(PDWrite_event_begin(writer, 10) == PDWriteStatus_ok);
     assert_true(PDWrite_event_begin(writer, 10) == PDWriteStatus_Fail);  // Must end even before new event
@@ -333,7 +479,7 @@ void testFind(void**) {
     uint16_t u16;
     uint32_t u32;
 
-    PDBinaryReader_initStream(reader, PDBinaryWriter_getData(writer), PDBinaryWriter_getSize(writer));
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
 
     assert_true(PDRead_get_event(reader) == 3);
 
@@ -356,7 +502,7 @@ void testFind(void**) {
 void testArray(void**) {
     // TODO: More tests
 
-    PDBinaryWriter_reset(writer);
+    pd_binary_writer_reset(writer);
 
     PDWrite_event_begin(writer, 5);
 
@@ -409,7 +555,7 @@ void testArray(void**) {
 void testArrayRead(void**) {
     PDReaderIterator arrayIter;
 
-    PDBinaryReader_initStream(reader, PDBinaryWriter_getData(writer), PDBinaryWriter_getSize(writer));
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
 
     assert_true(PDRead_get_event(reader) == 5);
 
@@ -520,33 +666,1810 @@ void testArrayRead(void**) {
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int main() {
-    log_set_level(LOG_ERROR);
+void testInternedKeys(void**) {
+    PDReaderIterator arrayIter;
+    const char* string;
+    uint32_t u32;
+    uint8_t* data;
+    uint64_t size;
+    int i;
 
-    const UnitTest tests[] =
-    {
-        unit_test(testWriteReadEvent),
-        unit_test(testDataReadWrite),
-        unit_test(testWriteSingleString),
-        unit_test(testWriteReadAction),
-        unit_test(testArrayWriteBreakage),
-        unit_test(testAllValueTypes),
-        unit_test(testFind),
-        unit_test(testArray),
-        unit_test(testArrayRead),
-        unit_test(testHeaderArray),
-    };
+    pd_binary_writer_set_intern_keys(writer, 1);
+    pd_binary_writer_reset(writer);
+
+    PDWrite_event_begin(writer, 7);
+    PDWrite_string(writer, "filename", "test.c");
+    PDWrite_data(writer, "my_data", s_data, sizeof(s_data));
+
+    PDWrite_array_begin(writer, "items");
+
+    for (i = 0; i < 3; ++i) {
+        PDWrite_array_entry_begin(writer);
+        PDWrite_u32(writer, "address", 0x1000 + i);
+        PDWrite_string(writer, "line", "nop");
+        PDWrite_entry_end(writer);
+    }
+
+    PDWrite_array_end(writer);
+    PDWrite_event_end(writer);
+
+    PDWrite_event_begin(writer, 8);
+    PDWrite_u32(writer, "address", 0x2000);
+    PDWrite_event_end(writer);
+
+    pd_binary_writer_finalize(writer);
+
+    // finalize a second time should replace the key table and not add a new one
+
+    size = pd_binary_writer_get_size(writer);
+    pd_binary_writer_finalize(writer);
+    assert_int_equal(size, pd_binary_writer_get_size(writer));
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    assert_int_equal(PDRead_get_event(reader), 7);
+
+    assert_true(PDRead_find_string(reader, &string, "filename", 0) == (PDReadStatus_Ok | PDReadType_String));
+    assert_string_equal(string, "test.c");
+
+    assert_true(PDRead_find_data(reader, (void**)&data, &size, "my_data", 0) == (PDReadStatus_Ok | PDReadType_Data));
+    assert_true(size == sizeof(s_data));
+    assert_true(data[5] == s_data[5]);
+
+    assert_true(PDRead_find_u32(reader, &u32, "unknown_key", 0) == PDReadStatus_NotFound);
+
+    assert_true(PDRead_find_array(reader, &arrayIter, "items", 0) == (PDReadStatus_Ok | PDReadType_Array));
+
+    for (i = 0; i < 3; ++i) {
+        assert_int_equal(PDRead_get_next_entry(reader, &arrayIter), 2);
+        assert_true(PDRead_find_u32(reader, &u32, "address", arrayIter) == (PDReadStatus_Ok | PDReadType_U32));
+        assert_int_equal(u32, 0x1000 + i);
+        assert_true(PDRead_find_string(reader, &string, "line", arrayIter) == (PDReadStatus_Ok | PDReadType_String));
+        assert_string_equal(string, "nop");
+    }
+
+    assert_int_equal(PDRead_get_next_entry(reader, &arrayIter), 0);
+
+    assert_int_equal(PDRead_get_event(reader), 8);
+    assert_true(PDRead_find_u32(reader, &u32, "address", 0) == (PDReadStatus_Ok | PDReadType_U32));
+    assert_int_equal(u32, 0x2000);
+
+    assert_int_equal(PDRead_get_event(reader), 0);
+
+    pd_binary_writer_set_intern_keys(writer, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testWriterGrow(void**) {
+    uint8_t* data;
+    uint8_t* largeData;
+    uint64_t size;
+    uint32_t u32;
+    const int largeSize = 3 * 1024 * 1024;
+    int i;
+
+    largeData = (uint8_t*)malloc(largeSize);
+
+    for (i = 0; i < largeSize; ++i)
+        largeData[i] = (uint8_t)i;
+
+    pd_binary_writer_reset(writer);
+
+    // make sure the buffer has to grow in the middle of an event
+
+    PDWrite_event_begin(writer, 9);
+    assert_true(PDWrite_u32(writer, "before", 1) == PDWriteStatus_ok);
+    assert_true(PDWrite_data(writer, "memory", largeData, largeSize) == PDWriteStatus_ok);
+    assert_true(PDWrite_u32(writer, "after", 2) == PDWriteStatus_ok);
+    PDWrite_event_end(writer);
+
+    pd_binary_writer_finalize(writer);
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    assert_int_equal(PDRead_get_event(reader), 9);
+
+    assert_true(PDRead_find_data(reader, (void**)&data, &size, "memory", 0) == (PDReadStatus_Ok | PDReadType_Data));
+    assert_true(size == (uint64_t)largeSize);
+    assert_true(memcmp(data, largeData, largeSize) == 0);
+
+    assert_true(PDRead_find_u32(reader, &u32, "after", 0) == (PDReadStatus_Ok | PDReadType_U32));
+    assert_int_equal(u32, 2);
+
+    assert_int_equal(PDRead_get_event(reader), 0);
+
+    free(largeData);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void* limitedAlloc(void* user_data, size_t size) {
+    if (size > *(size_t*)user_data)
+        return 0;
+
+    return malloc(size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void limitedFree(void*, void* ptr, size_t) {
+    free(ptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testWriterOutOfMemory(void**) {
+    PDWriter limitedWriterData;
+    PDWriter* limitedWriter = &limitedWriterData;
+    PDBinaryAllocator allocator;
+    size_t maxAlloc = 64 * 1024;
+    uint8_t* largeData;
+    uint32_t u32;
+    const int largeSize = 128 * 1024;
+
+    allocator.alloc = limitedAlloc;
+    allocator.free = limitedFree;
+    allocator.user_data = &maxAlloc;
+
+    largeData = (uint8_t*)malloc(largeSize);
+    memset(largeData, 0x11, largeSize);
+
+    pd_binary_writer_init_with_allocator(limitedWriter, &allocator);
+
+    PDWrite_event_begin(limitedWriter, 1);
+    assert_true(PDWrite_u32(limitedWriter, "value", 4) == PDWriteStatus_ok);
+    PDWrite_event_end(limitedWriter);
+
+    // doesn't fit and the allocator refuses to grow so this should fail without corrupting the stream
+
+    PDWrite_event_begin(limitedWriter, 2);
+    assert_true(PDWrite_data(limitedWriter, "memory", largeData, largeSize) == PDWriteStatus_Fail);
+    PDWrite_event_end(limitedWriter);
+
+    pd_binary_writer_finalize(limitedWriter);
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(limitedWriter), pd_binary_writer_get_size(limitedWriter));
+
+    assert_int_equal(PDRead_get_event(reader), 1);
+    assert_true(PDRead_find_u32(reader, &u32, "value", 0) == (PDReadStatus_Ok | PDReadType_U32));
+    assert_int_equal(u32, 4);
+
+    assert_int_equal(PDRead_get_event(reader), 2);
+    assert_int_equal(PDRead_get_event(reader), 0);
+
+    // the entry table at the end of the array doesn't fit. The array should be ended anyway so new ones can be
+    // written
+
+    pd_binary_writer_reset(limitedWriter);
+
+    PDWrite_event_begin(limitedWriter, 3);
+    assert_true(PDWrite_array_begin(limitedWriter, "entries") == PDWriteStatus_ok);
+
+    while (pd_binary_writer_get_size(limitedWriter) < maxAlloc - 1024) {
+        PDWrite_array_entry_begin(limitedWriter);
+        PDWrite_u32(limitedWriter, "v", 1);
+        PDWrite_entry_end(limitedWriter);
+    }
+
+    assert_true(PDWrite_array_end(limitedWriter) == PDWriteStatus_Fail);
+    PDWrite_event_end(limitedWriter);
+
+    PDWrite_event_begin(limitedWriter, 4);
+    assert_true(PDWrite_array_begin(limitedWriter, "entries") == PDWriteStatus_ok);
+    PDWrite_array_entry_begin(limitedWriter);
+    PDWrite_u32(limitedWriter, "v", 2);
+    PDWrite_entry_end(limitedWriter);
+    assert_true(PDWrite_array_end(limitedWriter) == PDWriteStatus_ok);
+    PDWrite_event_end(limitedWriter);
+
+    pd_binary_writer_destroy(limitedWriter);
+
+    free(largeData);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct AllocCounts {
+    int allocs;
+    int frees;
+    size_t bytes;
+};
+
+static void* countingAlloc(void* user_data, size_t size) {
+    AllocCounts* counts = (AllocCounts*)user_data;
+    counts->allocs++;
+    counts->bytes += size;
+    return malloc(size);
+}
+
+static void countingFree(void* user_data, void* ptr, size_t size) {
+    AllocCounts* counts = (AllocCounts*)user_data;
+
+    if (!ptr)
+        return;
+
+    counts->frees++;
+    counts->bytes -= size;
+    free(ptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testWriterAllocator(void**) {
+    PDWriter countedWriterData;
+    PDWriter* countedWriter = &countedWriterData;
+    PDBinaryAllocator allocator;
+    AllocCounts counts = { 0, 0, 0 };
+
+    allocator.alloc = countingAlloc;
+    allocator.free = countingFree;
+    allocator.user_data = &counts;
+
+    // the writer state and the stream buffer
+
+    pd_binary_writer_init_with_allocator(countedWriter, &allocator);
+    assert_int_equal(counts.allocs, 2);
+
+    PDWrite_event_begin(countedWriter, 1);
+    PDWrite_u32(countedWriter, "value", 1);
+    PDWrite_event_end(countedWriter);
+
+    // the table of entry offsets for arrays
+
+    PDWrite_event_begin(countedWriter, 2);
+    PDWrite_array_begin(countedWriter, "entries");
+
+    for (int i = 0; i < 1000; ++i) {
+        PDWrite_array_entry_begin(countedWriter);
+        PDWrite_u32(countedWriter, "v", (uint32_t)i);
+        PDWrite_entry_end(countedWriter);
+    }
+
+    PDWrite_array_end(countedWriter);
+    PDWrite_event_end(countedWriter);
+
+    assert_true(counts.allocs > 2);
+
+    // data references and the segments to send them
+
+    PDWrite_event_begin(countedWriter, 3);
+
+    for (int i = 0; i < 100; ++i)
+        PDWrite_data_ref(countedWriter, "ref", &counts, sizeof(counts), 0, 0);
+
+    PDWrite_event_end(countedWriter);
+    pd_binary_writer_finalize(countedWriter);
+
+    int segmentCount = 0;
+    assert_non_null(pd_binary_writer_get_segments(countedWriter, &segmentCount));
+    assert_int_equal(segmentCount, 102);
+
+    pd_binary_writer_destroy(countedWriter);
+
+    assert_int_equal(counts.allocs, counts.frees);
+    assert_int_equal((int)counts.bytes, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testChunkPool(void**) {
+    PDWriter pooledWriterData;
+    PDWriter* pooledWriter = &pooledWriterData;
+    PDBinaryAllocator allocator;
+    struct PDChunkPool* pool = pd_chunk_pool_create();
+    unsigned char* data;
+
+    pd_chunk_pool_get_allocator(pool, &allocator);
+
+    // a writer that is created and destroyed should get the same chunk back from the pool
+
+    pd_binary_writer_init_with_allocator(pooledWriter, &allocator);
+    data = pd_binary_writer_get_data(pooledWriter);
+    pd_binary_writer_destroy(pooledWriter);
+
+    pd_binary_writer_init_with_allocator(pooledWriter, &allocator);
+    assert_true(pd_binary_writer_get_data(pooledWriter) == data);
+    pd_binary_writer_destroy(pooledWriter);
+
+    pd_chunk_pool_destroy(pool);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testLz4(void**) {
+    const int size = 256 * 1024;
+    uint8_t* data = (uint8_t*)malloc(size);
+    uint8_t* out = (uint8_t*)malloc(size);
+    int capacity = pd_lz4_compress_bound(size);
+    uint8_t* compressed = (uint8_t*)malloc(capacity);
+    uint32_t seed = 1;
+    int compressedSize;
+
+    // repeating patterns (with overlapping matches) mixed with random data
+
+    for (int i = 0; i < size; ++i) {
+        seed = seed * 1103515245 + 12345;
+
+        if ((i & 0xffff) < 0x8000)
+            data[i] = (uint8_t)("abcab"[i % 5]);
+        else if ((i & 0xffff) < 0xc000)
+            data[i] = 0;
+        else
+            data[i] = (uint8_t)(seed >> 16);
+    }
+
+    compressedSize = pd_lz4_compress(data, size, compressed, capacity);
+
+    assert_true(compressedSize > 0);
+    assert_true(compressedSize < size / 2);
+    assert_int_equal(pd_lz4_decompress(compressed, compressedSize, out, size), size);
+    assert_memory_equal(data, out, size);
+
+    // too small output and cut off input needs to fail
+
+    assert_int_equal(pd_lz4_decompress(compressed, compressedSize, out, size - 1), -1);
+    assert_true(pd_lz4_decompress(compressed, compressedSize / 2, out, size) != size);
+
+    // small inputs are stored as literals only
+
+    compressedSize = pd_lz4_compress((const uint8_t*)"abc", 3, compressed, capacity);
+
+    assert_int_equal(pd_lz4_decompress(compressed, compressedSize, out, size), 3);
+    assert_memory_equal(out, "abc", 3);
+
+    free(compressed);
+    free(out);
+    free(data);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Blocks made by the reference implementation (LZ4_compress_default from liblz4 1.9.4) has to decode and the
+// compressor has to produce blocks it can decode. The first one has long literals and an overlapping match and the
+// second a match long enough to need several length bytes
+
+static const char s_lz4Plain[] =
+    "The quick brown fox jumps over the lazy dog. "
+    "The quick brown fox jumps over the lazy dog. "
+    "The quick brown fox jumps over the lazy dog. "
+    "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+    "0123456789abcdefghij";
+
+static const uint8_t s_lz4Block[] =
+{
+    0xff, 0x1e, 0x54, 0x68, 0x65, 0x20, 0x71, 0x75, 0x69, 0x63, 0x6b, 0x20, 0x62, 0x72, 0x6f, 0x77,
+    0x6e, 0x20, 0x66, 0x6f, 0x78, 0x20, 0x6a, 0x75, 0x6d, 0x70, 0x73, 0x20, 0x6f, 0x76, 0x65, 0x72,
+    0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x61, 0x7a, 0x79, 0x20, 0x64, 0x6f, 0x67, 0x2e, 0x20, 0x2d,
+    0x00, 0x47, 0x1f, 0x61, 0x01, 0x00, 0x14, 0xf0, 0x05, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36,
+    0x37, 0x38, 0x39, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+};
+
+// 1000 'b' followed by "0123456789ab"
+
+static const uint8_t s_lz4LongMatchBlock[] =
+{
+    0x1f, 0x62, 0x01, 0x00, 0xff, 0xff, 0xff, 0xd7, 0xc0, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36,
+    0x37, 0x38, 0x39, 0x61, 0x62,
+};
+
+void testLz4Reference(void**) {
+    const int plainSize = (int)sizeof(s_lz4Plain) - 1;
+    uint8_t longMatch[1012];
+    uint8_t compressed[512];
+    uint8_t out[2048];
+    int compressedSize;
+
+    assert_int_equal(pd_lz4_decompress(s_lz4Block, sizeof(s_lz4Block), out, sizeof(out)), plainSize);
+    assert_memory_equal(out, s_lz4Plain, plainSize);
+
+    memset(longMatch, 'b', 1000);
+    memcpy(longMatch + 1000, "0123456789ab", 12);
+
+    assert_int_equal(pd_lz4_decompress(s_lz4LongMatchBlock, sizeof(s_lz4LongMatchBlock), out, sizeof(out)), 1012);
+    assert_memory_equal(out, longMatch, 1012);
+
+    // the other way around. For this input the compressor picks the same matches as the reference implementation
+    // (LZ4_decompress_safe decodes the output as well)
+
+    compressedSize = pd_lz4_compress((const uint8_t*)s_lz4Plain, plainSize, compressed, sizeof(compressed));
+
+    assert_int_equal(compressedSize, sizeof(s_lz4Block));
+    assert_memory_equal(compressed, s_lz4Block, sizeof(s_lz4Block));
+
+    memset(out, 0, sizeof(out));
+    assert_int_equal(pd_lz4_decompress(compressed, compressedSize, out, sizeof(out)), plainSize);
+    assert_memory_equal(out, s_lz4Plain, plainSize);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testReaderIndex(void**) {
+    PDReader* indexReader = pd_binary_reader_create();
+    PDReaderIterator arrayIter;
+    const char* string;
+    uint32_t value;
+    int i, pass;
+
+    pd_binary_reader_set_use_index(indexReader, 1);
+
+    pd_binary_writer_reset(writer);
 
-    reader = &readerData;
-    writer = &writerData;
+    PDWrite_event_begin(writer, 1);
+    PDWrite_u32(writer, "value", 1);
+    PDWrite_u32(writer, "value", 2);  // first one should be found
+    PDWrite_array_begin(writer, "items");
+
+    for (i = 0; i < 4; ++i) {
+        PDWrite_array_entry_begin(writer);
+        PDWrite_u32(writer, "value", 10 + i);
+        PDWrite_string(writer, "name", "item");
+        PDWrite_entry_end(writer);
+    }
+
+    PDWrite_array_end(writer);
+    PDWrite_event_end(writer);
+
+    PDWrite_event_begin(writer, 2);
+    PDWrite_u32(writer, "other", 3);
+    PDWrite_event_end(writer);
+
+    pd_binary_writer_finalize(writer);
+
+    pd_binary_reader_init_stream(indexReader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    // read the stream twice to make sure the index survives a reset
+
+    for (pass = 0; pass < 2; ++pass) {
+        assert_int_equal(PDRead_get_event(indexReader), 1);
+
+        assert_true(PDRead_find_u32(indexReader, &value, "value", 0) == (PDReadType_U32 | PDReadStatus_Ok));
+        assert_int_equal(value, 1);
+
+        // keys from other events shouldn't be found
+        assert_true(PDRead_find_u32(indexReader, &value, "other", 0) == PDReadStatus_NotFound);
+        assert_true(PDRead_find_string(indexReader, &string, "name", 0) == PDReadStatus_NotFound);
+
+        assert_true(PDRead_find_array(indexReader, &arrayIter, "items", 0) == (PDReadType_Array | PDReadStatus_Ok));
+
+        for (i = 0; i < 4; ++i) {
+            assert_int_equal(PDRead_get_next_entry(indexReader, &arrayIter), 2);
+            assert_true(PDRead_find_u32(indexReader, &value, "value", arrayIter) == (PDReadType_U32 | PDReadStatus_Ok));
+            assert_int_equal(value, 10 + i);
+            assert_true(PDRead_find_string(indexReader, &string, "name", arrayIter) == (PDReadType_String | PDReadStatus_Ok));
+            assert_string_equal(string, "item");
+        }
+
+        assert_int_equal(PDRead_get_next_entry(indexReader, &arrayIter), 0);
+
+        assert_int_equal(PDRead_get_event(indexReader), 2);
+        assert_true(PDRead_find_u32(indexReader, &value, "other", 0) == (PDReadType_U32 | PDReadStatus_Ok));
+        assert_int_equal(value, 3);
+        assert_true(PDRead_find_u32(indexReader, &value, "value", 0) == PDReadStatus_NotFound);
+
+        assert_int_equal(PDRead_get_event(indexReader), 0);
+
+        pd_binary_reader_reset(indexReader);
+    }
+
+    pd_binary_reader_destroy(indexReader);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testZeroSizedBlocks(void**) {
+    static uint8_t payloads[] = { 0, 0, 0, 0, PDReadType_DataRefPayloads, 0, 0, 0, 0 };
+    static uint8_t keyTable[] = { 0, 0, 0, 0, PDReadType_KeyTable, 0, 0, 0, 0, 0, 0 };
+    static uint8_t stream[64];
+    unsigned int size;
+
+    // a corrupt stream with a zero sized block in it must stop the reader instead of looping on the same block
+
+    pd_binary_reader_init_stream(reader, payloads, sizeof(payloads));
+    assert_true(PDRead_get_event(reader) == 0);
+
+    pd_binary_reader_init_stream(reader, keyTable, sizeof(keyTable));
+    assert_true(PDRead_get_event(reader) == 0);
+
+    pd_binary_writer_reset(writer);
+    PDWrite_event_begin(writer, 10);
+    PDWrite_u32(writer, "value", 1);
+    PDWrite_event_end(writer);
+    pd_binary_writer_finalize(writer);
+
+    size = pd_binary_writer_get_size(writer);
+    assert_true(size <= sizeof(stream));
+    memcpy(stream, pd_binary_writer_get_data(writer), size);
+
+    // clear the size of the event (type, u16 event id and then the u32 size)
+
+    memset(stream + 4 + 3, 0, 4);
+
+    pd_binary_reader_init_stream(reader, stream, size);
+    assert_true(PDRead_get_event(reader) == 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testArrayRandomAccess(void**) {
+    static const char* ids[] = { "address", "text", 0 };
+    PDReaderIterator arrayIter;
+    PDReaderIterator entryIter;
+    uint32_t value;
+    const char* text;
+    char name[32];
+    int i;
+
+    pd_binary_writer_reset(writer);
+
+    PDWrite_event_begin(writer, 1);
+
+    PDWrite_array_begin(writer, "items");
+
+    for (i = 0; i < 1000; ++i) {
+        PDWrite_array_entry_begin(writer);
+        PDWrite_u32(writer, "value", i);
+
+        // entries with different sizes so we can't just calculate the offset
+        if (i & 1)
+            PDWrite_string(writer, "odd", "odd entry");
+
+        PDWrite_entry_end(writer);
+    }
+
+    PDWrite_array_end(writer);
+
+    PDWrite_array_begin(writer, "rows");
+    PDWrite_header_array_begin(writer, ids);
+
+    for (i = 0; i < 100; ++i) {
+        sprintf(name, "row %d", i);
+        PDWrite_u32(writer, 0, 0x1000 + i);
+        PDWrite_string(writer, 0, name);
+    }
+
+    PDWrite_header_array_end(writer);
+    PDWrite_array_end(writer);
+
+    PDWrite_array_begin(writer, "empty");
+    PDWrite_array_end(writer);
+
+    PDWrite_event_end(writer);
+
+    pd_binary_writer_finalize(writer);
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    assert_int_equal(PDRead_get_event(reader), 1);
+
+    assert_true(PDRead_find_array(reader, &arrayIter, "items", 0) == (PDReadType_Array | PDReadStatus_Ok));
+    assert_int_equal(PDRead_array_count(reader, arrayIter), 1000);
+
+    assert_true(PDRead_array_at(reader, &entryIter, arrayIter, 777) == (PDReadType_ArrayEntry | PDReadStatus_Ok));
+    assert_true(PDRead_find_u32(reader, &value, "value", entryIter) == (PDReadType_U32 | PDReadStatus_Ok));
+    assert_int_equal(value, 777);
+    assert_true(PDRead_find_string(reader, &text, "odd", entryIter) == (PDReadType_String | PDReadStatus_Ok));
+
+    // continue stepping from the entry
+
+    assert_int_equal(PDRead_get_next_entry(reader, &entryIter), 1);
+    assert_true(PDRead_find_u32(reader, &value, "value", entryIter) == (PDReadType_U32 | PDReadStatus_Ok));
+    assert_int_equal(value, 778);
+
+    assert_true(PDRead_array_at(reader, &entryIter, arrayIter, 0) == (PDReadType_ArrayEntry | PDReadStatus_Ok));
+    assert_true(PDRead_find_u32(reader, &value, "value", entryIter) == (PDReadType_U32 | PDReadStatus_Ok));
+    assert_int_equal(value, 0);
+
+    assert_true(PDRead_array_at(reader, &entryIter, arrayIter, 1000) == PDReadStatus_NotFound);
+
+    // stepping still works as before
+
+    for (i = 0; i < 1000; ++i)
+        assert_true(PDRead_get_next_entry(reader, &arrayIter) > 0);
+
+    assert_int_equal(PDRead_get_next_entry(reader, &arrayIter), 0);
+
+    assert_true(PDRead_find_array(reader, &arrayIter, "rows", 0) == (PDReadType_Array | PDReadStatus_Ok));
+    assert_int_equal(PDRead_array_count(reader, arrayIter), 100);
+
+    assert_true(PDRead_array_at(reader, &entryIter, arrayIter, 42) == (PDReadType_ArrayEntry | PDReadStatus_Ok));
+    assert_true(PDRead_find_u32(reader, &value, "address", entryIter) == (PDReadType_U32 | PDReadStatus_Ok));
+    assert_int_equal(value, 0x1000 + 42);
+    assert_true(PDRead_find_string(reader, &text, "text", entryIter) == (PDReadType_String | PDReadStatus_Ok));
+    assert_string_equal(text, "row 42");
+
+    assert_int_equal(PDRead_get_next_entry(reader, &entryIter), 2);
+    assert_true(PDRead_find_u32(reader, &value, "address", entryIter) == (PDReadType_U32 | PDReadStatus_Ok));
+    assert_int_equal(value, 0x1000 + 43);
+
+    assert_true(PDRead_array_at(reader, &entryIter, arrayIter, 100) == PDReadStatus_NotFound);
+
+    assert_true(PDRead_find_array(reader, &arrayIter, "empty", 0) == (PDReadType_Array | PDReadStatus_Ok));
+    assert_int_equal(PDRead_array_count(reader, arrayIter), 0);
+    assert_true(PDRead_array_at(reader, &entryIter, arrayIter, 0) == PDReadStatus_NotFound);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const char* s_headerIds[] = { "value", 0 };
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void countRelease(void* user_data, void*) {
+    (*(int*)user_data)++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testDataRef(void**) {
+    static uint8_t refData[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    static uint8_t copyData[] = { 0xff, 0xfe };
+    const PDBinarySegment* segments;
+    const uint8_t* header;
+    uint8_t* wireData;
+    uint8_t* data;
+    uint64_t size;
+    uint32_t value;
+    unsigned int wireSize = 0;
+    int releaseCount = 0;
+    int segmentCount;
+    int i;
+
+    pd_binary_writer_reset(writer);
+
+    PDWrite_event_begin(writer, 1);
+    PDWrite_u32(writer, "before", 1);
+    assert_true(PDWrite_data_ref(writer, "ref", refData, sizeof(refData), countRelease, &releaseCount) == PDWriteStatus_ok);
+    PDWrite_data(writer, "copy", copyData, sizeof(copyData));
+    PDWrite_u32(writer, "after", 2);
+    PDWrite_event_end(writer);
+
+    // same process so we should get the original pointer back
+
+    pd_binary_reader_init_from_writer(reader, writer);
+
+    assert_int_equal(PDRead_get_event(reader), 1);
+    assert_true(PDRead_find_data(reader, (void**)&data, &size, "ref", 0) == (PDReadType_Data | PDReadStatus_Ok));
+    assert_true(data == refData);
+    assert_true(size == sizeof(refData));
+    assert_true(PDRead_find_u32(reader, &value, "after", 0) == (PDReadType_U32 | PDReadStatus_Ok));
+
+    // but a received stream can't point to memory in this process
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    assert_int_equal(PDRead_get_event(reader), 1);
+    assert_true(PDRead_find_data(reader, (void**)&data, &size, "ref", 0) == (PDReadType_Data | PDReadStatus_Fail));
+    assert_true(PDRead_find_u32(reader, &value, "after", 0) == (PDReadType_U32 | PDReadStatus_Ok));
+
+    // gather the segments as they would be sent and read them back
+
+    segments = pd_binary_writer_get_segments(writer, &segmentCount);
+    assert_non_null(segments);
+    assert_int_equal(segmentCount, 3);
+
+    for (i = 0; i < segmentCount; ++i)
+        wireSize += segments[i].size;
+
+    header = (const uint8_t*)segments[0].data;
+    assert_int_equal(wireSize, ((header[0] & 0x3f) << 24) | (header[1] << 16) | (header[2] << 8) | header[3]);
+
+    wireData = (uint8_t*)malloc(wireSize);
+    wireSize = 0;
+
+    for (i = 0; i < segmentCount; ++i) {
+        memcpy(wireData + wireSize, segments[i].data, segments[i].size);
+        wireSize += segments[i].size;
+    }
+
+    pd_binary_reader_init_stream(reader, wireData, wireSize);
+
+    assert_int_equal(PDRead_get_event(reader), 1);
+    assert_true(PDRead_find_data(reader, (void**)&data, &size, "ref", 0) == (PDReadType_Data | PDReadStatus_Ok));
+    assert_true(data != refData);
+    assert_true(size == sizeof(refData));
+    assert_memory_equal(data, refData, sizeof(refData));
+    assert_true(PDRead_find_data(reader, (void**)&data, &size, "copy", 0) == (PDReadType_Data | PDReadStatus_Ok));
+    assert_memory_equal(data, copyData, sizeof(copyData));
+    assert_int_equal(PDRead_get_event(reader), 0);
+
+    // payload offsets outside of the received stream are rejected. The offset of the payload (relative to the data
+    // after the 4 byte header) is stored big endian in the value of the reference
+
+    for (i = 0; i < (int)(wireSize - sizeof(refData)); ++i) {
+        if (!memcmp(wireData + i, refData, sizeof(refData)))
+            break;
+    }
+
+    value = (uint32_t)(i - 4);
+
+    for (i = 0; i < (int)wireSize - 4; ++i) {
+        uint8_t* offset = wireData + i;
+
+        if (offset[0] == (value >> 24) && offset[1] == ((value >> 16) & 0xff) &&
+            offset[2] == ((value >> 8) & 0xff) && offset[3] == (value & 0xff)) {
+            offset[2] = (uint8_t)(wireSize >> 8);
+            offset[3] = (uint8_t)wireSize;
+            break;
+        }
+    }
+
+    pd_binary_reader_init_stream(reader, wireData, wireSize);
+
+    assert_int_equal(PDRead_get_event(reader), 1);
+    assert_true(PDRead_find_data(reader, (void**)&data, &size, "ref", 0) == (PDReadType_Data | PDReadStatus_Fail));
+    assert_true(PDRead_find_data(reader, (void**)&data, &size, "copy", 0) == (PDReadType_Data | PDReadStatus_Ok));
+
+    free(wireData);
+
+    assert_int_equal(releaseCount, 0);
+    pd_binary_writer_reset(writer);
+    assert_int_equal(releaseCount, 1);
+
+    // release is called directly if the write fails
+
+    PDWrite_array_begin(writer, "items");
+    PDWrite_header_array_begin(writer, s_headerIds);
+    assert_true(PDWrite_data_ref(writer, 0, refData, sizeof(refData), countRelease, &releaseCount) == PDWriteStatus_Fail);
+    assert_int_equal(releaseCount, 2);
+    PDWrite_array_end(writer);
+
+    pd_binary_writer_reset(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testTypedArrays(void**) {
+    static uint8_t memory[4096];
+    static const uint16_t u16Values[] = { 0x1234, 0xffff, 0 };
+    static const uint32_t u32Values[] = { 0x12345678, 0xdeadbeef };
+    static const uint64_t u64Values[] = { 0x0123456789abcdefULL, 1, 2, 3 };
+    static const float f32Values[] = { 1.0f, -2.5f };
+    const uint8_t* u8Res;
+    const uint16_t* u16Res;
+    const uint32_t* u32Res;
+    const uint64_t* u64Res;
+    const float* f32Res;
+    uint32_t count;
+    uint32_t value;
+    unsigned int size;
+    int i;
+
+    for (i = 0; i < (int)sizeof(memory); ++i)
+        memory[i] = (uint8_t)(i * 7);
+
+    pd_binary_writer_reset(writer);
+
+    PDWrite_event_begin(writer, 1);
+    PDWrite_u8(writer, "odd", 1);   // make sure we aren't aligned by accident
+    assert_true(PDWrite_u8_array(writer, "memory", memory, sizeof(memory)) == PDWriteStatus_ok);
+    assert_true(PDWrite_u16_array(writer, "u16", u16Values, 3) == PDWriteStatus_ok);
+    assert_true(PDWrite_u32_array(writer, "u32", u32Values, 2) == PDWriteStatus_ok);
+    assert_true(PDWrite_u64_array(writer, "registers", u64Values, 4) == PDWriteStatus_ok);
+    assert_true(PDWrite_f32_array(writer, "floats", f32Values, 2) == PDWriteStatus_ok);
+    assert_true(PDWrite_u32_array(writer, "empty", u32Values, 0) == PDWriteStatus_ok);
+    PDWrite_u32(writer, "after", 3);
+    PDWrite_event_end(writer);
+
+    // the overhead should only be the header and a few bytes of padding
+
+    size = pd_binary_writer_get_size(writer);
+    assert_true(size < sizeof(memory) + 3 * 2 + 2 * 4 + 4 * 8 + 2 * 4 + 200);
+
+    pd_binary_writer_finalize(writer);
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    assert_int_equal(PDRead_get_event(reader), 1);
+
+    assert_true(PDRead_find_u8_array(reader, &u8Res, &count, "memory", 0) == (PDReadType_U8Array | PDReadStatus_Ok));
+    assert_int_equal(count, sizeof(memory));
+    assert_memory_equal(u8Res, memory, sizeof(memory));
+
+    assert_true(PDRead_find_u16_array(reader, &u16Res, &count, "u16", 0) == (PDReadType_U16Array | PDReadStatus_Ok));
+    assert_int_equal(count, 3);
+    assert_true(((uintptr_t)u16Res & 1) == 0);
+    assert_memory_equal(u16Res, u16Values, sizeof(u16Values));
+
+    assert_true(PDRead_find_u32_array(reader, &u32Res, &count, "u32", 0) == (PDReadType_U32Array | PDReadStatus_Ok));
+    assert_int_equal(count, 2);
+    assert_true(((uintptr_t)u32Res & 3) == 0);
+    assert_int_equal(u32Res[1], 0xdeadbeef);
+
+    assert_true(PDRead_find_u64_array(reader, &u64Res, &count, "registers", 0) == (PDReadType_U64Array | PDReadStatus_Ok));
+    assert_int_equal(count, 4);
+    assert_true(((uintptr_t)u64Res & 7) == 0);
+    assert_true(u64Res[0] == 0x0123456789abcdefULL);
+    assert_true(u64Res[3] == 3);
+
+    assert_true(PDRead_find_f32_array(reader, &f32Res, &count, "floats", 0) == (PDReadType_FloatArray | PDReadStatus_Ok));
+    assert_int_equal(count, 2);
+    assert_true(f32Res[1] == -2.5f);
+
+    assert_true(PDRead_find_u32_array(reader, &u32Res, &count, "empty", 0) == (PDReadType_U32Array | PDReadStatus_Ok));
+    assert_int_equal(count, 0);
+
+    // no conversion between array types
+
+    assert_true(PDRead_find_u32_array(reader, &u32Res, &count, "u16", 0) == (PDReadType_U16Array | PDReadStatus_IllegalType));
+    assert_true(PDRead_find_u32(reader, &value, "u32", 0) == (PDReadType_U32Array | PDReadStatus_IllegalType));
+    assert_true(PDRead_find_u32_array(reader, &u32Res, &count, "missing", 0) == PDReadStatus_NotFound);
+
+    assert_true(PDRead_find_u32(reader, &value, "after", 0) == (PDReadType_U32 | PDReadStatus_Ok));
+    assert_int_equal(value, 3);
+
+    // the values are stored little endian whatever the host is
+
+    {
+        static const uint8_t u16Bytes[] = { 0x34, 0x12, 0xff, 0xff, 0, 0 };
+        uint8_t* data = pd_binary_writer_get_data(writer);
+        bool found = false;
+
+        for (i = 0; i < (int)(size - sizeof(u16Bytes)); ++i) {
+            if (!memcmp(data + i, u16Bytes, sizeof(u16Bytes)))
+                found = true;
+        }
+
+        assert_true(found);
+    }
+
+    // a received stream (such as from RemoteConnectionUV_nextFrame) can be anywhere in memory so the values
+    // may not be aligned, the find functions fail then and the copy functions have to be used
+
+    {
+        uint8_t* unaligned;
+        uint16_t u16Copy[3] = { 0 };
+        uint32_t u32Copy[1] = { 0 };
+        uint64_t u64Copy[4] = { 0 };
+        float f32Copy[2] = { 0 };
+        uint8_t u8Copy[16] = { 0 };
+
+        // the size doesn't include the 4 byte size at the start of the data
+
+        size = pd_binary_writer_get_size(writer);
+        unaligned = (uint8_t*)malloc(size + 4 + 1);
+
+        memcpy(unaligned + 1, pd_binary_writer_get_data(writer), size + 4);
+
+        pd_binary_reader_init_stream(reader, unaligned + 1, size);
+
+        assert_int_equal(PDRead_get_event(reader), 1);
+
+        assert_true(PDRead_find_u16_array(reader, &u16Res, &count, "u16", 0) == (PDReadType_U16Array | PDReadStatus_Fail));
+        assert_true(u16Res == 0);
+        assert_true(PDRead_find_u64_array(reader, &u64Res, &count, "registers", 0) == (PDReadType_U64Array | PDReadStatus_Fail));
+        assert_true(PDRead_find_u8_array(reader, &u8Res, &count, "memory", 0) == (PDReadType_U8Array | PDReadStatus_Ok));
+
+        assert_true(PDRead_copy_u16_array(reader, u16Copy, 3, &count, "u16", 0) == (PDReadType_U16Array | PDReadStatus_Ok));
+        assert_int_equal(count, 3);
+        assert_memory_equal(u16Copy, u16Values, sizeof(u16Values));
+
+        // only maxCount values are copied but count is the size of the array
+
+        assert_true(PDRead_copy_u32_array(reader, u32Copy, 1, &count, "u32", 0) == (PDReadType_U32Array | PDReadStatus_Ok));
+        assert_int_equal(count, 2);
+        assert_int_equal(u32Copy[0], 0x12345678);
+
+        assert_true(PDRead_copy_u64_array(reader, u64Copy, 4, &count, "registers", 0) == (PDReadType_U64Array | PDReadStatus_Ok));
+        assert_memory_equal(u64Copy, u64Values, sizeof(u64Values));
+
+        assert_true(PDRead_copy_f32_array(reader, f32Copy, 2, &count, "floats", 0) == (PDReadType_FloatArray | PDReadStatus_Ok));
+        assert_true(f32Copy[1] == -2.5f);
+
+        assert_true(PDRead_copy_u8_array(reader, u8Copy, 16, &count, "memory", 0) == (PDReadType_U8Array | PDReadStatus_Ok));
+        assert_int_equal(count, sizeof(memory));
+        assert_memory_equal(u8Copy, memory, sizeof(u8Copy));
+
+        assert_true(PDRead_copy_u32_array(reader, u32Copy, 1, &count, "u16", 0) == (PDReadType_U16Array | PDReadStatus_IllegalType));
+        assert_true(PDRead_copy_u32_array(reader, u32Copy, 1, &count, "missing", 0) == PDReadStatus_NotFound);
+
+        free(unaligned);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void writeCopyTestEvents(PDWriter* w, int* releaseCount) {
+    static const char* ids[] = { "address", "code", 0 };
+    static const char* codes[] = { "lda #$00", "sta $d020" };
+    static const uint16_t u16Values[] = { 0x1234, 0xffff, 0 };
+    static uint8_t refData[] = { 1, 2, 3, 4, 5 };
+
+    PDWrite_event_begin(w, PDEventType_SetRegisters);
+    PDWrite_s8(w, "s8", -2);
+    PDWrite_u16(w, "u16", 0x1234);
+    PDWrite_u32(w, "u32", 0xdeadbeef);
+    PDWrite_double(w, "double", 2.5);
+    PDWrite_string(w, "string", "test");
+    PDWrite_data_ref(w, "ref", refData, sizeof(refData), countRelease, releaseCount);
+    PDWrite_u16_array(w, "values", u16Values, 3);
+    PDWrite_array_begin(w, "registers");
+
+    for (int i = 0; i < 2; ++i) {
+        PDWrite_array_entry_begin(w);
+        PDWrite_u8(w, "register", (uint8_t)i);
+        PDWrite_entry_end(w);
+    }
+
+    PDWrite_array_end(w);
+    PDWrite_event_end(w);
+
+    PDWrite_event_begin(w, PDEventType_SetDisassembly);
+    PDWrite_array_begin(w, "disassembly");
+    PDWrite_header_array_begin(w, ids);
+
+    for (int i = 0; i < 2; ++i) {
+        PDWrite_u32(w, 0, 0x1000 + i);
+        PDWrite_string(w, 0, codes[i]);
+    }
+
+    PDWrite_header_array_end(w);
+    PDWrite_array_end(w);
+    PDWrite_event_end(w);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void checkCopyTestEvents(PDReader* r) {
+    PDReaderIterator arrayIter;
+    const uint16_t* u16Res;
+    const char* string;
+    uint8_t* data;
+    uint64_t size;
+    uint32_t count;
+    uint32_t value;
+    int8_t s8;
+    double d;
+
+    assert_int_equal(PDRead_get_event(r), PDEventType_SetRegisters);
+
+    assert_true(PDRead_find_s8(r, &s8, "s8", 0) == (PDReadType_S8 | PDReadStatus_Ok));
+    assert_int_equal(s8, -2);
+    assert_true(PDRead_find_u32(r, &value, "u16", 0) == (PDReadType_U16 | PDReadStatus_Converted));
+    assert_int_equal(value, 0x1234);
+    assert_true(PDRead_find_u32(r, &value, "u32", 0) == (PDReadType_U32 | PDReadStatus_Ok));
+    assert_int_equal(value, 0xdeadbeef);
+    assert_true(PDRead_find_double(r, &d, "double", 0) == (PDReadType_Double | PDReadStatus_Ok));
+    assert_true(d == 2.5);
+    assert_true(PDRead_find_string(r, &string, "string", 0) == (PDReadType_String | PDReadStatus_Ok));
+    assert_string_equal(string, "test");
+
+    // data references are copied as regular data
+
+    assert_true(PDRead_find_data(r, (void**)&data, &size, "ref", 0) == (PDReadType_Data | PDReadStatus_Ok));
+    assert_true(size == 5);
+    assert_int_equal(data[4], 5);
+
+    assert_true(PDRead_find_u16_array(r, &u16Res, &count, "values", 0) == (PDReadType_U16Array | PDReadStatus_Ok));
+    assert_int_equal(count, 3);
+    assert_int_equal(u16Res[1], 0xffff);
+
+    assert_true(PDRead_find_array(r, &arrayIter, "registers", 0) == (PDReadType_Array | PDReadStatus_Ok));
+
+    for (int i = 0; i < 2; ++i) {
+        assert_int_equal(PDRead_get_next_entry(r, &arrayIter), 1);
+        assert_true(PDRead_find_u32(r, &value, "register", arrayIter) == (PDReadType_U8 | PDReadStatus_Converted));
+        assert_int_equal(value, i);
+    }
+
+    assert_int_equal(PDRead_get_event(r), PDEventType_SetDisassembly);
+    assert_true(PDRead_find_array(r, &arrayIter, "disassembly", 0) == (PDReadType_Array | PDReadStatus_Ok));
+
+    for (int i = 0; i < 2; ++i) {
+        assert_int_equal(PDRead_get_next_entry(r, &arrayIter), 2);
+        assert_true(PDRead_find_u32(r, &value, "address", arrayIter) == (PDReadType_U32 | PDReadStatus_Ok));
+        assert_int_equal(value, 0x1000 + i);
+        assert_true(PDRead_find_string(r, &string, "code", arrayIter) == (PDReadType_String | PDReadStatus_Ok));
+        assert_string_equal(string, i == 0 ? "lda #$00" : "sta $d020");
+    }
+
+    assert_int_equal(PDRead_get_event(r), 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testCopyEvents(void**) {
+    PDWriter* copy = pd_binary_writer_create();
+    PDReader* copyReader = pd_binary_reader_create();
+    int releaseCount = 0;
+
+    // copy to a writer with interned keys to make sure the keys are mapped to the new key table
+
+    pd_binary_writer_set_intern_keys(copy, 1);
+
+    pd_binary_writer_reset(writer);
+    writeCopyTestEvents(writer, &releaseCount);
+    pd_binary_reader_init_from_writer(reader, writer);
+    pd_binary_reader_copy_events(reader, copy);
+    pd_binary_writer_finalize(copy);
+
+    // the position of the source reader isn't changed
+
+    checkCopyTestEvents(reader);
+
+    pd_binary_reader_init_stream(copyReader, pd_binary_writer_get_data(copy), pd_binary_writer_get_size(copy));
+    checkCopyTestEvents(copyReader);
+
+    pd_binary_writer_reset(writer);
+
+    pd_binary_reader_destroy(copyReader);
+    pd_binary_writer_destroy(copy);
+    free(copy);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testCapture(void**) {
+    const char* filename = "readwrite_tests_capture.pdc";
+    struct PDCaptureWriter* captureWriter;
+    struct PDCaptureReader* captureReader;
+    const PDBinarySegment* segments;
+    PDCaptureRecord record;
+    uint8_t* memory = (uint8_t*)malloc(64 * 1024);
+    int releaseCount = 0;
+    int segmentCount;
+
+    captureWriter = pd_capture_writer_create(filename);
+    assert_non_null(captureWriter);
+
+    // request with a data reference (only valid in this process), an action and a large reply that gets compressed
+
+    pd_binary_writer_reset(writer);
+    writeCopyTestEvents(writer, &releaseCount);
+    pd_binary_reader_init_from_writer(reader, writer);
+
+    assert_int_equal(pd_capture_writer_write_reader(captureWriter, PDCaptureRecord_Request, reader), 1);
+    assert_int_equal(pd_capture_writer_write_action(captureWriter, PDAction_Step), 1);
+
+    memset(memory, 0xea, 64 * 1024);
+
+    pd_binary_writer_reset(writer);
+    PDWrite_event_begin(writer, PDEventType_SetMemory);
+    PDWrite_u64(writer, "address", 0x1000);
+    PDWrite_data(writer, "data", memory, 64 * 1024);
+    PDWrite_event_end(writer);
+    pd_binary_writer_finalize(writer);
+
+    segments = pd_binary_writer_get_segments(writer, &segmentCount);
+    assert_int_equal(pd_capture_writer_write_segments(captureWriter, PDCaptureRecord_Reply, segments, segmentCount), 1);
+
+    pd_capture_writer_destroy(captureWriter);
+
+    // compression should make the file a lot smaller than the memory
+
+    FILE* file = fopen(filename, "rb");
+    assert_non_null(file);
+    fseek(file, 0, SEEK_END);
+    assert_true(ftell(file) < 4096);
+    fclose(file);
+
+    captureReader = pd_capture_reader_create(filename);
+    assert_non_null(captureReader);
+
+    for (int pass = 0; pass < 2; ++pass) {
+        uint8_t* data;
+        uint64_t size;
+        uint64_t lastTime;
+
+        assert_int_equal(pd_capture_reader_next(captureReader, &record), 1);
+        assert_int_equal(record.type, PDCaptureRecord_Request);
+        assert_true(record.time == 0);
+
+        pd_binary_reader_init_stream(reader, (uint8_t*)record.data, record.size);
+        checkCopyTestEvents(reader);
+
+        assert_int_equal(pd_capture_reader_next(captureReader, &record), 1);
+        assert_int_equal(record.type, PDCaptureRecord_Action);
+        assert_int_equal(record.size, 4);
+        assert_int_equal(record.data[3], PDAction_Step);
+
+        lastTime = record.time;
+
+        assert_int_equal(pd_capture_reader_next(captureReader, &record), 1);
+        assert_int_equal(record.type, PDCaptureRecord_Reply);
+        assert_true(record.time >= lastTime);
+
+        pd_binary_reader_init_stream(reader, (uint8_t*)record.data, record.size);
+        assert_int_equal(PDRead_get_event(reader), PDEventType_SetMemory);
+        assert_true(PDRead_find_data(reader, (void**)&data, &size, "data", 0) == (PDReadType_Data | PDReadStatus_Ok));
+        assert_true(size == 64 * 1024);
+        assert_memory_equal(data, memory, 64 * 1024);
+
+        assert_int_equal(pd_capture_reader_next(captureReader, &record), 0);
+
+        pd_capture_reader_rewind(captureReader);
+    }
+
+    pd_capture_reader_destroy(captureReader);
+    remove(filename);
+
+    pd_binary_writer_reset(writer);
+    free(memory);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Reads the events of a filtered reader and checks that they are the expected ones (by event type and the "index"
+// field that holds the position in the stream)
+
+static const uint16_t s_filterTestTypes[] = { PDEventType_SetLocals, PDEventType_SetCallstack, PDEventType_SetRegisters };
+
+static void checkFilteredEvents(PDReader* r, const uint32_t* expected, int count) {
+    uint32_t event;
+    uint32_t index;
+    int i = 0;
+
+    while ((event = PDRead_get_event(r))) {
+        assert_true(i < count);
+        assert_int_equal(PDRead_find_u32(r, &index, "index", 0), PDReadType_U32 | PDReadStatus_Ok);
+        assert_int_equal(index, expected[i]);
+        assert_int_equal(event, s_filterTestTypes[index % 3]);
+        i++;
+    }
+
+    assert_int_equal(i, count);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testEventFilter(void**) {
+    static uint8_t memory[8192];
+    const uint16_t localsAndRegisters[] = { PDEventType_SetRegisters, PDEventType_SetLocals, PDEventType_SetLocals };
+    const uint16_t callstackOnly[] = { PDEventType_SetCallstack, PDEventType_End };
+    const uint32_t localsAndRegistersExpected[] = { 0, 2, 3, 5, 6, 8 };
+    const uint32_t callstackExpected[] = { 1, 4, 7 };
+    const uint32_t allExpected[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+    PDReader* view0 = pd_binary_reader_create();
+    PDReader* view1 = pd_binary_reader_create();
+    uint32_t i;
+
+    // SetLocals, SetCallstack (with a large payload), SetRegisters repeated
+
+    pd_binary_writer_reset(writer);
+
+    for (i = 0; i < 9; ++i) {
+        PDWrite_event_begin(writer, s_filterTestTypes[i % 3]);
+        PDWrite_u32(writer, "index", i);
+
+        if (i % 3 == 1)
+            PDWrite_data(writer, "data", memory, sizeof(memory));
+
+        PDWrite_event_end(writer);
+    }
+
+    pd_binary_writer_finalize(writer);
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    // duplicated types in the filter are fine
+
+    PDRead_set_event_filter(view0, localsAndRegisters, 3);
+    PDRead_set_event_filter(view1, callstackOnly, 2);
+
+    pd_binary_reader_init_view(view0, reader);
+    pd_binary_reader_init_view(view1, reader);
+
+    checkFilteredEvents(view0, localsAndRegistersExpected, 6);
+    checkFilteredEvents(view1, callstackExpected, 3);
+
+    // views don't change the position of each other or the source
+
+    checkFilteredEvents(reader, allExpected, 9);
+
+    pd_binary_reader_reset(view0);
+    checkFilteredEvents(view0, localsAndRegistersExpected, 6);
+
+    // change and remove the filter after the view has been set up
+
+    PDRead_set_event_filter(view0, callstackOnly, 1);
+    checkFilteredEvents(view0, callstackExpected, 3);
+
+    PDRead_set_event_filter(view1, 0, 0);
+    checkFilteredEvents(view1, allExpected, 9);
+
+    // filter on a regular reader and keeping the filter for the next stream
+
+    PDRead_set_event_filter(reader, localsAndRegisters, 2);
+    pd_binary_reader_reset(reader);
+    checkFilteredEvents(reader, localsAndRegistersExpected, 6);
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+    checkFilteredEvents(reader, localsAndRegistersExpected, 6);
+
+    PDRead_set_event_filter(reader, 0, 0);
+
+    pd_binary_reader_destroy(view0);
+    pd_binary_reader_destroy(view1);
+
+    pd_binary_writer_reset(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void writeGetMemory(PDWriter* w, uint32_t id, uint64_t address, uint64_t size) {
+    PDWrite_event_begin(w, PDEventType_GetMemory);
+    PDWrite_u32(w, PD_REQUEST_ID, id);
+    PDWrite_u64(w, "address_start", address);
+    PDWrite_u64(w, "size", size);
+    PDWrite_event_end(w);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void checkMemoryReply(PDReader* r, uint32_t expectedId, uint64_t expectedAddress, uint64_t expectedSize) {
+    uint8_t* data;
+    uint64_t address;
+    uint64_t size;
+    uint32_t id;
+
+    assert_int_equal(PDRead_get_event(r), PDEventType_SetMemory);
+    assert_int_equal(PDRead_find_u32(r, &id, PD_REQUEST_ID, 0), PDReadType_U32 | PDReadStatus_Ok);
+    assert_int_equal(PDRead_find_u64(r, &address, "address", 0), PDReadType_U64 | PDReadStatus_Ok);
+    assert_int_equal(PDRead_find_data(r, (void**)&data, &size, "data", 0), PDReadType_Data | PDReadStatus_Ok);
+    assert_int_equal(id, expectedId);
+    assert_true(address == expectedAddress);
+    assert_true(size == expectedSize);
+
+    for (uint64_t i = 0; i < size; ++i)
+        assert_int_equal(data[i], (uint8_t)((address + i) >> 4));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testRequestCoalescer(void**) {
+    static uint8_t memory[0x2000];
+    struct PDRequestCoalescer* coalescer = pd_request_coalescer_create();
+    PDWriter* out = pd_binary_writer_create();
+    PDReader* outReader = pd_binary_reader_create();
+    PDRequestCoalescerStats stats;
+    uint64_t address = 0;
+    uint64_t size = 0;
+    uint32_t mergedId = 0;
+    uint32_t id = 0;
+
+    // three views asking for the same locals, two for the exception location (with ids) and memory requests where
+    // 0x1000 and 0x2000 are adjacent (and 0x1000 is asked for twice) while 0x8000 is on its own
+
+    pd_binary_writer_reset(writer);
+
+    for (int i = 0; i < 3; ++i) {
+        PDWrite_event_begin(writer, PDEventType_GetLocals);
+        PDWrite_u8(writer, "dummy_remove", 0);
+        PDWrite_event_end(writer);
+    }
+
+    for (uint32_t i = 1; i <= 2; ++i) {
+        PDWrite_event_begin(writer, PDEventType_GetExceptionLocation);
+        PDWrite_u32(writer, PD_REQUEST_ID, i);
+        PDWrite_event_end(writer);
+    }
+
+    PDWrite_event_begin(writer, PDEventType_SetBreakpoint);
+    PDWrite_string(writer, "filename", "foo.c");
+    PDWrite_u32(writer, "line", 10);
+    PDWrite_event_end(writer);
+
+    writeGetMemory(writer, 10, 0x1000, 0x1000);
+    writeGetMemory(writer, 11, 0x2000, 0x1000);
+    writeGetMemory(writer, 12, 0x8000, 0x100);
+    writeGetMemory(writer, 13, 0x1000, 0x1000);
+
+    pd_binary_writer_finalize(writer);
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    pd_request_coalescer_coalesce(coalescer, reader, out);
+    pd_binary_writer_finalize(out);
+    pd_binary_reader_init_stream(outReader, pd_binary_writer_get_data(out), pd_binary_writer_get_size(out));
+
+    assert_int_equal(PDRead_get_event(outReader), PDEventType_GetLocals);
+    assert_int_equal(PDRead_get_event(outReader), PDEventType_GetExceptionLocation);
+    assert_int_equal(PDRead_find_u32(outReader, &id, PD_REQUEST_ID, 0), PDReadType_U32 | PDReadStatus_Ok);
+    assert_int_equal(id, 1);
+    assert_int_equal(PDRead_get_event(outReader), PDEventType_SetBreakpoint);
+
+    assert_int_equal(PDRead_get_event(outReader), PDEventType_GetMemory);
+    PDRead_find_u32(outReader, &mergedId, PD_REQUEST_ID, 0);
+    PDRead_find_u64(outReader, &address, "address_start", 0);
+    PDRead_find_u64(outReader, &size, "size", 0);
+    assert_true(address == 0x1000);
+    assert_true(size == 0x2000);
+
+    assert_int_equal(PDRead_get_event(outReader), PDEventType_GetMemory);
+    PDRead_find_u32(outReader, &id, PD_REQUEST_ID, 0);
+    assert_int_equal(id, 12);
+
+    assert_int_equal(PDRead_get_event(outReader), 0);
+
+    pd_request_coalescer_get_stats(coalescer, &stats);
+    assert_int_equal(stats.requests, 9);
+    assert_int_equal(stats.sent, 4);
+
+    // replies from the backend
+
+    for (uint32_t i = 0; i < sizeof(memory); ++i)
+        memory[i] = (uint8_t)((0x1000 + i) >> 4);
+
+    pd_binary_writer_reset(writer);
+
+    PDWrite_event_begin(writer, PDEventType_SetExceptionLocation);
+    PDWrite_u32(writer, PD_REQUEST_ID, 1);
+    PDWrite_u64(writer, "address", 0x1234);
+    PDWrite_event_end(writer);
+
+    PDWrite_event_begin(writer, PDEventType_SetMemory);
+    PDWrite_u32(writer, PD_REQUEST_ID, mergedId);
+    PDWrite_u64(writer, "address", 0x1000);
+    PDWrite_data(writer, "data", memory, sizeof(memory));
+    PDWrite_event_end(writer);
+
+    PDWrite_event_begin(writer, PDEventType_SetLocals);
+    PDWrite_event_end(writer);
+
+    pd_binary_writer_finalize(writer);
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    pd_binary_writer_reset(out);
+    assert_int_equal(pd_request_coalescer_fan_out(coalescer, reader, out), 1);
+    pd_binary_writer_finalize(out);
+    pd_binary_reader_init_stream(outReader, pd_binary_writer_get_data(out), pd_binary_writer_get_size(out));
+
+    for (uint32_t i = 1; i <= 2; ++i) {
+        assert_int_equal(PDRead_get_event(outReader), PDEventType_SetExceptionLocation);
+        assert_int_equal(PDRead_find_u32(outReader, &id, PD_REQUEST_ID, 0), PDReadType_U32 | PDReadStatus_Ok);
+        assert_int_equal(PDRead_find_u64(outReader, &address, "address", 0), PDReadType_U64 | PDReadStatus_Ok);
+        assert_int_equal(id, i);
+        assert_true(address == 0x1234);
+    }
+
+    checkMemoryReply(outReader, 10, 0x1000, 0x1000);
+    checkMemoryReply(outReader, 13, 0x1000, 0x1000);
+    checkMemoryReply(outReader, 11, 0x2000, 0x1000);
+
+    assert_int_equal(PDRead_get_event(outReader), PDEventType_SetLocals);
+    assert_int_equal(PDRead_get_event(outReader), 0);
+
+    pd_request_coalescer_get_stats(coalescer, &stats);
+    assert_int_equal(stats.fannedOut, 4);
+
+    // each reply is only fanned out once so the replies can now be used as they are
+
+    pd_binary_writer_reset(out);
+    assert_int_equal(pd_request_coalescer_fan_out(coalescer, reader, out), 0);
+    assert_int_equal(pd_binary_writer_get_size(out), 0);
+
+    pd_request_coalescer_destroy(coalescer);
+    pd_binary_reader_destroy(outReader);
+    pd_binary_writer_destroy(out);
+    free(out);
+
+    pd_binary_writer_reset(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void writeStateChanged(PDWriter* w, uint32_t epoch, uint32_t changed) {
+    PDWrite_event_begin(w, PDEventType_StateChanged);
+    PDWrite_u32(w, PD_STATE_EPOCH, epoch);
+    PDWrite_u32(w, PD_STATE_CHANGED, changed);
+    PDWrite_event_end(w);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testStateTracker(void**) {
+    PDStateTracker tracker;
+
+    memset(&tracker, 0, sizeof(tracker));
+
+    // backends that never sends StateChanged are polled as before
+
+    assert_true(PDStateTracker_should_request(&tracker, PDStateChange_Locals));
+    assert_true(PDStateTracker_should_request(&tracker, PDStateChange_Locals));
+
+    pd_binary_writer_reset(writer);
+    writeStateChanged(writer, 5, PDStateChange_Registers);
+    writeStateChanged(writer, 5, PDStateChange_Registers);
+    writeStateChanged(writer, 6, PDStateChange_Locals | PDStateChange_Memory);
+    pd_binary_writer_finalize(writer);
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    // the first event means everything has changed as the view has nothing yet
+
+    assert_int_equal(PDRead_get_event(reader), PDEventType_StateChanged);
+    assert_int_equal(PDStateTracker_update(&tracker, reader), PDStateChange_All);
+
+    assert_true(PDStateTracker_should_request(&tracker, PDStateChange_Locals));
+    assert_false(PDStateTracker_should_request(&tracker, PDStateChange_Locals));
+
+    // same epoch again (the session gives the last event to the views each frame)
+
+    assert_int_equal(PDRead_get_event(reader), PDEventType_StateChanged);
+    assert_int_equal(PDStateTracker_update(&tracker, reader), 0);
+    assert_false(PDStateTracker_should_request(&tracker, PDStateChange_Locals));
+
+    assert_int_equal(PDRead_get_event(reader), PDEventType_StateChanged);
+    assert_int_equal(PDStateTracker_update(&tracker, reader), PDStateChange_Locals | PDStateChange_Memory);
+
+    assert_true(PDStateTracker_should_request(&tracker, PDStateChange_Locals));
+    assert_false(PDStateTracker_should_request(&tracker, PDStateChange_Locals));
+
+    // bits stays set until they are requested
+
+    assert_true(PDStateTracker_should_request(&tracker, PDStateChange_Threads));
+    assert_false(PDStateTracker_should_request(&tracker, PDStateChange_Threads));
+
+    pd_binary_writer_reset(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t readMemoryRequest(PDReader* r, uint64_t* address, uint64_t* size) {
+    uint32_t id = 0;
+
+    assert_int_equal(PDRead_get_event(r), PDEventType_GetMemory);
+    assert_int_equal(PDRead_find_u32(r, &id, PD_REQUEST_ID, 0), PDReadType_U32 | PDReadStatus_Ok);
+    PDRead_find_u64(r, address, "address_start", 0);
+    PDRead_find_u64(r, size, "size", 0);
+
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void replyMemory(PDMemoryCache* cache, uint32_t id, uint64_t address, uint64_t size, uint8_t value) {
+    static uint8_t memory[0x10000];
+
+    memset(memory, value, size);
+
+    pd_binary_writer_reset(writer);
+    PDWrite_event_begin(writer, PDEventType_SetMemory);
+    PDWrite_u32(writer, PD_REQUEST_ID, id);
+    PDWrite_u64(writer, "address", address);
+    PDWrite_data(writer, "data", memory, size);
+    PDWrite_event_end(writer);
+    pd_binary_writer_finalize(writer);
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+    pd_memory_cache_update(cache, reader);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void sendStateChanged(PDMemoryCache* cache, uint32_t epoch, uint32_t changed, uint64_t address, uint64_t size) {
+    pd_binary_writer_reset(writer);
+    PDWrite_event_begin(writer, PDEventType_StateChanged);
+    PDWrite_u32(writer, PD_STATE_EPOCH, epoch);
+    PDWrite_u32(writer, PD_STATE_CHANGED, changed);
+
+    if (size) {
+        PDWrite_array_begin(writer, PD_STATE_MEMORY);
+        PDWrite_array_entry_begin(writer);
+        PDWrite_u64(writer, "address_start", address);
+        PDWrite_u64(writer, "size", size);
+        PDWrite_entry_end(writer);
+        PDWrite_array_end(writer);
+    }
+
+    PDWrite_event_end(writer);
+    pd_binary_writer_finalize(writer);
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+    pd_memory_cache_update(cache, reader);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void testMemoryCache(void**) {
+    static uint8_t buffer[0x2000];
+    struct PDMemoryCache* cache = pd_memory_cache_create();
+    PDWriter* requests = pd_binary_writer_create();
+    PDReader* requestReader = pd_binary_reader_create();
+    PDMemoryCacheStats stats;
+    uint64_t address = 0;
+    uint64_t size = 0;
+    uint32_t id, oldId;
+
+    // three views reading (parts of) the same memory only gives one request
+
+    assert_false(pd_memory_cache_read(cache, 0, 0x1000, buffer, 0x2000));
+    assert_false(pd_memory_cache_read(cache, 0, 0x1000, buffer, 0x2000));
+    assert_false(pd_memory_cache_read(cache, 0, 0x1800, buffer, 0x100));
+
+    pd_memory_cache_write_requests(cache, requests);
+    pd_binary_writer_finalize(requests);
+    pd_binary_reader_init_stream(requestReader, pd_binary_writer_get_data(requests), pd_binary_writer_get_size(requests));
+
+    id = readMemoryRequest(requestReader, &address, &size);
+    assert_true(address == 0x1000);
+    assert_true(size == 0x2000);
+    assert_int_equal(PDRead_get_event(requestReader), 0);
+
+    // waiting for the memory doesn't request it again
+
+    pd_binary_writer_reset(requests);
+    assert_false(pd_memory_cache_read(cache, 0, 0x1000, buffer, 0x2000));
+    pd_memory_cache_write_requests(cache, requests);
+    assert_int_equal(pd_binary_writer_get_size(requests), 0);
+
+    uint32_t changeCount = pd_memory_cache_get_change_count(cache);
+
+    replyMemory(cache, id, 0x1000, 0x2000, 0x42);
+
+    assert_true(pd_memory_cache_get_change_count(cache) != changeCount);
+    memset(buffer, 0, sizeof(buffer));
+    assert_true(pd_memory_cache_read(cache, 0, 0x1000, buffer, 0x2000));
+    assert_int_equal(buffer[0], 0x42);
+    assert_int_equal(buffer[0x1fff], 0x42);
+
+    // misses close to each other are fetched in one go
+
+    pd_binary_writer_reset(requests);
+    assert_false(pd_memory_cache_read(cache, 0, 0x3000, buffer, 0x100));
+    assert_false(pd_memory_cache_read(cache, 0, 0x8000, buffer, 0x10));
+    assert_false(pd_memory_cache_read(cache, 1, 0x8000, buffer, 0x10));
+    pd_memory_cache_write_requests(cache, requests);
+    pd_binary_writer_finalize(requests);
+    pd_binary_reader_init_stream(requestReader, pd_binary_writer_get_data(requests), pd_binary_writer_get_size(requests));
+
+    readMemoryRequest(requestReader, &address, &size);
+    assert_true(address == 0x3000);
+    assert_true(size == 0x6000);
+    readMemoryRequest(requestReader, &address, &size);
+    assert_true(address == 0x8000);
+    assert_int_equal(PDRead_find_u32(requestReader, &id, PD_ADDRESS_SPACE, 0), PDReadType_U32 | PDReadStatus_Ok);
+    assert_int_equal(id, 1);
+    assert_int_equal(PDRead_get_event(requestReader), 0);
+
+    // the target has been running: the old memory is still there but out of date
+
+    sendStateChanged(cache, 1, PDStateChange_All, 0, 0);
+
+    memset(buffer, 0, sizeof(buffer));
+    assert_false(pd_memory_cache_read(cache, 0, 0x1000, buffer, 0x2000));
+    assert_int_equal(buffer[0], 0x42);
+
+    pd_binary_writer_reset(requests);
+    pd_memory_cache_write_requests(cache, requests);
+    pd_binary_writer_finalize(requests);
+    pd_binary_reader_init_stream(requestReader, pd_binary_writer_get_data(requests), pd_binary_writer_get_size(requests));
+    id = readMemoryRequest(requestReader, &address, &size);
+
+    // memory that was asked for before the target ran is still out of date
+
+    oldId = id - 1;
+    replyMemory(cache, oldId, 0x1000, 0x2000, 0x43);
+    assert_false(pd_memory_cache_read(cache, 0, 0x1000, buffer, 0x2000));
+    assert_int_equal(buffer[0], 0x43);
+
+    replyMemory(cache, id, 0x1000, 0x2000, 0x44);
+    assert_true(pd_memory_cache_read(cache, 0, 0x1000, buffer, 0x2000));
+    assert_int_equal(buffer[0], 0x44);
+
+    // same epoch again doesn't change anything and a range only makes the pages it touches out of date
+
+    sendStateChanged(cache, 1, PDStateChange_All, 0, 0);
+    assert_true(pd_memory_cache_read(cache, 0, 0x1000, buffer, 0x2000));
+
+    sendStateChanged(cache, 2, PDStateChange_Memory, 0x2010, 4);
+    assert_true(pd_memory_cache_read(cache, 0, 0x1000, buffer, 0x1000));
+    assert_false(pd_memory_cache_read(cache, 0, 0x2000, buffer, 0x1000));
+
+    pd_memory_cache_get_stats(cache, &stats);
+    assert_int_equal(stats.requests, 4);
+
+    pd_memory_cache_destroy(cache);
+    pd_binary_reader_destroy(requestReader);
+    pd_binary_writer_destroy(requests);
+    free(requests);
+
+    pd_binary_writer_reset(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Cache requests for memory in another address space going through the coalescer (as the session does) has to keep
+// the address space both in the request and in the replies that are fanned out or the cache never gets filled
+
+void testCoalescerAddressSpace(void**) {
+    static uint8_t buffer[0x1000];
+    static uint8_t memory[0x1000];
+    struct PDMemoryCache* cache = pd_memory_cache_create();
+    struct PDRequestCoalescer* coalescer = pd_request_coalescer_create();
+    PDWriter* requests = pd_binary_writer_create();
+    PDWriter* out = pd_binary_writer_create();
+    PDReader* outReader = pd_binary_reader_create();
+    uint64_t address = 0;
+    uint64_t size = 0;
+    uint32_t addressSpace = 0;
+    int viewReplies = 0;
+    uint32_t id;
+
+    // 0x1000 in space 0 and 0x2000 in space 1 are next to each other but must not be merged. A view asking for a
+    // part of the space 1 range makes that one a merged request
+
+    assert_false(pd_memory_cache_read(cache, 0, 0x1000, buffer, 0x1000));
+    assert_false(pd_memory_cache_read(cache, 1, 0x2000, buffer, 0x1000));
+
+    pd_memory_cache_write_requests(cache, requests);
+
+    PDWrite_event_begin(requests, PDEventType_GetMemory);
+    PDWrite_u32(requests, PD_REQUEST_ID, 77);
+    PDWrite_u32(requests, PD_ADDRESS_SPACE, 1);
+    PDWrite_u64(requests, "address_start", 0x2000);
+    PDWrite_u64(requests, "size", 0x100);
+    PDWrite_event_end(requests);
+
+    pd_binary_writer_finalize(requests);
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(requests), pd_binary_writer_get_size(requests));
+
+    pd_request_coalescer_coalesce(coalescer, reader, out);
+    pd_binary_writer_finalize(out);
+    pd_binary_reader_init_stream(outReader, pd_binary_writer_get_data(out), pd_binary_writer_get_size(out));
+
+    // the backend replies without the address space (it's up to the coalescer to add it for the merged request)
+
+    pd_binary_writer_reset(writer);
+
+    for (int i = 0; i < 2; ++i) {
+        addressSpace = 0;
+        id = readMemoryRequest(outReader, &address, &size);
+        PDRead_find_u32(outReader, &addressSpace, PD_ADDRESS_SPACE, 0);
+
+        assert_int_equal(addressSpace, (uint32_t)i);
+        assert_true(address == (i == 0 ? 0x1000 : 0x2000));
+        assert_true(size == 0x1000);
+
+        memset(memory, addressSpace ? 0x22 : 0x11, sizeof(memory));
+
+        PDWrite_event_begin(writer, PDEventType_SetMemory);
+        PDWrite_u32(writer, PD_REQUEST_ID, id);
+        PDWrite_u64(writer, "address", address);
+        PDWrite_data(writer, "data", memory, (uint32_t)size);
+        PDWrite_event_end(writer);
+    }
+
+    assert_int_equal(PDRead_get_event(outReader), 0);
+
+    pd_binary_writer_finalize(writer);
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+
+    pd_binary_writer_reset(out);
+    assert_int_equal(pd_request_coalescer_fan_out(coalescer, reader, out), 1);
+    pd_binary_writer_finalize(out);
+    pd_binary_reader_init_stream(outReader, pd_binary_writer_get_data(out), pd_binary_writer_get_size(out));
+
+    pd_memory_cache_update(cache, outReader);
+
+    memset(buffer, 0, sizeof(buffer));
+    assert_true(pd_memory_cache_read(cache, 0, 0x1000, buffer, 0x1000));
+    assert_int_equal(buffer[0], 0x11);
+
+    memset(buffer, 0, sizeof(buffer));
+    assert_true(pd_memory_cache_read(cache, 1, 0x2000, buffer, 0x1000));
+    assert_int_equal(buffer[0], 0x22);
+    assert_int_equal(buffer[0xfff], 0x22);
+
+    // the view gets its part in the right space as well
+
+    pd_binary_reader_reset(outReader);
+
+    while (PDRead_get_event(outReader)) {
+        if (PDRead_find_u32(outReader, &id, PD_REQUEST_ID, 0) == PDReadStatus_NotFound || id != 77)
+            continue;
+
+        addressSpace = 0;
+        PDRead_find_u32(outReader, &addressSpace, PD_ADDRESS_SPACE, 0);
+        assert_int_equal(addressSpace, 1);
+        viewReplies++;
+    }
+
+    assert_int_equal(viewReplies, 1);
+
+    pd_request_coalescer_destroy(coalescer);
+    pd_memory_cache_destroy(cache);
+    pd_binary_reader_destroy(outReader);
+    pd_binary_writer_destroy(out);
+    pd_binary_writer_destroy(requests);
+    free(out);
+    free(requests);
+
+    pd_binary_writer_reset(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int s_profileBegins;
+static int s_profileEnds;
+
+static void profileBegin(const char* name, uint32_t* hashCache) {
+    assert_true(name != 0);
+    assert_true(hashCache != 0);
+    s_profileBegins++;
+}
+
+static void profileEnd() {
+    s_profileEnds++;
+}
+
+void testProfilerHooks(void**) {
+    PDProfilerFuncs funcs = { profileBegin, profileEnd };
+
+    s_profileBegins = 0;
+    s_profileEnds = 0;
+
+    // no samples until the functions are set
+
+    pd_binary_writer_reset(writer);
+    PDWrite_event_begin(writer, 10);
+    PDWrite_event_end(writer);
+    pd_binary_writer_finalize(writer);
+
+    assert_int_equal(s_profileBegins, 0);
+
+    pd_profiler_set_funcs(&funcs);
+    assert_true(pd_profiler_get_funcs() == &funcs);
+
+    pd_binary_writer_reset(writer);
+    PDWrite_event_begin(writer, 10);
+    PDWrite_event_end(writer);
+    pd_binary_writer_finalize(writer);
+
+    pd_binary_reader_init_stream(reader, pd_binary_writer_get_data(writer), pd_binary_writer_get_size(writer));
+    assert_int_equal(PDRead_get_event(reader), 10);
+
+    pd_profiler_set_funcs(0);
+
+    assert_true(s_profileBegins > 0);
+    assert_int_equal(s_profileBegins, s_profileEnds);
+
+    pd_binary_writer_reset(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main() {
+    pda_log_set_level(LOG_ERROR);
+
+    const UnitTest tests[] =
+    {
+        unit_test(testWriteReadEvent),
+        unit_test(testDataReadWrite),
+        unit_test(testWriteSingleString),
+        unit_test(testWriteReadAction),
+        unit_test(testArrayWriteBreakage),
+        unit_test(testAllValueTypes),
+        unit_test(testFind),
+        unit_test(testArray),
+        unit_test(testArrayRead),
+        unit_test(testHeaderArray),
+        unit_test(testHeaderArraySize),
+        unit_test(testReaderIndex),
+        unit_test(testZeroSizedBlocks),
+        unit_test(testArrayRandomAccess),
+        unit_test(testDataRef),
+        unit_test(testTypedArrays),
+        unit_test(testInternedKeys),
+        unit_test(testWriterGrow),
+        unit_test(testWriterOutOfMemory),
+        unit_test(testWriterAllocator),
+        unit_test(testChunkPool),
+        unit_test(testLz4),
+        unit_test(testLz4Reference),
+        unit_test(testCopyEvents),
+        unit_test(testCapture),
+        unit_test(testEventFilter),
+        unit_test(testRequestCoalescer),
+        unit_test(testStateTracker),
+        unit_test(testMemoryCache),
+        unit_test(testCoalescerAddressSpace),
+        unit_test(testProfilerHooks),
+    };
 
-    PDBinaryReader_init(reader);
-    PDBinaryWriter_init(writer);
+    reader = pd_binary_reader_create();
+    writer = pd_binary_writer_create();
 
     int test = run_tests(tests);
 
-    PDBinaryReader_destroy(reader);
-    PDBinaryWriter_destroy(writer);
+    pd_binary_reader_destroy(reader);
+    pd_binary_writer_destroy(writer);
+    free(writer);
 
     return test;
 }
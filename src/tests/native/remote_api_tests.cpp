@@ -3,31 +3,948 @@
 #include <setjmp.h>
 #include <cmocka.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#include "core/time.h"
-#include "core/process.h"
-#include "session/session.h"
+#include <pd_backend.h>
+#include <pd_readwrite.h>
+#include <pd_remote.h>
+#include <uv.h>
+#include "api/src/remote/pd_readwrite_private.h"
+#include "api/src/remote/remote_connection.h"
+#include "api/src/remote/remote_connection_uv.h"
+#include "api/src/remote/remote_connection_shm.h"
+#include "src/native/headless/alloc_counter.h"
 
-struct Session* Session_createRemote(const char* target, int port);
+#if defined(__linux__)
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void test_remote_session(void**) {
-    Session* session = Session_createRemote("127.0.0.1", 1340);
+enum {
+    DefaultPort = 1340,     // port used by PDRemote_create (and fake6502)
+    NoReply = -1,
+};
 
-    assert_true(Session_isConnected(session));
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Backend used by the in-process tests. Each request event is answered with a SetStatus event that has the same
+// request id and updates without any request doesn't write anything
+
+struct TestBackend {
+    int updateCount;
+    int requestCount;
+};
+
+static TestBackend* s_backend;
+
+static void* testBackendCreate(ServiceFunc*) {
+    TestBackend* backend = (TestBackend*)malloc(sizeof(TestBackend));
+    memset(backend, 0, sizeof(TestBackend));
+    s_backend = backend;
+    return backend;
+}
+
+static void testBackendDestroy(void* userData) {
+    if (s_backend == userData)
+        s_backend = 0;
+
+    free(userData);
+}
+
+static PDDebugState testBackendUpdate(void* userData, PDAction, PDReader* reader, PDWriter* writer) {
+    TestBackend* backend = (TestBackend*)userData;
+    uint32_t requestId;
+
+    backend->updateCount++;
+
+    while (PDRead_get_event(reader)) {
+        requestId = 0;
+        PDRead_find_u32(reader, &requestId, PD_REQUEST_ID, 0);
+
+        backend->requestCount++;
+
+        PDWrite_event_begin(writer, PDEventType_SetStatus);
+        PDWrite_u32(writer, PD_REQUEST_ID, requestId);
+        PDWrite_string(writer, "status", "Stopped");
+        PDWrite_event_end(writer);
+    }
+
+    return PDDebugState_StopBreakpoint;
+}
+
+static PDBackendPlugin s_testBackend = {
+    "Test Backend",
+    testBackendCreate,
+    testBackendDestroy,
+    0,
+    testBackendUpdate,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The debugger side of the in-process tests. Everything runs on one thread so the target is updated while waiting
+// for replies
+
+struct Debugger {
+    RemoteConnectionUV* conn;
+    PDWriter* writer;
+    PDReader* reader;
+};
+
+static int debuggerConnect(Debugger* debugger, int port) {
+    debugger->conn = RemoteConnectionUV_create(RemoteConnectionType_Connect, 0);
+    debugger->writer = pd_binary_writer_create();
+    debugger->reader = pd_binary_reader_create();
+
+    return RemoteConnectionUV_connect(debugger->conn, "127.0.0.1", port);
+}
+
+static void debuggerDestroy(Debugger* debugger) {
+    RemoteConnectionUV_destroy(debugger->conn);
+    pd_binary_reader_destroy(debugger->reader);
+    pd_binary_writer_destroy(debugger->writer);
+    free(debugger->writer);
+}
+
+static void sendRequest(Debugger* debugger, uint32_t requestId) {
+    const PDBinarySegment* segments;
+    int count;
+
+    pd_binary_writer_reset(debugger->writer);
+
+    PDWrite_event_begin(debugger->writer, PDEventType_GetStatus);
+    PDWrite_u32(debugger->writer, PD_REQUEST_ID, requestId);
+    PDWrite_event_end(debugger->writer);
+
+    pd_binary_writer_finalize(debugger->writer);
+
+    assert_non_null(segments = pd_binary_writer_get_segments(debugger->writer, &count));
+    assert_true(RemoteConnectionUV_sendSegments(debugger->conn, 0, segments, count) > 0);
+}
+
+// Returns the request id of the reply if one has arrived
+
+static int pollReply(Debugger* debugger) {
+    const uint8_t* frame;
+    uint32_t requestId;
+    int client;
+    int size;
+
+    RemoteConnectionUV_update(debugger->conn, 1);
+
+    if (!(frame = RemoteConnectionUV_nextFrame(debugger->conn, &client, &size)))
+        return NoReply;
+
+    pd_binary_reader_init_stream(debugger->reader, (uint8_t*)frame, (unsigned int)size);
+
+    if (PDRead_get_event(debugger->reader) != PDEventType_SetStatus)
+        return NoReply;
+
+    if (PDRead_find_u32(debugger->reader, &requestId, PD_REQUEST_ID, 0) == PDReadStatus_NotFound)
+        return NoReply;
+
+    return (int)requestId;
+}
+
+// Updates the target until a reply arrives and returns the request id of it. A NULL remote updates the instance
+// created with PDRemote_create
+
+static int receiveReply(Debugger* debugger, PDRemote* remote) {
+    int requestId;
+    int i;
+
+    for (i = 0; i < 500; ++i) {
+        if (remote)
+            PDRemote_updateInstance(remote, 1);
+        else
+            PDRemote_update(1);
+
+        if ((requestId = pollReply(debugger)) != NoReply)
+            return requestId;
+    }
+
+    return NoReply;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Once the buffers have grown to fit the traffic PDRemote_update should not allocate anything. The allocations of
+// the debugger side are counted as well as they use the same connection code
+
+static void test_update_no_allocations(void**) {
+    Debugger debugger;
+    AllocCounts start;
+    AllocCounts end;
+    uint32_t i;
+
+    assert_true(PDRemote_create(&s_testBackend, 0));
+    assert_true(debuggerConnect(&debugger, DefaultPort));
+
+    // the first round trips grows the buffers (and the first update without a request creates the broadcast writer)
+
+    for (i = 1; i <= 4; ++i) {
+        sendRequest(&debugger, i);
+        assert_int_equal(receiveReply(&debugger, 0), (int)i);
+    }
+
+    PDRemote_update(0);
+
+    alloc_counter_get(&start);
+
+    for (i = 0; i < 100; ++i)
+        PDRemote_update(0);
+
+    for (i = 100; i < 200; ++i) {
+        sendRequest(&debugger, i);
+        assert_int_equal(receiveReply(&debugger, 0), (int)i);
+    }
+
+    alloc_counter_get(&end);
+
+    if (alloc_counter_is_supported()) {
+        assert_int_equal(end.count - start.count, 0);
+        assert_int_equal(end.bytes - start.bytes, 0);
+    }
+
+    debuggerDestroy(&debugger);
+    PDRemote_destroy();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// In threaded mode the IO thread receives the request and flags it as pending but the backend is only updated when
+// the target calls PDRemote_update. The reply is sent by the IO thread without the target doing anything more
+
+static void test_threaded_request(void**) {
+    Debugger debugger;
+    int requestId = NoReply;
+    int i;
+
+    assert_true(PDRemote_createThreaded(&s_testBackend, 0));
+    assert_true(debuggerConnect(&debugger, DefaultPort));
+
+    for (i = 0; i < 100 && !PDRemote_isConnected(); ++i)
+        RemoteConnectionUV_update(debugger.conn, 10);
+
+    assert_true(PDRemote_isConnected());
+    assert_false(PDRemote_hasPendingRequest());
+
+    sendRequest(&debugger, 42);
+
+    for (i = 0; i < 100 && !PDRemote_hasPendingRequest(); ++i)
+        RemoteConnectionUV_update(debugger.conn, 10);
+
+    assert_true(PDRemote_hasPendingRequest());
+    assert_int_equal(s_backend->requestCount, 0);
+
+    PDRemote_update(0);
+
+    assert_int_equal(s_backend->requestCount, 1);
+    assert_false(PDRemote_hasPendingRequest());
+
+    for (i = 0; i < 500 && requestId == NoReply; ++i)
+        requestId = pollReply(&debugger);
+
+    assert_int_equal(requestId, 42);
+
+    // update waits for the next request to arrive (up to the sleep time)
+
+    sendRequest(&debugger, 43);
+    PDRemote_update(5000);
+
+    assert_int_equal(s_backend->requestCount, 2);
+
+    requestId = NoReply;
+
+    for (i = 0; i < 500 && requestId == NoReply; ++i)
+        requestId = pollReply(&debugger);
+
+    assert_int_equal(requestId, 43);
+
+    debuggerDestroy(&debugger);
+    PDRemote_destroy();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Instances created with port 0 listens on a port picked by the OS. Each debugger connected to it only gets the
+// replies to its own requests
+
+static void test_instance_clients(void**) {
+    Debugger first;
+    Debugger second;
+    PDRemote* remote;
+    int firstReply = NoReply;
+    int secondReply = NoReply;
+    int requestId;
+    int i;
+
+    assert_non_null(remote = PDRemote_createInstance(&s_testBackend, 0, 0));
+    assert_true(PDRemote_getPort(remote) > 0);
+
+    assert_true(debuggerConnect(&first, PDRemote_getPort(remote)));
+    assert_true(debuggerConnect(&second, PDRemote_getPort(remote)));
+
+    sendRequest(&first, 1);
+    sendRequest(&second, 2);
+
+    for (i = 0; i < 500 && (firstReply == NoReply || secondReply == NoReply); ++i) {
+        PDRemote_updateInstance(remote, 1);
+
+        if ((requestId = pollReply(&first)) != NoReply)
+            firstReply = requestId;
+
+        if ((requestId = pollReply(&second)) != NoReply)
+            secondReply = requestId;
+    }
+
+    assert_int_equal(firstReply, 1);
+    assert_int_equal(secondReply, 2);
+
+    // only the first debugger asks this time so the second one shouldn't get anything
+
+    sendRequest(&first, 3);
+    firstReply = NoReply;
+
+    for (i = 0; i < 500 && firstReply == NoReply; ++i) {
+        PDRemote_updateInstance(remote, 1);
+        firstReply = pollReply(&first);
+        assert_int_equal(pollReply(&second), NoReply);
+    }
+
+    assert_int_equal(firstReply, 3);
+
+    for (i = 0; i < 20; ++i) {
+        PDRemote_updateInstance(remote, 1);
+        assert_int_equal(pollReply(&second), NoReply);
+    }
+
+    debuggerDestroy(&first);
+    debuggerDestroy(&second);
+    PDRemote_destroyInstance(remote);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Debuggers can have several requests in flight. Each reply carries the id of the request it answers so the replies
+// are matched up by id (and the ones for other requests skipped) instead of relying on the order they arrive in
+
+static void test_request_ids(void**) {
+    Debugger first;
+    Debugger second;
+    PDRemote* remote;
+    int firstReplies[4];
+    int secondReplies[4];
+    int firstCount = 0;
+    int secondCount = 0;
+    int requestId;
+    int i;
+
+    assert_non_null(remote = PDRemote_createInstance(&s_testBackend, 0, 0));
+
+    assert_true(debuggerConnect(&first, PDRemote_getPort(remote)));
+    assert_true(debuggerConnect(&second, PDRemote_getPort(remote)));
+
+    sendRequest(&first, 10);
+    sendRequest(&first, 11);
+    sendRequest(&second, 20);
+    sendRequest(&first, 12);
+
+    for (i = 0; i < 500 && (firstCount < 3 || secondCount < 1); ++i) {
+        PDRemote_updateInstance(remote, 1);
+
+        while ((requestId = pollReply(&first)) != NoReply && firstCount < 4)
+            firstReplies[firstCount++] = requestId;
+
+        while ((requestId = pollReply(&second)) != NoReply && secondCount < 4)
+            secondReplies[secondCount++] = requestId;
+    }
+
+    assert_int_equal(s_backend->requestCount, 4);
+
+    assert_int_equal(firstCount, 3);
+    assert_int_equal(firstReplies[0], 10);
+    assert_int_equal(firstReplies[1], 11);
+    assert_int_equal(firstReplies[2], 12);
+
+    assert_int_equal(secondCount, 1);
+    assert_int_equal(secondReplies[0], 20);
+
+    // a debugger waiting for one request skips the replies to the others it has sent
+
+    sendRequest(&first, 13);
+    sendRequest(&first, 14);
+
+    requestId = NoReply;
+
+    for (i = 0; i < 500 && requestId != 14; ++i) {
+        PDRemote_updateInstance(remote, 1);
+        requestId = pollReply(&first);
+    }
+
+    assert_int_equal(requestId, 14);
+    assert_int_equal(pollReply(&second), NoReply);
+
+    debuggerDestroy(&first);
+    debuggerDestroy(&second);
+    PDRemote_destroyInstance(remote);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The libuv transport tests sends with the select based RemoteConnection so it's known exactly what is written to
+// the socket and when
+
+static void makeFrame(uint8_t* frame, int size, uint8_t seed) {
+    int i;
+
+    frame[0] = (uint8_t)(size >> 24);
+    frame[1] = (uint8_t)(size >> 16);
+    frame[2] = (uint8_t)(size >> 8);
+    frame[3] = (uint8_t)(size >> 0);
+
+    for (i = 4; i < size; ++i)
+        frame[i] = (uint8_t)(seed + i * 13);
+}
+
+static RemoteConnection* connectRaw(RemoteConnectionUV* listener) {
+    RemoteConnection* raw = RemoteConnection_create(RemoteConnectionType_Connect, 0);
+    int i;
+
+    assert_true(RemoteConnection_connect(raw, "127.0.0.1", RemoteConnectionUV_getPort(listener)));
+
+    for (i = 0; i < 100 && !RemoteConnectionUV_isConnected(listener); ++i)
+        RemoteConnectionUV_update(listener, 10);
+
+    assert_true(RemoteConnectionUV_isConnected(listener));
+
+    return raw;
+}
+
+static const uint8_t* waitFrame(RemoteConnectionUV* conn, int* size) {
+    const uint8_t* frame;
+    int client;
+    int i;
+
+    for (i = 0; i < 200; ++i) {
+        if ((frame = RemoteConnectionUV_nextFrame(conn, &client, size)))
+            return frame;
+
+        RemoteConnectionUV_update(conn, 10);
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Frames that arrive over several reads are only handed out when they are complete
+
+static void test_uv_split_frames(void**) {
+    RemoteConnectionUV* listener = RemoteConnectionUV_create(RemoteConnectionType_Listener, 0);
+    RemoteConnection* raw = connectRaw(listener);
+    const uint8_t* frame;
+    uint8_t small[1000];
+    uint8_t* large = (uint8_t*)malloc(300 * 1024);
+    int largeSize = 300 * 1024;
+    int client;
+    int offset;
+    int size;
+
+    makeFrame(small, sizeof(small), 1);
+    makeFrame(large, largeSize, 2);
+
+    // only part of the header, then part of the data and then the rest
+
+    assert_true(RemoteConnection_send(raw, small, 2, 0));
+    RemoteConnectionUV_update(listener, 20);
+    assert_null(RemoteConnectionUV_nextFrame(listener, &client, &size));
+
+    assert_true(RemoteConnection_send(raw, small + 2, 500, 0));
+    RemoteConnectionUV_update(listener, 20);
+    assert_null(RemoteConnectionUV_nextFrame(listener, &client, &size));
+
+    assert_true(RemoteConnection_send(raw, small + 502, sizeof(small) - 502, 0));
+
+    assert_non_null(frame = waitFrame(listener, &size));
+    assert_int_equal(size, sizeof(small));
+    assert_memory_equal(frame, small, sizeof(small));
+    assert_null(RemoteConnectionUV_nextFrame(listener, &client, &size));
+
+    // larger than the space the connection reads into at a time so the receive buffer needs to grow
+
+    for (offset = 0; offset < largeSize; offset += 10000) {
+        int left = largeSize - offset;
+        assert_true(RemoteConnection_send(raw, large + offset, left < 10000 ? left : 10000, 0));
+        RemoteConnectionUV_update(listener, 0);
+    }
+
+    assert_non_null(frame = waitFrame(listener, &size));
+    assert_int_equal(size, largeSize);
+    assert_memory_equal(frame, large, (size_t)largeSize);
+    assert_null(RemoteConnectionUV_nextFrame(listener, &client, &size));
 
-    Session_destroy(session);
+    free(large);
+    RemoteConnection_destroy(raw);
+    RemoteConnectionUV_destroy(listener);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Several frames received in one read are handed out one at the time in order
+
+static void test_uv_frames_in_one_read(void**) {
+    RemoteConnectionUV* listener = RemoteConnectionUV_create(RemoteConnectionType_Listener, 0);
+    RemoteConnection* raw = connectRaw(listener);
+    static const uint8_t action[4] = { 0x80, 0, 0, PDAction_Step };
+    const uint8_t* frame;
+    uint8_t data[100 + 4 + 20];
+    int client;
+    int size;
+
+    makeFrame(data, 100, 3);
+    memcpy(data + 100, action, sizeof(action));
+    makeFrame(data + 104, 20, 4);
+
+    assert_true(RemoteConnection_send(raw, data, sizeof(data), 0));
+
+    assert_non_null(frame = waitFrame(listener, &size));
+    assert_int_equal(size, 100);
+    assert_memory_equal(frame, data, 100);
+
+    assert_non_null(frame = RemoteConnectionUV_nextFrame(listener, &client, &size));
+    assert_int_equal(size, 4);
+    assert_memory_equal(frame, action, sizeof(action));
+
+    assert_non_null(frame = RemoteConnectionUV_nextFrame(listener, &client, &size));
+    assert_int_equal(size, 20);
+    assert_memory_equal(frame, data + 104, 20);
+
+    assert_null(RemoteConnectionUV_nextFrame(listener, &client, &size));
+
+    RemoteConnection_destroy(raw);
+    RemoteConnectionUV_destroy(listener);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A partially received frame is thrown away when the other side disconnects and the next client in the same slot
+// starts from scratch. The connecting side sees the listener going away as well
+
+static void test_uv_disconnect(void**) {
+    RemoteConnectionUV* listener = RemoteConnectionUV_create(RemoteConnectionType_Listener, 0);
+    RemoteConnection* raw = connectRaw(listener);
+    RemoteConnectionUV* debugger;
+    const uint8_t* frame;
+    uint8_t data[64];
+    int client;
+    int size;
+    int i;
+
+    makeFrame(data, sizeof(data), 5);
+
+    assert_true(RemoteConnection_send(raw, data, 30, 0));
+    RemoteConnectionUV_update(listener, 20);
+
+    RemoteConnection_destroy(raw);
+
+    for (i = 0; i < 100 && RemoteConnectionUV_isConnected(listener); ++i)
+        RemoteConnectionUV_update(listener, 10);
+
+    assert_false(RemoteConnectionUV_isConnected(listener));
+    assert_null(RemoteConnectionUV_nextFrame(listener, &client, &size));
+
+    raw = connectRaw(listener);
+
+    assert_true(RemoteConnection_send(raw, data, sizeof(data), 0));
+    assert_non_null(frame = waitFrame(listener, &size));
+    assert_int_equal(size, sizeof(data));
+    assert_memory_equal(frame, data, sizeof(data));
+
+    RemoteConnection_destroy(raw);
+
+    // debugger side
+
+    debugger = RemoteConnectionUV_create(RemoteConnectionType_Connect, 0);
+
+    assert_true(RemoteConnectionUV_connect(debugger, "127.0.0.1", RemoteConnectionUV_getPort(listener)));
+
+    RemoteConnectionUV_destroy(listener);
+
+    for (i = 0; i < 100 && RemoteConnectionUV_isConnected(debugger); ++i)
+        RemoteConnectionUV_update(debugger, 10);
+
+    assert_false(RemoteConnectionUV_isConnected(debugger));
+    assert_int_equal(RemoteConnectionUV_send(debugger, 0, data, sizeof(data)), 0);
+
+    RemoteConnectionUV_destroy(debugger);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A stream sent in chunks is handed out when the chunks add up to the size in its header. Chunks that go past that
+// size close the connection instead of growing the stream forever
+
+static void makeChunk(uint8_t* chunk, const uint8_t* data, int size) {
+    chunk[0] = (uint8_t)(0x40 | ((size + 4) >> 24));
+    chunk[1] = (uint8_t)((size + 4) >> 16);
+    chunk[2] = (uint8_t)((size + 4) >> 8);
+    chunk[3] = (uint8_t)((size + 4) >> 0);
+
+    memcpy(chunk + 4, data, (size_t)size);
+}
+
+static void test_uv_chunk_overflow(void**) {
+    RemoteConnectionUV* listener = RemoteConnectionUV_create(RemoteConnectionType_Listener, 0);
+    RemoteConnection* raw = connectRaw(listener);
+    const uint8_t* frame;
+    uint8_t stream[100];
+    uint8_t chunks[2][4 + 60];
+    int client;
+    int size;
+    int i;
+
+    makeFrame(stream, sizeof(stream), 6);
+    makeChunk(chunks[0], stream, 60);
+    makeChunk(chunks[1], stream + 60, 40);
+
+    assert_true(RemoteConnection_send(raw, chunks[0], 4 + 60, 0));
+    assert_true(RemoteConnection_send(raw, chunks[1], 4 + 40, 0));
+
+    assert_non_null(frame = waitFrame(listener, &size));
+    assert_int_equal(size, sizeof(stream));
+    assert_memory_equal(frame, stream, sizeof(stream));
+    assert_null(RemoteConnectionUV_nextFrame(listener, &client, &size));
+
+    // 60 + 60 bytes for a stream of 100
+
+    makeChunk(chunks[1], stream, 60);
+
+    assert_true(RemoteConnection_send(raw, chunks[0], 4 + 60, 0));
+    assert_true(RemoteConnection_send(raw, chunks[1], 4 + 60, 0));
+
+    for (i = 0; i < 100 && RemoteConnectionUV_isConnected(listener); ++i) {
+        RemoteConnectionUV_update(listener, 10);
+        assert_null(RemoteConnectionUV_nextFrame(listener, &client, &size));
+    }
+
+    assert_false(RemoteConnectionUV_isConnected(listener));
+
+    RemoteConnection_destroy(raw);
+    RemoteConnectionUV_destroy(listener);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A small frame sent after a large stream doesn't have to wait for all of it. The stream goes to the bulk lane and is
+// sent in chunks so the control frame is sent after the first chunk and arrives before the stream is complete
+
+enum {
+    BulkStreamSize = 4 * 1024 * 1024,
+    BulkChunkSize = 64 * 1024,          // ChunkSize in remote_connection_uv.c
+    ControlFrameSize = 100,
+};
+
+static void test_uv_control_after_bulk(void**) {
+    static uint8_t bulk[BulkStreamSize];
+    RemoteConnectionUV* listener = RemoteConnectionUV_create(RemoteConnectionType_Listener, 0);
+    RemoteConnectionUV* sender = RemoteConnectionUV_create(RemoteConnectionType_Connect, 0);
+    uint8_t control[ControlFrameSize];
+    const uint8_t* frame;
+    int gotControl = 0;
+    int gotBulk = 0;
+    int client;
+    int size;
+    int i;
+
+    assert_true(RemoteConnectionUV_connect(sender, "127.0.0.1", RemoteConnectionUV_getPort(listener)));
+
+    for (i = 0; i < 100 && !RemoteConnectionUV_isConnected(listener); ++i)
+        RemoteConnectionUV_update(listener, 10);
+
+    assert_true(RemoteConnectionUV_isConnected(listener));
+
+    makeFrame(bulk, BulkStreamSize, 6);
+    makeFrame(control, ControlFrameSize, 7);
+
+    // the first chunk is being written and the rest of the stream waits in the bulk lane. The control frame waits
+    // for the chunk being written but goes ahead of the rest
+
+    assert_int_equal(RemoteConnectionUV_send(sender, 0, bulk, BulkStreamSize), BulkStreamSize);
+    assert_int_equal(RemoteConnectionUV_getQueueDepth(sender, RemoteConnectionLane_Bulk), BulkStreamSize - BulkChunkSize);
+    assert_int_equal(RemoteConnectionUV_getQueueDepth(sender, RemoteConnectionLane_Control), 0);
+
+    assert_int_equal(RemoteConnectionUV_send(sender, 0, control, ControlFrameSize), ControlFrameSize);
+    assert_int_equal(RemoteConnectionUV_getQueueDepth(sender, RemoteConnectionLane_Bulk), BulkStreamSize - BulkChunkSize);
+    assert_int_equal(RemoteConnectionUV_getQueueDepth(sender, RemoteConnectionLane_Control), ControlFrameSize);
+
+    for (i = 0; i < 2000 && !gotBulk; ++i) {
+        RemoteConnectionUV_update(sender, 0);
+        RemoteConnectionUV_update(listener, 1);
+
+        while ((frame = RemoteConnectionUV_nextFrame(listener, &client, &size))) {
+            if (size == ControlFrameSize) {
+                assert_false(gotBulk);
+                assert_memory_equal(frame, control, ControlFrameSize);
+                gotControl = 1;
+            } else {
+                assert_true(gotControl);
+                assert_int_equal(size, BulkStreamSize);
+                assert_memory_equal(frame, bulk, BulkStreamSize);
+                gotBulk = 1;
+            }
+        }
+    }
+
+    assert_true(gotControl);
+    assert_true(gotBulk);
+
+    assert_int_equal(RemoteConnectionUV_getQueueDepth(sender, RemoteConnectionLane_Bulk), 0);
+    assert_int_equal(RemoteConnectionUV_getQueueDepth(sender, RemoteConnectionLane_Control), 0);
+
+    RemoteConnectionUV_destroy(sender);
+    RemoteConnectionUV_destroy(listener);
+}
+
+#if defined(__linux__)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Shared memory connection between two processes. The child connects and sends back every frame it gets until it
+// gets an action frame (or the listener goes away.) It can't use the cmocka asserts so the exit code tells how it went
+
+enum {
+    ShmRingSize = 4096,     // smallest ring possible so the tests wraps around it a lot
+    ShmLargeSize = 64 * 1024,
+};
+
+static void shmEchoChild(const char* name) {
+    RemoteConnectionShm* conn = RemoteConnectionShm_create(RemoteConnectionType_Connect, name, 0);
+    const uint8_t* frame;
+    int size;
+    int i;
+
+    for (i = 0; i < 100 && !RemoteConnectionShm_connect(conn, name); ++i)
+        usleep(10 * 1000);
+
+    if (!RemoteConnectionShm_isConnected(conn))
+        _exit(2);
+
+    while (RemoteConnectionShm_isConnected(conn)) {
+        RemoteConnectionShm_update(conn, 100);
+
+        while ((frame = RemoteConnectionShm_nextFrame(conn, &size))) {
+            if (frame[0] & 0x80) {
+                RemoteConnectionShm_destroy(conn);
+                _exit(0);
+            }
+
+            if (!RemoteConnectionShm_send(conn, frame, size))
+                _exit(3);
+        }
+    }
+
+    _exit(4);
+}
+
+static pid_t startShmChild(const char* name) {
+    pid_t pid = fork();
+
+    if (pid == 0)
+        shmEchoChild(name);
+
+    return pid;
+}
+
+static const uint8_t* waitShmFrame(RemoteConnectionShm* conn, int* size) {
+    const uint8_t* frame;
+    int i;
+
+    for (i = 0; i < 100; ++i) {
+        if ((frame = RemoteConnectionShm_nextFrame(conn, size)))
+            return frame;
+
+        RemoteConnectionShm_update(conn, 50);
+    }
+
+    return 0;
+}
+
+static void shmEcho(RemoteConnectionShm* listener, const uint8_t* data, int dataSize) {
+    const uint8_t* frame;
+    int size;
+
+    assert_int_equal(RemoteConnectionShm_send(listener, data, dataSize), dataSize);
+
+    assert_non_null(frame = waitShmFrame(listener, &size));
+    assert_int_equal(size, dataSize);
+    assert_memory_equal(frame, data, (size_t)dataSize);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void test_shm_two_processes(void**) {
+    static const uint8_t quit[4] = { 0x80, 0, 0, PDAction_Stop };
+    RemoteConnectionShm* listener;
+    uint8_t* data = (uint8_t*)malloc(ShmLargeSize);
+    char name[64];
+    int status;
+    pid_t pid;
+    int size;
+    int i;
+
+    sprintf(name, "/prodbg_remote_test_%d", (int)getpid());
+
+    assert_non_null(listener = RemoteConnectionShm_create(RemoteConnectionType_Listener, name, ShmRingSize));
+    assert_true((pid = startShmChild(name)) > 0);
+
+    for (i = 0; i < 100 && !RemoteConnectionShm_isConnected(listener); ++i)
+        RemoteConnectionShm_update(listener, 10);
+
+    assert_true(RemoteConnectionShm_isConnected(listener));
+
+    // 1500 bytes doesn't divide the ring size so the frames ends up at all kinds of places and some of them are split
+    // at the end of the ring (which is read directly as the ring is mapped twice)
+
+    for (i = 0; i < 40; ++i) {
+        makeFrame(data, 1500, (uint8_t)i);
+        shmEcho(listener, data, 1500);
+    }
+
+    // frames larger than the ring are sent (and received) in parts while the other side makes room
+
+    makeFrame(data, ShmLargeSize, 7);
+    shmEcho(listener, data, ShmLargeSize);
+
+    makeFrame(data, 100, 8);
+    shmEcho(listener, data, 100);
+
+    // the child disconnects when it gets an action
+
+    assert_int_equal(RemoteConnectionShm_send(listener, quit, sizeof(quit)), sizeof(quit));
+    assert_int_equal(waitpid(pid, &status, 0), pid);
+    assert_true(WIFEXITED(status));
+    assert_int_equal(WEXITSTATUS(status), 0);
+
+    RemoteConnectionShm_update(listener, 10);
+    assert_false(RemoteConnectionShm_isConnected(listener));
+    assert_null(RemoteConnectionShm_nextFrame(listener, &size));
+
+    // a new debugger can connect after that. When it dies without disconnecting the listener finds out by checking
+    // if the process is still there
+
+    assert_true((pid = startShmChild(name)) > 0);
+
+    for (i = 0; i < 100 && !RemoteConnectionShm_isConnected(listener); ++i)
+        RemoteConnectionShm_update(listener, 10);
+
+    assert_true(RemoteConnectionShm_isConnected(listener));
+
+    makeFrame(data, 200, 9);
+    shmEcho(listener, data, 200);
+
+    kill(pid, SIGKILL);
+    assert_int_equal(waitpid(pid, &status, 0), pid);
+
+    for (i = 0; i < 50 && RemoteConnectionShm_isConnected(listener); ++i)
+        RemoteConnectionShm_update(listener, 200);
+
+    assert_false(RemoteConnectionShm_isConnected(listener));
+
+    // and the child sees the listener going away
+
+    assert_true((pid = startShmChild(name)) > 0);
+
+    for (i = 0; i < 100 && !RemoteConnectionShm_isConnected(listener); ++i)
+        RemoteConnectionShm_update(listener, 10);
+
+    assert_true(RemoteConnectionShm_isConnected(listener));
+
+    RemoteConnectionShm_destroy(listener);
+
+    assert_int_equal(waitpid(pid, &status, 0), pid);
+    assert_true(WIFEXITED(status));
+    assert_int_equal(WEXITSTATUS(status), 4);
+
+    free(data);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The ring size is read from the segment so a debugger must not map (or mask with) one that doesn't fit it
+
+static void test_shm_bad_ring_size(void**) {
+    static const uint32_t badSizes[] = { 0, 3000, 1024, 1 << 20 };
+    RemoteConnectionShm* listener;
+    RemoteConnectionShm* conn;
+    uint32_t ringSize;
+    char name[64];
+    size_t i;
+    int fd;
+
+    sprintf(name, "/prodbg_remote_ring_test_%d", (int)getpid());
+
+    assert_non_null(listener = RemoteConnectionShm_create(RemoteConnectionType_Listener, name, ShmRingSize));
+    assert_non_null(conn = RemoteConnectionShm_create(RemoteConnectionType_Connect, name, 0));
+    assert_true((fd = shm_open(name, O_RDWR, 0600)) >= 0);
+
+    // ringSize is the third u32 of the header (after magic and version)
+
+    for (i = 0; i < sizeof(badSizes) / sizeof(badSizes[0]); ++i) {
+        assert_int_equal(pwrite(fd, &badSizes[i], sizeof(uint32_t), 8), sizeof(uint32_t));
+        assert_false(RemoteConnectionShm_connect(conn, name));
+    }
+
+    ringSize = ShmRingSize;
+    assert_int_equal(pwrite(fd, &ringSize, sizeof(uint32_t), 8), sizeof(uint32_t));
+    assert_true(RemoteConnectionShm_connect(conn, name));
+
+    close(fd);
+    RemoteConnectionShm_destroy(conn);
+    RemoteConnectionShm_destroy(listener);
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Connects to fake6502 running in its own process
+
+static void test_remote_session(void**) {
+    Debugger debugger;
+    int i;
+
+    // fake6502 may not be listening yet so give it a few seconds (update waits 100 ms as there is nothing to read)
+
+    if (!debuggerConnect(&debugger, DefaultPort)) {
+        for (i = 0; i < 30 && !RemoteConnectionUV_connect(debugger.conn, "127.0.0.1", DefaultPort); ++i)
+            RemoteConnectionUV_update(debugger.conn, 100);
+    }
+
+    assert_true(RemoteConnectionUV_isConnected(debugger.conn));
+
+    debuggerDestroy(&debugger);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 int main() {
+    uv_process_options_t options;
+    uv_process_t fakeProcess;
     int ret = 0;
 
+    // the in-process tests are run before fake6502 is started as it listens on the same port as PDRemote_create
+
+    const UnitTest localTests[] =
+    {
+        unit_test(test_update_no_allocations),
+        unit_test(test_threaded_request),
+        unit_test(test_instance_clients),
+        unit_test(test_request_ids),
+        unit_test(test_uv_split_frames),
+        unit_test(test_uv_frames_in_one_read),
+        unit_test(test_uv_disconnect),
+        unit_test(test_uv_chunk_overflow),
+        unit_test(test_uv_control_after_bulk),
+#if defined(__linux__)
+        unit_test(test_shm_two_processes),
+        unit_test(test_shm_bad_ring_size),
+#endif
+    };
+
     const UnitTest tests[] =
     {
         unit_test(test_remote_session),
@@ -36,20 +953,21 @@ int main() {
     static const char* fake_exe = OBJECT_DIR "/fake6502";
     static const char* argv[] = {fake_exe, "examples/fake_6502/test.bin", 0};
 
-    ProcessHandle fakeHandle = Process_spawn(fake_exe, argv);
-
-    if (!fakeHandle)
-        return -1;
+    if ((ret = run_tests(localTests)) != 0)
+        return ret;
 
-    // Wait 1 sec for the remote process to setup socket, get everything running, etc
-    // Not really nice but this is more of simulating how it would work in a real life
-    // test when connecting with the debugger to a remote process
+    memset(&options, 0, sizeof(options));
+    options.file = fake_exe;
+    options.args = (char**)argv;
 
-    Time_sleepMs(1000);
+    if (uv_spawn(uv_default_loop(), &fakeProcess, &options) != 0)
+        return -1;
 
     ret = run_tests(tests);
 
-    Process_kill(fakeHandle);
+    uv_process_kill(&fakeProcess, SIGTERM);
+    uv_close((uv_handle_t*)&fakeProcess, 0);
+    uv_run(uv_default_loop(), UV_RUN_DEFAULT);
 
     return ret;
 }
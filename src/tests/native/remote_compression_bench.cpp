@@ -0,0 +1,220 @@
+#include <pd_backend.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+#include "api/src/remote/pd_readwrite_private.h"
+#include "api/src/remote/remote_connection_uv.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Measures the round trip time of requests to a target with and without compression of the replies. The target and
+// the debugger runs in the same process and talks over loopback. To test a slower link shape lo with tc, such as
+//
+// sudo tc qdisc add dev lo root tbf rate 100mbit burst 256kb latency 50ms
+// remote_compression_bench
+// sudo tc qdisc del dev lo root
+//
+// (the burst needs to be larger than the MTU of lo which is 64k)
+
+enum {
+    Iterations = 50,
+};
+
+typedef void (*BuildFunc)(PDWriter* writer);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void buildMemory(PDWriter* writer, uint32_t size) {
+    uint8_t* memory = (uint8_t*)malloc(size);
+    uint32_t seed = 1;
+
+    // mostly code/data like patterns with some random areas and cleared memory
+
+    for (uint32_t i = 0; i < size; ++i) {
+        seed = seed * 1103515245 + 12345;
+
+        if ((i & 0x3fff) < 0x1000)
+            memory[i] = 0;
+        else if ((i & 0x3fff) < 0x3000)
+            memory[i] = (uint8_t)("\xa9\x00\x8d\x20\xd0\x4c\x10\x08\xea\x60"[i % 10] + ((i >> 6) & 3));
+        else
+            memory[i] = (uint8_t)(seed >> 16);
+    }
+
+    PDWrite_event_begin(writer, PDEventType_SetMemory);
+    PDWrite_u64(writer, "address", 0);
+    PDWrite_data(writer, "data", memory, size);
+    PDWrite_event_end(writer);
+
+    free(memory);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void buildMemory64k(PDWriter* writer) {
+    buildMemory(writer, 64 * 1024);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void buildMemory1M(PDWriter* writer) {
+    buildMemory(writer, 1024 * 1024);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void buildDisassembly(PDWriter* writer) {
+    static const char* ops[] = { "LDA", "STA", "JMP", "JSR", "BNE", "INX", "CMP", "RTS" };
+    char line[64];
+
+    PDWrite_event_begin(writer, PDEventType_SetDisassembly);
+    PDWrite_array_begin(writer, "disassembly");
+
+    for (int i = 0; i < 8192; ++i) {
+        sprintf(line, "%s $%04x,X", ops[(i * 7) % 8], (i * 3) & 0xffff);
+
+        PDWrite_array_entry_begin(writer);
+        PDWrite_u16(writer, "address", (uint16_t)(0x0800 + i * 2));
+        PDWrite_string(writer, "line", line);
+        PDWrite_entry_end(writer);
+    }
+
+    PDWrite_array_end(writer);
+    PDWrite_event_end(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void buildSourceFiles(PDWriter* writer) {
+    static const char* dirs[] = { "src/native/core", "src/addons/c64_vice_debugger", "src/plugins/hex_memory", "api/src/remote" };
+    char path[256];
+
+    PDWrite_event_begin(writer, PDEventType_SetSourceFiles);
+    PDWrite_array_begin(writer, "files");
+
+    for (int i = 0; i < 4096; ++i) {
+        sprintf(path, "/home/user/code/prodbg/%s/file_%d.c", dirs[i & 3], i);
+
+        PDWrite_array_entry_begin(writer);
+        PDWrite_string(writer, "file", path);
+        PDWrite_entry_end(writer);
+    }
+
+    PDWrite_array_end(writer);
+    PDWrite_event_end(writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int compareDouble(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Debugger sends a small request and the target replies with the stream, timed until the debugger has received the
+// full reply
+
+static bool runBench(const char* name, BuildFunc build, bool compression) {
+    static const uint8_t request[4] = { 0x80, 0, 0, PDAction_None };
+    double times[Iterations];
+    const PDBinarySegment* segments;
+    int segmentCount;
+    int client;
+    int size;
+
+    PDWriter* writer = pd_binary_writer_create();
+
+    build(writer);
+    pd_binary_writer_finalize(writer);
+    segments = pd_binary_writer_get_segments(writer, &segmentCount);
+
+    RemoteConnectionUV* target = RemoteConnectionUV_create(RemoteConnectionType_Listener, 0);
+    RemoteConnectionUV* debugger = RemoteConnectionUV_create(RemoteConnectionType_Connect, 0);
+
+    RemoteConnectionUV_setCompression(target, compression);
+    RemoteConnectionUV_setCompression(debugger, compression);
+
+    if (!RemoteConnectionUV_connect(debugger, "127.0.0.1", RemoteConnectionUV_getPort(target))) {
+        printf("Unable to connect\n");
+        return false;
+    }
+
+    // make sure both sides has seen the connection (and the compression support)
+
+    for (int i = 0; i < 20; ++i) {
+        RemoteConnectionUV_update(target, 1);
+        RemoteConnectionUV_update(debugger, 1);
+    }
+
+    for (int i = 0; i < Iterations; ++i) {
+        uint64_t start = uv_hrtime();
+        bool done = false;
+
+        RemoteConnectionUV_send(debugger, 0, request, sizeof(request));
+
+        while (!RemoteConnectionUV_update(target, 0) || !RemoteConnectionUV_nextFrame(target, &client, &size)) {
+            RemoteConnectionUV_update(debugger, 0);
+
+            if (!RemoteConnectionUV_isConnected(debugger)) {
+                printf("Lost connection\n");
+                return false;
+            }
+        }
+
+        RemoteConnectionUV_sendSegments(target, client, segments, segmentCount);
+
+        while (!done) {
+            RemoteConnectionUV_update(target, 0);
+
+            if (RemoteConnectionUV_update(debugger, 0) && RemoteConnectionUV_nextFrame(debugger, &client, &size))
+                done = true;
+
+            if (!RemoteConnectionUV_isConnected(debugger)) {
+                printf("Lost connection\n");
+                return false;
+            }
+        }
+
+        times[i] = (double)(uv_hrtime() - start) / 1000000.0;
+    }
+
+    qsort(times, Iterations, sizeof(double), compareDouble);
+
+    printf("%-14s %-4s %9d bytes  median %8.3f ms  min %8.3f ms  max %8.3f ms\n", name, compression ? "on" : "off",
+           size, times[Iterations / 2], times[0], times[Iterations - 1]);
+
+    RemoteConnectionUV_destroy(debugger);
+    RemoteConnectionUV_destroy(target);
+
+    pd_binary_writer_destroy(writer);
+    free(writer);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main() {
+    static const struct {
+        const char* name;
+        BuildFunc build;
+    } benches[] = {
+        { "memory 64k", buildMemory64k },
+        { "memory 1M", buildMemory1M },
+        { "disassembly", buildDisassembly },
+        { "source files", buildSourceFiles },
+    };
+
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); ++i) {
+        if (!runBench(benches[i].name, benches[i].build, false))
+            return -1;
+
+        if (!runBench(benches[i].name, benches[i].build, true))
+            return -1;
+    }
+
+    return 0;
+}
@@ -364,7 +364,7 @@ StaticLibrary {
 
     Env = { 
         
-        CPPPATH = { "api/include" },
+        CPPPATH = { "api/include", "src/native/external/libuv/include" },
         CCOPTS = {
             "-Wno-visibility",
             "-Wno-conversion", 
@@ -417,6 +417,7 @@ StaticLibrary {
 
     Sources = { 
             "api/src/remote/remote_connection.c",
+            "api/src/remote/pd_profiler.c",
     },
 
 	IdeGenerationHints = { Msvc = { SolutionFolder = "Libs" } },
@@ -636,6 +637,31 @@ StaticLibrary {
 
 -----------------------------------------------------------------------------------------------------------------------
 
+StaticLibrary {
+    Name = "headless_native",
+
+    Env = { 
+        CXXOPTS = {
+        	{ "-Wno-everything"; Config = "macosx-*-*" },
+        },
+
+        CPPPATH = { 
+        	"api/include",
+        },
+    },
+
+    Sources = { 
+        Glob {
+            Dir = "src/native/headless",
+            Extensions = { ".c", ".cpp", ".h" },
+        },
+    },
+
+	IdeGenerationHints = { Msvc = { SolutionFolder = "Libs" } },
+}
+
+-----------------------------------------------------------------------------------------------------------------------
+
 --[[
 
 StaticLibrary {
@@ -22,6 +22,10 @@ Program {
             "-Wno-switch-enum",
             "-Wno-format-nonliteral"; Config = "macosx-*-*" },
         },
+
+		PROGCOM = {
+			{ "-lm -lpthread -ldl -lrt"; Config = "linux-*-*" },
+		},
     },
 
     Sources = { 
@@ -31,9 +35,9 @@ Program {
         },
     },
 
-    Libs = { { "wsock32.lib", "kernel32.lib" ; Config = { "win32-*-*", "win64-*-*" } } },
+    Libs = { { "Ws2_32.lib", "psapi.lib", "iphlpapi.lib", "wsock32.lib", "kernel32.lib", "user32.lib", "Advapi32.lib" ; Config = { "win32-*-*", "win64-*-*" } } },
 
-    Depends = { "remote_api" },
+    Depends = { "remote_api", "uv" },
 
 	IdeGenerationHints = { Msvc = { SolutionFolder = "Misc" } },
 }
@@ -80,7 +84,7 @@ Program {
 
 		PROGCOM = {
 			{ "-lstdc++"; Config = { "macosx-clang-*", "linux-gcc-*" } },
-			{ "-lm -lpthread"; Config = "linux-*-*" },
+			{ "-lm -lpthread -ldl -lrt"; Config = "linux-*-*" },
 		},
     },
 
@@ -91,9 +95,9 @@ Program {
         },
     },
 
-    Libs = { { "wsock32.lib", "kernel32.lib" ; Config = { "win32-*-*", "win64-*-*" } } },
+    Libs = { { "Ws2_32.lib", "psapi.lib", "iphlpapi.lib", "wsock32.lib", "kernel32.lib", "user32.lib", "Advapi32.lib" ; Config = { "win32-*-*", "win64-*-*" } } },
 
-    Depends = { "remote_api", "angelscript", "as_debugger" },
+    Depends = { "remote_api", "angelscript", "as_debugger", "uv" },
 
 	IdeGenerationHints = { Msvc = { SolutionFolder = "Addons" } },
 }
@@ -393,6 +393,48 @@ SharedLibrary {
 	IdeGenerationHints = { Msvc = { SolutionFolder = "Plugins" } },
 }
 
+-----------------------------------------------------------------------------------------------------------------------
+
+SharedLibrary {
+    Name = "replay_backend_plugin",
+
+    Env = {
+        CPPPATH = {
+        	".",
+        	"api/include",
+        	"src/native/external/libuv/include",
+        },
+    	CXXOPTS = { { "-fPIC"; Config = "linux-gcc"; }, },
+    },
+
+    Sources = { "src/plugins/replay_backend/replay_backend.c" },
+
+    Depends = { "remote_api", "uv" },
+
+	IdeGenerationHints = { Msvc = { SolutionFolder = "Plugins" } },
+}
+
+
+-----------------------------------------------------------------------------------------------------------------------
+
+SharedLibrary {
+    Name = "remote_backend_plugin",
+
+    Env = {
+        CPPPATH = {
+        	".",
+        	"api/include",
+        	"src/native/external/libuv/include",
+        },
+    	CXXOPTS = { { "-fPIC"; Config = "linux-gcc"; }, },
+    },
+
+    Sources = { "src/plugins/remote_backend/remote_backend.c" },
+
+    Depends = { "remote_api", "uv" },
+
+	IdeGenerationHints = { Msvc = { SolutionFolder = "Plugins" } },
+}
 
 -----------------------------------------------------------------------------------------------------------------------
 
@@ -418,5 +460,7 @@ Default "c64_vice_plugin"
 Default "amiga_uae_plugin"
 Default "bitmap_memory"
 Default "dummy_backend_plugin"
+Default "replay_backend_plugin"
+Default "remote_backend_plugin"
 --Default "i3_docking"
 
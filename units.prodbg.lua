@@ -80,7 +80,7 @@ RustProgram {
 		"src/prodbg/build.rs",
 	},
 
-    Depends = { "lua", "remote_api", "stb", "bgfx", "bgfx_rs", "ui",
+    Depends = { "lua", "remote_api", "remotery", "stb", "bgfx", "bgfx_rs", "ui",
     			"imgui", "scintilla", "tinyxml2", "capstone", "imgui_sys", "core" },
 }
 
@@ -96,12 +96,26 @@ RustProgram {
 		"src/prodbg/build.rs",
 	},
 
-    Depends = { "lua", "remote_api", "stb", "bgfx", "bgfx_rs", "ui",
+    Depends = { "lua", "remote_api", "remotery", "stb", "bgfx", "bgfx_rs", "ui",
     			"imgui", "scintilla", "tinyxml2", "capstone", "imgui_sys", "core", "viewdock" },
 }
 
 -----------------------------------------------------------------------------------------------------------------------
 
+-- Runs sessions and views without a window for benchmarking (see src/prodbg/headless/src/script.rs)
+
+RustProgram {
+	Name = "headless",
+	CargoConfig = "src/prodbg/headless/Cargo.toml",
+	Sources = {
+		get_rs_src("src/prodbg/headless"),
+	},
+
+    Depends = { "remote_api", "remotery", "headless_native", "core" },
+}
+
+-----------------------------------------------------------------------------------------------------------------------
+
 local prodbgBundle = OsxBundle
 {
 	Depends = { "prodbg" },
@@ -137,8 +151,10 @@ local uiBundle = OsxBundle
 if native.host_platform == "macosx" then
 	Default(prodbgBundle)
 	Default(uiBundle)
+	Default "headless"
 else
 	Default "prodbg"
 	Default "ui_testbench"
+	Default "headless"
 end
 
@@ -17,7 +17,10 @@ local function Test(params)
 				"src/external/minifb/include",
             	"src/external/imgui",
 				"src/external/cmocka/include",
+				"src/native/external/cmocka/include",
+				"src/native/external/libuv/include",
 				"src/prodbg",
+				".",
 			},
 
 			PROGCOM = {
@@ -54,8 +57,8 @@ local all_depends = { "uv", "api", "core", "stb", "remote_api", "cmocka", "sessi
 Test({ Name = "capstone_tests", Source = "src/prodbg/tests/capstone_tests.cpp", Depends = { "core", "stb", "uv", "cmocka", "foundation_lib", "jansson", "capstone"} })
 Test({ Name = "core_tests", Source = "src/prodbg/tests/core_tests.cpp", Depends = { "core", "stb", "uv", "cmocka", "foundation_lib", "jansson"} })
 Test({ Name = "lldb_tests", Source = "src/prodbg/tests/lldb_tests.cpp", Depends = all_depends})
-Test({ Name = "readwrite_tests", Source = "src/prodbg/tests/readwrite_tests.cpp", Depends = all_depends})
-Test({ Name = "remote_api_tests", Source = "src/prodbg/tests/remote_api_tests.cpp", Depends = all_depends})
+Test({ Name = "readwrite_tests", Source = "src/tests/native/readwrite_tests.cpp", Depends = { "remote_api", "uv", "cmocka" } })
+Test({ Name = "remote_api_tests", Source = "src/tests/native/remote_api_tests.cpp", Depends = { "remote_api", "uv", "cmocka", "headless_native" } })
 Test({ Name = "session_tests", Source = "src/prodbg/tests/session_tests.cpp", Depends = all_depends})
 Test({ Name = "ui_docking_tests", Source = "src/prodbg/tests/ui_docking_tests.cpp", Depends = all_depends})
 Test({ Name = "ui_tests", Source = "src/prodbg/tests/ui_tests.cpp", Depends = all_depends})
@@ -63,6 +66,10 @@ Test({ Name = "dbgeng_tests", Source = "src/prodbg/tests/dbgeng_tests.cpp", Depe
 Test({ Name = "c64_vice_tests", Source = "src/prodbg/tests/c64_vice_tests.cpp", Depends = all_depends })
 Test({ Name = "rust_api_tests", Source = "src/prodbg/tests/rust_api_tests.cpp", Depends = all_depends })
 
+-- Benchmarks, not run by default
+
+Test({ Name = "remote_compression_bench", Source = "src/tests/native/remote_compression_bench.cpp", Depends = { "remote_api", "uv" } })
+
 -----------------------------------------------------------------------------------------------------------------------
 
 Default "core_tests"